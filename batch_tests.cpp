@@ -0,0 +1,79 @@
+#include "regression_tests.h"
+
+#include <algorithm>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+const float BATCH_TOLERANCE = 1e-5f; // colors interleave differently across bodies, so agreement is to rounding
+
+// batch: two sheets packed into one Tissue, around a body with no source, end where the sheets stepped on their
+// own do; the empty body is refused and stays empty
+int testBatch()
+{
+    Tissue first(EDGE_COUNT, 1);
+    Tissue second(EDGE_COUNT / 2, 1);
+    const glm::vec3 offset(2.0f, 0.0f, 0.0f);
+    std::vector<TissueInstance> instances = {
+        { &first, glm::vec3(0.0f), 1.0f },
+        { nullptr, glm::vec3(0.0f), 1.0f },
+        { &second, offset, 1.0f }
+    };
+    Tissue batch(instances);
+    if (batch.getBodyCount() != 3 || batch.getBodyBegin(1) != batch.getBodyEnd(1)
+        || batch.getVertexCount() != first.getVertexCount() + second.getVertexCount())
+    {
+        std::cout << "FAIL bodies are not laid out as sheet, empty, sheet" << std::endl;
+        return 1;
+    }
+    for (int s = 0; s < STEPS; s++)
+    {
+        drag(first, s);
+        first.step(DELTA_TIME, GRAVITY);
+        second.step(DELTA_TIME, GRAVITY);
+        // the same drag on the first body's corner, which keeps its index in the batch
+        drag(batch, s);
+        batch.step(DELTA_TIME, GRAVITY);
+    }
+
+    float deviation = 0.0f;
+    for (int i = 0; i < first.getVertexCount(); i++)
+    {
+        deviation = std::max(deviation, glm::length(batch.positions.get(batch.getBodyBegin(0) + i) - first.positions.get(i)));
+    }
+    for (int i = 0; i < second.getVertexCount(); i++)
+    {
+        deviation = std::max(deviation, glm::length(batch.positions.get(batch.getBodyBegin(2) + i) - offset - second.positions.get(i)));
+    }
+    if (!(deviation <= BATCH_TOLERANCE))
+    {
+        std::cout << "FAIL batched bodies are " << deviation << " from the separate sheets" << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+// batch-empty: an empty list or only unusable bodies give an empty tissue that steps and keeps one empty body
+int testBatchEmpty()
+{
+    Tissue implicitGrid(EDGE_COUNT, 1, 0.001f, Integrator::PBD, VertexOrder::Build, GridConstraints::Implicit);
+    const std::vector<std::vector<TissueInstance>> batches = {
+        {},
+        { { nullptr, glm::vec3(0.0f), 1.0f } },
+        { { &implicitGrid, glm::vec3(0.0f), 1.0f }, { nullptr, glm::vec3(0.0f), 1.0f } }
+    };
+    for (const std::vector<TissueInstance>& instances : batches)
+    {
+        Tissue batch(instances);
+        batch.step(DELTA_TIME, GRAVITY);
+        if (batch.getVertexCount() != 0 || batch.getBodyCount() < 1)
+        {
+            std::cout << "FAIL a batch of " << instances.size() << " unusable bodies is not empty" << std::endl;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static RegressionCase batch("batch", testBatch);
+static RegressionCase batchEmpty("batch-empty", testBatchEmpty);
@@ -0,0 +1,716 @@
+#include "tissue.h"
+#include "sdf_obstacle.h"
+#include "vertex_picker.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <numeric>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Per-stage microbenchmarks for Tissue across grid sizes.
+// Usage: Benchmark [--min-edge N] [--max-edge N] [--threads N] [--csv] [--out file] [--orderings] [--grid explicit|implicit]
+//                  [--convergence] [--sleep] [--scene]
+// Every stage is timed on its own for a serial (1 thread) and a parallel solver; results
+// are written as JSON (default) or CSV so runs can be diffed between releases. findCollisionPairs is the
+// self-collision broad phase with a thickness of SELF_COLLISION_EDGES, SolveObstacleConstraints one pass against
+// an OBSTACLE_RADIUS sphere through the middle of the sheet; "step" runs with neither. VertexPicker::refit reboxes
+// every vertex (all tiles changed), VertexPicker::pick casts a ray of PICK_RADIUS_EDGES through the middle vertex.
+// --grid implicit runs the same stages with GridConstraints::Implicit (no stored constraints).
+// --orderings instead compares vertex orders (VertexOrder) on one thread: the grid as built,
+// Morton and RCM, and the same three after a random shuffle, which is what an unordered
+// imported mesh looks like to the solver.
+// --convergence drags a corner of the sheet and records the residual against solver wall time after every
+// iteration, for plain Gauss-Seidel sweeps ("flat") and for multigrid V-cycles over every coarse level ("multigrid").
+// --sleep lets a weightless sheet come to rest, then circles one corner with the mouse-drag commands and times the
+// steps with sleeping off and on, along with the awake and uploaded (changed) share of the vertices.
+// --scene steps SCENE_PATCHES small sheets one Tissue at a time ("separate") and packed into one batched Tissue
+// ("batched"), for every patch size in SCENE_EDGE_COUNTS, and checks both end up in the same place.
+
+const int EDGE_COUNTS[] = { 40, 64, 128, 256, 512, 1024, 2048 };
+const unsigned int MAX_EDGE_WIDTH = 1;
+const float DELTA_TIME = 1.0f / 60.0f;
+const double MIN_STAGE_SECONDS = 0.2; // keep sampling a stage until this much time was spent
+const int MIN_SAMPLES = 5;
+const int MAX_SAMPLES = 1000;
+const int RESTORE_EVERY = 8;          // samples of a per-stage benchmark between restores of the settled sheet
+const unsigned int SHUFFLE_SEED = 1234;
+const int CONVERGENCE_FLAT_SWEEPS = 200;
+const int CONVERGENCE_VCYCLES = 40;
+const float CONVERGENCE_DRAG = 0.25f; // corner offset, as a fraction of the sheet width
+const int SLEEP_SETTLE_STEPS = 60;    // before the drag starts, > SLEEP_STEPS
+const int SLEEP_DRAG_STEPS = 240;
+const float SLEEP_VELOCITY = 0.01f;   // Tissue::sleepVelocity, sheet widths per second
+const float SLEEP_RESIDUAL = 0.01f;   // Tissue::sleepResidual, in edge lengths
+const float SLEEP_DRAG_RADIUS = 4.0f; // of the dragged corner's circle, in edge lengths
+const float SELF_COLLISION_EDGES = 1.0f; // thickness of the findCollisionPairs stage, in edge lengths
+const float OBSTACLE_RADIUS = 0.25f;     // sphere of the SolveObstacleConstraints stage, the grid is 1 wide
+const int OBSTACLE_RESOLUTION = 64;
+const float PICK_RADIUS_EDGES = 1.0f;
+const int SCENE_EDGE_COUNTS[] = { 8, 16, 32, 64 };
+const int SCENE_PATCHES = 64;
+const int SCENE_STEPS = 60;           // stepped in both layouts before the positions are compared
+
+struct StageResult
+{
+    int edgeCount;
+    int vertices;
+    int constraints;
+    size_t constraintBytes;  // Tissue::getConstraintMemoryBytes
+    std::string grid;        // explicit | implicit
+    int threads;
+    std::string integrator;
+    std::string stage;
+    int samples;
+    double minNs;
+    double medianNs;
+    double nsPerVertex;      // median / vertices
+    double nsPerConstraint;  // median / constraints, solver stages only
+};
+
+struct OrderingResult
+{
+    int edgeCount;
+    int vertices;
+    int constraints;
+    std::string order;
+    double meanEndpointGap;     // mean |first - second| over constraints, in vertices
+    double meanGatherStride;    // mean |first[i] - first[i-1]| in sweep order, how far consecutive gathers jump
+    double solveMedianNs;       // one SolveAllStretchConstraints sweep
+    double stepMedianNs;
+    double solveSpeedup;        // against the build order
+    double stepSpeedup;
+};
+
+struct ConvergenceResult
+{
+    int edgeCount;
+    std::string solver;     // flat | multigrid
+    int levels;             // coarse levels, 0 for flat
+    int iteration;          // sweeps or V-cycles so far
+    double elapsedMs;       // solver wall time so far
+    float residualMax;      // of the iteration's last fine sweep
+    float residualRms;
+};
+
+struct SleepResult
+{
+    int edgeCount;
+    int vertices;
+    bool sleeping;
+    double stepMedianNs;
+    double stepMeanNs;
+    double awakeFraction;   // mean over the drag steps
+    double uploadFraction;  // vertices in Tissue::getChangedRanges after each step, mean
+};
+
+struct SceneResult
+{
+    int edgeCount;          // of one patch
+    int patches;
+    int vertices;           // all patches
+    std::string layout;     // separate | batched
+    int threads;
+    double stepMedianNs;    // every patch one step
+    double nsPerVertex;
+    float maxDeviation;     // from the separate patches after SCENE_STEPS steps, 0 for separate
+};
+
+// the settled sheet the per-stage benchmarks start from. Stages run out of step() order on one tissue, so without
+// it addGravity keeps speeding the sheet up and every later stage times a stretched or torn one
+struct SettledState
+{
+    Vec3Streams positions;
+    Vec3Streams estimatedPositions;
+    Vec3Streams velocities;
+
+    explicit SettledState(const Tissue& tissue)
+        : positions(tissue.positions), estimatedPositions(tissue.estimatedPositions), velocities(tissue.velocities) {}
+
+    void restore(Tissue& tissue) const
+    {
+        tissue.positions = positions;
+        tissue.estimatedPositions = estimatedPositions;
+        tissue.velocities = velocities;
+        tissue.wakeAll();
+    }
+};
+
+// times fn until MIN_STAGE_SECONDS and MIN_SAMPLES are reached; reset runs untimed before the warm-up and then
+// every RESTORE_EVERY samples
+template<typename F, typename R>
+std::vector<double> sample(F&& fn, R&& reset)
+{
+    std::vector<double> samples;
+    double spent = 0.0;
+    reset();
+    fn(); // warm up caches and the thread pool
+    while ((spent < MIN_STAGE_SECONDS || samples.size() < MIN_SAMPLES) && samples.size() < MAX_SAMPLES)
+    {
+        if (samples.size() % RESTORE_EVERY == RESTORE_EVERY - 1) reset();
+        auto start = std::chrono::steady_clock::now();
+        fn();
+        auto end = std::chrono::steady_clock::now();
+        double ns = std::chrono::duration<double, std::nano>(end - start).count();
+        samples.push_back(ns);
+        spent += ns * 1e-9;
+    }
+    return samples;
+}
+
+template<typename F>
+std::vector<double> sample(F&& fn)
+{
+    return sample(fn, []() {});
+}
+
+StageResult summarize(const Tissue& tissue, const std::string& integrator, const std::string& stage, std::vector<double> samples, bool perConstraint)
+{
+    std::sort(samples.begin(), samples.end());
+    StageResult result;
+    result.edgeCount = tissue.getEdgeCount();
+    result.vertices = tissue.getVertexCount();
+    result.constraints = tissue.getConstraintCount();
+    result.constraintBytes = tissue.getConstraintMemoryBytes();
+    result.grid = tissue.getGridConstraints() == GridConstraints::Implicit ? "implicit" : "explicit";
+    result.threads = tissue.getThreadCount();
+    result.integrator = integrator;
+    result.stage = stage;
+    result.samples = (int)samples.size();
+    result.minNs = samples.front();
+    result.medianNs = samples[samples.size() / 2];
+    result.nsPerVertex = result.medianNs / result.vertices;
+    result.nsPerConstraint = perConstraint ? result.medianNs / result.constraints : 0.0;
+    return result;
+}
+
+void benchmarkEdgeCount(int edgeCount, int threads, GridConstraints constraints, std::vector<StageResult>& results)
+{
+    // construction, including createStretchConstraints and coloring
+    std::vector<double> buildSamples;
+    for (int i = 0; i < MIN_SAMPLES; i++)
+    {
+        auto start = std::chrono::steady_clock::now();
+        Tissue tissue(edgeCount, MAX_EDGE_WIDTH, 0.001f, Integrator::PBD, VertexOrder::Build, constraints);
+        auto end = std::chrono::steady_clock::now();
+        buildSamples.push_back(std::chrono::duration<double, std::nano>(end - start).count());
+    }
+
+    const Integrator integrators[] = { Integrator::PBD, Integrator::XPBD };
+    for (Integrator integrator : integrators)
+    {
+        std::string name = integrator == Integrator::PBD ? "PBD" : "XPBD";
+        Tissue tissue(edgeCount, MAX_EDGE_WIDTH, 0.001f, integrator, VertexOrder::Build, constraints);
+        if (integrator == Integrator::PBD) results.push_back(summarize(tissue, name, "construction", buildSamples, true));
+
+        // settle for a few frames so the solver sees a deformed sheet, not the rest state; every stage starts there
+        for (int frame = 0; frame < 5; frame++) tissue.step(DELTA_TIME, glm::vec3(0.0f, -0.5f, 0.0f));
+        const SettledState settled(tissue);
+        auto restore = [&]() { settled.restore(tissue); };
+
+        std::vector<int> threadCounts = { 1 };
+        if (threads > 1) threadCounts.push_back(threads);
+        for (int t : threadCounts)
+        {
+            tissue.setThreadCount(t);
+
+            if (integrator == Integrator::PBD)
+            {
+                results.push_back(summarize(tissue, name, "addGravity",
+                    sample([&]() { tissue.addGravity(DELTA_TIME, glm::vec3(0.0f, -0.5f, 0.0f)); }, restore), false));
+                results.push_back(summarize(tissue, name, "applyDamping",
+                    sample([&]() { tissue.applyDamping(tissue.dampingFactor); }, restore), false));
+                results.push_back(summarize(tissue, name, "updateEstimatedPositions",
+                    sample([&]() { tissue.updateEstimatedPositions(DELTA_TIME); }, restore), false));
+
+                // the broad phase only; off again below so "step" stays comparable between releases
+                tissue.selfCollisionThickness = SELF_COLLISION_EDGES / (edgeCount - 1);
+                results.push_back(summarize(tissue, name, "findCollisionPairs",
+                    sample([&]() { tissue.findCollisionPairs(); }, restore), false));
+                tissue.selfCollisionThickness = 0.0f;
+
+                SdfObstacle obstacle;
+                obstacle.bakeSphere(OBSTACLE_RADIUS, OBSTACLE_RESOLUTION);
+                obstacle.setPose(glm::mat3(1.0f), tissue.positions.get(tissue.getVertexIndex(edgeCount / 2 * edgeCount + edgeCount / 2)));
+                tissue.addObstacle(&obstacle);
+                results.push_back(summarize(tissue, name, "SolveObstacleConstraints",
+                    sample([&]() { tissue.SolveObstacleConstraints(); }, restore), false));
+                tissue.removeObstacle(&obstacle);
+
+                VertexPicker picker(tissue);
+                results.push_back(summarize(tissue, name, "VertexPicker::refit",
+                    sample([&]() { tissue.wakeAll(); picker.refit(); }, restore), false));
+                glm::vec3 middle = tissue.positions.get(tissue.getVertexIndex(edgeCount / 2 * edgeCount + edgeCount / 2));
+                PickRay ray = { middle - glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.0f, 0.0f, 1.0f), PICK_RADIUS_EDGES / (edgeCount - 1) };
+                results.push_back(summarize(tissue, name, "VertexPicker::pick",
+                    sample([&]() { picker.pick(ray); }, restore), false));
+            }
+            results.push_back(summarize(tissue, name, "SolveAllStretchConstraints",
+                sample([&]() { tissue.SolveAllStretchConstraints(); }, restore), true));
+            if (integrator == Integrator::PBD)
+            {
+                results.push_back(summarize(tissue, name, "updateVelocitiesAndPositions",
+                    sample([&]() { tissue.updateVelocitiesAndPositions(DELTA_TIME); }, restore), false));
+            }
+            results.push_back(summarize(tissue, name, "step",
+                sample([&]() { tissue.step(DELTA_TIME, glm::vec3(0.0f, -0.5f, 0.0f)); }, restore), true));
+        }
+
+        const StageResult& step = results.back();
+        std::cerr << "edgeCount " << edgeCount << " " << name << " done (step " << step.medianNs * 1e-6 << " ms at "
+                  << step.threads << " threads)" << std::endl;
+    }
+}
+
+double median(std::vector<double> samples)
+{
+    std::sort(samples.begin(), samples.end());
+    return samples[samples.size() / 2];
+}
+
+void benchmarkOrderings(int edgeCount, std::vector<OrderingResult>& results)
+{
+    struct Variant { const char* name; bool shuffle; VertexOrder order; };
+    const Variant variants[] = {
+        { "build", false, VertexOrder::Build },
+        { "morton", false, VertexOrder::Morton },
+        { "rcm", false, VertexOrder::RCM },
+        { "shuffled", true, VertexOrder::Build },
+        { "shuffled+morton", true, VertexOrder::Morton },
+        { "shuffled+rcm", true, VertexOrder::RCM }
+    };
+
+    size_t first = results.size();
+    for (const Variant& variant : variants)
+    {
+        Tissue tissue(edgeCount, MAX_EDGE_WIDTH);
+        if (variant.shuffle)
+        {
+            std::vector<int> newIndex(tissue.getVertexCount());
+            std::iota(newIndex.begin(), newIndex.end(), 0);
+            std::shuffle(newIndex.begin(), newIndex.end(), std::mt19937(SHUFFLE_SEED));
+            tissue.permuteVertices(newIndex);
+        }
+        tissue.reorderVertices(variant.order);
+        for (int frame = 0; frame < 5; frame++) tissue.step(DELTA_TIME, glm::vec3(0.0f, -0.5f, 0.0f));
+
+        OrderingResult result;
+        result.edgeCount = edgeCount;
+        result.vertices = tissue.getVertexCount();
+        result.constraints = tissue.getConstraintCount();
+        result.order = variant.name;
+
+        const std::vector<int>& a = tissue.getConstraintFirst();
+        const std::vector<int>& b = tissue.getConstraintSecond();
+        double gap = 0.0, stride = 0.0;
+        for (size_t i = 0; i < a.size(); i++)
+        {
+            gap += std::abs(a[i] - b[i]);
+            if (i > 0) stride += std::abs(a[i] - a[i - 1]);
+        }
+        result.meanEndpointGap = gap / a.size();
+        result.meanGatherStride = stride / std::max<size_t>(1, a.size() - 1);
+
+        result.solveMedianNs = median(sample([&]() { tissue.SolveAllStretchConstraints(); }));
+        result.stepMedianNs = median(sample([&]() { tissue.step(DELTA_TIME, glm::vec3(0.0f, -0.5f, 0.0f)); }));
+        result.solveSpeedup = results.size() > first ? results[first].solveMedianNs / result.solveMedianNs : 1.0;
+        result.stepSpeedup = results.size() > first ? results[first].stepMedianNs / result.stepMedianNs : 1.0;
+        results.push_back(result);
+
+        std::cerr << "edgeCount " << edgeCount << " " << variant.name << ": sweep " << result.solveMedianNs * 1e-6 << " ms ("
+                  << result.solveSpeedup << "x), step " << result.stepMedianNs * 1e-6 << " ms (" << result.stepSpeedup << "x)" << std::endl;
+    }
+}
+
+// The same dragged sheet for both solvers: from rest, pull a free corner out of the plane and pin it there,
+// predict one frame, then iterate on that frame's constraints and log the residual as it falls.
+void benchmarkConvergence(int edgeCount, int threads, std::vector<ConvergenceResult>& results)
+{
+    const int variants[] = { 0, 32 }; // multigrid levels; 32 = as many as the grid allows
+    for (int levels : variants)
+    {
+        Tissue tissue(edgeCount, MAX_EDGE_WIDTH);
+        tissue.setThreadCount(threads);
+        int corner = tissue.getVertexIndex(edgeCount - 1);
+        tissue.positions.set(corner, tissue.positions.get(corner) + glm::vec3(0.0f, 0.0f, CONVERGENCE_DRAG * MAX_EDGE_WIDTH));
+        tissue.setVertexFixed(corner, true);
+        tissue.addGravity(DELTA_TIME, glm::vec3(0.0f, -0.5f, 0.0f));
+        tissue.applyDamping(tissue.dampingFactor);
+        tissue.updateEstimatedPositions(DELTA_TIME);
+        tissue.setMultigridLevels(levels);
+
+        std::string name = levels > 0 ? "multigrid" : "flat";
+        int iterations = levels > 0 ? CONVERGENCE_VCYCLES : CONVERGENCE_FLAT_SWEEPS;
+        double elapsed = 0.0;
+        // ms until the max residual first drops below one edge length, and below a quarter of one
+        double reachedEdge = -1.0, reachedQuarter = -1.0;
+        float edge = MAX_EDGE_WIDTH / (edgeCount - 1.0f);
+        for (int i = 1; i <= iterations; i++)
+        {
+            auto start = std::chrono::steady_clock::now();
+            ConstraintResidual residual = tissue.SolveAllStretchConstraints();
+            elapsed += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            results.push_back({ edgeCount, name, tissue.getMultigridLevels(), i, elapsed, residual.max, residual.rms });
+            if (reachedEdge < 0.0 && residual.max < edge) reachedEdge = elapsed;
+            if (reachedQuarter < 0.0 && residual.max < 0.25f * edge) reachedQuarter = elapsed;
+        }
+
+        const ConvergenceResult& last = results.back();
+        std::cerr << "edgeCount " << edgeCount << " " << name << ": residual max " << last.residualMax << " after " << last.iteration
+                  << " iterations, " << last.elapsedMs << " ms; below 1 edge after "
+                  << (reachedEdge >= 0.0 ? std::to_string(reachedEdge) + " ms" : "never") << ", below 1/4 edge after "
+                  << (reachedQuarter >= 0.0 ? std::to_string(reachedQuarter) + " ms" : "never") << std::endl;
+    }
+}
+
+// A small interaction on a large resting tissue: with sleeping on, the cost should follow the area the drag keeps awake.
+void benchmarkSleep(int edgeCount, int threads, std::vector<SleepResult>& results)
+{
+    float edge = MAX_EDGE_WIDTH / (edgeCount - 1.0f);
+    for (bool sleeping : { false, true })
+    {
+        Tissue tissue(edgeCount, MAX_EDGE_WIDTH);
+        tissue.setThreadCount(threads);
+        tissue.sleepVelocity = sleeping ? SLEEP_VELOCITY * MAX_EDGE_WIDTH : 0.0f;
+        tissue.sleepResidual = SLEEP_RESIDUAL * edge;
+        for (int s = 0; s < SLEEP_SETTLE_STEPS; s++) tissue.step(DELTA_TIME, glm::vec3(0.0f));
+
+        // the free bottom left corner goes round a circle out of the plane, one drag command per step
+        int corner = tissue.getVertexIndex(0);
+        glm::vec3 previous(0.0f);
+        std::vector<double> stepNs;
+        std::vector<std::pair<int, int>> ranges;
+        double awake = 0.0, uploaded = 0.0;
+        for (int s = 0; s < SLEEP_DRAG_STEPS; s++)
+        {
+            float angle = 6.2831853f * s / SLEEP_DRAG_STEPS * 4.0f;
+            glm::vec3 offset = SLEEP_DRAG_RADIUS * edge * glm::vec3(std::cos(angle) - 1.0f, 0.0f, std::sin(angle));
+            uint64_t version = tissue.getPositionVersion();
+
+            auto start = std::chrono::steady_clock::now();
+            tissue.positions.set(corner, tissue.positions.get(corner) + offset - previous);
+            tissue.setVertexFixed(corner, true);
+            tissue.step(DELTA_TIME, glm::vec3(0.0f));
+            stepNs.push_back(std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count());
+            previous = offset;
+
+            awake += tissue.getAwakeVertexCount();
+            tissue.getChangedRanges(version, ranges);
+            for (const std::pair<int, int>& range : ranges) uploaded += range.second - range.first;
+        }
+
+        SleepResult result;
+        result.edgeCount = edgeCount;
+        result.vertices = tissue.getVertexCount();
+        result.sleeping = sleeping;
+        result.stepMeanNs = std::accumulate(stepNs.begin(), stepNs.end(), 0.0) / stepNs.size();
+        std::sort(stepNs.begin(), stepNs.end());
+        result.stepMedianNs = stepNs[stepNs.size() / 2];
+        result.awakeFraction = awake / SLEEP_DRAG_STEPS / result.vertices;
+        result.uploadFraction = uploaded / SLEEP_DRAG_STEPS / result.vertices;
+        results.push_back(result);
+
+        std::cerr << "edgeCount " << edgeCount << (sleeping ? " sleeping" : " awake") << ": step " << result.stepMedianNs * 1e-6
+                  << " ms median, " << result.stepMeanNs * 1e-6 << " ms mean, " << result.awakeFraction * 100.0 << "% awake, "
+                  << result.uploadFraction * 100.0 << "% uploaded" << std::endl;
+    }
+}
+
+// Many small patches: one Tissue each pays the per-step overhead (passes, colors, thread pool handoffs) per patch,
+// the batched Tissue pays it once.
+void benchmarkScene(int edgeCount, int threads, std::vector<SceneResult>& results)
+{
+    std::vector<std::unique_ptr<Tissue>> separate;
+    std::vector<TissueInstance> instances;
+    for (int p = 0; p < SCENE_PATCHES; p++)
+    {
+        separate.emplace_back(new Tissue(edgeCount, MAX_EDGE_WIDTH));
+        separate.back()->setThreadCount(threads);
+        instances.push_back({ separate.back().get(), glm::vec3(0.0f), 1.0f });
+    }
+    Tissue batched(instances);
+    batched.setThreadCount(threads);
+
+    for (int s = 0; s < SCENE_STEPS; s++)
+    {
+        for (std::unique_ptr<Tissue>& tissue : separate) tissue->step(DELTA_TIME, glm::vec3(0.0f, -0.5f, 0.0f));
+        batched.step(DELTA_TIME, glm::vec3(0.0f, -0.5f, 0.0f));
+    }
+    float deviation = 0.0f;
+    for (int p = 0; p < SCENE_PATCHES; p++)
+    {
+        for (int i = 0; i < separate[p]->getVertexCount(); i++)
+        {
+            glm::vec3 difference = batched.positions.get(batched.getBodyBegin(p) + i) - separate[p]->positions.get(i);
+            deviation = std::max(deviation, glm::length(difference));
+        }
+    }
+
+    for (bool batch : { false, true })
+    {
+        std::vector<double> samples = sample([&]() {
+            if (batch) batched.step(DELTA_TIME, glm::vec3(0.0f, -0.5f, 0.0f));
+            else for (std::unique_ptr<Tissue>& tissue : separate) tissue->step(DELTA_TIME, glm::vec3(0.0f, -0.5f, 0.0f));
+        });
+        std::sort(samples.begin(), samples.end());
+
+        SceneResult result;
+        result.edgeCount = edgeCount;
+        result.patches = SCENE_PATCHES;
+        result.vertices = batched.getVertexCount();
+        result.layout = batch ? "batched" : "separate";
+        result.threads = threads;
+        result.stepMedianNs = samples[samples.size() / 2];
+        result.nsPerVertex = result.stepMedianNs / result.vertices;
+        result.maxDeviation = batch ? deviation : 0.0f;
+        results.push_back(result);
+
+        std::cerr << "edgeCount " << edgeCount << " x " << SCENE_PATCHES << " " << result.layout << ": step " << result.stepMedianNs * 1e-6
+                  << " ms median, " << result.nsPerVertex << " ns/vertex";
+        if (batch) std::cerr << ", max deviation " << deviation;
+        std::cerr << std::endl;
+    }
+}
+
+void writeSceneJson(std::ostream& out, const std::vector<SceneResult>& results)
+{
+    out << "{\n";
+    out << "  \"simd\": \"" << Tissue::getSimdName() << "\",\n";
+    out << "  \"scene\": [\n";
+    for (size_t i = 0; i < results.size(); i++)
+    {
+        const SceneResult& r = results[i];
+        out << "    {\"edgeCount\": " << r.edgeCount
+            << ", \"patches\": " << r.patches
+            << ", \"vertices\": " << r.vertices
+            << ", \"layout\": \"" << r.layout << "\""
+            << ", \"threads\": " << r.threads
+            << ", \"stepMedianNs\": " << r.stepMedianNs
+            << ", \"nsPerVertex\": " << r.nsPerVertex
+            << ", \"maxDeviation\": " << r.maxDeviation
+            << "}" << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    out << "  ]\n}\n";
+}
+
+void writeSceneCsv(std::ostream& out, const std::vector<SceneResult>& results)
+{
+    out << "simd,edgeCount,patches,vertices,layout,threads,stepMedianNs,nsPerVertex,maxDeviation\n";
+    for (const SceneResult& r : results)
+    {
+        out << Tissue::getSimdName() << "," << r.edgeCount << "," << r.patches << "," << r.vertices << "," << r.layout << ","
+            << r.threads << "," << r.stepMedianNs << "," << r.nsPerVertex << "," << r.maxDeviation << "\n";
+    }
+}
+
+void writeSleepJson(std::ostream& out, const std::vector<SleepResult>& results)
+{
+    out << "{\n";
+    out << "  \"simd\": \"" << Tissue::getSimdName() << "\",\n";
+    out << "  \"sleep\": [\n";
+    for (size_t i = 0; i < results.size(); i++)
+    {
+        const SleepResult& r = results[i];
+        out << "    {\"edgeCount\": " << r.edgeCount
+            << ", \"vertices\": " << r.vertices
+            << ", \"sleeping\": " << (r.sleeping ? "true" : "false")
+            << ", \"stepMedianNs\": " << r.stepMedianNs
+            << ", \"stepMeanNs\": " << r.stepMeanNs
+            << ", \"awakeFraction\": " << r.awakeFraction
+            << ", \"uploadFraction\": " << r.uploadFraction
+            << "}" << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    out << "  ]\n}\n";
+}
+
+void writeSleepCsv(std::ostream& out, const std::vector<SleepResult>& results)
+{
+    out << "simd,edgeCount,vertices,sleeping,stepMedianNs,stepMeanNs,awakeFraction,uploadFraction\n";
+    for (const SleepResult& r : results)
+    {
+        out << Tissue::getSimdName() << "," << r.edgeCount << "," << r.vertices << "," << (r.sleeping ? 1 : 0) << ","
+            << r.stepMedianNs << "," << r.stepMeanNs << "," << r.awakeFraction << "," << r.uploadFraction << "\n";
+    }
+}
+
+void writeConvergenceJson(std::ostream& out, const std::vector<ConvergenceResult>& results)
+{
+    out << "{\n";
+    out << "  \"simd\": \"" << Tissue::getSimdName() << "\",\n";
+    out << "  \"convergence\": [\n";
+    for (size_t i = 0; i < results.size(); i++)
+    {
+        const ConvergenceResult& r = results[i];
+        out << "    {\"edgeCount\": " << r.edgeCount
+            << ", \"solver\": \"" << r.solver << "\""
+            << ", \"levels\": " << r.levels
+            << ", \"iteration\": " << r.iteration
+            << ", \"elapsedMs\": " << r.elapsedMs
+            << ", \"residualMax\": " << r.residualMax
+            << ", \"residualRms\": " << r.residualRms
+            << "}" << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    out << "  ]\n}\n";
+}
+
+void writeConvergenceCsv(std::ostream& out, const std::vector<ConvergenceResult>& results)
+{
+    out << "simd,edgeCount,solver,levels,iteration,elapsedMs,residualMax,residualRms\n";
+    for (const ConvergenceResult& r : results)
+    {
+        out << Tissue::getSimdName() << "," << r.edgeCount << "," << r.solver << "," << r.levels << "," << r.iteration << ","
+            << r.elapsedMs << "," << r.residualMax << "," << r.residualRms << "\n";
+    }
+}
+
+void writeOrderingsJson(std::ostream& out, const std::vector<OrderingResult>& results)
+{
+    out << "{\n";
+    out << "  \"simd\": \"" << Tissue::getSimdName() << "\",\n";
+    out << "  \"orderings\": [\n";
+    for (size_t i = 0; i < results.size(); i++)
+    {
+        const OrderingResult& r = results[i];
+        out << "    {\"edgeCount\": " << r.edgeCount
+            << ", \"vertices\": " << r.vertices
+            << ", \"constraints\": " << r.constraints
+            << ", \"order\": \"" << r.order << "\""
+            << ", \"meanEndpointGap\": " << r.meanEndpointGap
+            << ", \"meanGatherStride\": " << r.meanGatherStride
+            << ", \"solveMedianNs\": " << r.solveMedianNs
+            << ", \"stepMedianNs\": " << r.stepMedianNs
+            << ", \"solveSpeedup\": " << r.solveSpeedup
+            << ", \"stepSpeedup\": " << r.stepSpeedup
+            << "}" << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    out << "  ]\n}\n";
+}
+
+void writeOrderingsCsv(std::ostream& out, const std::vector<OrderingResult>& results)
+{
+    out << "simd,edgeCount,vertices,constraints,order,meanEndpointGap,meanGatherStride,solveMedianNs,stepMedianNs,solveSpeedup,stepSpeedup\n";
+    for (const OrderingResult& r : results)
+    {
+        out << Tissue::getSimdName() << "," << r.edgeCount << "," << r.vertices << "," << r.constraints << "," << r.order << ","
+            << r.meanEndpointGap << "," << r.meanGatherStride << "," << r.solveMedianNs << "," << r.stepMedianNs << ","
+            << r.solveSpeedup << "," << r.stepSpeedup << "\n";
+    }
+}
+
+void writeJson(std::ostream& out, const std::vector<StageResult>& results, int threads)
+{
+    out << "{\n";
+    out << "  \"simd\": \"" << Tissue::getSimdName() << "\",\n";
+    out << "  \"parallelThreads\": " << threads << ",\n";
+    out << "  \"results\": [\n";
+    for (size_t i = 0; i < results.size(); i++)
+    {
+        const StageResult& r = results[i];
+        out << "    {\"edgeCount\": " << r.edgeCount
+            << ", \"vertices\": " << r.vertices
+            << ", \"constraints\": " << r.constraints
+            << ", \"constraintBytes\": " << r.constraintBytes
+            << ", \"grid\": \"" << r.grid << "\""
+            << ", \"threads\": " << r.threads
+            << ", \"integrator\": \"" << r.integrator << "\""
+            << ", \"stage\": \"" << r.stage << "\""
+            << ", \"samples\": " << r.samples
+            << ", \"minNs\": " << r.minNs
+            << ", \"medianNs\": " << r.medianNs
+            << ", \"nsPerVertex\": " << r.nsPerVertex
+            << ", \"nsPerConstraint\": " << r.nsPerConstraint
+            << "}" << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    out << "  ]\n}\n";
+}
+
+void writeCsv(std::ostream& out, const std::vector<StageResult>& results)
+{
+    out << "simd,edgeCount,vertices,constraints,constraintBytes,grid,threads,integrator,stage,samples,minNs,medianNs,nsPerVertex,nsPerConstraint\n";
+    for (const StageResult& r : results)
+    {
+        out << Tissue::getSimdName() << "," << r.edgeCount << "," << r.vertices << "," << r.constraints << ","
+            << r.constraintBytes << "," << r.grid << "," << r.threads << "," << r.integrator << "," << r.stage << "," << r.samples << ","
+            << r.minNs << "," << r.medianNs << "," << r.nsPerVertex << "," << r.nsPerConstraint << "\n";
+    }
+}
+
+int main(int argc, char** argv)
+{
+    int minEdge = EDGE_COUNTS[0];
+    int maxEdge = 2048;
+    int threads = std::max(1u, std::thread::hardware_concurrency());
+    bool csv = false;
+    bool orderings = false;
+    bool convergence = false;
+    bool sleep = false;
+    bool scene = false;
+    GridConstraints constraints = GridConstraints::Explicit;
+    std::string outPath;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (std::strcmp(argv[i], "--min-edge") == 0 && i + 1 < argc) minEdge = std::atoi(argv[++i]);
+        else if (std::strcmp(argv[i], "--max-edge") == 0 && i + 1 < argc) maxEdge = std::atoi(argv[++i]);
+        else if (std::strcmp(argv[i], "--threads") == 0 && i + 1 < argc) threads = std::max(1, std::atoi(argv[++i]));
+        else if (std::strcmp(argv[i], "--csv") == 0) csv = true;
+        else if (std::strcmp(argv[i], "--out") == 0 && i + 1 < argc) outPath = argv[++i];
+        else if (std::strcmp(argv[i], "--orderings") == 0) orderings = true;
+        else if (std::strcmp(argv[i], "--convergence") == 0) convergence = true;
+        else if (std::strcmp(argv[i], "--sleep") == 0) sleep = true;
+        else if (std::strcmp(argv[i], "--scene") == 0) scene = true;
+        else if (std::strcmp(argv[i], "--grid") == 0 && i + 1 < argc && std::strcmp(argv[i + 1], "implicit") == 0) { constraints = GridConstraints::Implicit; i++; }
+        else if (std::strcmp(argv[i], "--grid") == 0 && i + 1 < argc && std::strcmp(argv[i + 1], "explicit") == 0) { constraints = GridConstraints::Explicit; i++; }
+        else
+        {
+            std::cout << "Usage: " << argv[0] << " [--min-edge N] [--max-edge N] [--threads N] [--csv] [--out file] [--orderings] [--grid explicit|implicit] [--convergence] [--sleep] [--scene]" << std::endl;
+            return -1;
+        }
+    }
+
+    std::vector<StageResult> results;
+    std::vector<OrderingResult> orderingResults;
+    std::vector<ConvergenceResult> convergenceResults;
+    std::vector<SleepResult> sleepResults;
+    std::vector<SceneResult> sceneResults;
+    // patch sizes of their own, far below the grid sizes
+    if (scene) for (int edgeCount : SCENE_EDGE_COUNTS) benchmarkScene(edgeCount, threads, sceneResults);
+    for (int edgeCount : EDGE_COUNTS)
+    {
+        if (scene || edgeCount < minEdge || edgeCount > maxEdge) continue;
+        if (sleep) benchmarkSleep(edgeCount, threads, sleepResults);
+        else if (convergence) benchmarkConvergence(edgeCount, threads, convergenceResults);
+        else if (orderings) benchmarkOrderings(edgeCount, orderingResults);
+        else benchmarkEdgeCount(edgeCount, threads, constraints, results);
+    }
+
+    std::ostringstream report;
+    if (scene && csv) writeSceneCsv(report, sceneResults);
+    else if (scene) writeSceneJson(report, sceneResults);
+    else if (sleep && csv) writeSleepCsv(report, sleepResults);
+    else if (sleep) writeSleepJson(report, sleepResults);
+    else if (convergence && csv) writeConvergenceCsv(report, convergenceResults);
+    else if (convergence) writeConvergenceJson(report, convergenceResults);
+    else if (orderings && csv) writeOrderingsCsv(report, orderingResults);
+    else if (orderings) writeOrderingsJson(report, orderingResults);
+    else if (csv) writeCsv(report, results);
+    else writeJson(report, results, threads);
+
+    if (outPath.empty()) std::cout << report.str();
+    else
+    {
+        std::ofstream file(outPath);
+        file << report.str();
+        std::cerr << "wrote " << outPath << std::endl;
+    }
+    return 0;
+}
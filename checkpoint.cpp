@@ -0,0 +1,351 @@
+#include "checkpoint.h"
+#include "tissue.h"
+
+#include <cstring>
+
+namespace
+{
+    bool isLittleEndian()
+    {
+        uint32_t tag = CHECKPOINT_ENDIAN_TAG;
+        unsigned char first;
+        std::memcpy(&first, &tag, 1);
+        return first == 0x04;
+    }
+
+    size_t alignUp(size_t offset)
+    {
+        return (offset + CHECKPOINT_ALIGNMENT - 1) / CHECKPOINT_ALIGNMENT * CHECKPOINT_ALIGNMENT;
+    }
+
+    struct SectionSource
+    {
+        CheckpointSectionId id;
+        const void* data;
+        size_t count;
+    };
+}
+
+// ------------------------------------------------------------------------
+// writing
+
+void Checkpoint::serialize(const Tissue& tissue, std::vector<char>& image)
+{
+    const SectionSource sources[] = {
+        { CheckpointSectionId::PositionsX, tissue.positions.x.data(), tissue.positions.x.size() },
+        { CheckpointSectionId::PositionsY, tissue.positions.y.data(), tissue.positions.y.size() },
+        { CheckpointSectionId::PositionsZ, tissue.positions.z.data(), tissue.positions.z.size() },
+        { CheckpointSectionId::VelocitiesX, tissue.velocities.x.data(), tissue.velocities.x.size() },
+        { CheckpointSectionId::VelocitiesY, tissue.velocities.y.data(), tissue.velocities.y.size() },
+        { CheckpointSectionId::VelocitiesZ, tissue.velocities.z.data(), tissue.velocities.z.size() },
+        { CheckpointSectionId::InverseMass, tissue.inverseMass.data(), tissue.inverseMass.size() },
+        { CheckpointSectionId::ConstraintFirst, tissue.stretchConstraintFirst.data(), tissue.stretchConstraintFirst.size() },
+        { CheckpointSectionId::ConstraintSecond, tissue.stretchConstraintSecond.data(), tissue.stretchConstraintSecond.size() },
+        { CheckpointSectionId::ConstraintRestLength, tissue.stretchConstraintsRestLength.data(), tissue.stretchConstraintsRestLength.size() },
+        { CheckpointSectionId::ConstraintLambda, tissue.stretchConstraintLambda.data(), tissue.stretchConstraintLambda.size() },
+        { CheckpointSectionId::ColorOffsets, tissue.stretchConstraintColorOffsets.data(), tissue.stretchConstraintColorOffsets.size() },
+        { CheckpointSectionId::SurfaceTriangles, tissue.surfaceTriangles.data(), tissue.surfaceTriangles.size() },
+        { CheckpointSectionId::VertexPermutation, tissue.vertexPermutation.data(), tissue.vertexPermutation.size() },
+        { CheckpointSectionId::BodyOffsets, tissue.bodyOffsets.data(), tissue.bodyOffsets.size() }
+    };
+    const int sectionCount = sizeof(sources) / sizeof(sources[0]);
+
+    CheckpointSection sections[sectionCount];
+    size_t offset = alignUp(sizeof(CheckpointHeader) + sizeof(sections));
+    for (int s = 0; s < sectionCount; s++)
+    {
+        sections[s] = { (uint32_t)sources[s].id, 4, offset, sources[s].count };
+        offset = alignUp(offset + sources[s].count * 4);
+    }
+
+    CheckpointHeader header = {};
+    std::memcpy(header.magic, CHECKPOINT_MAGIC, sizeof(header.magic));
+    header.version = CHECKPOINT_VERSION;
+    header.endianTag = CHECKPOINT_ENDIAN_TAG;
+    header.headerBytes = sizeof(CheckpointHeader);
+    header.sectionCount = sectionCount;
+    header.fileBytes = offset;
+    header.vertexCount = tissue.getVertexCount();
+    // stored arrays only; implicit grid constraints are rebuilt from edgeCount
+    header.constraintCount = tissue.stretchConstraintFirst.size();
+    header.colorCount = (uint32_t)tissue.stretchConstraintColorOffsets.size() - 1;
+    header.integrator = (uint32_t)tissue.integrator;
+    header.edgeCount = tissue.edgeCount;
+    header.maxEdgeWidth = tissue.maxEdgeWidth;
+    header.weight = tissue.weight;
+    header.iterations = tissue.iterations;
+    header.substeps = tissue.substeps;
+    header.compliance = tissue.compliance;
+    header.dampingFactor = tissue.dampingFactor;
+    header.residualTolerance = tissue.residualTolerance;
+    header.solverBudgetMs = tissue.solverBudgetMs;
+    header.gridConstraints = (uint32_t)tissue.getGridConstraints();
+    header.multigridLevels = (uint32_t)tissue.getMultigridLevels();
+    header.sleepVelocity = tissue.sleepVelocity;
+    header.sleepResidual = tissue.sleepResidual;
+    header.selfCollisionThickness = tissue.selfCollisionThickness;
+    header.obstacleMargin = tissue.obstacleMargin;
+
+    // padding stays zero so identical states give identical files
+    image.assign(offset, 0);
+    std::memcpy(image.data(), &header, sizeof(header));
+    std::memcpy(image.data() + sizeof(header), sections, sizeof(sections));
+    for (int s = 0; s < sectionCount; s++)
+    {
+        if (sources[s].count) std::memcpy(image.data() + sections[s].offset, sources[s].data, sources[s].count * 4);
+    }
+}
+
+bool Checkpoint::writeImage(const std::vector<char>& image, const std::string& path)
+{
+    return replaceFile(path, { { image.data(), image.size() } });
+}
+
+bool Checkpoint::write(const Tissue& tissue, const std::string& path)
+{
+    if (!isLittleEndian()) return false;
+    std::vector<char> image;
+    serialize(tissue, image);
+    return writeImage(image, path);
+}
+
+// ------------------------------------------------------------------------
+// reading
+
+Checkpoint::~Checkpoint()
+{
+    close();
+}
+
+void Checkpoint::close()
+{
+    file.close();
+    data = nullptr;
+    size = 0;
+}
+
+bool Checkpoint::fail(const std::string& reason)
+{
+    error = reason;
+    close();
+    return false;
+}
+
+bool Checkpoint::open(const std::string& path)
+{
+    close();
+    error.clear();
+    if (!isLittleEndian()) return fail("checkpoints are little-endian, this host is not");
+    if (!file.open(path)) return fail("cannot open " + path);
+    if (file.size() < sizeof(CheckpointHeader)) return fail(path + " is too small for a checkpoint");
+    data = file.data();
+    size = file.size();
+    return validate();
+}
+
+const void* Checkpoint::getSection(CheckpointSectionId id, uint64_t& count) const
+{
+    const CheckpointHeader& header = getHeader();
+    const CheckpointSection* sections = (const CheckpointSection*)(data + header.headerBytes);
+    for (uint32_t s = 0; s < header.sectionCount; s++)
+    {
+        if (sections[s].id != (uint32_t)id) continue;
+        count = sections[s].count;
+        return data + sections[s].offset;
+    }
+    count = 0;
+    return nullptr;
+}
+
+// everything Tissue(const Checkpoint&) relies on, so a bad file is rejected here and not in the solver
+bool Checkpoint::validate()
+{
+    const CheckpointHeader& header = getHeader();
+    if (std::memcmp(header.magic, CHECKPOINT_MAGIC, sizeof(header.magic)) != 0) return fail("not a tissue checkpoint");
+    if (header.endianTag != CHECKPOINT_ENDIAN_TAG) return fail("checkpoint has the wrong byte order");
+    if (header.version != CHECKPOINT_VERSION) return fail("checkpoint version " + std::to_string(header.version) + " is not supported");
+    if (header.headerBytes < sizeof(CheckpointHeader) || header.fileBytes != size) return fail("checkpoint is truncated");
+    if ((uint64_t)header.headerBytes + (uint64_t)header.sectionCount * sizeof(CheckpointSection) > size) return fail("checkpoint section table is truncated");
+    if (header.integrator > (uint32_t)Integrator::XPBD || (header.colorCount == 0 && header.constraintCount > 0)) return fail("checkpoint settings are invalid");
+    if (header.gridConstraints > (uint32_t)GridConstraints::Implicit || header.multigridLevels > 32) return fail("checkpoint settings are invalid");
+    if (!(header.sleepVelocity >= 0.0f) || !(header.sleepResidual >= 0.0f) || !(header.selfCollisionThickness >= 0.0f)
+        || !(header.obstacleMargin >= 0.0f))
+    {
+        return fail("checkpoint settings are invalid");
+    }
+    // a grid's surface triangles and hierarchy are rebuilt from edgeCount, imported models store 0
+    if (header.edgeCount != 0 && (header.edgeCount < 2 || header.vertexCount != (uint64_t)header.edgeCount * header.edgeCount))
+    {
+        return fail("checkpoint grid does not match its vertices");
+    }
+    if (header.multigridLevels > 0 && header.edgeCount == 0) return fail("checkpoint multigrid levels need a grid");
+    if (header.gridConstraints == (uint32_t)GridConstraints::Implicit
+        && (header.edgeCount == 0 || header.maxEdgeWidth <= 0 || header.constraintCount != 0))
+    {
+        return fail("checkpoint implicit grid does not match its vertices");
+    }
+
+    const CheckpointSection* sections = (const CheckpointSection*)(data + header.headerBytes);
+    for (uint32_t s = 0; s < header.sectionCount; s++)
+    {
+        const CheckpointSection& section = sections[s];
+        if (section.offset % CHECKPOINT_ALIGNMENT != 0) return fail("checkpoint section is misaligned");
+        // every section is an array of 4-byte values, read as such whatever it claims
+        if (section.elementBytes != 4) return fail("checkpoint section " + std::to_string(section.id) + " has the wrong element size");
+        if (section.offset > size || section.count > (size - section.offset) / section.elementBytes)
+        {
+            return fail("checkpoint section runs past the end of the file");
+        }
+    }
+
+    struct Required { CheckpointSectionId id; uint64_t count; };
+    const Required required[] = {
+        { CheckpointSectionId::PositionsX, header.vertexCount },
+        { CheckpointSectionId::PositionsY, header.vertexCount },
+        { CheckpointSectionId::PositionsZ, header.vertexCount },
+        { CheckpointSectionId::VelocitiesX, header.vertexCount },
+        { CheckpointSectionId::VelocitiesY, header.vertexCount },
+        { CheckpointSectionId::VelocitiesZ, header.vertexCount },
+        { CheckpointSectionId::InverseMass, header.vertexCount },
+        { CheckpointSectionId::ConstraintFirst, header.constraintCount },
+        { CheckpointSectionId::ConstraintSecond, header.constraintCount },
+        { CheckpointSectionId::ConstraintRestLength, header.constraintCount },
+        { CheckpointSectionId::ConstraintLambda, header.constraintCount },
+        { CheckpointSectionId::ColorOffsets, (uint64_t)header.colorCount + 1 }
+    };
+    for (const Required& r : required)
+    {
+        uint64_t count;
+        if (!getSection(r.id, count) || count != r.count) return fail("checkpoint section " + std::to_string((uint32_t)r.id) + " is missing or has the wrong size");
+    }
+
+    // endpoints in range, color offsets ascending and covering every constraint
+    uint64_t count;
+    const int32_t* first = (const int32_t*)getSection(CheckpointSectionId::ConstraintFirst, count);
+    const int32_t* second = (const int32_t*)getSection(CheckpointSectionId::ConstraintSecond, count);
+    for (uint64_t i = 0; i < header.constraintCount; i++)
+    {
+        if ((uint64_t)(uint32_t)first[i] >= header.vertexCount || (uint64_t)(uint32_t)second[i] >= header.vertexCount)
+        {
+            return fail("checkpoint constraint endpoint out of range");
+        }
+    }
+    const int32_t* offsets = (const int32_t*)getSection(CheckpointSectionId::ColorOffsets, count);
+    if (offsets[0] != 0 || (uint64_t)offsets[header.colorCount] != header.constraintCount) return fail("checkpoint color offsets are invalid");
+    for (uint32_t c = 0; c < header.colorCount; c++)
+    {
+        if (offsets[c + 1] < offsets[c]) return fail("checkpoint color offsets are invalid");
+    }
+    const uint32_t* triangles = (const uint32_t*)getSection(CheckpointSectionId::SurfaceTriangles, count);
+    if (count % 3 != 0) return fail("checkpoint surface triangles are incomplete");
+    for (uint64_t i = 0; i < count; i++)
+    {
+        if (triangles[i] >= header.vertexCount) return fail("checkpoint surface triangle index out of range");
+    }
+    const int32_t* permutation = (const int32_t*)getSection(CheckpointSectionId::VertexPermutation, count);
+    if (count != 0 && count != header.vertexCount) return fail("checkpoint vertex permutation has the wrong size");
+    if (count != 0 && (header.gridConstraints == (uint32_t)GridConstraints::Implicit || header.multigridLevels > 0))
+    {
+        return fail("checkpoint implicit grid or multigrid levels cannot be reordered");
+    }
+    std::vector<bool> seen(count, false);
+    for (uint64_t i = 0; i < count; i++)
+    {
+        if ((uint64_t)(uint32_t)permutation[i] >= count || seen[permutation[i]]) return fail("checkpoint vertex permutation is not a permutation");
+        seen[permutation[i]] = true;
+    }
+    const int32_t* bodies = (const int32_t*)getSection(CheckpointSectionId::BodyOffsets, count);
+    if (count == 1 || (count != 0 && (bodies[0] != 0 || (uint64_t)(uint32_t)bodies[count - 1] != header.vertexCount)))
+    {
+        return fail("checkpoint body offsets are invalid");
+    }
+    for (uint64_t b = 1; b < count; b++)
+    {
+        if (bodies[b] < bodies[b - 1]) return fail("checkpoint body offsets are invalid");
+    }
+    if (count > 2 && (header.gridConstraints == (uint32_t)GridConstraints::Implicit || header.multigridLevels > 0))
+    {
+        return fail("checkpoint implicit grid or multigrid levels need a single body");
+    }
+    return true;
+}
+
+// ------------------------------------------------------------------------
+// asynchronous writer
+
+CheckpointWriter::CheckpointWriter()
+{
+    thread = std::thread([this]() { writerLoop(); });
+}
+
+CheckpointWriter::~CheckpointWriter()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    thread.join();
+}
+
+bool CheckpointWriter::write(const Tissue& tissue, const std::string& path)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (busy)
+        {
+            skipped++;
+            return false;
+        }
+    }
+
+    // the writer thread is idle and only touches image while busy, so this copy needs no lock
+    Checkpoint::serialize(tissue, image);
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        this->path = path;
+        busy = true;
+    }
+    wake.notify_one();
+    return true;
+}
+
+void CheckpointWriter::wait()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    done.wait(lock, [this]() { return !busy; });
+}
+
+uint64_t CheckpointWriter::getWrittenCount()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return written;
+}
+
+uint64_t CheckpointWriter::getFailedCount()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return failed;
+}
+
+void CheckpointWriter::writerLoop()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true)
+    {
+        wake.wait(lock, [this]() { return busy || stopping; });
+        if (busy)
+        {
+            std::string target = path;
+            lock.unlock();
+            bool ok = Checkpoint::writeImage(image, target);
+            lock.lock();
+            if (ok) written++;
+            else failed++;
+            busy = false;
+            done.notify_all();
+            continue;
+        }
+        if (stopping) return;
+    }
+}
@@ -0,0 +1,158 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include "mapped_file.h"
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+class Tissue;
+
+/*
+    Checkpoint file, version 1, little-endian
+        CheckpointHeader                 settings and sizes, 128 bytes
+        CheckpointSection[sectionCount]  where every array lives
+        sections                         raw arrays, each starting on a CHECKPOINT_ALIGNMENT boundary
+    Readers skip section ids they do not know, so sections can be added without a version bump;
+    a change to an existing section's layout needs a new version.
+*/
+const char CHECKPOINT_MAGIC[8] = { 'T', 'I', 'S', 'S', 'C', 'K', 'P', 'T' };
+const uint32_t CHECKPOINT_VERSION = 1;
+const uint32_t CHECKPOINT_ENDIAN_TAG = 0x01020304;
+const size_t CHECKPOINT_ALIGNMENT = 64;
+
+enum class CheckpointSectionId : uint32_t
+{
+    PositionsX = 1, PositionsY, PositionsZ,
+    VelocitiesX, VelocitiesY, VelocitiesZ,
+    InverseMass,
+    ConstraintFirst, ConstraintSecond, ConstraintRestLength, ConstraintLambda,
+    ColorOffsets,
+    SurfaceTriangles,   // optional, imported models only
+    VertexPermutation,  // optional, build index -> vertex index after reordering
+    BodyOffsets         // optional, first vertex of every body plus the vertex count (one body when absent)
+};
+
+struct CheckpointHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t endianTag;
+    uint32_t headerBytes;
+    uint32_t sectionCount;
+    uint64_t fileBytes;
+    uint64_t vertexCount;
+    uint64_t constraintCount;
+    uint32_t colorCount;
+    uint32_t integrator;
+    int32_t edgeCount;
+    int32_t maxEdgeWidth;
+    float weight;
+    int32_t iterations;
+    int32_t substeps;
+    float compliance;
+    float dampingFactor;
+    float residualTolerance;
+    float solverBudgetMs;
+    uint32_t gridConstraints;   // GridConstraints; Implicit stores no constraint arrays (0 in older files)
+    uint32_t multigridLevels;   // Tissue::setMultigridLevels (0 in older files)
+    float sleepVelocity;        // 0 (sleeping off) in older files; which tiles sleep is not stored, all wake on restore
+    float sleepResidual;
+    float selfCollisionThickness; // 0 (off) in older files
+    float obstacleMargin;         // 0 in older files
+    uint8_t reserved[12];
+};
+static_assert(sizeof(CheckpointHeader) == 128, "CheckpointHeader layout is part of the file format");
+
+struct CheckpointSection
+{
+    uint32_t id;            // CheckpointSectionId
+    uint32_t elementBytes;  // 4 for every version 1 section
+    uint64_t offset;        // from the start of the file, CHECKPOINT_ALIGNMENT aligned
+    uint64_t count;         // elements
+};
+static_assert(sizeof(CheckpointSection) == 24, "CheckpointSection layout is part of the file format");
+
+/*
+    Checkpoint (a checkpoint file opened for reading)
+        open() maps the file read-only and validates it; sections are read in place, nothing is parsed
+        Tissue(const Checkpoint&) copies them straight into the solver arrays, no rebuild
+*/
+class Checkpoint
+{
+    public:
+    Checkpoint() = default;
+    ~Checkpoint();
+    Checkpoint(const Checkpoint&) = delete;
+    Checkpoint& operator=(const Checkpoint&) = delete;
+
+    // false, with the reason in getError(), when the file is missing, truncated, from another version or inconsistent
+    bool open(const std::string& path);
+    void close();
+    const std::string& getError() const { return error; }
+
+    const CheckpointHeader& getHeader() const { return *(const CheckpointHeader*)data; }
+    // nullptr when the section is absent
+    const void* getSection(CheckpointSectionId id, uint64_t& count) const;
+
+    // whole-file image of tissue, ready to be written out
+    static void serialize(const Tissue& tissue, std::vector<char>& image);
+    // synchronous write through replaceFile (mapped_file.h)
+    static bool write(const Tissue& tissue, const std::string& path);
+    static bool writeImage(const std::vector<char>& image, const std::string& path);
+
+    private:
+    MappedFile file;
+    const char* data = nullptr; // file.data() once opened
+    size_t size = 0;
+    std::string error;
+
+    bool fail(const std::string& reason);
+    bool validate();
+};
+
+/*
+    CheckpointWriter
+        write() snapshots the tissue into a staging image (one memcpy per array) and returns;
+        a background thread writes the image to disk
+        while a write is still in flight, the next request is skipped rather than stalling the caller
+*/
+class CheckpointWriter
+{
+    public:
+    CheckpointWriter();
+    ~CheckpointWriter();
+    CheckpointWriter(const CheckpointWriter&) = delete;
+    CheckpointWriter& operator=(const CheckpointWriter&) = delete;
+
+    // false when the previous checkpoint is still being written
+    bool write(const Tissue& tissue, const std::string& path);
+    // blocks until the last requested checkpoint is on disk
+    void wait();
+
+    uint64_t getWrittenCount();
+    uint64_t getSkippedCount() const { return skipped; }
+    uint64_t getFailedCount();
+
+    private:
+    std::vector<char> image;
+    std::string path;
+    bool busy = false;
+    bool stopping = false;
+    uint64_t written = 0;
+    uint64_t failed = 0;
+    uint64_t skipped = 0;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+    std::thread thread;
+
+    void writerLoop();
+};
+
+#endif
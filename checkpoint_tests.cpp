@@ -0,0 +1,112 @@
+#include "regression_tests.h"
+#include "checkpoint.h"
+
+#include <cstdio>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// checkpoint: N steps, write, restore, N more is bit-identical to 2N steps in one run
+int testCheckpoint()
+{
+    const std::string path = "regression_checkpoint.bin";
+    bool pass = true;
+    for (Integrator integrator : { Integrator::PBD, Integrator::XPBD })
+    {
+        Tissue straight(EDGE_COUNT, 1, 0.001f, integrator);
+        Tissue first(EDGE_COUNT, 1, 0.001f, integrator);
+        for (int s = 0; s < STEPS; s++)
+        {
+            straight.step(DELTA_TIME, GRAVITY);
+            first.step(DELTA_TIME, GRAVITY);
+        }
+        if (!Checkpoint::write(first, path))
+        {
+            std::cout << "FAIL cannot write " << path << std::endl;
+            return 1;
+        }
+        Checkpoint checkpoint;
+        if (!checkpoint.open(path))
+        {
+            std::cout << "FAIL cannot open " << path << ": " << checkpoint.getError() << std::endl;
+            return 1;
+        }
+        Tissue restored(checkpoint);
+        checkpoint.close();
+        for (int s = 0; s < STEPS; s++)
+        {
+            straight.step(DELTA_TIME, GRAVITY);
+            restored.step(DELTA_TIME, GRAVITY);
+        }
+        pass &= expectSame(straight, restored, std::string(integrator == Integrator::XPBD ? "XPBD" : "PBD") + " restored mid-run");
+    }
+    std::remove(path.c_str());
+    return pass ? 0 : 1;
+}
+
+// writes the image and opens it, the reason in error when open() refuses it
+bool openImage(const std::vector<char>& image, std::string& error)
+{
+    const std::string path = "regression_malformed.bin";
+    Checkpoint checkpoint;
+    bool opened = Checkpoint::writeImage(image, path) && checkpoint.open(path);
+    error = checkpoint.getError();
+    checkpoint.close();
+    std::remove(path.c_str());
+    return opened;
+}
+
+// a valid image with one change applied; open() must refuse it with a reason instead of reading out of bounds
+bool expectRejected(const std::vector<char>& valid, const std::string& what, const std::function<void(std::vector<char>&)>& corrupt)
+{
+    std::vector<char> image = valid;
+    corrupt(image);
+    std::string error;
+    if (openImage(image, error))
+    {
+        std::cout << "FAIL " << what << " was accepted" << std::endl;
+        return false;
+    }
+    std::cout << what << ": " << error << std::endl;
+    return true;
+}
+
+CheckpointSection* findSection(std::vector<char>& image, CheckpointSectionId id)
+{
+    const CheckpointHeader* header = (const CheckpointHeader*)image.data();
+    CheckpointSection* sections = (CheckpointSection*)(image.data() + header->headerBytes);
+    for (uint32_t s = 0; s < header->sectionCount; s++)
+    {
+        if (sections[s].id == (uint32_t)id) return &sections[s];
+    }
+    return nullptr;
+}
+
+// checkpoint-malformed: crafted files that once crashed a restore are rejected by Checkpoint::open
+int testCheckpointMalformed()
+{
+    Tissue tissue(EDGE_COUNT, 1, 0.001f, Integrator::XPBD);
+    std::vector<char> valid;
+    Checkpoint::serialize(tissue, valid);
+    std::string error;
+    if (!openImage(valid, error))
+    {
+        std::cout << "FAIL the untouched checkpoint was rejected: " << error << std::endl;
+        return 1;
+    }
+    bool pass = true;
+    // the lambdas claimed as 1-byte elements at the very end: in bounds as claimed, count * 4 bytes read past the end
+    pass &= expectRejected(valid, "1-byte lambda section", [](std::vector<char>& image) {
+        CheckpointSection* lambda = findSection(image, CheckpointSectionId::ConstraintLambda);
+        lambda->elementBytes = 1;
+        lambda->offset = (image.size() - lambda->count) / CHECKPOINT_ALIGNMENT * CHECKPOINT_ALIGNMENT;
+    });
+    // a grid size that does not match the vertices: surface triangles would index past them
+    pass &= expectRejected(valid, "edgeCount + 1", [](std::vector<char>& image) { ((CheckpointHeader*)image.data())->edgeCount++; });
+    pass &= expectRejected(valid, "edgeCount 1", [](std::vector<char>& image) { ((CheckpointHeader*)image.data())->edgeCount = 1; });
+    return pass ? 0 : 1;
+}
+
+static RegressionCase checkpoint("checkpoint", testCheckpoint);
+static RegressionCase checkpointMalformed("checkpoint-malformed", testCheckpointMalformed);
@@ -0,0 +1,122 @@
+#ifndef DOMAIN_PARTITION_H
+#define DOMAIN_PARTITION_H
+
+#include <algorithm>
+#include <vector>
+
+// grid rows [rowBegin, rowEnd) x columns [columnBegin, columnEnd); vertex (i, j) is i * edgeCount + j in build order
+struct GridRect
+{
+    int rowBegin, rowEnd, columnBegin, columnEnd;
+
+    int getRows() const { return std::max(0, rowEnd - rowBegin); }
+    int getColumns() const { return std::max(0, columnEnd - columnBegin); }
+    int getCount() const { return getRows() * getColumns(); }
+    bool contains(int row, int column) const { return row >= rowBegin && row < rowEnd && column >= columnBegin && column < columnEnd; }
+
+    GridRect intersect(const GridRect& other) const
+    {
+        return { std::max(rowBegin, other.rowBegin), std::min(rowEnd, other.rowEnd),
+                 std::max(columnBegin, other.columnBegin), std::min(columnEnd, other.columnEnd) };
+    }
+
+    // build indices, row by row
+    std::vector<int> getVertices(int edgeCount) const
+    {
+        std::vector<int> vertices;
+        vertices.reserve(getCount());
+        for (int i = rowBegin; i < rowEnd; i++)
+            for (int j = columnBegin; j < columnEnd; j++) vertices.push_back(i * edgeCount + j);
+        return vertices;
+    }
+};
+
+// what a tile sends to and receives from one neighbouring tile every exchange
+struct DomainLink
+{
+    int peer;
+    std::vector<int> send;      // own vertices in the peer's halo, build indices, row by row
+    std::vector<int> receive;   // the peer's vertices in this tile's halo, in the peer's send order
+};
+
+struct DomainTile
+{
+    GridRect owned;
+    GridRect local;             // owned plus the halo: the ring of vertices around it, clipped to the grid
+    std::vector<DomainLink> links; // by peer
+};
+
+/*
+    DomainPartition (a grid in build order cut into tilesAcross x tilesDown rectangles, one per worker)
+        every vertex is owned by one tile. A tile also holds a copy of the one-vertex ring around it: every
+        stretch constraint that leaves the tile ends there, the diagonals too, so tiles that only touch at
+        a corner are linked as well. Tile t is column t % tilesAcross, row t / tilesAcross.
+*/
+class DomainPartition
+{
+    public:
+    DomainPartition() : edgeCount(0), tilesAcross(0), tilesDown(0) {}
+
+    // tiles are as even as the grid allows; every tile needs at least one row and column
+    DomainPartition(int edgeCount, int tilesAcross, int tilesDown)
+        : edgeCount(edgeCount), tilesAcross(tilesAcross), tilesDown(tilesDown)
+    {
+        for (int y = 0; y < tilesDown; y++)
+        {
+            for (int x = 0; x < tilesAcross; x++)
+            {
+                DomainTile tile;
+                tile.owned = { edgeCount * y / tilesDown, edgeCount * (y + 1) / tilesDown,
+                               edgeCount * x / tilesAcross, edgeCount * (x + 1) / tilesAcross };
+                tile.local = GridRect{ tile.owned.rowBegin - 1, tile.owned.rowEnd + 1, tile.owned.columnBegin - 1, tile.owned.columnEnd + 1 }
+                    .intersect({ 0, edgeCount, 0, edgeCount });
+                tiles.push_back(tile);
+            }
+        }
+        for (int t = 0; t < getTileCount(); t++)
+        {
+            for (int p = 0; p < getTileCount(); p++)
+            {
+                if (p == t) continue;
+                GridRect send = tiles[t].owned.intersect(tiles[p].local);
+                GridRect receive = tiles[p].owned.intersect(tiles[t].local);
+                if (send.getCount() == 0) continue; // halos are one ring on every side, so receive is empty too
+                tiles[t].links.push_back({ p, send.getVertices(edgeCount), receive.getVertices(edgeCount) });
+            }
+        }
+    }
+
+    int getEdgeCount() const { return edgeCount; }
+    int getTilesAcross() const { return tilesAcross; }
+    int getTilesDown() const { return tilesDown; }
+    int getTileCount() const { return (int)tiles.size(); }
+    const DomainTile& getTile(int tile) const { return tiles[tile]; }
+
+    // index of tile's link to peer in peer's own list, -1 when they are not linked
+    int getReverseLink(int tile, int link) const
+    {
+        const std::vector<DomainLink>& peerLinks = tiles[tiles[tile].links[link].peer].links;
+        for (int k = 0; k < (int)peerLinks.size(); k++)
+        {
+            if (peerLinks[k].peer == tile) return k;
+        }
+        return -1;
+    }
+
+    // vertex copies exchanged per sweep, both directions counted
+    int getHaloVertexCount() const
+    {
+        int count = 0;
+        for (const DomainTile& tile : tiles)
+            for (const DomainLink& link : tile.links) count += (int)link.send.size();
+        return count;
+    }
+
+    private:
+    int edgeCount;
+    int tilesAcross;
+    int tilesDown;
+    std::vector<DomainTile> tiles;
+};
+
+#endif
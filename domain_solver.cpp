@@ -0,0 +1,326 @@
+#include "domain_solver.h"
+#include "tissue_model.h"
+
+#include <algorithm>
+#include <chrono>
+#include <csignal>
+#include <iostream>
+
+#ifdef DOMAIN_PROCESSES
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+#ifdef __linux__
+#include <sys/prctl.h>
+#endif
+
+const int WORKER_POLL_MS = 100; // how often a waiting coordinator checks that its workers are still alive
+
+const char* DomainSolver::getUnsupportedReason(const Tissue& tissue, int tilesAcross, int tilesDown)
+{
+#ifndef DOMAIN_PROCESSES
+    return "needs fork() and POSIX shared memory";
+#endif
+    if (tissue.getEdgeCount() < 2) return "needs a grid";
+    if (!tissue.isBuildOrder()) return "needs the build vertex order";
+    if (tilesAcross < 1 || tilesDown < 1 || tilesAcross > tissue.getEdgeCount() || tilesDown > tissue.getEdgeCount())
+        return "needs between 1 and edgeCount tiles each way";
+    if (tissue.getMultigridLevels() > 0) return "has no multigrid levels";
+    if (tissue.sleepVelocity > 0.0f) return "has no sleeping";
+    if (tissue.selfCollisionThickness > 0.0f) return "has no self-collision";
+    if (tissue.getObstacleCount() > 0) return "has no obstacles";
+    return nullptr;
+}
+
+std::unique_ptr<DomainSolver> DomainSolver::createLocal(Tissue& tissue, int tilesAcross, int tilesDown)
+{
+    const char* reason = getUnsupportedReason(tissue, tilesAcross, tilesDown);
+    if (reason)
+    {
+        std::cout << "ERROR::DOMAIN_SOLVER " << reason << std::endl;
+        return nullptr;
+    }
+    DomainPartition partition(tissue.getEdgeCount(), tilesAcross, tilesDown);
+    std::unique_ptr<SharedMemoryTransport> transport(new SharedMemoryTransport(partition));
+    if (!transport->isValid())
+    {
+        std::cout << "ERROR::DOMAIN_SOLVER::SHARED_MEMORY " << transport->getError() << std::endl;
+        return nullptr;
+    }
+    std::unique_ptr<DomainSolver> solver(new DomainSolver(tissue, partition, std::move(transport)));
+    if (!solver->isValid()) return nullptr;
+    return solver;
+}
+
+DomainSolver::DomainSolver(Tissue& tissue, const DomainPartition& partition, std::unique_ptr<DomainTransport> transport)
+    : tissue(tissue), partition(partition), transport(std::move(transport)), valid(true), lastStepMs(0.0f)
+{
+#ifdef DOMAIN_PROCESSES
+    std::cout.flush(); // or the children print the parent's buffered output again
+    for (int w = 0; w < partition.getTileCount(); w++)
+    {
+        pid_t pid = fork();
+        if (pid == 0) runWorker(w);
+        if (pid < 0)
+        {
+            fail("could not fork", w);
+            return;
+        }
+        workers.push_back((int)pid);
+    }
+#else
+    fail("no worker processes on this platform", -1);
+#endif
+}
+
+DomainSolver::~DomainSolver()
+{
+    if (valid)
+    {
+        DomainCommand command = {};
+        command.type = DomainCommandType::Stop;
+        valid = run(command);
+    }
+    reapWorkers(!valid);
+}
+
+bool DomainSolver::step(float deltaTime, glm::vec3 gravity)
+{
+    if (!valid) return false;
+    auto start = std::chrono::steady_clock::now();
+
+    DomainCommand command = {};
+    for (size_t e = 0; e < edits.size(); e += DOMAIN_MAX_EDITS)
+    {
+        command.type = DomainCommandType::Edit;
+        command.editCount = (int32_t)std::min(edits.size() - e, (size_t)DOMAIN_MAX_EDITS);
+        std::copy(edits.begin() + e, edits.begin() + e + command.editCount, command.edits);
+        if (!run(command)) return false;
+    }
+    edits.clear();
+
+    command.type = DomainCommandType::Step;
+    command.deltaTime = deltaTime;
+    command.gravity[0] = gravity.x;
+    command.gravity[1] = gravity.y;
+    command.gravity[2] = gravity.z;
+    command.editCount = 0;
+    if (!run(command)) return false;
+
+    // gather: every vertex comes from the tile that owns it
+    for (int w = 0; w < partition.getTileCount(); w++)
+    {
+        const GridRect& owned = partition.getTile(w).owned;
+        const float* state = transport->getState(w);
+        size_t count = owned.getCount(), n = 0;
+        for (int i = owned.rowBegin; i < owned.rowEnd; i++)
+        {
+            for (int j = owned.columnBegin; j < owned.columnEnd; j++, n++)
+            {
+                int v = i * partition.getEdgeCount() + j;
+                tissue.positions.set(v, glm::vec3(state[n], state[count + n], state[2 * count + n]));
+                tissue.velocities.set(v, glm::vec3(state[3 * count + n], state[4 * count + n], state[5 * count + n]));
+            }
+        }
+    }
+    tissue.estimatedPositions = tissue.positions;
+    tissue.wakeAll(); // every position changed
+
+    lastStepMs = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+    return true;
+}
+
+void DomainSolver::setVertex(int vertex, glm::vec3 offset, float inverseMass)
+{
+    edits.push_back({ vertex, { offset.x, offset.y, offset.z }, inverseMass });
+}
+
+bool DomainSolver::run(const DomainCommand& command)
+{
+    if (!transport->post(command))
+    {
+        fail("transport closed", -1);
+        return false;
+    }
+    while (!transport->wait(WORKER_POLL_MS))
+    {
+#ifdef DOMAIN_PROCESSES
+        for (int w = 0; w < (int)workers.size(); w++)
+        {
+            int status;
+            if (workers[w] == 0 || waitpid((pid_t)workers[w], &status, WNOHANG) != workers[w]) continue;
+            workers[w] = 0;
+            fail("worker exited", w);
+            return false;
+        }
+#endif
+    }
+    return true;
+}
+
+void DomainSolver::fail(const char* reason, int worker)
+{
+    std::cout << "ERROR::DOMAIN_SOLVER " << reason;
+    if (worker >= 0) std::cout << " (tile " << worker << ")";
+    std::cout << ", stopping the workers" << std::endl;
+    valid = false;
+    transport->abort();
+    reapWorkers(true);
+}
+
+void DomainSolver::reapWorkers(bool kill)
+{
+#ifdef DOMAIN_PROCESSES
+    for (int& pid : workers)
+    {
+        if (pid == 0) continue;
+        if (kill) ::kill((pid_t)pid, SIGKILL);
+        int status;
+        waitpid((pid_t)pid, &status, 0);
+        pid = 0;
+    }
+#else
+    (void)kill;
+#endif
+}
+
+void DomainSolver::runWorker(int worker)
+{
+#ifdef DOMAIN_PROCESSES
+#ifdef __linux__
+    prctl(PR_SET_PDEATHSIG, SIGKILL); // go at once with the coordinator; elsewhere the transport's waits notice it
+#endif
+    const int edgeCount = partition.getEdgeCount();
+    const DomainTile& tile = partition.getTile(worker);
+    const GridRect& local = tile.local;
+    auto toLocal = [&](int v) { return (v / edgeCount - local.rowBegin) * local.getColumns() + v % edgeCount - local.columnBegin; };
+
+    // the tile's share of the grid: vertices at their build layout (the rest lengths), constraints as the
+    // grid builds them, kept when one endpoint is owned
+    TissueModel model;
+    model.positions.resize(local.getCount());
+    float width = (float)tissue.getMaxEdgeWidth();
+    for (int v : local.getVertices(edgeCount))
+    {
+        int i = v / edgeCount, j = v % edgeCount;
+        model.positions.set(toLocal(v), glm::vec3(-(width/2.0f) + j*(width/(edgeCount-1.0f)), -(width/2.0f) + i*(width/(edgeCount-1.0f)), 0.0f));
+    }
+    auto addEdge = [&](int i1, int j1, int i2, int j2) {
+        if (!local.contains(i1, j1) || !local.contains(i2, j2)) return;
+        if (!tile.owned.contains(i1, j1) && !tile.owned.contains(i2, j2)) return;
+        model.edgeFirst.push_back(toLocal(i1 * edgeCount + j1));
+        model.edgeSecond.push_back(toLocal(i2 * edgeCount + j2));
+    };
+    for (int i = local.rowBegin; i < local.rowEnd; i++)
+    {
+        for (int j = local.columnBegin; j < local.columnEnd; j++)
+        {
+            if (j + 1 < edgeCount) addEdge(i, j, i, j + 1);
+            if (i + 1 < edgeCount) addEdge(i, j, i + 1, j);
+            if (i + 1 < edgeCount && j + 1 < edgeCount) addEdge(i, j, i + 1, j + 1);
+            if (i + 1 < edgeCount && j > 0) addEdge(i, j, i + 1, j - 1);
+        }
+    }
+    Tissue part(model, 1.0f / tissue.getFreeInverseMass(), tissue.getIntegrator());
+    part.iterations = tissue.iterations;
+    part.substeps = tissue.substeps;
+    part.compliance = tissue.compliance;
+    part.dampingFactor = tissue.dampingFactor;
+    for (int v : local.getVertices(edgeCount))
+    {
+        int l = toLocal(v);
+        part.positions.set(l, tissue.positions.get(v));
+        part.estimatedPositions.set(l, tissue.positions.get(v));
+        part.velocities.set(l, tissue.velocities.get(v));
+        part.inverseMass[l] = tissue.inverseMass[v];
+    }
+
+    std::vector<std::vector<int>> send, receive; // local indices per link
+    for (const DomainLink& link : tile.links)
+    {
+        send.emplace_back();
+        receive.emplace_back();
+        for (int v : link.send) send.back().push_back(toLocal(v));
+        for (int v : link.receive) receive.back().push_back(toLocal(v));
+    }
+    std::vector<int> owned;
+    for (int v : tile.owned.getVertices(edgeCount)) owned.push_back(toLocal(v));
+
+    Vec3Streams& estimated = part.estimatedPositions;
+    auto exchange = [&]() {
+        for (int k = 0; k < (int)send.size(); k++)
+        {
+            float* out = transport->getOutgoing(worker, k);
+            for (size_t n = 0; n < send[k].size(); n++)
+            {
+                int l = send[k][n];
+                out[3*n] = estimated.x[l];
+                out[3*n + 1] = estimated.y[l];
+                out[3*n + 2] = estimated.z[l];
+            }
+        }
+        if (!transport->exchange(worker)) return false;
+        for (int k = 0; k < (int)receive.size(); k++)
+        {
+            const float* in = transport->getIncoming(worker, k);
+            for (size_t n = 0; n < receive[k].size(); n++) estimated.set(receive[k][n], glm::vec3(in[3*n], in[3*n + 1], in[3*n + 2]));
+        }
+        return true;
+    };
+
+    DomainCommand command;
+    while (transport->receive(worker, command) && command.type != DomainCommandType::Stop)
+    {
+        for (int e = 0; e < command.editCount; e++)
+        {
+            const DomainVertexEdit& edit = command.edits[e];
+            int i = edit.vertex / edgeCount, j = edit.vertex % edgeCount;
+            if (!local.contains(i, j)) continue;
+            int l = toLocal(edit.vertex);
+            part.positions.set(l, part.positions.get(l) + glm::vec3(edit.offset[0], edit.offset[1], edit.offset[2]));
+            part.inverseMass[l] = edit.inverseMass;
+        }
+
+        if (command.type == DomainCommandType::Step)
+        {
+            float h = command.deltaTime / part.substeps;
+            glm::vec3 gravity(command.gravity[0], command.gravity[1], command.gravity[2]);
+            bool ok = true;
+            for (int s = 0; s < part.substeps && ok; s++)
+            {
+                part.addGravity(h, gravity);
+                if (s == 0) part.applyDamping(part.dampingFactor);
+                part.updateEstimatedPositions(h);
+                ok = exchange();
+                part.beginSubstep(h);
+                for (int it = 0; it < part.iterations && ok; it++)
+                {
+                    part.SolveAllStretchConstraints();
+                    ok = exchange();
+                }
+                part.updateVelocitiesAndPositions(h);
+            }
+            if (!ok) break;
+
+            float* state = transport->getState(worker);
+            size_t count = owned.size();
+            for (size_t n = 0; n < count; n++)
+            {
+                int l = owned[n];
+                state[n] = part.positions.x[l];
+                state[count + n] = part.positions.y[l];
+                state[2 * count + n] = part.positions.z[l];
+                state[3 * count + n] = part.velocities.x[l];
+                state[4 * count + n] = part.velocities.y[l];
+                state[5 * count + n] = part.velocities.z[l];
+            }
+        }
+        transport->finish(worker);
+    }
+    transport->finish(worker);
+    _exit(0); // no destructors or atexit handlers of the coordinator's copy
+#else
+    (void)worker;
+#endif
+}
@@ -0,0 +1,71 @@
+#ifndef DOMAIN_SOLVER_H
+#define DOMAIN_SOLVER_H
+
+#include "domain_partition.h"
+#include "domain_transport.h"
+#include "tissue.h"
+#include <glm/glm.hpp>
+
+#include <memory>
+#include <vector>
+
+/*
+    DomainSolver (Tissue::step of one grid split over worker processes, one per tile, see DomainPartition)
+        each worker builds a Tissue of its tile plus halo from the coordinator's state: the stretch constraints
+        with at least one owned endpoint, rest lengths from the grid layout. A step there is Tissue::step with
+        a halo exchange of the estimated positions after the prediction and after every sweep:
+            gravity, damping, prediction, exchange, then `iterations` x (sweep, exchange), velocity update
+        A constraint across two tiles is projected by both, each moving only its own endpoint by that endpoint's
+        share, so the tiles meet like a Jacobi update along their borders; results differ from a single process
+        within the solver tolerance, not bit for bit. Damping removes each tile's own rigid motion.
+        The coordinator (the process that owns the Tissue) gathers positions and velocities back after every
+        step, so Mesh::updatePositions / draw see the whole grid. Grids in build order only, explicit or implicit
+        constraints, no sleeping, multigrid, self-collision or obstacles; residualTolerance and solverBudgetMs
+        are ignored, every step runs `iterations` sweeps per substep.
+        Workers are fork()ed by the constructor, so build it on the thread that owns the tissue, not while a
+        SimulationThread steps it; the Tissue's solver threads are not needed by the workers.
+*/
+class DomainSolver
+{
+    public:
+    // nullptr when the tissue can be split into tilesAcross x tilesDown worker tiles, else why not
+    static const char* getUnsupportedReason(const Tissue& tissue, int tilesAcross, int tilesDown);
+    // workers on this machine over a SharedMemoryTransport; nullptr, with the reason printed, when that failed
+    static std::unique_ptr<DomainSolver> createLocal(Tissue& tissue, int tilesAcross, int tilesDown);
+
+    // forks one worker per tile from the tissue's current state, each talking over transport
+    DomainSolver(Tissue& tissue, const DomainPartition& partition, std::unique_ptr<DomainTransport> transport);
+    // stops and reaps the workers
+    ~DomainSolver();
+
+    // false once a worker failed to start or died; the tissue keeps the last gathered state
+    bool isValid() const { return valid; }
+
+    // one step on the workers, then the positions and velocities are gathered into the tissue; false when a worker died
+    bool step(float deltaTime, glm::vec3 gravity);
+    // moves vertex i (current index) by offset with the given inverse mass, on the workers from the next step on
+    void setVertex(int vertex, glm::vec3 offset, float inverseMass);
+
+    const DomainPartition& getPartition() const { return partition; }
+    int getWorkerCount() const { return partition.getTileCount(); }
+    // wall time of the last step, gather included
+    float getLastStepMs() const { return lastStepMs; }
+
+    private:
+    Tissue& tissue;
+    DomainPartition partition;
+    std::unique_ptr<DomainTransport> transport;
+    std::vector<int> workers;   // process ids, 0 once reaped
+    std::vector<DomainVertexEdit> edits; // for the next step
+    bool valid;
+    float lastStepMs;
+
+    // posts command and waits for every worker; a dead worker fails the solver
+    bool run(const DomainCommand& command);
+    void fail(const char* reason, int worker);
+    void reapWorkers(bool kill);
+    // the worker process: never returns
+    void runWorker(int worker);
+};
+
+#endif
@@ -0,0 +1,31 @@
+#include "regression_tests.h"
+#include "domain_solver.h"
+
+#include <iostream>
+#include <memory>
+
+// processes: one DomainSolver tile is bit-identical to the tissue stepped in this process
+int testProcesses()
+{
+    Tissue local(EDGE_COUNT, 1);
+    Tissue split(EDGE_COUNT, 1);
+    if (DomainSolver::getUnsupportedReason(split, 1, 1))
+    {
+        std::cout << "skipped: " << DomainSolver::getUnsupportedReason(split, 1, 1) << std::endl;
+        return SKIPPED;
+    }
+    std::unique_ptr<DomainSolver> solver = DomainSolver::createLocal(split, 1, 1);
+    if (!solver) return 1;
+    for (int s = 0; s < STEPS; s++)
+    {
+        local.step(DELTA_TIME, GRAVITY);
+        if (!solver->step(DELTA_TIME, GRAVITY))
+        {
+            std::cout << "FAIL the worker died" << std::endl;
+            return 1;
+        }
+    }
+    return expectSame(local, split, "one worker tile vs in process") ? 0 : 1;
+}
+
+static RegressionCase processes("processes", testProcesses);
@@ -0,0 +1,222 @@
+#include "domain_transport.h"
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <new>
+#include <thread>
+
+#ifdef DOMAIN_PROCESSES
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+static_assert(ATOMIC_LLONG_LOCK_FREE == 2 && ATOMIC_INT_LOCK_FREE == 2, "shared memory atomics have to be lock-free");
+
+const size_t SEGMENT_ALIGNMENT = 64;
+
+struct SharedMemoryTransport::Control
+{
+    std::atomic<uint64_t> sequence; // bumped by the coordinator once the command is written
+    std::atomic<int32_t> finished;  // workers done with the command
+    std::atomic<int32_t> aborted;
+    DomainCommand command;
+};
+
+struct alignas(SEGMENT_ALIGNMENT) SharedMemoryTransport::WorkerSlot
+{
+    std::atomic<uint64_t> round;    // exchanges the worker has published
+};
+
+namespace
+{
+    size_t alignUp(size_t value)
+    {
+        return (value + SEGMENT_ALIGNMENT - 1) / SEGMENT_ALIGNMENT * SEGMENT_ALIGNMENT;
+    }
+
+    // one poll of a wait: yield while the other side is likely just a few microseconds away, then sleep
+    void backOff(int& polls)
+    {
+        if (polls++ < DOMAIN_SPIN_YIELDS) std::this_thread::yield();
+        else std::this_thread::sleep_for(std::chrono::microseconds(DOMAIN_IDLE_SLEEP_US));
+    }
+}
+
+SharedMemoryTransport::SharedMemoryTransport(const DomainPartition& partition)
+    : workerCount(partition.getTileCount()), received(0), coordinator(0), base(nullptr), bytes(0)
+{
+    // lay the segment out: control, worker slots, halo buffers, states
+    size_t offset = alignUp(sizeof(Control)) + alignUp(sizeof(WorkerSlot)) * workerCount;
+    peers.resize(workerCount);
+    linkFloats.resize(workerCount);
+    outgoingOffset.resize(workerCount);
+    incomingOffset.resize(workerCount);
+    incomingFloats.resize(workerCount);
+    for (int w = 0; w < workerCount; w++)
+    {
+        for (const DomainLink& link : partition.getTile(w).links)
+        {
+            peers[w].push_back(link.peer);
+            linkFloats[w].push_back(3 * link.send.size());
+            outgoingOffset[w].push_back(offset);
+            offset += alignUp(2 * linkFloats[w].back() * sizeof(float));
+        }
+    }
+    for (int w = 0; w < workerCount; w++)
+    {
+        for (int k = 0; k < (int)peers[w].size(); k++)
+        {
+            int reverse = partition.getReverseLink(w, k);
+            incomingOffset[w].push_back(outgoingOffset[peers[w][k]][reverse]);
+            incomingFloats[w].push_back(linkFloats[peers[w][k]][reverse]);
+        }
+    }
+    for (int w = 0; w < workerCount; w++)
+    {
+        stateOffset.push_back(offset);
+        offset += alignUp(6 * (size_t)partition.getTile(w).owned.getCount() * sizeof(float));
+    }
+    rounds.assign(workerCount, 0);
+
+#ifdef DOMAIN_PROCESSES
+    // a name nobody else uses, gone again once mapped
+    static std::atomic<int> segmentCount(0);
+    std::string name = "/tissue-domain-" + std::to_string(getpid()) + "-" + std::to_string(segmentCount++);
+    int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fd < 0)
+    {
+        error = "shm_open " + name + ": " + std::strerror(errno);
+        return;
+    }
+    shm_unlink(name.c_str());
+    if (ftruncate(fd, (off_t)offset) != 0)
+    {
+        error = "ftruncate to " + std::to_string(offset) + " bytes: " + std::strerror(errno);
+        close(fd);
+        return;
+    }
+    void* mapped = mmap(nullptr, offset, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapped == MAP_FAILED)
+    {
+        error = std::string("mmap: ") + std::strerror(errno);
+        return;
+    }
+    base = (char*)mapped;
+    bytes = offset;
+    coordinator = (long)getpid();
+
+    // ftruncate zero-filled the rest
+    Control* control = new (base) Control();
+    control->sequence.store(0);
+    control->finished.store(0);
+    control->aborted.store(0);
+    for (int w = 0; w < workerCount; w++) (new (getSlot(w)) WorkerSlot())->round.store(0);
+#else
+    error = "no POSIX shared memory on this platform";
+#endif
+}
+
+SharedMemoryTransport::~SharedMemoryTransport()
+{
+#ifdef DOMAIN_PROCESSES
+    if (base) munmap(base, bytes);
+#endif
+}
+
+SharedMemoryTransport::WorkerSlot* SharedMemoryTransport::getSlot(int worker) const
+{
+    return (WorkerSlot*)(base + alignUp(sizeof(Control)) + alignUp(sizeof(WorkerSlot)) * worker);
+}
+
+bool SharedMemoryTransport::post(const DomainCommand& command)
+{
+    Control* control = getControl();
+    if (control->aborted.load()) return false;
+    std::memcpy(&control->command, &command, sizeof(command));
+    control->finished.store(0, std::memory_order_relaxed);
+    control->sequence.fetch_add(1, std::memory_order_release);
+    return true;
+}
+
+bool SharedMemoryTransport::wait(int timeoutMs)
+{
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+    const std::atomic<int32_t>& finished = getControl()->finished;
+    for (int polls = 0; finished.load(std::memory_order_acquire) < workerCount; backOff(polls))
+    {
+        if (std::chrono::steady_clock::now() > deadline) return false;
+    }
+    return true;
+}
+
+void SharedMemoryTransport::abort()
+{
+    getControl()->aborted.store(1);
+}
+
+bool SharedMemoryTransport::isOver() const
+{
+    if (getControl()->aborted.load(std::memory_order_relaxed)) return true;
+#ifdef DOMAIN_PROCESSES
+    return (long)getppid() != coordinator;
+#else
+    return false;
+#endif
+}
+
+bool SharedMemoryTransport::receive(int worker, DomainCommand& command)
+{
+    (void)worker;
+    Control* control = getControl();
+    for (int polls = 0; control->sequence.load(std::memory_order_acquire) == received; backOff(polls))
+    {
+        if (isOver()) return false;
+    }
+    received++;
+    std::memcpy(&command, &control->command, sizeof(command));
+    return true;
+}
+
+void SharedMemoryTransport::finish(int worker)
+{
+    (void)worker;
+    getControl()->finished.fetch_add(1, std::memory_order_release);
+}
+
+float* SharedMemoryTransport::getState(int worker)
+{
+    return (float*)(base + stateOffset[worker]);
+}
+
+float* SharedMemoryTransport::getOutgoing(int worker, int link)
+{
+    size_t buffer = (rounds[worker] + 1) & 1;
+    return (float*)(base + outgoingOffset[worker][link]) + buffer * linkFloats[worker][link];
+}
+
+const float* SharedMemoryTransport::getIncoming(int worker, int link) const
+{
+    size_t buffer = rounds[worker] & 1;
+    return (const float*)(base + incomingOffset[worker][link]) + buffer * incomingFloats[worker][link];
+}
+
+// publish, then poll until every neighbour published the same round; the release / acquire pair on the
+// round counters orders the halo buffers
+bool SharedMemoryTransport::exchange(int worker)
+{
+    uint64_t round = ++rounds[worker];
+    getSlot(worker)->round.store(round, std::memory_order_release);
+    for (int peer : peers[worker])
+    {
+        const std::atomic<uint64_t>& peerRound = getSlot(peer)->round;
+        for (int polls = 0; peerRound.load(std::memory_order_acquire) < round; backOff(polls))
+        {
+            if (isOver()) return false;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,134 @@
+#ifndef DOMAIN_TRANSPORT_H
+#define DOMAIN_TRANSPORT_H
+
+#include "domain_partition.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define DOMAIN_PROCESSES 1 // fork() and POSIX shared memory, what DomainSolver::createLocal needs
+#endif
+
+enum class DomainCommandType : int32_t
+{
+    Step,   // one Tissue::step of deltaTime under gravity
+    Edit,   // apply the edits, no step
+    Stop    // leave the worker loop
+};
+
+// a vertex the coordinator moved by offset and pinned (inverse mass 0) or let go, applied by every tile holding a copy
+struct DomainVertexEdit
+{
+    int32_t vertex;     // build index
+    float offset[3];
+    float inverseMass;
+};
+
+const int DOMAIN_MAX_EDITS = 64; // per command, more go out as several Edit commands
+const int DOMAIN_SPIN_YIELDS = 1000;    // polls with sched_yield before a waiting process starts sleeping
+const int DOMAIN_IDLE_SLEEP_US = 50;
+
+struct DomainCommand
+{
+    DomainCommandType type;
+    float deltaTime;
+    float gravity[3];
+    int32_t editCount;
+    DomainVertexEdit edits[DOMAIN_MAX_EDITS];
+};
+
+/*
+    DomainTransport (what the coordinator and the workers of a DomainSolver exchange, and how)
+        coordinator     post() hands a command to every worker, wait() blocks until all of them ran it
+        worker          receive() blocks for the next command, finish() reports it done
+                        getState(): the owned vertices' positions then velocities as six streams (px py pz vx vy vz)
+                        of owned-count floats each, row by row; written before finish(), read after wait()
+        halo exchange   a worker fills getOutgoing(link) with xyz of DomainLink::send, calls exchange() and then
+                        reads getIncoming(link), xyz of DomainLink::receive. Only linked workers wait on each other,
+                        so a tile can run ahead of the far side of the grid by one exchange.
+        false from any call means the solve is over: a peer is gone, the coordinator gave up (abort) or died
+*/
+class DomainTransport
+{
+    public:
+    virtual ~DomainTransport() {}
+
+    virtual bool post(const DomainCommand& command) = 0;
+    // false when timeoutMs passed first; call again to keep waiting for the rest
+    virtual bool wait(int timeoutMs) = 0;
+    // wakes every worker with a failure, whatever it is blocked in
+    virtual void abort() = 0;
+
+    virtual bool receive(int worker, DomainCommand& command) = 0;
+    virtual void finish(int worker) = 0;
+    virtual float* getState(int worker) = 0;
+
+    virtual float* getOutgoing(int worker, int link) = 0;
+    virtual const float* getIncoming(int worker, int link) const = 0;
+    virtual bool exchange(int worker) = 0;
+};
+
+/*
+    SharedMemoryTransport (workers forked on this machine, everything in one POSIX shared memory segment)
+        control block       the command and its sequence number, the count of workers done with it, the abort flag
+        per worker          exchange round counter, on its own cache line
+        per link            two halo buffers, written in alternate rounds: a worker can fill round r + 1 while
+                            its slower neighbour still reads round r
+        per worker          its state
+    Every wait polls lock-free atomics, yielding at first and then sleeping DOMAIN_IDLE_SLEEP_US between polls,
+    so idle workers between frames cost next to nothing and nothing needs process-shared semaphores (macOS has
+    none). The segment is unlinked as soon as it is mapped, so nothing is left behind if a process dies; workers
+    inherit the mapping through fork(), which has to come after the constructor. A dead coordinator cannot abort,
+    so the worker waits also end once the worker's parent is no longer the process that made the transport.
+*/
+class SharedMemoryTransport : public DomainTransport
+{
+    public:
+    explicit SharedMemoryTransport(const DomainPartition& partition);
+    ~SharedMemoryTransport();
+
+    // false, with the reason in getError(), when the segment could not be made (always without DOMAIN_PROCESSES)
+    bool isValid() const { return base != nullptr; }
+    const std::string& getError() const { return error; }
+    size_t getBytes() const { return bytes; }
+
+    bool post(const DomainCommand& command) override;
+    bool wait(int timeoutMs) override;
+    void abort() override;
+
+    bool receive(int worker, DomainCommand& command) override;
+    void finish(int worker) override;
+    float* getState(int worker) override;
+
+    float* getOutgoing(int worker, int link) override;
+    const float* getIncoming(int worker, int link) const override;
+    bool exchange(int worker) override;
+
+    private:
+    struct Control;
+    struct WorkerSlot;
+
+    int workerCount;
+    std::vector<std::vector<int>> peers;            // per worker and link
+    std::vector<std::vector<size_t>> linkFloats;    // floats per round, 3 per vertex sent
+    std::vector<std::vector<size_t>> outgoingOffset; // byte offset of the link's first buffer
+    std::vector<std::vector<size_t>> incomingOffset; // the peer's outgoing buffers for this worker
+    std::vector<std::vector<size_t>> incomingFloats; // and their floats per round, 3 per vertex received
+    std::vector<size_t> stateOffset;
+    std::vector<uint64_t> rounds;   // exchanges each worker finished; every process only moves its own worker's
+    uint64_t received;              // worker: sequence number of the last command taken
+    long coordinator;               // process id of the constructor's caller, the workers' parent
+    char* base;
+    size_t bytes;
+    std::string error;
+
+    Control* getControl() const { return (Control*)base; }
+    WorkerSlot* getSlot(int worker) const;
+    // worker: aborted, or reparented because the coordinator died
+    bool isOver() const;
+};
+
+#endif
@@ -0,0 +1,248 @@
+#ifndef FRAME_CAPTURE_H
+#define FRAME_CAPTURE_H
+
+#include <glad/glad.h>
+#include "spsc_queue.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+enum class VideoFormat
+{
+    Raw,    // bare top-down RGBA8 frames, e.g. ffmpeg -f rawvideo -pix_fmt rgba -s WxH
+    Y4M     // YUV4MPEG2, 4:2:0 BT.601 limited range; plays in ffplay / mpv directly
+};
+
+const size_t VIDEO_QUEUE_FRAMES = 8;   // frames buffered between capture and the writer thread
+const int CAPTURE_RING_SIZE = 3;       // pixel-pack buffers in flight
+
+/*
+    VideoWriter
+        submit() copies a finished frame into one of VIDEO_QUEUE_FRAMES buffers and returns;
+        a background thread converts and writes it, so disk and colour conversion stay off the render thread
+        submit only waits when all buffers are queued (counted in getStalls)
+*/
+class VideoWriter
+{
+    public:
+    VideoWriter(const std::string& path, int width, int height, int fps, VideoFormat format)
+        : width(width), height(height), format(format), frames(VIDEO_QUEUE_FRAMES)
+    {
+        file = std::fopen(path.c_str(), "wb");
+        if (!file)
+        {
+            std::cout << "ERROR::VIDEO::CANNOT_OPEN " << path << std::endl;
+            return;
+        }
+        if (format == VideoFormat::Y4M) std::fprintf(file, "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C420jpeg\n", width, height, fps);
+
+        for (size_t i = 0; i < VIDEO_QUEUE_FRAMES; i++)
+        {
+            frames[i].resize((size_t)width * height * 4);
+            freeFrames.push((int)i);
+        }
+        writer = std::thread([this]() { writerLoop(); });
+    }
+
+    ~VideoWriter()
+    {
+        if (!file) return;
+        stopping.store(true, std::memory_order_release);
+        writer.join();
+        std::fclose(file);
+    }
+
+    VideoWriter(const VideoWriter&) = delete;
+    VideoWriter& operator=(const VideoWriter&) = delete;
+
+    bool isOpen() const { return file != nullptr; }
+
+    // rgba: width * height RGBA8 pixels, bottom row first (glReadPixels order)
+    void submit(const unsigned char* rgba)
+    {
+        if (!file) return;
+        int frame;
+        if (!freeFrames.pop(frame))
+        {
+            stalls++;
+            while (!freeFrames.pop(frame)) std::this_thread::yield();
+        }
+        std::memcpy(frames[frame].data(), rgba, frames[frame].size());
+        queuedFrames.push(frame);
+    }
+
+    uint64_t getFramesWritten() const { return written.load(std::memory_order_relaxed); }
+    uint64_t getStalls() const { return stalls; }
+
+    private:
+    int width, height;
+    VideoFormat format;
+    FILE* file;
+    std::vector<std::vector<unsigned char>> frames;
+    SpscQueue<int, VIDEO_QUEUE_FRAMES> freeFrames;     // writer -> capture
+    SpscQueue<int, VIDEO_QUEUE_FRAMES> queuedFrames;   // capture -> writer
+    std::vector<unsigned char> output;                 // writer thread only
+    std::atomic<bool> stopping{ false };
+    std::atomic<uint64_t> written{ 0 };
+    uint64_t stalls = 0;
+    std::thread writer;
+
+    void writerLoop()
+    {
+        size_t chroma = (size_t)((width + 1) / 2) * ((height + 1) / 2);
+        output.resize(format == VideoFormat::Y4M ? (size_t)width * height + 2 * chroma : (size_t)width * height * 4);
+        while (true)
+        {
+            // read stopping before popping: every frame submitted before the stop is then visible
+            bool done = stopping.load(std::memory_order_acquire);
+            int frame;
+            if (!queuedFrames.pop(frame))
+            {
+                if (done) return;
+                std::this_thread::sleep_for(std::chrono::microseconds(500));
+                continue;
+            }
+            writeFrame(frames[frame].data());
+            freeFrames.push(frame);
+            written.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    void writeFrame(const unsigned char* rgba)
+    {
+        // locals, not members: byte stores may alias *this, which would keep the loops from vectorizing
+        const int width = this->width, height = this->height;
+        size_t pixels = (size_t)width * height;
+        if (format == VideoFormat::Raw)
+        {
+            // flip to top-down
+            size_t rowBytes = (size_t)width * 4;
+            for (int row = 0; row < height; row++)
+            {
+                std::memcpy(&output[row * rowBytes], rgba + (size_t)(height - 1 - row) * rowBytes, rowBytes);
+            }
+            std::fwrite(output.data(), 1, output.size(), file);
+            return;
+        }
+
+        // RGB -> Y'CbCr (BT.601, limited range), planar and top-down, chroma averaged over 2x2 pixels
+        int chromaWidth = (width + 1) / 2, chromaHeight = (height + 1) / 2;
+        unsigned char* yPlane = output.data();
+        unsigned char* uPlane = yPlane + pixels;
+        unsigned char* vPlane = uPlane + (size_t)chromaWidth * chromaHeight;
+        for (int row = 0; row < height; row++)
+        {
+            const unsigned char* source = rgba + (size_t)(height - 1 - row) * width * 4;
+            unsigned char* luma = yPlane + (size_t)row * width;
+            for (int column = 0; column < width; column++)
+            {
+                int r = source[column * 4 + 0], g = source[column * 4 + 1], b = source[column * 4 + 2];
+                luma[column] = (unsigned char)(((66 * r + 129 * g + 25 * b + 128) >> 8) + 16);
+            }
+        }
+        for (int row = 0; row < chromaHeight; row++)
+        {
+            // output rows 2 row and 2 row + 1 are input rows height - 1 - 2 row and the one below it
+            const unsigned char* top = rgba + (size_t)(height - 1 - 2 * row) * width * 4;
+            const unsigned char* bottom = 2 * row + 1 < height ? top - (size_t)width * 4 : top;
+            for (int column = 0; column < chromaWidth; column++)
+            {
+                // an odd last column pairs with itself
+                const unsigned char* left = top + column * 8;
+                int step = 2 * column + 1 < width ? 4 : 0;
+                int below = (int)(bottom - top);
+                int r = left[0] + left[step + 0] + left[below + 0] + left[below + step + 0];
+                int g = left[1] + left[step + 1] + left[below + 1] + left[below + step + 1];
+                int b = left[2] + left[step + 2] + left[below + 2] + left[below + step + 2];
+                uPlane[(size_t)row * chromaWidth + column] = (unsigned char)(((-38 * r - 74 * g + 112 * b + 512) >> 10) + 128);
+                vPlane[(size_t)row * chromaWidth + column] = (unsigned char)(((112 * r - 94 * g - 18 * b + 512) >> 10) + 128);
+            }
+        }
+        std::fputs("FRAME\n", file);
+        std::fwrite(output.data(), 1, output.size(), file);
+    }
+};
+
+/*
+    FrameCapture
+        reads the bound framebuffer into a ring of CAPTURE_RING_SIZE pixel-pack buffers;
+        glReadPixels into a PBO returns at once, the frame is mapped and handed to the
+        VideoWriter only when its buffer comes round again, by which time the GPU is done with it
+    Needs a current GL context; call capture() after drawing each frame and finish() before the end.
+*/
+class FrameCapture
+{
+    public:
+    FrameCapture(int width, int height, VideoWriter& writer)
+        : width(width), height(height), writer(writer), next(0), pending(0)
+    {
+        glGenBuffers(CAPTURE_RING_SIZE, pixelBuffers);
+        for (int i = 0; i < CAPTURE_RING_SIZE; i++)
+        {
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, pixelBuffers[i]);
+            glBufferData(GL_PIXEL_PACK_BUFFER, (GLsizeiptr)width * height * 4, nullptr, GL_STREAM_READ);
+            fences[i] = 0;
+        }
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    }
+
+    ~FrameCapture()
+    {
+        for (int i = 0; i < CAPTURE_RING_SIZE; i++) if (fences[i]) glDeleteSync(fences[i]);
+        glDeleteBuffers(CAPTURE_RING_SIZE, pixelBuffers);
+    }
+
+    FrameCapture(const FrameCapture&) = delete;
+    FrameCapture& operator=(const FrameCapture&) = delete;
+
+    void capture()
+    {
+        if (pending == CAPTURE_RING_SIZE) collect(next);
+
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, pixelBuffers[next]);
+        glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, (void*)0);
+        fences[next] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+        next = (next + 1) % CAPTURE_RING_SIZE;
+        pending++;
+    }
+
+    // hands every frame still in flight to the writer, oldest first
+    void finish()
+    {
+        while (pending > 0) collect((next - pending + CAPTURE_RING_SIZE) % CAPTURE_RING_SIZE);
+    }
+
+    private:
+    int width, height;
+    VideoWriter& writer;
+    unsigned int pixelBuffers[CAPTURE_RING_SIZE];
+    GLsync fences[CAPTURE_RING_SIZE];
+    int next;       // buffer the next capture reads into
+    int pending;    // captured but not yet handed to the writer
+
+    void collect(int slot)
+    {
+        GLbitfield flags = GL_SYNC_FLUSH_COMMANDS_BIT;
+        while (glClientWaitSync(fences[slot], flags, 1000000000) == GL_TIMEOUT_EXPIRED) flags = 0;
+        glDeleteSync(fences[slot]);
+        fences[slot] = 0;
+
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, pixelBuffers[slot]);
+        const unsigned char* pixels = (const unsigned char*)glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, (GLsizeiptr)width * height * 4, GL_MAP_READ_BIT);
+        if (pixels) writer.submit(pixels);
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        pending--;
+    }
+};
+
+#endif
@@ -0,0 +1,304 @@
+#ifndef GPU_SOLVER_H
+#define GPU_SOLVER_H
+
+#include <glad/glad.h>
+#include "shader.h"
+#include "tissue.h"
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+const int GPU_DAMPING_CHUNK = 4096; // vertices per DampingReduce workgroup, as DAMPING_CHUNK on the CPU
+const int GPU_DAMPING_MOMENTS = 16;
+const int GPU_GROUP_SIZE = 256;     // local_size_x of the per-vertex and per-constraint shaders
+const int GPU_QUERY_RING = 3;       // step timer queries in flight before the oldest is read
+
+/*
+    GpuSolver (Tissue::step as compute dispatches, GL 4.3)
+        shader storage buffers, vertices as vec4 so the position buffer doubles as the draw's attribute 0
+            0 positions (xyz, w = inverse mass)   1 estimated positions (same)   2 velocities
+            3 constraints (first, second, rest length) in the Tissue's color order
+            4 damping partials, 16 doubles per GPU_DAMPING_CHUNK vertices
+            5 damping result (center, center velocity, angular velocity)
+            6 XPBD multipliers, cleared every substep
+        shaders/Integrate.comp                      gravity, prediction, velocity update, drag
+        shaders/Damping{Reduce,Fold,Apply}.comp     rigid-mode damping, reduced in double
+        shaders/SolveConstraints.comp               one dispatch per color and sweep
+        State stays on the GPU between steps; download() copies it back. Residuals are not
+        measured, so every step runs `iterations` sweeps (residualTolerance / solverBudgetMs are CPU only).
+*/
+class GpuSolver
+{
+    public:
+    // needs the current context to be 4.3 (compute, SSBOs, fp64, buffer clears)
+    static bool isSupported()
+    {
+        GLint major = 0, minor = 0;
+        glGetIntegerv(GL_MAJOR_VERSION, &major);
+        glGetIntegerv(GL_MINOR_VERSION, &minor);
+        bool version = major > 4 || (major == 4 && minor >= 3);
+        return version && GLAD_GL_ARB_compute_shader && GLAD_GL_ARB_shader_storage_buffer_object
+            && GLAD_GL_ARB_gpu_shader_fp64 && GLAD_GL_ARB_clear_buffer_object;
+    }
+
+    // shaderDirectory ends with a separator, e.g. "../shaders/"; uploads the tissue's current state
+    GpuSolver(const Tissue& tissue, const std::string& shaderDirectory)
+        : integrate((shaderDirectory + "Integrate.comp").c_str()),
+          dampingReduce((shaderDirectory + "DampingReduce.comp").c_str()),
+          dampingFold((shaderDirectory + "DampingFold.comp").c_str()),
+          dampingApply((shaderDirectory + "DampingApply.comp").c_str()),
+          solveConstraints((shaderDirectory + "SolveConstraints.comp").c_str()),
+          vertexCount(tissue.getVertexCount()), colorOffsets(tissue.getColorOffsets()),
+          querySlot(0), lastStepMs(0.0f)
+    {
+        int constraintCount = tissue.getConstraintCount();
+        int chunks = (vertexCount + GPU_DAMPING_CHUNK - 1) / GPU_DAMPING_CHUNK;
+
+        glGenBuffers(BUFFER_COUNT, buffers);
+        createBuffer(POSITIONS, (size_t)vertexCount * 4 * sizeof(float), nullptr);
+        createBuffer(ESTIMATED_POSITIONS, (size_t)vertexCount * 4 * sizeof(float), nullptr);
+        createBuffer(VELOCITIES, (size_t)vertexCount * 4 * sizeof(float), nullptr);
+
+        // first, second, rest length: 12 bytes per constraint under std430
+        std::vector<int32_t> constraints((size_t)constraintCount * 3);
+        const std::vector<float>& restLength = tissue.getConstraintRestLength();
+        for (int c = 0; c < constraintCount; c++)
+        {
+            constraints[c * 3 + 0] = tissue.getConstraintFirst()[c];
+            constraints[c * 3 + 1] = tissue.getConstraintSecond()[c];
+            std::memcpy(&constraints[c * 3 + 2], &restLength[c], sizeof(float));
+        }
+        createBuffer(CONSTRAINTS, std::max<size_t>(constraints.size() * sizeof(int32_t), 4), constraints.data());
+        createBuffer(DAMPING_PARTIALS, (size_t)std::max(chunks, 1) * GPU_DAMPING_MOMENTS * sizeof(double), nullptr);
+        createBuffer(DAMPING, 3 * 4 * sizeof(float), nullptr);
+        createBuffer(LAMBDA, (size_t)std::max(constraintCount, 1) * sizeof(float), nullptr);
+
+        glGenQueries(GPU_QUERY_RING, queries);
+        for (int q = 0; q < GPU_QUERY_RING; q++) queryPending[q] = false;
+
+        upload(tissue);
+    }
+
+    ~GpuSolver()
+    {
+        glDeleteBuffers(BUFFER_COUNT, buffers);
+        glDeleteQueries(GPU_QUERY_RING, queries);
+        Shader* programs[] = { &integrate, &dampingReduce, &dampingFold, &dampingApply, &solveConstraints };
+        for (Shader* program : programs) glDeleteProgram(program->ID);
+    }
+
+    GpuSolver(const GpuSolver&) = delete;
+    GpuSolver& operator=(const GpuSolver&) = delete;
+
+    // every compute program compiled and linked
+    bool isValid() const
+    {
+        return integrate.isLinked() && dampingReduce.isLinked() && dampingFold.isLinked()
+            && dampingApply.isLinked() && solveConstraints.isLinked();
+    }
+
+    // the vec4 position buffer, xyz + inverse mass; a vertex attribute with 3 components and a 16 byte stride
+    GLuint getPositionBuffer() const { return buffers[POSITIONS]; }
+    // GPU time of a step() a few frames back (timer query), 0 until the first one is read
+    float getLastStepMs() const { return lastStepMs; }
+
+    // positions, inverse masses and velocities from the Tissue
+    void upload(const Tissue& tissue)
+    {
+        std::vector<float> packed((size_t)vertexCount * 4);
+        for (int i = 0; i < vertexCount; i++)
+        {
+            packed[i * 4 + 0] = tissue.positions.x[i];
+            packed[i * 4 + 1] = tissue.positions.y[i];
+            packed[i * 4 + 2] = tissue.positions.z[i];
+            packed[i * 4 + 3] = tissue.inverseMass[i];
+        }
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffers[POSITIONS]);
+        glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, packed.size() * sizeof(float), packed.data());
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffers[ESTIMATED_POSITIONS]);
+        glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, packed.size() * sizeof(float), packed.data());
+
+        for (int i = 0; i < vertexCount; i++)
+        {
+            packed[i * 4 + 0] = tissue.velocities.x[i];
+            packed[i * 4 + 1] = tissue.velocities.y[i];
+            packed[i * 4 + 2] = tissue.velocities.z[i];
+            packed[i * 4 + 3] = 0.0f;
+        }
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffers[VELOCITIES]);
+        glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, packed.size() * sizeof(float), packed.data());
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    }
+
+    // positions, inverse masses and velocities back into the Tissue (waits for the GPU)
+    void download(Tissue& tissue) const
+    {
+        glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+        std::vector<float> packed((size_t)vertexCount * 4);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffers[POSITIONS]);
+        glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, packed.size() * sizeof(float), packed.data());
+        for (int i = 0; i < vertexCount; i++)
+        {
+            tissue.positions.set(i, glm::vec3(packed[i * 4 + 0], packed[i * 4 + 1], packed[i * 4 + 2]));
+            tissue.inverseMass[i] = packed[i * 4 + 3];
+        }
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffers[VELOCITIES]);
+        glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, packed.size() * sizeof(float), packed.data());
+        for (int i = 0; i < vertexCount; i++) tissue.velocities.set(i, glm::vec3(packed[i * 4 + 0], packed[i * 4 + 1], packed[i * 4 + 2]));
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    }
+
+    // moves vertex by offset and gives it inverseMass (0 pins it), without a read back
+    void setVertex(int vertex, glm::vec3 offset, float inverseMass)
+    {
+        bindBuffers();
+        integrate.use();
+        integrate.setInt("stage", STAGE_SET_VERTEX);
+        integrate.setInt("count", 1);
+        integrate.setInt("vertex", vertex);
+        integrate.setVec3("offset", offset.x, offset.y, offset.z);
+        integrate.setFloat("inverseMass", inverseMass);
+        dispatch(1);
+    }
+
+    // Tissue::step with the tissue's settings (iterations, substeps, compliance, dampingFactor, integrator)
+    void step(const Tissue& tissue, float deltaTime, glm::vec3 gravity)
+    {
+        beginQuery();
+        bindBuffers();
+        int substeps = tissue.substeps;
+        float h = deltaTime / substeps;
+        bool xpbd = tissue.getIntegrator() == Integrator::XPBD;
+        int vertexGroups = (vertexCount + GPU_GROUP_SIZE - 1) / GPU_GROUP_SIZE;
+
+        for (int s = 0; s < substeps; s++)
+        {
+            // damping sits between gravity and prediction on the first substep only
+            integrate.use();
+            integrate.setInt("count", vertexCount);
+            integrate.setFloat("deltaTime", h);
+            integrate.setVec3("gravityStep", gravity.x * h, gravity.y * h, gravity.z * h);
+            integrate.setInt("stage", s == 0 ? STAGE_GRAVITY : STAGE_GRAVITY_PREDICT);
+            dispatch(vertexGroups);
+            if (s == 0)
+            {
+                applyDamping(tissue.dampingFactor, tissue.getFreeInverseMass());
+                integrate.use();
+                integrate.setInt("stage", STAGE_PREDICT);
+                dispatch(vertexGroups);
+            }
+
+            float alphaTilde = 0.0f;
+            if (xpbd)
+            {
+                float zero = 0.0f;
+                glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffers[LAMBDA]);
+                glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32F, GL_RED, GL_FLOAT, &zero);
+                alphaTilde = tissue.compliance / (h * h);
+            }
+            solveConstraints.use();
+            solveConstraints.setBool("xpbd", xpbd);
+            solveConstraints.setFloat("stiffness", STRETCH_STIFFNESS);
+            solveConstraints.setFloat("alphaTilde", alphaTilde);
+            GLint beginLocation = glGetUniformLocation(solveConstraints.ID, "colorBegin");
+            GLint endLocation = glGetUniformLocation(solveConstraints.ID, "colorEnd");
+            for (int i = 0; i < tissue.iterations; i++)
+            {
+                for (size_t c = 0; c + 1 < colorOffsets.size(); c++)
+                {
+                    int begin = colorOffsets[c], end = colorOffsets[c + 1];
+                    if (begin == end) continue;
+                    glUniform1i(beginLocation, begin);
+                    glUniform1i(endLocation, end);
+                    dispatch((end - begin + GPU_GROUP_SIZE - 1) / GPU_GROUP_SIZE);
+                }
+            }
+
+            integrate.use();
+            integrate.setInt("stage", STAGE_UPDATE);
+            dispatch(vertexGroups);
+        }
+        // the draw reads the positions as a vertex attribute next
+        glMemoryBarrier(GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+        endQuery();
+    }
+
+    private:
+    enum Buffer { POSITIONS, ESTIMATED_POSITIONS, VELOCITIES, CONSTRAINTS, DAMPING_PARTIALS, DAMPING, LAMBDA, BUFFER_COUNT };
+    enum Stage { STAGE_GRAVITY, STAGE_PREDICT, STAGE_GRAVITY_PREDICT, STAGE_UPDATE, STAGE_SET_VERTEX }; // Integrate.comp
+
+    Shader integrate, dampingReduce, dampingFold, dampingApply, solveConstraints;
+    GLuint buffers[BUFFER_COUNT];
+    int vertexCount;
+    std::vector<int> colorOffsets;
+    GLuint queries[GPU_QUERY_RING];
+    bool queryPending[GPU_QUERY_RING];
+    int querySlot;
+    float lastStepMs;
+
+    void createBuffer(Buffer buffer, size_t size, const void* data)
+    {
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffers[buffer]);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, size, data, GL_DYNAMIC_COPY);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    }
+
+    // binding points match the enum
+    void bindBuffers()
+    {
+        for (int b = 0; b < BUFFER_COUNT; b++) glBindBufferBase(GL_SHADER_STORAGE_BUFFER, b, buffers[b]);
+    }
+
+    // every pass reads what the previous one wrote
+    void dispatch(int groups)
+    {
+        glDispatchCompute(groups, 1, 1);
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+    }
+
+    void applyDamping(float dampingFactor, float freeInverseMass)
+    {
+        int chunks = (vertexCount + GPU_DAMPING_CHUNK - 1) / GPU_DAMPING_CHUNK;
+        dampingReduce.use();
+        dampingReduce.setInt("count", vertexCount);
+        dispatch(chunks);
+
+        dampingFold.use();
+        dampingFold.setInt("chunks", chunks);
+        dampingFold.setInt("count", vertexCount);
+        dampingFold.setFloat("freeInverseMass", freeInverseMass);
+        dispatch(1);
+
+        dampingApply.use();
+        dampingApply.setInt("count", vertexCount);
+        dampingApply.setFloat("dampingFactor", dampingFactor);
+        dispatch((vertexCount + GPU_GROUP_SIZE - 1) / GPU_GROUP_SIZE);
+    }
+
+    // the query reused now was issued GPU_QUERY_RING steps ago, so its result is normally in
+    void beginQuery()
+    {
+        if (queryPending[querySlot])
+        {
+            GLuint64 nanoseconds = 0;
+            glGetQueryObjectui64v(queries[querySlot], GL_QUERY_RESULT, &nanoseconds);
+            lastStepMs = (float)(nanoseconds * 1e-6);
+        }
+        glBeginQuery(GL_TIME_ELAPSED, queries[querySlot]);
+    }
+
+    void endQuery()
+    {
+        glEndQuery(GL_TIME_ELAPSED);
+        queryPending[querySlot] = true;
+        querySlot = (querySlot + 1) % GPU_QUERY_RING;
+    }
+};
+
+#endif
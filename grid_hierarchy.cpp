@@ -0,0 +1,146 @@
+#include "grid_hierarchy.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <cmath>
+
+// sweeps on the coarsest level, where they are cheapest
+const int COARSEST_SWEEPS = 4;
+// vertices per transfer task
+const int TRANSFER_CHUNK = 4096;
+
+namespace
+{
+    // coordinate k of a `from`-sized axis measured on a `to`-sized axis spanning the same length
+    std::vector<GridSample> makeSamples(int from, int to)
+    {
+        std::vector<GridSample> samples(from);
+        for (int k = 0; k < from; k++)
+        {
+            double u = from > 1 ? (double)k * (to - 1) / (from - 1) : 0.0;
+            int index = std::min((int)u, to - 2);
+            samples[k] = { index, (float)(u - index) };
+        }
+        return samples;
+    }
+
+    glm::vec3 bilinear(const Vec3Streams& p, int edge, GridSample row, GridSample column)
+    {
+        int i = row.index * edge + column.index;
+        glm::vec3 bottom = p.get(i) + (p.get(i + 1) - p.get(i)) * column.fraction;
+        glm::vec3 top = p.get(i + edge) + (p.get(i + edge + 1) - p.get(i + edge)) * column.fraction;
+        return bottom + (top - bottom) * row.fraction;
+    }
+
+    // rows [0, rows) in chunks of about TRANSFER_CHUNK vertices; no reductions, so any split gives the same result
+    template<typename F>
+    void forRows(ThreadPool* threadPool, int rows, int rowLength, F&& fn)
+    {
+        int rowsPerTask = std::max(1, TRANSFER_CHUNK / rowLength);
+        int tasks = (rows + rowsPerTask - 1) / rowsPerTask;
+        auto task = [&](int t) {
+            int end = std::min((t + 1) * rowsPerTask, rows);
+            for (int row = t * rowsPerTask; row < end; row++) fn(row);
+        };
+        if (threadPool) threadPool->parallelFor(tasks, task);
+        else for (int t = 0; t < tasks; t++) task(t);
+    }
+}
+
+GridHierarchy::GridHierarchy(int edgeCount, int maxEdgeWidth, int levelCount, float weight, Integrator integrator, int constraintsPerTask)
+    : fineEdgeCount(edgeCount), fineSpacing(maxEdgeWidth / (edgeCount - 1.0f)), weight(weight)
+{
+    int finer = edgeCount;
+    for (int l = 0; l < levelCount; l++)
+    {
+        int coarse = (finer + 1) / 2;
+        if (coarse < MULTIGRID_MIN_EDGE || coarse == finer) break;
+
+        Level level;
+        level.edgeCount = coarse;
+        level.spacing = maxEdgeWidth / (coarse - 1.0f);
+        level.positions.resize(coarse * coarse);
+        level.restricted.resize(coarse * coarse);
+        level.inverseMass.assign(coarse * coarse, weight);
+        level.fromFiner = makeSamples(coarse, finer);
+        level.toFiner = makeSamples(finer, coarse);
+        level.nearestFiner.resize(coarse);
+        for (int k = 0; k < coarse; k++) level.nearestFiner[k] = (int)std::lround((double)k * (finer - 1) / (coarse - 1));
+
+        // same cell layout as Tissue::createImplicitConstraints, at this level's spacing
+        glm::vec3 right(level.spacing, 0.0f, 0.0f), up(0.0f, level.spacing, 0.0f);
+        GridRestLengths restLengths;
+        restLengths.structural = glm::length(right);
+        restLengths.shear = glm::length(right + up);
+        restLengths.antiShear = glm::length(right - up);
+        level.solver = createGridSolver<FullStencil>(coarse, restLengths, integrator, constraintsPerTask);
+
+        levels.push_back(std::move(level));
+        finer = coarse;
+    }
+}
+
+GridHierarchy::~GridHierarchy() = default;
+
+void GridHierarchy::resetLambda()
+{
+    for (Level& level : levels) level.solver->resetLambda();
+}
+
+void GridHierarchy::correct(Vec3Streams& positions, const std::vector<float>& inverseMass, ThreadPool* threadPool, float stiffness, float alphaTilde)
+{
+    if (levels.empty()) return;
+    restrictTo(levels[0], positions, inverseMass, fineEdgeCount, threadPool);
+    solveLevel(0, threadPool, stiffness, alphaTilde);
+    prolongFrom(levels[0], positions, inverseMass, fineEdgeCount, threadPool);
+}
+
+// level is already restricted; leaves its solved positions for the caller to prolong
+void GridHierarchy::solveLevel(int l, ThreadPool* threadPool, float stiffness, float alphaTilde)
+{
+    Level& level = levels[l];
+    float levelAlpha = alphaTilde * level.spacing / fineSpacing;
+    if (l + 1 == (int)levels.size())
+    {
+        for (int s = 0; s < COARSEST_SWEEPS; s++) level.solver->solve(level.positions, level.inverseMass, threadPool, stiffness, levelAlpha);
+        return;
+    }
+
+    level.solver->solve(level.positions, level.inverseMass, threadPool, stiffness, levelAlpha);
+    restrictTo(levels[l + 1], level.positions, level.inverseMass, level.edgeCount, threadPool);
+    solveLevel(l + 1, threadPool, stiffness, alphaTilde);
+    prolongFrom(levels[l + 1], level.positions, level.inverseMass, level.edgeCount, threadPool);
+    level.solver->solve(level.positions, level.inverseMass, threadPool, stiffness, levelAlpha);
+}
+
+void GridHierarchy::restrictTo(Level& coarse, const Vec3Streams& finer, const std::vector<float>& finerMass, int finerEdge, ThreadPool* threadPool)
+{
+    int n = coarse.edgeCount;
+    forRows(threadPool, n, n, [&](int i) {
+        for (int j = 0; j < n; j++)
+        {
+            int c = i * n + j;
+            glm::vec3 p = bilinear(finer, finerEdge, coarse.fromFiner[i], coarse.fromFiner[j]);
+            coarse.positions.set(c, p);
+            coarse.restricted.set(c, p);
+            bool fixed = finerMass[coarse.nearestFiner[i] * finerEdge + coarse.nearestFiner[j]] == 0.0f;
+            coarse.inverseMass[c] = fixed ? 0.0f : weight;
+        }
+    });
+}
+
+void GridHierarchy::prolongFrom(const Level& coarse, Vec3Streams& finer, const std::vector<float>& finerMass, int finerEdge, ThreadPool* threadPool)
+{
+    int n = coarse.edgeCount;
+    forRows(threadPool, finerEdge, finerEdge, [&](int i) {
+        GridSample row = coarse.toFiner[i];
+        for (int j = 0; j < finerEdge; j++)
+        {
+            int f = i * finerEdge + j;
+            if (finerMass[f] == 0.0f) continue;
+            GridSample column = coarse.toFiner[j];
+            glm::vec3 moved = bilinear(coarse.positions, n, row, column) - bilinear(coarse.restricted, n, row, column);
+            finer.set(f, finer.get(f) + moved);
+        }
+    });
+}
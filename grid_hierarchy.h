@@ -0,0 +1,73 @@
+#ifndef GRID_HIERARCHY_H
+#define GRID_HIERARCHY_H
+
+#include "grid_solver.h"
+#include "tissue.h"
+
+#include <memory>
+#include <vector>
+
+class ThreadPool;
+
+// coarsest level allowed, in vertices per side
+const int MULTIGRID_MIN_EDGE = 8;
+
+// where a row/column coordinate of one level lands on another: lower index and fraction towards the next
+struct GridSample
+{
+    int index;
+    float fraction;
+};
+
+/*
+    GridHierarchy (coarse levels of a grid tissue for multigrid V-cycles)
+        level l+1 has (n_l + 1) / 2 vertices per side spread uniformly over the same sheet,
+        with its own positions and implicit constraints (StructuredGridSolver)
+        restriction   coarse vertex = bilinear sample of the finer level at its rest coordinates;
+                      it is fixed when the nearest finer vertex is
+        prolongation  each free finer vertex moves by the bilinear blend of how far the coarse
+                      vertices around it moved while the coarse level was solved
+        correct() runs the coarse part of one V-cycle: restrict, pre-smooth, recurse, prolong,
+        post-smooth on every level, with extra sweeps on the coarsest
+*/
+class GridHierarchy
+{
+    public:
+    // edgeCount / maxEdgeWidth of the fine grid (build order); stops early once a level would drop below MULTIGRID_MIN_EDGE
+    // ------------------------------------------------------------------------
+    GridHierarchy(int edgeCount, int maxEdgeWidth, int levels, float weight, Integrator integrator, int constraintsPerTask);
+    ~GridHierarchy();
+
+    int getLevelCount() const { return (int)levels.size(); }
+    int getLevelEdgeCount(int level) const { return levels[level].edgeCount; }
+    void resetLambda();
+
+    // moves the fine grid's positions by the correction of all coarse levels. alphaTilde is the
+    // fine level's; coarse edges are longer springs in series, so their compliance scales with spacing
+    void correct(Vec3Streams& positions, const std::vector<float>& inverseMass, ThreadPool* threadPool, float stiffness, float alphaTilde);
+
+    private:
+    struct Level
+    {
+        int edgeCount;
+        float spacing;
+        Vec3Streams positions;
+        Vec3Streams restricted;         // positions as restricted, before this level was solved
+        std::vector<float> inverseMass;
+        std::unique_ptr<GridSolver> solver;
+        std::vector<GridSample> fromFiner;  // coarse coordinate -> finer level
+        std::vector<GridSample> toFiner;    // finer coordinate -> this level
+        std::vector<int> nearestFiner;  // finer coordinate closest to each coarse coordinate
+    };
+
+    std::vector<Level> levels;
+    int fineEdgeCount;
+    float fineSpacing;
+    float weight;
+
+    void solveLevel(int level, ThreadPool* threadPool, float stiffness, float alphaTilde);
+    void restrictTo(Level& coarse, const Vec3Streams& finer, const std::vector<float>& finerMass, int finerEdge, ThreadPool* threadPool);
+    void prolongFrom(const Level& coarse, Vec3Streams& finer, const std::vector<float>& finerMass, int finerEdge, ThreadPool* threadPool);
+};
+
+#endif
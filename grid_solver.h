@@ -0,0 +1,315 @@
+#ifndef GRID_SOLVER_H
+#define GRID_SOLVER_H
+
+#include "simd.h"
+#include "thread_pool.h"
+#include "tissue.h"
+
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <vector>
+
+// constraint stencils of a structured grid, by the neighbours vertex (i, j) is tied to
+struct StructuralStencil    // (i, j+1) and (i+1, j)
+{
+    static const bool SHEAR = false;
+};
+struct FullStencil          // structural plus shear (i+1, j+1) and anti-shear (i+1, j-1); what the Tissue grid uses
+{
+    static const bool SHEAR = true;
+};
+
+// the only rest lengths a uniform grid has
+struct GridRestLengths
+{
+    float structural;
+    float shear;
+    float antiShear;
+};
+
+/*
+    GridSolver (stretch constraints of an edgeCount x edgeCount grid, generated in the sweep loops)
+        vertex (i, j) is i*edgeCount + j, the build order
+        implicit colors: each constraint kind split by the parity of j (horizontal) or of i (the others),
+        so no color holds two constraints on one vertex; 8 colors, 4 without shear
+        vertical, shear and anti-shear rows read both endpoints with plain vector loads; horizontal rows
+        load 2*WIDTH floats and deinterleave them into the two endpoints. Nothing is gathered.
+        the only per-constraint state is the XPBD multipliers, reset every substep
+*/
+class GridSolver
+{
+    public:
+    virtual ~GridSolver() = default;
+
+    virtual int getConstraintCount() const = 0;
+    virtual int getColorCount() const = 0;
+    // solver-owned bytes (multipliers and residual partials)
+    virtual size_t getMemoryBytes() const = 0;
+    virtual void resetLambda() = 0;
+    // one Gauss-Seidel sweep over positions; stiffness is used by PBD, alphaTilde (compliance / h^2) by XPBD
+    virtual ConstraintResidual solve(Vec3Streams& positions, const std::vector<float>& inverseMass, ThreadPool* threadPool,
+                                     float stiffness, float alphaTilde) = 0;
+};
+
+// EdgeCount 0 takes the edge count at run time; a fixed one lets the compiler see every row length
+template<typename Stencil, int EdgeCount = 0>
+class StructuredGridSolver : public GridSolver
+{
+    enum Kind { Horizontal, Vertical, Shear, AntiShear };
+
+    int edgeCount;
+    GridRestLengths restLengths;
+    Integrator integrator;
+    int constraintsPerTask;
+    std::vector<float> lambda;  // XPBD only, color by color, row by row
+    int lambdaOffset[8];
+    std::vector<ResidualPartial> residualPartials;
+
+    public:
+    // constraintsPerTask sets how many rows one pool task projects; the split is the same for any thread count
+    // ------------------------------------------------------------------------
+    StructuredGridSolver(int edgeCount, GridRestLengths restLengths, Integrator integrator, int constraintsPerTask)
+        : edgeCount(EdgeCount > 0 ? EdgeCount : edgeCount), restLengths(restLengths), integrator(integrator), constraintsPerTask(constraintsPerTask)
+    {
+        int offset = 0, maxTasks = 0;
+        for (int c = 0; c < getColorCount(); c++)
+        {
+            lambdaOffset[c] = offset;
+            offset += getRowCount(c / 2, c % 2) * getRowLength(c / 2, c % 2);
+            int rowsPerTask = getRowsPerTask(c / 2, c % 2);
+            maxTasks = std::max(maxTasks, (getRowCount(c / 2, c % 2) + rowsPerTask - 1) / rowsPerTask);
+        }
+        if (integrator == Integrator::XPBD) lambda.assign(offset, 0.0f);
+        residualPartials.resize(maxTasks);
+    }
+
+    int getConstraintCount() const override
+    {
+        int n = getEdge();
+        return 2 * n * (n - 1) + (Stencil::SHEAR ? 2 * (n - 1) * (n - 1) : 0);
+    }
+    int getColorCount() const override { return Stencil::SHEAR ? 8 : 4; }
+    size_t getMemoryBytes() const override { return lambda.size() * sizeof(float) + residualPartials.size() * sizeof(ResidualPartial); }
+    void resetLambda() override { std::fill(lambda.begin(), lambda.end(), 0.0f); }
+
+    ConstraintResidual solve(Vec3Streams& positions, const std::vector<float>& inverseMass, ThreadPool* threadPool,
+                             float stiffness, float alphaTilde) override
+    {
+        Sweep sweep = { positions.x.data(), positions.y.data(), positions.z.data(), inverseMass.data(), threadPool,
+                        integrator == Integrator::XPBD ? alphaTilde : stiffness, 0.0f, 0.0 };
+        if (integrator == Integrator::XPBD) solveColors<true>(sweep);
+        else solveColors<false>(sweep);
+
+        ConstraintResidual residual;
+        residual.max = sweep.residualMax;
+        residual.rms = (float)std::sqrt(sweep.residualSumSquares / getConstraintCount());
+        return residual;
+    }
+
+    private:
+    struct Sweep
+    {
+        float* x;
+        float* y;
+        float* z;
+        const float* w;
+        ThreadPool* threadPool;
+        float coefficient;          // PBD stiffness or XPBD alpha~
+        float residualMax;
+        double residualSumSquares;
+    };
+
+    int getEdge() const { return EdgeCount > 0 ? EdgeCount : edgeCount; }
+    // rows of a color: every grid row for horizontal constraints, every other row pair for the rest
+    int getRowCount(int kind, int parity) const { return kind == Horizontal ? getEdge() : (getEdge() - parity) / 2; }
+    int getRowLength(int kind, int parity) const
+    {
+        return kind == Horizontal ? (getEdge() - parity) / 2 : kind == Vertical ? getEdge() : getEdge() - 1;
+    }
+    int getRowsPerTask(int kind, int parity) const { return std::max(1, constraintsPerTask / std::max(1, getRowLength(kind, parity))); }
+
+    // Gauss-Seidel over the colors in a fixed order
+    template<bool Xpbd>
+    void solveColors(Sweep& sweep)
+    {
+        solveColor<Horizontal, 0, Xpbd>(sweep);
+        solveColor<Horizontal, 1, Xpbd>(sweep);
+        solveColor<Vertical, 0, Xpbd>(sweep);
+        solveColor<Vertical, 1, Xpbd>(sweep);
+        if constexpr (Stencil::SHEAR)
+        {
+            solveColor<Shear, 0, Xpbd>(sweep);
+            solveColor<Shear, 1, Xpbd>(sweep);
+            solveColor<AntiShear, 0, Xpbd>(sweep);
+            solveColor<AntiShear, 1, Xpbd>(sweep);
+        }
+    }
+
+    // Cuts the color into tasks of whole rows and sums the residual partials in task order, as Tissue does
+    template<int K, int Parity, bool Xpbd>
+    void solveColor(Sweep& sweep)
+    {
+        const int n = getEdge();
+        const int rows = getRowCount(K, Parity);
+        const int rowLength = getRowLength(K, Parity);
+        const int rowsPerTask = getRowsPerTask(K, Parity);
+        const int tasks = (rows + rowsPerTask - 1) / rowsPerTask;
+        const float restLength = K == Horizontal || K == Vertical ? restLengths.structural : K == Shear ? restLengths.shear : restLengths.antiShear;
+        float* colorLambda = Xpbd ? lambda.data() + lambdaOffset[K * 2 + Parity] : nullptr;
+
+        auto solve = [&](int task) {
+            simd::vfloat residualMax = simd::set1(0.0f), residualSumSquares = simd::set1(0.0f);
+            ResidualPartial tail = { 0.0f, 0.0 };
+            int end = std::min((task + 1) * rowsPerTask, rows);
+            for (int r = task * rowsPerTask; r < end; r++)
+            {
+                // first endpoint of the row's first constraint, and the second one (horizontal: first + 1)
+                int i = K == Horizontal ? r : Parity + 2 * r;
+                int first = K == Horizontal ? i * n + Parity : K == AntiShear ? i * n + 1 : i * n;
+                int second = K == Horizontal ? first + 1 : K == Shear ? (i + 1) * n + 1 : (i + 1) * n;
+                projectRow<K == Horizontal, Xpbd>(sweep, first, second, rowLength, restLength,
+                                                  Xpbd ? colorLambda + r * rowLength : nullptr, residualMax, residualSumSquares, tail);
+            }
+            residualPartials[task].max = std::max(simd::horizontalMax(residualMax), tail.max);
+            residualPartials[task].sumSquares = simd::horizontalSum(residualSumSquares) + tail.sumSquares;
+        };
+        if (sweep.threadPool) sweep.threadPool->parallelFor(tasks, solve);
+        else for (int task = 0; task < tasks; task++) solve(task);
+
+        for (int task = 0; task < tasks; task++)
+        {
+            sweep.residualMax = std::max(sweep.residualMax, residualPartials[task].max);
+            sweep.residualSumSquares += residualPartials[task].sumSquares;
+        }
+    }
+
+    // Projects count constraints of one row. Contiguous: constraint k joins first + k and second + k.
+    // Interleaved (horizontal): constraint k joins first + 2k and first + 2k + 1.
+    // Same arithmetic as Tissue::SolveStretchConstraints / SolveStretchConstraintsXPBD.
+    template<bool Interleaved, bool Xpbd>
+    static void projectRow(Sweep& sweep, int first, int second, int count, float restLength, float* lambda,
+                           simd::vfloat& residualMax, simd::vfloat& residualSumSquares, ResidualPartial& tail)
+    {
+        float* x = sweep.x;
+        float* y = sweep.y;
+        float* z = sweep.z;
+        const float* w = sweep.w;
+        simd::vfloat zero = simd::set1(0.0f);
+        simd::vfloat coefficient = simd::set1(sweep.coefficient);
+        simd::vfloat rest = simd::set1(restLength);
+        int k = 0;
+
+        for (; k + simd::WIDTH <= count; k += simd::WIDTH)
+        {
+            simd::vfloat x1, x2, y1, y2, z1, z2, w1, w2;
+            if constexpr (Interleaved)
+            {
+                int i = first + 2 * k;
+                simd::deinterleave(x + i, x1, x2);
+                simd::deinterleave(y + i, y1, y2);
+                simd::deinterleave(z + i, z1, z2);
+                simd::deinterleave(w + i, w1, w2);
+            }
+            else
+            {
+                x1 = simd::load(x + first + k); x2 = simd::load(x + second + k);
+                y1 = simd::load(y + first + k); y2 = simd::load(y + second + k);
+                z1 = simd::load(z + first + k); z2 = simd::load(z + second + k);
+                w1 = simd::load(w + first + k); w2 = simd::load(w + second + k);
+            }
+
+            simd::vfloat dx = simd::sub(x1, x2), dy = simd::sub(y1, y2), dz = simd::sub(z1, z2);
+            simd::vfloat currentLength = simd::sqrt(simd::add(simd::add(simd::mul(dx, dx), simd::mul(dy, dy)), simd::mul(dz, dz)));
+            simd::vfloat wSum = simd::add(w1, w2);
+            simd::vmask valid = simd::both(simd::greater(currentLength, zero), simd::greater(wSum, zero));
+            simd::vfloat C = simd::select(valid, simd::sub(currentLength, rest), zero);
+            residualMax = simd::max(residualMax, simd::abs(C));
+            residualSumSquares = simd::add(residualSumSquares, simd::mul(C, C));
+
+            // s1, s2: how far along d each endpoint moves, p1 -= s1 d, p2 += s2 d
+            simd::vfloat s1, s2;
+            if constexpr (Xpbd)
+            {
+                simd::vfloat l = simd::load(lambda + k);
+                simd::vfloat deltaLambda = simd::div(simd::sub(simd::sub(zero, C), simd::mul(coefficient, l)), simd::add(wSum, coefficient));
+                deltaLambda = simd::select(valid, deltaLambda, zero);
+                simd::store(lambda + k, simd::add(l, deltaLambda));
+                simd::vfloat scale = simd::select(valid, simd::div(deltaLambda, currentLength), zero);
+                s1 = simd::sub(zero, simd::mul(w1, scale));
+                s2 = simd::sub(zero, simd::mul(w2, scale));
+            }
+            else
+            {
+                simd::vfloat scale = simd::select(valid, simd::div(simd::mul(C, coefficient), simd::mul(currentLength, wSum)), zero);
+                s1 = simd::mul(w1, scale);
+                s2 = simd::mul(w2, scale);
+            }
+            x1 = simd::sub(x1, simd::mul(s1, dx)); x2 = simd::add(x2, simd::mul(s2, dx));
+            y1 = simd::sub(y1, simd::mul(s1, dy)); y2 = simd::add(y2, simd::mul(s2, dy));
+            z1 = simd::sub(z1, simd::mul(s1, dz)); z2 = simd::add(z2, simd::mul(s2, dz));
+
+            if constexpr (Interleaved)
+            {
+                int i = first + 2 * k;
+                simd::interleave(x + i, x1, x2);
+                simd::interleave(y + i, y1, y2);
+                simd::interleave(z + i, z1, z2);
+            }
+            else
+            {
+                simd::store(x + first + k, x1); simd::store(x + second + k, x2);
+                simd::store(y + first + k, y1); simd::store(y + second + k, y2);
+                simd::store(z + first + k, z1); simd::store(z + second + k, z2);
+            }
+        }
+        for (; k < count; k++)
+        {
+            int i1 = Interleaved ? first + 2 * k : first + k;
+            int i2 = Interleaved ? i1 + 1 : second + k;
+
+            glm::vec3 p1(x[i1], y[i1], z[i1]);
+            glm::vec3 p2(x[i2], y[i2], z[i2]);
+            float currentLength = glm::length(p1 - p2);
+            float wSum = w[i1] + w[i2];
+            if (currentLength == 0.0f || wSum == 0.0f) continue;
+
+            glm::vec3 n = (p1 - p2) / currentLength;
+            float C = currentLength - restLength;
+            tail.max = std::max(tail.max, std::fabs(C));
+            tail.sumSquares += C * C;
+            if constexpr (Xpbd)
+            {
+                float deltaLambda = (-C - sweep.coefficient * lambda[k]) / (wSum + sweep.coefficient);
+                lambda[k] += deltaLambda;
+                p1 += w[i1] * deltaLambda * n;
+                p2 -= w[i2] * deltaLambda * n;
+            }
+            else
+            {
+                p1 -= (w[i1] / wSum) * C * n * sweep.coefficient;
+                p2 += (w[i2] / wSum) * C * n * sweep.coefficient;
+            }
+            x[i1] = p1.x; y[i1] = p1.y; z[i1] = p1.z;
+            x[i2] = p2.x; y[i2] = p2.y; z[i2] = p2.z;
+        }
+    }
+};
+
+// Fixed-size solvers for the grid sizes the viewer (40), Headless and Benchmark run, run-time size otherwise
+template<typename Stencil>
+std::unique_ptr<GridSolver> createGridSolver(int edgeCount, GridRestLengths restLengths, Integrator integrator, int constraintsPerTask)
+{
+    switch (edgeCount)
+    {
+        case 40: return std::make_unique<StructuredGridSolver<Stencil, 40>>(edgeCount, restLengths, integrator, constraintsPerTask);
+        case 64: return std::make_unique<StructuredGridSolver<Stencil, 64>>(edgeCount, restLengths, integrator, constraintsPerTask);
+        case 128: return std::make_unique<StructuredGridSolver<Stencil, 128>>(edgeCount, restLengths, integrator, constraintsPerTask);
+        case 256: return std::make_unique<StructuredGridSolver<Stencil, 256>>(edgeCount, restLengths, integrator, constraintsPerTask);
+        case 512: return std::make_unique<StructuredGridSolver<Stencil, 512>>(edgeCount, restLengths, integrator, constraintsPerTask);
+        case 1024: return std::make_unique<StructuredGridSolver<Stencil, 1024>>(edgeCount, restLengths, integrator, constraintsPerTask);
+        default: return std::make_unique<StructuredGridSolver<Stencil>>(edgeCount, restLengths, integrator, constraintsPerTask);
+    }
+}
+
+#endif
@@ -0,0 +1,271 @@
+#include "tissue.h"
+#include "checkpoint.h"
+#include "domain_solver.h"
+#include "profiler.h"
+#include "sdf_obstacle.h"
+#include "tissue_model.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Headless batch run: steps the tissue as fast as the solver allows, no window,
+// no vsync and no buffer swaps.
+// Usage: Headless [--tolerance t] [--budget ms] [--restore file] [--checkpoint file] [--checkpoint-every n]
+//                 [--model file] [--pin band] [--no-cache] [--order build|morton|rcm] [--grid explicit|implicit]
+//                 [--multigrid levels] [--iterations n] [--sleep velocity residual] [--self-collision thickness]
+//                 [--obstacle radius|file] [--processes tiles] [edgeCount] [frames] [threads] [pbd|xpbd] [profile prefix]
+// With a profile prefix the last frames are written to <prefix>.json (Chrome trace) and <prefix>.csv.
+// --tolerance and --budget set Tissue::residualTolerance and solverBudgetMs.
+// --restore continues from a checkpoint instead of building the grid (edgeCount and pbd|xpbd are then ignored).
+// --checkpoint writes one in the background every --checkpoint-every frames (default: once, after the last frame).
+// --model imports an .obj, .ply or TetGen .node/.ele instead of building the grid (edgeCount is then ignored);
+// vertices within --pin (fraction of the height, default 0.02) of the top are fixed. --no-cache skips the .tcache.
+// --order renumbers the vertices at build time (VertexOrder); results are reported for the same vertex either way.
+// --grid implicit generates the grid's constraints in the solver loops instead of storing them (GridConstraints).
+// --multigrid makes every solver iteration a V-cycle over that many coarser levels; --iterations overrides the
+// PBD sweep (or V-cycle) count per frame, default 20.
+// --sleep sets Tissue::sleepVelocity and sleepResidual; the awake vertex count is printed at the end.
+// --self-collision sets Tissue::selfCollisionThickness (world units, the grid is 1 wide); the last
+// substep's collision pair count is printed.
+// --obstacle adds a sphere of that radius, centred half a radius in front of the middle of the sheet, or the closed
+// mesh in file where it is (baked at OBSTACLE_RESOLUTION, cached as <file>.sdf unless --no-cache). The vertices are
+// kept OBSTACLE_MARGIN outside it; the closest one's distance is printed at the end.
+// --processes splits the grid into tiles x tiles worker processes (DomainSolver over shared memory); this process
+// only gathers their positions. Sweeps per frame are fixed, and the profile and checkpoints see gathered state only.
+
+// settings
+const unsigned int EDGE_COUNT = 40;
+const unsigned int MAX_EDGE_WIDTH = 1;
+const unsigned int ITERATIONS = 20; // PBD sweeps per frame
+const unsigned int FRAMES = 1000;
+const unsigned int SOLVER_THREADS = 1;
+const float DELTA_TIME = 1.0f / 60.0f;
+const unsigned int PROFILE_FRAMES = 600;
+const float MODEL_PIN_BAND = 0.02f;
+const int OBSTACLE_RESOLUTION = 64;     // SDF samples along the obstacle's longest side
+const float OBSTACLE_MARGIN = 0.005f;   // Tissue::obstacleMargin, the grid is 1 wide
+
+int main(int argc, char** argv)
+{
+    // pull the adaptive solver options out, the rest stays positional
+    float residualTolerance = 0.0f, solverBudgetMs = 0.0f;
+    std::string restorePath, checkpointPath, modelPath;
+    int checkpointEvery = 0;
+    float pinBand = MODEL_PIN_BAND;
+    bool modelCache = true;
+    VertexOrder order = VertexOrder::Build;
+    GridConstraints constraints = GridConstraints::Explicit;
+    int multigridLevels = 0;
+    int iterations = ITERATIONS;
+    float sleepVelocity = 0.0f, sleepResidual = 0.0f;
+    float selfCollisionThickness = 0.0f;
+    std::string obstacleShape;
+    int processTiles = 0;
+    std::vector<char*> positional = { argv[0] };
+    for (int i = 1; i < argc; i++)
+    {
+        if (std::strcmp(argv[i], "--tolerance") == 0 && i + 1 < argc) residualTolerance = (float)std::atof(argv[++i]);
+        else if (std::strcmp(argv[i], "--budget") == 0 && i + 1 < argc) solverBudgetMs = (float)std::atof(argv[++i]);
+        else if (std::strcmp(argv[i], "--restore") == 0 && i + 1 < argc) restorePath = argv[++i];
+        else if (std::strcmp(argv[i], "--checkpoint") == 0 && i + 1 < argc) checkpointPath = argv[++i];
+        else if (std::strcmp(argv[i], "--checkpoint-every") == 0 && i + 1 < argc) checkpointEvery = std::atoi(argv[++i]);
+        else if (std::strcmp(argv[i], "--model") == 0 && i + 1 < argc) modelPath = argv[++i];
+        else if (std::strcmp(argv[i], "--pin") == 0 && i + 1 < argc) pinBand = (float)std::atof(argv[++i]);
+        else if (std::strcmp(argv[i], "--no-cache") == 0) modelCache = false;
+        else if (std::strcmp(argv[i], "--order") == 0 && i + 1 < argc && std::strcmp(argv[i + 1], "morton") == 0) { order = VertexOrder::Morton; i++; }
+        else if (std::strcmp(argv[i], "--order") == 0 && i + 1 < argc && std::strcmp(argv[i + 1], "rcm") == 0) { order = VertexOrder::RCM; i++; }
+        else if (std::strcmp(argv[i], "--order") == 0 && i + 1 < argc && std::strcmp(argv[i + 1], "build") == 0) { order = VertexOrder::Build; i++; }
+        else if (std::strcmp(argv[i], "--grid") == 0 && i + 1 < argc && std::strcmp(argv[i + 1], "implicit") == 0) { constraints = GridConstraints::Implicit; i++; }
+        else if (std::strcmp(argv[i], "--grid") == 0 && i + 1 < argc && std::strcmp(argv[i + 1], "explicit") == 0) { constraints = GridConstraints::Explicit; i++; }
+        else if (std::strcmp(argv[i], "--multigrid") == 0 && i + 1 < argc) multigridLevels = std::atoi(argv[++i]);
+        else if (std::strcmp(argv[i], "--iterations") == 0 && i + 1 < argc) iterations = std::max(1, std::atoi(argv[++i]));
+        else if (std::strcmp(argv[i], "--sleep") == 0 && i + 2 < argc)
+        {
+            sleepVelocity = (float)std::atof(argv[++i]);
+            sleepResidual = (float)std::atof(argv[++i]);
+        }
+        else if (std::strcmp(argv[i], "--obstacle") == 0 && i + 1 < argc) obstacleShape = argv[++i];
+        else if (std::strcmp(argv[i], "--self-collision") == 0 && i + 1 < argc) selfCollisionThickness = (float)std::atof(argv[++i]);
+        else if (std::strcmp(argv[i], "--processes") == 0 && i + 1 < argc) processTiles = std::atoi(argv[++i]);
+        else positional.push_back(argv[i]);
+    }
+    argc = (int)positional.size();
+    argv = positional.data();
+
+    int edgeCount = argc > 1 ? std::atoi(argv[1]) : EDGE_COUNT;
+    int frames = argc > 2 ? std::atoi(argv[2]) : FRAMES;
+    int threads = argc > 3 ? std::atoi(argv[3]) : SOLVER_THREADS;
+    bool xpbd = argc > 4 && std::strcmp(argv[4], "xpbd") == 0;
+    if ((edgeCount < 2 && modelPath.empty() && restorePath.empty()) || frames < 1 || threads < 1 || (argc > 4 && !xpbd && std::strcmp(argv[4], "pbd") != 0))
+    {
+        std::cout << "Usage: " << argv[0] << " [--tolerance t] [--budget ms] [--restore file] [--checkpoint file] [--checkpoint-every n] [--model file] [--pin band] [--no-cache] [--order build|morton|rcm] [--grid explicit|implicit] [--multigrid levels] [--iterations n] [--sleep velocity residual] [--self-collision thickness] [--obstacle radius|file] [--processes tiles] [edgeCount >= 2] [frames >= 1] [threads >= 1] [pbd|xpbd] [profile prefix]" << std::endl;
+        return -1;
+    }
+
+    auto buildStart = std::chrono::steady_clock::now();
+    std::unique_ptr<Tissue> owned;
+    if (!restorePath.empty())
+    {
+        Checkpoint checkpoint;
+        if (!checkpoint.open(restorePath))
+        {
+            std::cout << "Cannot restore " << restorePath << ": " << checkpoint.getError() << std::endl;
+            return -1;
+        }
+        owned.reset(new Tissue(checkpoint));
+    }
+    else if (!modelPath.empty())
+    {
+        TissueModel model;
+        if (!model.load(modelPath, modelCache))
+        {
+            std::cout << "Cannot import " << modelPath << ": " << model.getError() << std::endl;
+            return -1;
+        }
+        std::cout << "Model " << modelPath << (model.isFromCache() ? " (cached): " : ": ") << model.getVertexCount() << " vertices, "
+                  << model.getTriangleCount() << " surface triangles, " << model.getEdgeCount() << " edges in "
+                  << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - buildStart).count() << " ms" << std::endl;
+        model.fixTopVertices(pinBand);
+        owned.reset(new Tissue(model, 0.001f, xpbd ? Integrator::XPBD : Integrator::PBD, order));
+    }
+    else owned.reset(new Tissue(edgeCount, MAX_EDGE_WIDTH, 0.001f, xpbd ? Integrator::XPBD : Integrator::PBD, order, constraints));
+    auto buildEnd = std::chrono::steady_clock::now();
+    Tissue& tissue = *owned;
+    xpbd = tissue.getIntegrator() == Integrator::XPBD;
+    tissue.setThreadCount(threads);
+    if (restorePath.empty())
+    {
+        // a restored run keeps the settings it was saved with
+        if (!xpbd) tissue.iterations = iterations;
+        tissue.setMultigridLevels(multigridLevels);
+        tissue.residualTolerance = residualTolerance;
+        tissue.solverBudgetMs = solverBudgetMs;
+        tissue.sleepVelocity = sleepVelocity;
+        tissue.sleepResidual = sleepResidual;
+        tissue.selfCollisionThickness = selfCollisionThickness;
+        tissue.obstacleMargin = OBSTACLE_MARGIN;
+    }
+
+    SdfObstacle obstacle;
+    if (!obstacleShape.empty())
+    {
+        auto bakeStart = std::chrono::steady_clock::now();
+        char* end;
+        float radius = std::strtof(obstacleShape.c_str(), &end);
+        if (*end == '\0' && radius > 0.0f)
+        {
+            obstacle.bakeSphere(radius, OBSTACLE_RESOLUTION);
+            glm::vec3 middle(0.0f);
+            for (int i = 0; i < tissue.getVertexCount(); i++) middle += tissue.positions.get(i);
+            middle /= (float)tissue.getVertexCount();
+            obstacle.setPose(glm::mat3(1.0f), middle + glm::vec3(0.0f, 0.0f, 0.5f * radius));
+        }
+        else if (!obstacle.bakeModel(obstacleShape, OBSTACLE_RESOLUTION, modelCache, threads))
+        {
+            std::cout << "Cannot bake " << obstacleShape << ": " << obstacle.getError() << std::endl;
+            return -1;
+        }
+        tissue.addObstacle(&obstacle);
+        glm::ivec3 size = obstacle.getSize();
+        std::cout << "Obstacle " << obstacleShape << (obstacle.isFromCache() ? " (cached): " : ": ") << size.x << "x" << size.y << "x" << size.z
+                  << " samples (" << obstacle.getMemoryBytes() / 1024 << " KB) in "
+                  << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - bakeStart).count() << " ms" << std::endl;
+    }
+    std::unique_ptr<DomainSolver> domainSolver;
+    if (processTiles > 0)
+    {
+        auto forkStart = std::chrono::steady_clock::now();
+        domainSolver = DomainSolver::createLocal(tissue, processTiles, processTiles);
+        if (!domainSolver) return -1;
+        std::cout << "Domain: " << domainSolver->getWorkerCount() << " worker processes, " << domainSolver->getPartition().getHaloVertexCount()
+                  << " halo vertices exchanged per sweep, started in "
+                  << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - forkStart).count() << " ms" << std::endl;
+    }
+    CheckpointWriter checkpointWriter;
+
+    std::string profilePrefix = argc > 5 ? argv[5] : "";
+    Profiler profiler(PROFILE_FRAMES);
+    if (!profilePrefix.empty()) tissue.setProfiler(&profiler);
+
+    std::cout << (restorePath.empty() ? "Tissue created: " : "Tissue restored: ") << tissue.getVertexCount() << " vertices, "
+              << tissue.getConstraintCount() << (tissue.getGridConstraints() == GridConstraints::Implicit ? " implicit" : "") << " constraints ("
+              << tissue.getColorCount() << " colors, " << tissue.getConstraintMemoryBytes() / 1024 << " KB) in "
+              << std::chrono::duration<double, std::milli>(buildEnd - buildStart).count() << " ms, " << tissue.getThreadCount() << " solver threads, "
+              << Tissue::getSimdName() << " kernels, "
+              << (xpbd ? "XPBD" : "PBD") << " " << tissue.substeps << "x" << tissue.iterations
+              << (tissue.getMultigridLevels() > 0 ? " V-cycles over " + std::to_string(tissue.getMultigridLevels()) + " coarse levels" : " sweeps") << std::endl;
+
+    // simulation loop
+    // ---------------
+    long long sweeps = 0;
+    double solverMs = 0.0;
+    int budgetLimitedFrames = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int frame = 0; frame < frames; frame++)
+    {
+        profiler.beginFrame();
+        if (!domainSolver) tissue.step(DELTA_TIME, glm::vec3(0.0f, -0.5f, 0.0f));
+        else if (!domainSolver->step(DELTA_TIME, glm::vec3(0.0f, -0.5f, 0.0f))) return -1;
+        profiler.endFrame();
+
+        if (!checkpointPath.empty() && checkpointEvery > 0 && (frame + 1) % checkpointEvery == 0) checkpointWriter.write(tissue, checkpointPath);
+
+        SolveStats stats = tissue.getLastSolveStats();
+        if (domainSolver) stats = {tissue.iterations * tissue.substeps, stats.residual, domainSolver->getLastStepMs(), false};
+        sweeps += stats.iterations;
+        solverMs += stats.solverMs;
+        if (stats.budgetLimited) budgetLimitedFrames++;
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    if (!checkpointPath.empty())
+    {
+        // make sure the final state is the one left on disk
+        checkpointWriter.wait();
+        if (checkpointEvery <= 0 || frames % checkpointEvery != 0) checkpointWriter.write(tissue, checkpointPath);
+        checkpointWriter.wait();
+        std::cout << "checkpoints: " << checkpointWriter.getWrittenCount() << " written, " << checkpointWriter.getSkippedCount()
+                  << " skipped while busy, " << checkpointWriter.getFailedCount() << " failed, last at " << checkpointPath << std::endl;
+    }
+
+    double seconds = std::chrono::duration<double>(end - start).count();
+    std::cout << frames << " steps in " << seconds << " s: "
+              << frames / seconds << " steps/sec, "
+              << seconds * 1e9 / ((double)frames * tissue.getVertexCount()) << " ns/vertex/step" << std::endl;
+
+    // print a sample vertex so the optimizer cannot drop the loop and runs can be compared
+    glm::vec3 corner = tissue.positions.get(tissue.getVertexIndex(0));
+    std::cout << "positions[0] = (" << corner.x << ", " << corner.y << ", " << corner.z << ")" << std::endl;
+    SolveStats last = tissue.getLastSolveStats();
+    if (domainSolver) last = {tissue.iterations * tissue.substeps, last.residual, domainSolver->getLastStepMs(), false};
+    std::cout << "last frame: " << last.iterations << " sweeps, residual max " << last.residual.max << ", rms " << last.residual.rms
+              << ", " << last.solverMs << " ms solving" << std::endl;
+    std::cout << "average: " << (double)sweeps / frames << " sweeps/frame, " << solverMs / frames << " ms solving/frame, "
+              << budgetLimitedFrames << " frames cut by the budget" << std::endl;
+    if (tissue.selfCollisionThickness > 0.0f) std::cout << "self-collision: " << tissue.getCollisionPairCount() << " pairs in the last substep" << std::endl;
+    if (obstacle.isBaked())
+    {
+        float closest = std::numeric_limits<float>::max(), distance;
+        glm::vec3 normal;
+        for (int i = 0; i < tissue.getVertexCount(); i++)
+        {
+            if (obstacle.getDistance(tissue.positions.get(i), distance, normal)) closest = std::min(closest, distance);
+        }
+        std::cout << "obstacle: closest vertex " << closest << " from its surface (margin " << tissue.obstacleMargin << ")" << std::endl;
+    }
+    if (tissue.sleepVelocity > 0.0f) std::cout << "awake: " << tissue.getAwakeVertexCount() << " of " << tissue.getVertexCount() << " vertices" << std::endl;
+
+    if (!profilePrefix.empty())
+    {
+        profiler.writeChromeTrace(profilePrefix + ".json");
+        profiler.writeCsv(profilePrefix + ".csv");
+        std::cout << "profile: " << profiler.getFrameCount() << " frames written to " << profilePrefix << ".json/.csv" << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,22 @@
+# ctest script (see CMakeLists.txt): Headless run for 80 frames must end where 40 frames, a checkpoint and 40
+# restored frames end. Run with -DHEADLESS=<path to Headless>
+function(run_headless output)
+    execute_process(COMMAND ${HEADLESS} ${ARGN} RESULT_VARIABLE result OUTPUT_VARIABLE text)
+    if(NOT result EQUAL 0)
+        message(FATAL_ERROR "Headless ${ARGN} failed (${result}):\n${text}")
+    endif()
+    string(REGEX MATCH "positions\\[0\\] = \\([^)]*\\)" corner "${text}")
+    if(corner STREQUAL "")
+        message(FATAL_ERROR "Headless ${ARGN} printed no positions[0]:\n${text}")
+    endif()
+    set(${output} "${corner}" PARENT_SCOPE)
+endfunction()
+
+run_headless(straight 40 80 1 xpbd)
+run_headless(first --checkpoint headless_restore_test.bin 40 40 1 xpbd)
+run_headless(restored --restore headless_restore_test.bin 40 40 1 xpbd)
+file(REMOVE headless_restore_test.bin)
+if(NOT straight STREQUAL restored)
+    message(FATAL_ERROR "restored run ends at ${restored}, straight run at ${straight}")
+endif()
+message(STATUS "both end at ${straight}")
@@ -3,13 +3,16 @@
 
 #include "shader.h"
 #include "mesh.h"
+#include "profiler.h"
+#include "simulation_thread.h"
+#include "vertex_picker.h"
+#include <memory>
 #include <vector>
 #include <iostream>
+#include <sstream>
 
 void framebuffer_size_callback(GLFWwindow* window, int width, int height);
-void processInput(GLFWwindow *window);
-
-float lastTime = 0.0f;
+void processInput(GLFWwindow *window, const Profiler& renderProfiler, SimulationThread* simulation);
 
 // settings
 const unsigned int SCR_WIDTH = 800;
@@ -17,9 +20,47 @@ const unsigned int SCR_HEIGHT = 600;
 
 const unsigned int EDGE_COUNT = 40;
 const unsigned int MAX_EDGE_WIDTH = 1;
-const unsigned int ITERATIONS = 20;
+const unsigned int ITERATIONS = 20; // max PBD sweeps per frame
+const float RESIDUAL_TOLERANCE = 0.0125f; // stop sweeping once no constraint is off its rest length by more, 0 = always ITERATIONS
+const int MULTIGRID_LEVELS = 0; // > 0: each iteration is a V-cycle over coarser grids; pays off from edgeCount ~128 with fewer ITERATIONS
+const float SOLVER_BUDGET_MS = 8.0f; // cap on sweep time per frame so large meshes keep the frame rate, 0 = no cap
+const unsigned int TITLE_INTERVAL = 30; // frames between solver stats in the window title
+const Integrator INTEGRATOR = Integrator::PBD;
+const VertexOrder VERTEX_ORDER = VertexOrder::Build; // Morton / RCM renumber vertices for cache locality on large meshes
+const GridConstraints GRID_CONSTRAINTS = GridConstraints::Implicit; // generated in the solver loops, needs VertexOrder::Build
+const unsigned int SOLVER_THREADS = 1; // > 1 solves constraint color batches in parallel
+// > 0: tiles of vertices slower than this for SLEEP_STEPS steps stop simulating until a neighbor or the grab wakes them
+// (explicit constraints only, so GridConstraints::Explicit, and INTERPOLATE = false to skip their upload too).
+// SLEEP_RESIDUAL must exceed the sheet's resting stretch.
+const float SLEEP_VELOCITY = 0.0f;
+const float SLEEP_RESIDUAL = 0.0f;
+// > 0: vertices not joined by a triangle or constraint stay this far apart, in edge lengths (the grid is 1 wide);
+// vertices only, so keep it near one edge or the sheet slips through between them. CPU backend only
+const float SELF_COLLISION_EDGES = 0.0f;
+// GPU: compute shaders on the render thread, positions never leave the GPU. Needs a GL 4.3 context (not macOS),
+// GridConstraints::Explicit and no multigrid; otherwise it stays on the CPU simulation thread
+// Processes: DOMAIN_TILES x DOMAIN_TILES worker processes, the render thread gathers and uploads their positions.
+// Build order, no multigrid, sleeping or self-collision
+const SolverBackend SOLVER_BACKEND = SolverBackend::CPU;
+const int DOMAIN_TILES = 2;
+// Compact: RGBA8 colors, 16-bit strip indices; CompactHalf / CompactSnorm16 also stream 8-byte positions instead of 12
+const VertexFormat VERTEX_FORMAT = VertexFormat::Float;
+// a click picks the vertex under the cursor, within PICK_RADIUS_PIXELS of it; the grab holds the free vertices within
+// GRAB_RADIUS_EDGES edge lengths of that one, the hold fading out towards the rim (0: the picked vertex alone)
+const float PICK_RADIUS_PIXELS = 12.0f;
+const float GRAB_RADIUS_EDGES = 3.0f;
+const float SIM_TIMESTEP = 1.0f / 60.0f; // fixed step of the simulation thread
+// blend the last two sim states when drawing, one step behind; uploads every vertex each frame. false uploads only the
+// tiles that moved, so sleeping tiles cost no upload
+const bool INTERPOLATE = true;
+
+// press P to write the last PROFILE_FRAMES sim steps to tissue_trace.json (chrome://tracing) and tissue_profile.csv,
+// and the render frames to tissue_render_trace.json and tissue_render_profile.csv
+const unsigned int PROFILE_FRAMES = 600;
+bool profileKeyDown = false;
 
 bool mousePressed = false;
+bool dragging = false;
 glm::vec2 lastMousePos(0.0f, 0.0f);
 
 void mouseButtonCallback(GLFWwindow* window, int button, int action, int mods);
@@ -29,7 +70,8 @@ int main()
     // glfw: initialize and configure
     // ------------------------------
     glfwInit();
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    bool compute = SOLVER_BACKEND == SolverBackend::GPU;
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, compute ? 4 : 3);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
 
@@ -61,26 +103,49 @@ int main()
     
     std::cout << "GLAD initialized successfully" << std::endl;
     
-    Mesh mesh(EDGE_COUNT, MAX_EDGE_WIDTH, "../shaders/VertexShader.vert", "../shaders/FragmentShader.frag");
+    Mesh mesh(EDGE_COUNT, MAX_EDGE_WIDTH, "../shaders/VertexShader.vert", "../shaders/FragmentShader.frag", 0.001f, INTEGRATOR,
+              PositionUpload::Auto, VERTEX_ORDER, GRID_CONSTRAINTS, VERTEX_FORMAT);
+    if (INTEGRATOR == Integrator::PBD) mesh.iterations = ITERATIONS;
+    mesh.residualTolerance = RESIDUAL_TOLERANCE;
+    mesh.solverBudgetMs = SOLVER_BUDGET_MS;
+    mesh.setThreadCount(SOLVER_THREADS);
+    mesh.setMultigridLevels(MULTIGRID_LEVELS);
+    mesh.sleepVelocity = SLEEP_VELOCITY;
+    mesh.sleepResidual = SLEEP_RESIDUAL;
+    mesh.selfCollisionThickness = SELF_COLLISION_EDGES / (EDGE_COUNT - 1);
+    mesh.domainTiles = DOMAIN_TILES;
     std::cout << "Mesh created successfully" << std::endl;
+
+    // CPU: the simulation thread owns the mesh's Tissue state from here on; the render loop only
+    // reads position snapshots and sends drag commands. GPU and Processes: the render loop steps the mesh itself.
+    Profiler renderProfiler(PROFILE_FRAMES);
+    Profiler simProfiler(PROFILE_FRAMES);
+    std::unique_ptr<SimulationThread> simulation;
+    std::unique_ptr<VertexPicker> picker; // the simulation thread picks for itself
+    GrabRegion grabRegion;
+    std::vector<std::pair<int, int>> changedRanges; // what readChangedPositions copied
+    if (SOLVER_BACKEND == SolverBackend::CPU || !mesh.setSolverBackend(SOLVER_BACKEND, "../shaders/"))
+        simulation.reset(new SimulationThread(mesh, SIM_TIMESTEP, glm::vec3(0.0f, -0.5f, 0.0f), &simProfiler));
+    else picker.reset(new VertexPicker(mesh));
+    // positions are clip coordinates: the cursor looks down +z from the near plane
+    const float pickRadius = PICK_RADIUS_PIXELS * 2.0f / SCR_WIDTH;
+    const float grabRadius = GRAB_RADIUS_EDGES * MAX_EDGE_WIDTH / (EDGE_COUNT - 1);
     
     // render loop
     // -----------
+    unsigned int frame = 0;
     while (!glfwWindowShouldClose(window))
     {
         // input
         // -----
-        processInput(window);
+        processInput(window, renderProfiler, simulation.get());
+        renderProfiler.beginFrame();
 
         // render
         // ------
         glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT);
 
-        float currentTime = glfwGetTime();
-        float deltaTime = currentTime - lastTime;
-        lastTime = currentTime;
-
         if(mousePressed)
         {
             double xpos, ypos;
@@ -91,25 +156,66 @@ int main()
             glm::vec2 deltaMouse = mousePos - lastMousePos;
             lastMousePos = mousePos;
 
-            mesh.positions[EDGE_COUNT- 1] += glm::vec3(deltaMouse, 0.0f);
-            mesh.velocities[EDGE_COUNT - 1] = glm::vec3(deltaMouse / deltaTime, 0.0f);
-            mesh.isVerticesFixed[EDGE_COUNT - 1] = 1;
+            if(!dragging)
+            {
+                PickRay ray = { glm::vec3(mousePos, -1.0f), glm::vec3(0.0f, 0.0f, 1.0f), pickRadius };
+                if (simulation) dragging = simulation->send({ SimCommandType::Grab, -1, glm::vec3(0.0f), nullptr, nullptr, ray, grabRadius });
+                else
+                {
+                    mesh.syncFromGpu(); // the picker reads the CPU copy
+                    picker->refit();
+                    picker->getGrabRegion(picker->pick(ray), grabRadius, grabRegion);
+                    mesh.grab(grabRegion.vertices, grabRegion.weights);
+                    dragging = true;
+                }
+            }
+            else if(deltaMouse != glm::vec2(0.0f, 0.0f))
+            {
+                if (simulation) simulation->send({ SimCommandType::MoveGrab, -1, glm::vec3(deltaMouse, 0.0f), nullptr, nullptr });
+                else mesh.moveGrab(glm::vec3(deltaMouse, 0.0f));
+            }
         }
         else
         {
             lastMousePos = glm::vec2(0.0f, 0.0f);
-            mesh.isVerticesFixed[EDGE_COUNT - 1] = 0;
+            if(dragging && simulation) dragging = !simulation->send({ SimCommandType::ReleaseGrab, -1, glm::vec3(0.0f), nullptr, nullptr });
+            else if(dragging)
+            {
+                mesh.releaseGrab();
+                dragging = false;
+            }
         }
         
-        mesh.addGravity(deltaTime, glm::vec3(0.0f, -0.5f, 0.0f));
-        mesh.applyDamping(0.01f);
-        mesh.updateEstimatedPositions(deltaTime);
-        for(int i=0; i<ITERATIONS; i++) mesh.SolveAllStretchConstraints();
-        mesh.updateVelocitiesAndPositions(deltaTime);
-        mesh.updatePositions();
+        if (++frame % TITLE_INTERVAL == 0)
+        {
+            SolveStats stats = simulation ? simulation->getLastSolveStats() : mesh.getLastSolveStats();
+            std::ostringstream title;
+            title << "LearnOpenGL - " << stats.iterations << " sweeps, residual " << stats.residual.max << ", "
+                  << stats.solverMs << " ms" << (stats.budgetLimited ? " (budget)" : "");
+            glfwSetWindowTitle(window, title.str().c_str());
+        }
+        {
+            ProfileScope scope(&renderProfiler, Stage::UpdatePositions);
+            if (simulation && INTERPOLATE) mesh.endPositionWrite(simulation->readPositions(mesh.beginPositionWrite(), true));
+            else if (simulation)
+            {
+                uint64_t version = mesh.getPositionWriteVersion();
+                if (simulation->readChangedPositions(mesh.beginPositionWrite(), version, changedRanges)) mesh.endPositionWrite(version, changedRanges);
+                simulation->setHeldVersion(mesh.getPositionWriteVersion());
+            }
+            else
+            {
+                mesh.step(SIM_TIMESTEP, glm::vec3(0.0f, -0.5f, 0.0f)); // one step per frame, vsync paced
+                mesh.updatePositions(); // gathered from the workers; nothing to do on the GPU
+            }
+        }
 
         // render the triangle
-        mesh.draw();
+        {
+            ProfileScope scope(&renderProfiler, Stage::Draw);
+            mesh.draw();
+        }
+        renderProfiler.endFrame();
         // glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
         // -------------------------------------------------------------------------------
         glfwSwapBuffers(window);
@@ -118,6 +224,7 @@ int main()
 
     // optional: de-allocate all resources once they've outlived their purpose:
     // ------------------------------------------------------------------------
+    simulation.reset();
     mesh.deleteArraysAndBuffers();
     // glfw: terminate, clearing all previously allocated GLFW resources.
     // ------------------------------------------------------------------
@@ -127,10 +234,22 @@ int main()
 
 // process all input: query GLFW whether relevant keys are pressed/released this frame and react accordingly
 // ---------------------------------------------------------------------------------------------------------
-void processInput(GLFWwindow *window)
+void processInput(GLFWwindow *window, const Profiler& renderProfiler, SimulationThread* simulation)
 {
     if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
         glfwSetWindowShouldClose(window, true);
+
+    bool profileKey = glfwGetKey(window, GLFW_KEY_P) == GLFW_PRESS;
+    if (profileKey && !profileKeyDown)
+    {
+        renderProfiler.writeChromeTrace("tissue_render_trace.json");
+        renderProfiler.writeCsv("tissue_render_profile.csv");
+        // the sim profiler belongs to the sim thread, so it writes its own files (none on the GPU backend)
+        if (simulation) simulation->send({ SimCommandType::WriteProfile, 0, glm::vec3(0.0f), "tissue_trace.json", "tissue_profile.csv" });
+        std::cout << "Wrote " << renderProfiler.getFrameCount() << " render frames to tissue_render_trace.json and tissue_render_profile.csv, "
+                  << "sim steps to tissue_trace.json and tissue_profile.csv" << std::endl;
+    }
+    profileKeyDown = profileKey;
 }
 
 // glfw: whenever the window size changed (by OS or user resize) this callback function executes
@@ -0,0 +1,131 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <cstddef>
+#include <cstdio>
+#include <fstream>
+#include <initializer_list>
+#include <string>
+#include <utility>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define MAPPED_FILE_MMAP 1
+#elif defined(_WIN32)
+#include <io.h>
+#endif
+
+/*
+    MappedFile
+        read-only view of a whole file: mmap where available (faulted in up front, read sequentially),
+        else the contents read into memory
+    Used by the binary formats (checkpoints, model caches) that are read in place without parsing.
+*/
+class MappedFile
+{
+    public:
+    MappedFile() = default;
+    ~MappedFile() { close(); }
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    // false when the file is missing or cannot be mapped
+    bool open(const std::string& path)
+    {
+        close();
+#ifdef MAPPED_FILE_MMAP
+        int file = ::open(path.c_str(), O_RDONLY);
+        if (file < 0) return false;
+        struct stat info;
+        if (fstat(file, &info) != 0)
+        {
+            ::close(file);
+            return false;
+        }
+        if (info.st_size == 0)
+        {
+            ::close(file);
+            return true;
+        }
+        int flags = MAP_PRIVATE;
+#ifdef MAP_POPULATE
+        flags |= MAP_POPULATE; // fault the whole file in at once, readers go through all of it
+#endif
+        void* view = mmap(nullptr, (size_t)info.st_size, PROT_READ, flags, file, 0);
+        ::close(file);
+        if (view == MAP_FAILED) return false;
+        madvise(view, (size_t)info.st_size, MADV_SEQUENTIAL);
+        contents = (const char*)view;
+        length = (size_t)info.st_size;
+        mapped = true;
+#else
+        std::ifstream in(path, std::ios::binary | std::ios::ate);
+        if (!in) return false;
+        fallback.resize((size_t)in.tellg());
+        in.seekg(0);
+        in.read(fallback.data(), (std::streamsize)fallback.size());
+        if (!in) return false;
+        contents = fallback.data();
+        length = fallback.size();
+#endif
+        return true;
+    }
+
+    void close()
+    {
+#ifdef MAPPED_FILE_MMAP
+        if (mapped) munmap((void*)contents, length);
+#endif
+        fallback.clear();
+        fallback.shrink_to_fit();
+        contents = nullptr;
+        length = 0;
+        mapped = false;
+    }
+
+    const char* data() const { return contents; }
+    size_t size() const { return length; }
+
+    private:
+    const char* contents = nullptr;
+    size_t length = 0;
+    bool mapped = false;
+    std::vector<char> fallback; // file contents where mmap is not available
+};
+
+// Writes the parts one after another to path + ".tmp", flushes it to disk and renames it over path, so a crash
+// leaves the old file or the new one and never a torn mix. Windows' rename cannot replace a file, there the old one
+// is removed first and a crash in between leaves none. The writers of the formats MappedFile reads use this.
+inline bool replaceFile(const std::string& path, std::initializer_list<std::pair<const void*, size_t>> parts)
+{
+    std::string temporary = path + ".tmp";
+    FILE* out = std::fopen(temporary.c_str(), "wb");
+    if (!out) return false;
+    bool written = true;
+    for (const std::pair<const void*, size_t>& part : parts)
+    {
+        if (written && part.second) written = std::fwrite(part.first, 1, part.second, out) == part.second;
+    }
+    written = written && std::fflush(out) == 0;
+#ifdef MAPPED_FILE_MMAP
+    written = written && fsync(fileno(out)) == 0;
+#elif defined(_WIN32)
+    written = written && _commit(_fileno(out)) == 0;
+#endif
+    written = std::fclose(out) == 0 && written;
+    if (!written)
+    {
+        std::remove(temporary.c_str());
+        return false;
+    }
+#ifdef _WIN32
+    std::remove(path.c_str());
+#endif
+    return std::rename(temporary.c_str(), path.c_str()) == 0;
+}
+
+#endif
@@ -2,102 +2,265 @@
 #define MESH_H
 
 #include <glad/glad.h>
+#include "domain_solver.h"
+#include "gpu_solver.h"
 #include "shader.h"
+#include "tissue.h"
+#include "tissue_model.h"
+#include "vertex_format.h"
 #include <glm/glm.hpp>
 
+#include <cstring>
 #include <string>
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <memory>
+// how positions reach VBO_positions every frame
+enum class PositionUpload
+{
+    Auto,       // Persistent when ARB_buffer_storage is there, else Orphan
+    Persistent, // persistently mapped ring of POSITION_RING_SIZE regions, one fence per region
+    Orphan      // GL 3.3: re-specify the buffer, then glBufferSubData from packedPositions
+};
+
+const int POSITION_RING_SIZE = 3; // frames the GPU may still be reading while the CPU writes the next one
+
+// where Mesh::step runs, switchable at runtime with setSolverBackend
+enum class SolverBackend
+{
+    CPU,        // Tissue::step, positions uploaded every frame
+    GPU,        // GpuSolver compute dispatches, draw reads the solver's buffer (GL 4.3, explicit constraints, no multigrid)
+    Processes   // DomainSolver, domainTiles x domainTiles worker processes; positions gathered and uploaded as on the CPU
+};
+
 /*  
-    Mesh
-        Vertices
-            pos
-            est pos
-            weight
-            velocity
-            color
-            UPDATE VERTICES VELOCITY
-            UPDATE VERTICES POSITIONS
-        Indices
+    Mesh (GL side of a Tissue)
+        Vertices (see VertexFormat)
+            color (immutable)
+            positions (streamed, see PositionUpload)
+        Indices (immutable): triangles, or strips with primitive restart in the compact formats
+        VBO / VAO / EBO
+        optional GpuSolver: the state lives on the GPU and the positions never come back
+        optional DomainSolver: worker processes step the grid, the Tissue holds what they sent back
 */
-class Mesh
+class Mesh : public Tissue
 {
     public: 
     unsigned int VBO_positions, VBO_colors, VAO, EBO;
     Shader shader;
-    std::vector<glm::vec3> positions;
-    std::vector<glm::vec3> estimatedPositions;
-    std::vector<glm::vec3> velocities;
     std::vector<glm::vec3> colors;
-    std::vector<int> isVerticesFixed;
-
-    private:
-    int edgeCount;
-    int maxEdgeWidth;
-    float weight;    
-    float dampingFactor;
-    std::vector<glm::vec4> stretchConstraints;
-    std::vector<float> stretchConstraintsRestLength;
+    std::vector<glm::vec3> packedPositions; // interleaved copy of the SoA positions, staging for the Orphan path
+    std::vector<char> compactPositions;     // packed staging for the Orphan path in the half / snorm16 formats
+    int indexCount;
+    GLenum indexMode;       // GL_TRIANGLES, or GL_TRIANGLE_STRIP with restarts
+    GLenum indexType;       // GL_UNSIGNED_SHORT when every index fits
+    VertexFormat vertexFormat;
+    uint64_t uploadedBytes; // position bytes written for the GPU since creation, see getUploadedBytes
+
+    // persistent ring: region r holds positions at [r * vertexCount, (r+1) * vertexCount)
+    PositionUpload positionUpload;
+    char* mappedPositions;
+    GLsync positionFences[POSITION_RING_SIZE];
+    int positionSlot;       // region the next draw reads
+
+    // Tissue::getPositionVersion of what each ring region / the orphaned buffer holds, so updatePositions only
+    // copies the ranges that changed since; 0 after a write through beginPositionWrite (contents unknown)
+    uint64_t regionVersion[POSITION_RING_SIZE];
+    uint64_t uploadedVersion;
+    std::vector<std::pair<int, int>> changedRanges; // scratch
+
+    std::unique_ptr<GpuSolver> gpuSolver; // SolverBackend::GPU
+    std::unique_ptr<DomainSolver> domainSolver; // SolverBackend::Processes
+    int domainTiles = 2; // tiles per side for SolverBackend::Processes, read when switching to it
 
     public:
     // constructor generates the shader on the fly
     // ------------------------------------------------------------------------
-    Mesh(int edgeCount, int maxEdgeWidth, const char* vertexPath, const char* fragmentPath, float mass=0.001f)
-        : shader(vertexPath, fragmentPath), edgeCount(edgeCount), maxEdgeWidth(maxEdgeWidth), weight(1.0f/mass)
+    Mesh(int edgeCount, int maxEdgeWidth, const char* vertexPath, const char* fragmentPath, float mass=0.001f, Integrator integrator=Integrator::PBD,
+         PositionUpload upload=PositionUpload::Auto, VertexOrder order=VertexOrder::Build, GridConstraints constraints=GridConstraints::Explicit,
+         VertexFormat format=VertexFormat::Float)
+        : Tissue(edgeCount, maxEdgeWidth, mass, integrator, order, constraints), shader(vertexPath, fragmentPath),
+          vertexFormat(format), mappedPositions(nullptr), positionSlot(0)
+    {
+        createBuffers(upload);
+    }
+
+    // imported model (see tissue_model.h): draws its surface triangles, colored by position
+    Mesh(const TissueModel& model, const char* vertexPath, const char* fragmentPath, float mass=0.001f, Integrator integrator=Integrator::PBD,
+         PositionUpload upload=PositionUpload::Auto, VertexOrder order=VertexOrder::Build, VertexFormat format=VertexFormat::Float)
+        : Tissue(model, mass, integrator, order), shader(vertexPath, fragmentPath),
+          vertexFormat(format), mappedPositions(nullptr), positionSlot(0)
+    {
+        createBuffers(upload);
+    }
+
+    // restores the Tissue from an open checkpoint (vertex order included), then builds the GL side as above
+    Mesh(const Checkpoint& checkpoint, const char* vertexPath, const char* fragmentPath, PositionUpload upload=PositionUpload::Auto,
+         VertexFormat format=VertexFormat::Float)
+        : Tissue(checkpoint), shader(vertexPath, fragmentPath), vertexFormat(format), mappedPositions(nullptr), positionSlot(0)
     {
-        dampingFactor = 0.75f;
+        createBuffers(upload);
+    }
 
+    // a batch (see Tissue(const std::vector<TissueInstance>&)) drawn as one surface; Scene draws it body by body
+    Mesh(const std::vector<TissueInstance>& instances, const char* vertexPath, const char* fragmentPath, PositionUpload upload=PositionUpload::Auto,
+         VertexFormat format=VertexFormat::Float)
+        : Tissue(instances), shader(vertexPath, fragmentPath), vertexFormat(format), mappedPositions(nullptr), positionSlot(0)
+    {
+        createBuffers(upload);
+    }
+
+    virtual ~Mesh() = default;
 
-        positions = createPositions(edgeCount,maxEdgeWidth);
-        colors = createColors(edgeCount); // we have 3 coordinates per vertex and 3 color values
-        
-        for (int i = 0; i < edgeCount*edgeCount; i++)
+    void unbind(){
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        glBindVertexArray(0);
+    }
+
+    void bind(){
+        glBindVertexArray(VAO);
+    }
+
+    // GPU uploads the current state and steps it with compute shaders from shaderDirectory from now on; Processes forks
+    // the DomainSolver workers from it. False, with the reason printed, when the context or the tissue cannot (then the
+    // CPU keeps going). Switching away brings the state back to the Tissue first.
+    // Not while a SimulationThread steps this mesh: these backends run on the thread that steps it with Mesh::step.
+    bool setSolverBackend(SolverBackend backend, const std::string& shaderDirectory = "../shaders/")
+    {
+        if (backend == getSolverBackend()) return true;
+        if (gpuSolver)
         {
-            velocities.push_back(glm::vec3(0.0f, 0.0f, 0.0f));
+            syncFromGpu();
+            gpuSolver.reset();
+            // attribute 0 back to the streamed VBO, refreshed with the downloaded positions
+            glBindVertexArray(VAO);
+            glBindBuffer(GL_ARRAY_BUFFER, VBO_positions);
+            setPositionAttribute(0);
+            updatePositions();
         }
-        
+        domainSolver.reset(); // its last step is already in the Tissue
+        if (backend == SolverBackend::CPU) return true;
 
-        std::vector<unsigned int> indices = createMeshIndices(edgeCount,maxEdgeWidth);
+        if (backend == SolverBackend::Processes)
+        {
+            domainSolver = DomainSolver::createLocal(*this, domainTiles, domainTiles);
+            if (domainSolver) return true;
+            std::cout << "ERROR::MESH::DOMAIN_SOLVER staying on the CPU" << std::endl;
+            return false;
+        }
 
-        glGenVertexArrays(1, &VAO);
-        glGenBuffers(1, &EBO);
+        const char* reason = nullptr;
+        if (!GpuSolver::isSupported()) reason = "needs a GL 4.3 context";
+        else if (getGridConstraints() == GridConstraints::Implicit) reason = "needs explicit grid constraints";
+        else if (getMultigridLevels() > 0) reason = "has no multigrid levels";
+        else if (getBodyCount() > 1) reason = "needs a single body";
+        else if (selfCollisionThickness > 0.0f) reason = "has no self-collision";
+        else if (getObstacleCount() > 0) reason = "has no obstacles";
+        if (reason)
+        {
+            std::cout << "ERROR::MESH::GPU_SOLVER " << reason << ", staying on the CPU" << std::endl;
+            return false;
+        }
+        gpuSolver.reset(new GpuSolver(*this, shaderDirectory));
+        if (!gpuSolver->isValid())
+        {
+            std::cout << "ERROR::MESH::GPU_SOLVER compute shaders did not build, staying on the CPU" << std::endl;
+            gpuSolver.reset();
+            return false;
+        }
+        return true;
+    }
 
-        glGenBuffers(1, &VBO_positions);
-        glGenBuffers(1, &VBO_colors);
+    SolverBackend getSolverBackend() const
+    {
+        return gpuSolver ? SolverBackend::GPU : domainSolver ? SolverBackend::Processes : SolverBackend::CPU;
+    }
 
-        glBindVertexArray(VAO);
+    // Tissue::step on the selected backend. The GPU and the worker processes run `iterations` sweeps every substep and
+    // do not measure the residual; the GPU's SolveStats carry the GPU time of a step a few frames back, the workers'
+    // the wall time of the last step. A worker that dies drops the mesh back to the CPU at its last gathered state.
+    void step(float deltaTime, glm::vec3 gravity)
+    {
+        if (domainSolver)
+        {
+            if (domainSolver->step(deltaTime, gravity))
+            {
+                lastSolve = {iterations * substeps, lastResidual, domainSolver->getLastStepMs(), false};
+                return;
+            }
+            std::cout << "ERROR::MESH::DOMAIN_SOLVER lost a worker, back on the CPU" << std::endl;
+            domainSolver.reset();
+        }
+        if (!gpuSolver)
+        {
+            Tissue::step(deltaTime, gravity);
+            return;
+        }
+        gpuSolver->step(*this, deltaTime, gravity);
+        lastSolve = {iterations * substeps, lastResidual, gpuSolver->getLastStepMs(), false};
+    }
 
-        // positions VBO
-        glBindBuffer(GL_ARRAY_BUFFER, VBO_positions);
-        glBufferData(GL_ARRAY_BUFFER, positions.size() * sizeof(glm::vec3), positions.data(), GL_DYNAMIC_DRAW);
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, (void*)0);
-        glEnableVertexAttribArray(0);
+    // copies the GPU state into the Tissue, e.g. before a checkpoint or a CPU comparison; no-op on the CPU backend
+    void syncFromGpu()
+    {
+        if (!gpuSolver) return;
+        gpuSolver->download(*this);
+        wakeAll(); // every position may have changed
+    }
 
-        // colors VBO
-        glBindBuffer(GL_ARRAY_BUFFER, VBO_colors);
-        glBufferData(GL_ARRAY_BUFFER, colors.size() * sizeof(glm::vec3), colors.data(), GL_DYNAMIC_DRAW);
-        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 0, (void*)0);
-        glEnableVertexAttribArray(1);
+    // moves vertex i by offset and pins it / unpins it, on any backend
+    void dragVertex(int i, glm::vec3 offset)
+    {
+        if (gpuSolver) gpuSolver->setVertex(i, offset, 0.0f);
+        else positions.set(i, positions.get(i) + offset);
+        if (domainSolver) domainSolver->setVertex(i, offset, 0.0f);
+        setVertexFixed(i, true);
+    }
 
+    void releaseVertex(int i)
+    {
+        if (gpuSolver) gpuSolver->setVertex(i, glm::vec3(0.0f), getFreeInverseMass());
+        if (domainSolver) domainSolver->setVertex(i, glm::vec3(0.0f), getFreeInverseMass());
+        setVertexFixed(i, false);
+    }
 
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), GL_DYNAMIC_DRAW);
-    
-        createStretchConstraints();
+    // Tissue::grab on any backend; the GPU and the worker processes have no grab pass, they get the pinned
+    // (weight 1) vertices only
+    void grab(const std::vector<int>& vertices, const std::vector<float>& weights)
+    {
+        releaseGrab();
+        Tissue::grab(vertices, weights);
+        forwardGrab(glm::vec3(0.0f), 0.0f);
     }
 
-    void unbind(){
-        glBindBuffer(GL_ARRAY_BUFFER, 0);
-        glBindVertexArray(0);
+    void moveGrab(glm::vec3 offset)
+    {
+        Tissue::moveGrab(offset);
+        forwardGrab(offset, 0.0f);
     }
 
-    void bind(){
-        glBindVertexArray(VAO);
+    void releaseGrab()
+    {
+        forwardGrab(glm::vec3(0.0f), getFreeInverseMass());
+        Tissue::releaseGrab();
     }
 
     void deleteArraysAndBuffers()
     {
+        gpuSolver.reset();
+        domainSolver.reset();
+        for (int r = 0; r < POSITION_RING_SIZE; r++)
+        {
+            if (positionFences[r]) glDeleteSync(positionFences[r]);
+            positionFences[r] = 0;
+        }
+        if (mappedPositions)
+        {
+            glBindBuffer(GL_ARRAY_BUFFER, VBO_positions);
+            glUnmapBuffer(GL_ARRAY_BUFFER);
+            mappedPositions = nullptr;
+        }
         glDeleteVertexArrays(1, &VAO);
         glDeleteBuffers(1, &VBO_positions);
         glDeleteBuffers(1, &VBO_colors);
@@ -105,143 +268,366 @@ class Mesh
         shader.ID = 0;
     }
 
-    void draw(){
+    virtual void draw(){
         shader.use();
         glBindVertexArray(VAO);
-        glDrawElements(GL_TRIANGLES, (edgeCount - 1) * (edgeCount - 1) * 6, GL_UNSIGNED_INT, 0);
+        bindPositions();
+        setPrimitiveRestart(true);
+        glDrawElements(indexMode, indexCount, indexType, 0);
+        setPrimitiveRestart(false);
+        fencePositions();
     }
 
-    void updateEstimatedPositions(float deltaTime)
+    // points attribute 0 of the bound VAO at the positions the next draw reads, and tells the shader how to scale them
+    void bindPositions()
     {
-        if(estimatedPositions.size() == 0) 
+        bool snorm = !gpuSolver && vertexFormat == VertexFormat::CompactSnorm16;
+        shader.setFloat("positionScale", snorm ? SNORM16_POSITION_RANGE : 1.0f);
+        if (gpuSolver)
         {
-            for(int i=0; i<positions.size(); i++){
-                if(isVerticesFixed[i] == 0) estimatedPositions.push_back(positions[i] + velocities[i] * deltaTime);
-                else estimatedPositions.push_back(positions[i]);
-            }
-        } 
-        else 
+            // straight from the solver's vec4 buffer, the inverse mass in w is skipped
+            glBindBuffer(GL_ARRAY_BUFFER, gpuSolver->getPositionBuffer());
+            glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)0);
+        }
+        else if (positionUpload == PositionUpload::Persistent)
         {
-            for(int i=0; i<positions.size(); i++){
-                if(isVerticesFixed[i] == 0) estimatedPositions[i] = positions[i] + velocities[i] * deltaTime;
-                else estimatedPositions[i] = positions[i];
-            }
+            // point attribute 0 at the region written last
+            glBindBuffer(GL_ARRAY_BUFFER, VBO_positions);
+            setPositionAttribute(positionSlot * getPositionBytes());
         }
     }
 
-    void updateVelocitiesAndPositions(float deltaTime)
+    // strips restart at the all-ones index of their index type
+    void setPrimitiveRestart(bool enabled)
     {
-        for(int i=0; i<velocities.size(); i++){
-            if(isVerticesFixed[i] == 0) 
-            {
-                velocities[i] = (estimatedPositions[i] - positions[i]) / deltaTime;
-                positions[i] = estimatedPositions[i];
-            }
-            else velocities[i] = glm::vec3(0.0f);   
+        if (indexMode != GL_TRIANGLE_STRIP) return;
+        if (!enabled)
+        {
+            glDisable(GL_PRIMITIVE_RESTART);
+            return;
         }
+        glEnable(GL_PRIMITIVE_RESTART);
+        glPrimitiveRestartIndex(indexType == GL_UNSIGNED_SHORT ? 0xFFFF : PRIMITIVE_RESTART);
     }
 
-    void updatePositions()
+    // after the draws reading the current ring region, so beginPositionWrite waits for them before reusing it
+    void fencePositions()
     {
-        glBindBuffer(GL_ARRAY_BUFFER, VBO_positions);
-        glBufferSubData(GL_ARRAY_BUFFER, 0, positions.size() * sizeof(glm::vec3), positions.data());
+        if (!gpuSolver && positionUpload == PositionUpload::Persistent)
+        {
+            if (positionFences[positionSlot]) glDeleteSync(positionFences[positionSlot]);
+            positionFences[positionSlot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        }
     }
 
-    void addGravity(float deltaTime, glm::vec3 gravity)
+    // copies the Tissue positions that changed since the last upload (see Tissue::getChangedRanges) and uploads
+    // them; not while a SimulationThread steps this mesh. Nothing to do on the GPU backend, draw reads the solver's buffer.
+    void updatePositions()
     {
-        for(int i=0; i<velocities.size(); i++){
-            if(isVerticesFixed[i] == 0) velocities[i] += gravity * deltaTime;
+        if (gpuSolver) return;
+        uint64_t version = getPositionVersion();
+        if (positionUpload == PositionUpload::Persistent)
+        {
+            // the region drawn now is up to date: keep drawing it
+            if (regionVersion[positionSlot] == version) return;
+            int next = (positionSlot + 1) % POSITION_RING_SIZE;
+            getChangedRanges(regionVersion[next], changedRanges);
+            char* region = acquireRegion(next);
+            for (const std::pair<int, int>& range : changedRanges)
+            {
+                writePositions(region, range.first, range.second);
+                uploadedBytes += (uint64_t)(range.second - range.first) * getPositionStride(vertexFormat);
+            }
+            positionSlot = next;
+            regionVersion[positionSlot] = version;
+            return;
         }
+
+        getChangedRanges(uploadedVersion, changedRanges);
+        if (changedRanges.empty()) return;
+        for (const std::pair<int, int>& range : changedRanges) writePositions(getOrphanStaging(), range.first, range.second);
+        uploadStagedRanges(changedRanges);
+        uploadedVersion = version;
     }
 
-    void applyDamping(float dampingFactor)
+    // Returns where the next frame's interleaved xyz floats go: the next ring region once the GPU has
+    // finished reading it (Persistent, VertexFormat Float or Compact), or packedPositions, packed on
+    // endPositionWrite. endPositionWrite(false) keeps drawing the previous positions, e.g. when
+    // SimulationThread::readPositions had nothing new.
+    float* beginPositionWrite()
     {
-        glm::vec3 centerOfMassPosition = glm::vec3(0.0f);
-        glm::vec3 centerOfMassVelocity = glm::vec3(0.0f);
-        
-        float totalMass = 1/weight * edgeCount * edgeCount;
-        float mass = 1/weight;
+        if (positionUpload == PositionUpload::Orphan) return &packedPositions[0].x;
+        char* region = acquireRegion((positionSlot + 1) % POSITION_RING_SIZE);
+        return getPositionStride(vertexFormat) == 3 * sizeof(float) ? (float*)region : &packedPositions[0].x;
+    }
 
-        for(int i=0; i<velocities.size(); i++)
+    void endPositionWrite(bool written)
+    {
+        if (!written) return;
+        bool packed = getPositionStride(vertexFormat) != 3 * sizeof(float);
+        if (positionUpload == PositionUpload::Persistent)
         {
-            if(isVerticesFixed[i] == 1) continue;
+            int next = (positionSlot + 1) % POSITION_RING_SIZE;
+            if (packed) packPositions(vertexFormat, &packedPositions[0].x, getPositionRegion(next), getVertexCount());
+            uploadedBytes += getPositionBytes();
+            positionSlot = next; // coherent mapping, no flush needed
+            regionVersion[positionSlot] = 0;
+            return;
+        }
+        uploadedVersion = 0;
+        if (packed) packPositions(vertexFormat, &packedPositions[0].x, getOrphanStaging(), getVertexCount());
+        orphanPositions();
+    }
 
-            centerOfMassPosition += positions[i] * mass;
-            centerOfMassVelocity += velocities[i] * mass;
-    
+    // endPositionWrite after SimulationThread::readChangedPositions: only ranges were written, on top of positions of
+    // getPositionWriteVersion(), and the buffer now holds those of version
+    void endPositionWrite(uint64_t version, const std::vector<std::pair<int, int>>& ranges)
+    {
+        int stride = getPositionStride(vertexFormat);
+        bool packed = stride != 3 * sizeof(float);
+        const float* written = &packedPositions[0].x;
+        if (positionUpload == PositionUpload::Persistent)
+        {
+            int next = (positionSlot + 1) % POSITION_RING_SIZE;
+            for (const std::pair<int, int>& range : ranges)
+            {
+                if (packed) packPositions(vertexFormat, written + (size_t)range.first * 3, getPositionRegion(next) + (size_t)range.first * stride, range.second - range.first);
+                uploadedBytes += (uint64_t)(range.second - range.first) * stride;
+            }
+            positionSlot = next;
+            regionVersion[positionSlot] = version;
+            return;
         }
-  
-        centerOfMassPosition /= totalMass;
-        centerOfMassVelocity /= totalMass;
-        
-        std::vector<glm::vec3> relativePositions(velocities.size(), glm::vec3(0.0f));
-        glm::vec3 angularMomentum = glm::vec3(0.0f);
-        glm::mat3 inertiaTensor = glm::mat3(0.0f);
-
-        for(int i=0; i<velocities.size(); i++)
+        for (const std::pair<int, int>& range : ranges)
         {
-            if(isVerticesFixed[i] == 1) continue;
+            if (packed) packPositions(vertexFormat, written + (size_t)range.first * 3, getOrphanStaging() + (size_t)range.first * stride, range.second - range.first);
+        }
+        uploadStagedRanges(ranges);
+        uploadedVersion = version;
+    }
+
+    // Tissue::getPositionVersion of what beginPositionWrite hands out, 0 when unknown; the oldest positions on the
+    // render side, so SimulationThread::setHeldVersion with it keeps readChangedPositions correct for every region
+    uint64_t getPositionWriteVersion() const
+    {
+        return positionUpload == PositionUpload::Persistent ? regionVersion[(positionSlot + 1) % POSITION_RING_SIZE] : uploadedVersion;
+    }
 
-            relativePositions[i] = positions[i] - centerOfMassPosition;
-            glm::vec3 relativeVelocity = velocities[i] - centerOfMassVelocity;
+    GLsizeiptr getPositionBytes() const { return (GLsizeiptr)getVertexCount() * getPositionStride(vertexFormat); }
+    char* getPositionRegion(int slot) { return mappedPositions + (size_t)slot * getPositionBytes(); }
+
+    VertexFormat getVertexFormat() const { return vertexFormat; }
+    // position bytes written into the ring or uploaded since creation; the difference over a frame is that frame's upload
+    uint64_t getUploadedBytes() const { return uploadedBytes; }
+    // GPU memory of the position (whole ring), color and index buffers
+    size_t getBufferBytes() const
+    {
+        size_t positionBytes = (size_t)getPositionBytes() * (positionUpload == PositionUpload::Persistent ? POSITION_RING_SIZE : 1);
+        size_t colorBytes = colors.size() * (isCompact(vertexFormat) ? 4 : 3 * sizeof(float));
+        size_t indexBytes = (size_t)indexCount * (indexType == GL_UNSIGNED_SHORT ? sizeof(uint16_t) : sizeof(uint32_t));
+        return positionBytes + colorBytes + indexBytes;
+    }
 
-            angularMomentum += glm::cross(relativePositions[i], relativeVelocity * mass);
+    // a grid's gradient over its rows and columns, or the same gradient over a model's bounding box
+    static std::vector<glm::vec3> createColors(const Tissue& tissue)
+    {
+        return tissue.getEdgeCount() >= 2 ? createGridColors(tissue) : createModelColors(tissue);
+    }
+
+    // utility function for creating mesh colors and indices.
+    // ------------------------------------------------------------------------
+
+    // two triangles per grid cell, or with strips one strip per grid row, a PRIMITIVE_RESTART between rows
+    // (same diagonals); models and batches draw their surface triangles either way
+    static std::vector<unsigned int> createIndices(const Tissue& tissue, bool strips)
+    {
+        int edgeCount = tissue.getEdgeCount();
+        if (!strips || edgeCount < 2) return tissue.getDrawTriangles();
 
-            glm::mat3 ri_tilde = skewSymmetric(relativePositions[i]);
-            inertiaTensor += mass * (ri_tilde * glm::transpose(ri_tilde));
+        std::vector<unsigned int> indices;
+        indices.reserve((edgeCount-1) * (2*edgeCount + 1));
+        for(int i=0; i<edgeCount-1; i++){
+            if (i > 0) indices.push_back(PRIMITIVE_RESTART);
+            for(int j=0; j<edgeCount; j++){
+                indices.push_back(tissue.getVertexIndex((i+1)*edgeCount + j)); // bottom
+                indices.push_back(tissue.getVertexIndex(i*edgeCount + j));     // top
+            }
         }
+        return indices;
+    }
 
-        glm::mat3 inertiaTensorInv = glm::inverse(inertiaTensor);
-        glm::vec3 angularVelocity = inertiaTensorInv * angularMomentum;
+    protected:
+    // for subclasses that pick their own colors and indices, then call createBuffers
+    struct Deferred {};
+    Mesh(const std::vector<TissueInstance>& instances, const char* vertexPath, const char* fragmentPath, VertexFormat format, Deferred)
+        : Tissue(instances), shader(vertexPath, fragmentPath), vertexFormat(format), mappedPositions(nullptr), positionSlot(0)
+    {
+    }
 
-        for(int i=0; i<velocities.size(); i++)
+    // colors and indices of this tissue: strips for grids in the compact formats
+    void createBuffers(PositionUpload upload)
+    {
+        colors = createColors(*this);
+        bool strips = isCompact(vertexFormat) && getEdgeCount() >= 2;
+        createBuffers(upload, createIndices(*this, strips), strips ? GL_TRIANGLE_STRIP : GL_TRIANGLES);
+    }
+
+    // VAO and buffers for colors (filled in by the caller) and indices drawn as mode
+    void createBuffers(PositionUpload upload, const std::vector<unsigned int>& indices, GLenum mode)
+    {
+        bool bufferStorage = GLAD_GL_ARB_buffer_storage != 0;
+        positionUpload = upload == PositionUpload::Auto ? (bufferStorage ? PositionUpload::Persistent : PositionUpload::Orphan) : upload;
+        if (positionUpload == PositionUpload::Persistent && !bufferStorage)
         {
-            if(isVerticesFixed[i] == 1) continue;
-            glm::vec3 deltaVelocity = centerOfMassVelocity + glm::cross(angularVelocity, relativePositions[i]) - velocities[i];
+            std::cout << "ERROR::MESH::ARB_buffer_storage missing, falling back to orphaning" << std::endl;
+            positionUpload = PositionUpload::Orphan;
+        }
+        for (int r = 0; r < POSITION_RING_SIZE; r++) positionFences[r] = 0;
+        for (int r = 0; r < POSITION_RING_SIZE; r++) regionVersion[r] = getPositionVersion();
+        uploadedVersion = getPositionVersion();
+        uploadedBytes = 0;
+
+        packedPositions.resize(getVertexCount());
+        if (getPositionStride(vertexFormat) != 3 * sizeof(float)) compactPositions.resize(getPositionBytes());
+        writePositions(getOrphanStaging(), 0, getVertexCount());
+
+        std::vector<char> packedIndices;
+        indexCount = (int)indices.size();
+        indexMode = mode;
+        indexType = packIndices(indices, isCompact(vertexFormat), packedIndices) == sizeof(uint16_t) ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
 
-            velocities[i] -= deltaVelocity * dampingFactor;
+        glGenVertexArrays(1, &VAO);
+        glGenBuffers(1, &EBO);
+
+        glGenBuffers(1, &VBO_positions);
+        glGenBuffers(1, &VBO_colors);
+
+        glBindVertexArray(VAO);
+
+        // positions VBO
+        glBindBuffer(GL_ARRAY_BUFFER, VBO_positions);
+        if (positionUpload == PositionUpload::Persistent)
+        {
+            GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+            GLsizeiptr ringSize = POSITION_RING_SIZE * getPositionBytes();
+            glBufferStorage(GL_ARRAY_BUFFER, ringSize, nullptr, flags);
+            mappedPositions = (char*)glMapBufferRange(GL_ARRAY_BUFFER, 0, ringSize, flags);
+            for (int r = 0; r < POSITION_RING_SIZE; r++) std::memcpy(getPositionRegion(r), getOrphanStaging(), getPositionBytes());
         }
+        else glBufferData(GL_ARRAY_BUFFER, getPositionBytes(), getOrphanStaging(), GL_STREAM_DRAW);
+        setPositionAttribute(0);
+        glEnableVertexAttribArray(0);
+
+        // colors VBO, never changes
+        glBindBuffer(GL_ARRAY_BUFFER, VBO_colors);
+        if (isCompact(vertexFormat))
+        {
+            std::vector<uint32_t> packedColors = packColors(colors);
+            createStaticBuffer(GL_ARRAY_BUFFER, packedColors.size() * sizeof(uint32_t), packedColors.data());
+            glVertexAttribPointer(1, 4, GL_UNSIGNED_BYTE, GL_TRUE, 0, (void*)0);
+        }
+        else
+        {
+            createStaticBuffer(GL_ARRAY_BUFFER, colors.size() * sizeof(glm::vec3), colors.data());
+            glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 0, (void*)0);
+        }
+        glEnableVertexAttribArray(1);
+
+
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+        createStaticBuffer(GL_ELEMENT_ARRAY_BUFFER, packedIndices.size(), packedIndices.data());
+    }
+
+    // attribute 0 from the bound GL_ARRAY_BUFFER at offset, in vertexFormat
+    void setPositionAttribute(GLsizeiptr offset)
+    {
+        if (vertexFormat == VertexFormat::CompactHalf) glVertexAttribPointer(0, 3, GL_HALF_FLOAT, GL_FALSE, 4 * sizeof(uint16_t), (void*)offset);
+        else if (vertexFormat == VertexFormat::CompactSnorm16) glVertexAttribPointer(0, 3, GL_SHORT, GL_TRUE, 4 * sizeof(int16_t), (void*)offset);
+        else glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, (void*)offset);
     }
 
-    void SolveAllStretchConstraints()
+    // vertices [begin, end) of the Tissue to the same place in destination, in vertexFormat
+    void writePositions(char* destination, int begin, int end)
     {
-        for(int i=0; i<stretchConstraints.size(); i++)
+        if (getPositionStride(vertexFormat) == 3 * sizeof(float)) copyPositions((float*)destination, begin, end);
+        else packPositions(vertexFormat, positions, destination, begin, end);
+    }
+
+    // Orphan: what glBufferSubData reads, in vertexFormat
+    char* getOrphanStaging()
+    {
+        return getPositionStride(vertexFormat) == 3 * sizeof(float) ? (char*)packedPositions.data() : compactPositions.data();
+    }
+
+    // ring region slot once the GPU has finished reading it
+    char* acquireRegion(int slot)
+    {
+        if (positionFences[slot])
         {
-            SolveStretchConstraint(stretchConstraints[i], stretchConstraintsRestLength[i]);
+            GLbitfield flags = GL_SYNC_FLUSH_COMMANDS_BIT;
+            while (glClientWaitSync(positionFences[slot], flags, 1000000000) == GL_TIMEOUT_EXPIRED) flags = 0;
+            glDeleteSync(positionFences[slot]);
+            positionFences[slot] = 0;
         }
+        return getPositionRegion(slot);
     }
 
-    // utility function for creating mesh vertices and indices.
-    // ------------------------------------------------------------------------
+    // orphan: the driver hands out fresh storage while the GPU may still read the old one
+    void orphanPositions()
+    {
+        glBindBuffer(GL_ARRAY_BUFFER, VBO_positions);
+        glBufferData(GL_ARRAY_BUFFER, getPositionBytes(), nullptr, GL_STREAM_DRAW);
+        glBufferSubData(GL_ARRAY_BUFFER, 0, getPositionBytes(), getOrphanStaging());
+        uploadedBytes += getPositionBytes();
+    }
 
-    private:
-    std::vector<glm::vec3> createPositions(int edgeCount, int maxEdgeWidth) 
+    // Orphan: the staged ranges to the GPU, orphaning only when they cover every vertex
+    void uploadStagedRanges(const std::vector<std::pair<int, int>>& ranges)
     {
-        std::vector<glm::vec3> pos(edgeCount * edgeCount);
-        for(int i=0; i < edgeCount; ++i){
-            for(int j=0; j < edgeCount; ++j){
-                pos[i*edgeCount + j] = glm::vec3(
-                    -(maxEdgeWidth/2.0f) + j*(maxEdgeWidth/(edgeCount-1.0f)),
-                    -(maxEdgeWidth/2.0f) + i*(maxEdgeWidth/(edgeCount-1.0f)),
-                    0.0f
-                );
+        if (ranges.size() == 1 && ranges[0].first == 0 && ranges[0].second == getVertexCount())
+        {
+            orphanPositions();
+            return;
+        }
+        // no orphaning, it would drop the unchanged ranges; the driver orders these writes after pending draws
+        glBindBuffer(GL_ARRAY_BUFFER, VBO_positions);
+        int stride = getPositionStride(vertexFormat);
+        char* staging = getOrphanStaging();
+        for (const std::pair<int, int>& range : ranges)
+        {
+            glBufferSubData(GL_ARRAY_BUFFER, (GLintptr)range.first * stride, (GLsizeiptr)(range.second - range.first) * stride,
+                            staging + (size_t)range.first * stride);
+            uploadedBytes += (uint64_t)(range.second - range.first) * stride;
+        }
+    }
 
-                if(i == edgeCount - 1 && (j == 0 || j == edgeCount - 1)){
-                    isVerticesFixed.push_back(1);
-                } else {
-                    isVerticesFixed.push_back(0);
-                }
-            }
+    // immutable storage when available, else a STATIC_DRAW buffer
+    void createStaticBuffer(GLenum target, GLsizeiptr size, const void* data)
+    {
+        if (GLAD_GL_ARB_buffer_storage) glBufferStorage(target, size, data, 0);
+        else glBufferData(target, size, data, GL_STATIC_DRAW);
+    }
+
+    // the grab's pinned vertices to the GPU or the workers: moved by offset, at inverseMass
+    void forwardGrab(glm::vec3 offset, float inverseMass)
+    {
+        if (!gpuSolver && !domainSolver) return;
+        for (size_t k = 0; k < getGrabVertices().size(); k++)
+        {
+            if (getGrabWeights()[k] < 1.0f) continue;
+            if (gpuSolver) gpuSolver->setVertex(getGrabVertices()[k], offset, inverseMass);
+            if (domainSolver) domainSolver->setVertex(getGrabVertices()[k], offset, inverseMass);
         }
-        return pos;
     }
 
-    std::vector<glm::vec3> createColors(int edgeCount) 
+    private:
+    static std::vector<glm::vec3> createGridColors(const Tissue& tissue)
     {
+        int edgeCount = tissue.getEdgeCount();
         std::vector<glm::vec3> cols(edgeCount * edgeCount);
         for(int i=0; i < edgeCount; ++i){
             for(int j=0; j < edgeCount; ++j){
-                cols[i*edgeCount + j] = glm::vec3(
+                cols[tissue.getVertexIndex(i*edgeCount + j)] = glm::vec3(
                     (float)i / edgeCount,
                     (float)j / edgeCount,
                     0.0f
@@ -251,98 +637,26 @@ class Mesh
         return cols;
     }
 
-    std::vector<unsigned int> createMeshIndices(int edgeCount, int maxEdgeWidth)
+    // the grid's gradient over the bounding box: red follows y, green follows x
+    static std::vector<glm::vec3> createModelColors(const Tissue& tissue)
     {
-        std::vector<unsigned int> indices((edgeCount-1)*(edgeCount-1)*6); // we have 6 indices per quad
-        for(int i=0; i<edgeCount-1; i++){
-            for(int j=0; j<edgeCount-1; j++)
-            {
-                indices[(i*(edgeCount-1)+j)*6+0] = i*edgeCount + j;         // top left
-                indices[(i*(edgeCount-1)+j)*6+1] = i*edgeCount + (j+1);     // top right
-                indices[(i*(edgeCount-1)+j)*6+2] = (i+1)*edgeCount + (j+1); // bottom right
-                indices[(i*(edgeCount-1)+j)*6+3] = i*edgeCount + j;         // top left
-                indices[(i*(edgeCount-1)+j)*6+4] = (i+1)*edgeCount + (j+1); // bottom right
-                indices[(i*(edgeCount-1)+j)*6+5] = (i+1)*edgeCount + j;     // bottom left
-            }
+        const Vec3Streams& positions = tissue.positions;
+        std::vector<glm::vec3> cols(tissue.getVertexCount());
+        if (cols.empty()) return cols;
+        glm::vec3 low = positions.get(0), high = low;
+        for(int i=1; i<tissue.getVertexCount(); i++)
+        {
+            low = glm::min(low, positions.get(i));
+            high = glm::max(high, positions.get(i));
         }
+        glm::vec3 extent = glm::max(high - low, glm::vec3(1e-6f));
 
-        return indices;
-    }
-
-    // Create the skew-symmetric cross-product matrix of vector r
-    glm::mat3 skewSymmetric(const glm::vec3& r) {
-        return glm::mat3(
-            0,      -r.z,    r.y,
-            r.z,    0,      -r.x,
-        -r.y,    r.x,    0
-        );
-    }
-
-    void createStretchConstraints()
-    {
-        for(int i=0; i<edgeCount; i++){
-            for(int j=0; j<edgeCount; j++)
-            {
-                glm::vec4 stretchConstrainstIndex;
-                if(j < edgeCount - 1 && i < edgeCount - 1)
-                {
-                    stretchConstrainstIndex = glm::vec4(i , j, i, j+1);
-                    stretchConstraints.push_back(stretchConstrainstIndex);
-                    stretchConstraintsRestLength.push_back(glm::length(positions[i*edgeCount + j] - positions[i*edgeCount + (j+1)]));
-                    stretchConstrainstIndex = glm::vec4(i , j, i+1, j);
-                    stretchConstraints.push_back(stretchConstrainstIndex);
-                    stretchConstraintsRestLength.push_back(glm::length(positions[i*edgeCount + j] - positions[(i+1)*edgeCount + j]));
-                    stretchConstrainstIndex = glm::vec4(i , j, i+1, j+1);
-                    stretchConstraints.push_back(stretchConstrainstIndex);
-                    stretchConstraintsRestLength.push_back(glm::length(positions[i*edgeCount + j] - positions[(i+1)*edgeCount + (j+1)]));
-                    if(j > 0)
-                    {
-                        stretchConstrainstIndex = glm::vec4(i , j, i+1, j-1);
-                        stretchConstraints.push_back(stretchConstrainstIndex);
-                        stretchConstraintsRestLength.push_back(glm::length(positions[i*edgeCount + j] - positions[(i+1)*edgeCount + (j-1)]));
-                    }
-                }
-                else if(j == edgeCount - 1 && i < edgeCount - 1)
-                {
-                    stretchConstrainstIndex = glm::vec4(i , j, i+1, j);
-                    stretchConstraints.push_back(stretchConstrainstIndex);
-                    stretchConstraintsRestLength.push_back(glm::length(positions[i*edgeCount + j] - positions[(i+1)*edgeCount + j]));
-                
-                    stretchConstrainstIndex = glm::vec4(i , j, i+1, j-1);
-                    stretchConstraints.push_back(stretchConstrainstIndex);
-                    stretchConstraintsRestLength.push_back(glm::length(positions[i*edgeCount + j] - positions[(i+1)*edgeCount + (j-1)]));
-                }
-                else if(j < edgeCount - 1 && i == edgeCount - 1)
-                {
-                    stretchConstrainstIndex = glm::vec4(i , j, i, j+1);
-                    stretchConstraints.push_back(stretchConstrainstIndex);
-                    stretchConstraintsRestLength.push_back(glm::length(positions[i*edgeCount + j] - positions[i*edgeCount + (j+1)]));
-                }
-            }
+        for(int i=0; i<tissue.getVertexCount(); i++)
+        {
+            glm::vec3 t = (positions.get(i) - low) / extent;
+            cols[i] = glm::vec3(t.y, t.x, 0.0f);
         }
-    }
-
-    void SolveStretchConstraint(const glm::vec4& constraint, float restLength)
-    {
-        int i1 = constraint.x * edgeCount + constraint.y;
-        int i2 = constraint.z * edgeCount + constraint.w;
-
-        glm::vec3 p1 = estimatedPositions[i1];
-        glm::vec3 p2 = estimatedPositions[i2];
-
-        float currentLength = glm::length(p1 - p2);
-        if(currentLength == 0.0f) return;
-
-        glm::vec3 deltaPNormalized = (p1 - p2)/currentLength; 
-        float deltaLength = currentLength - restLength;
-
-        float w1 = (isVerticesFixed[i1] == 1) ? 0.0f : weight;
-        float w2 = (isVerticesFixed[i2] == 1) ? 0.0f : weight;
-        float wSum = w1 + w2;
-        if(wSum == 0.0f) return;        
-
-        if(isVerticesFixed[i1] == 0) estimatedPositions[i1] -= (w1/wSum) * deltaLength * deltaPNormalized * 0.25f;// * 0.01 is STIFFNESS;
-        if(isVerticesFixed[i2] == 0) estimatedPositions[i2] += (w2/wSum) * deltaLength * deltaPNormalized * 0.25f;// * STIFFNESS;
+        return cols;
     }
 };
     
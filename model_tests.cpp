@@ -0,0 +1,196 @@
+#include "regression_tests.h"
+#include "tissue_model.h"
+
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+namespace
+{
+    void writeText(const std::string& path, const std::string& text)
+    {
+        std::ofstream out(path, std::ios::binary);
+        out << text;
+    }
+
+    void removeModel(const std::vector<std::string>& paths)
+    {
+        for (const std::string& path : paths)
+        {
+            std::remove(path.c_str());
+            std::remove(TissueModel::getCachePath(path).c_str());
+        }
+    }
+
+    bool loadModel(TissueModel& model, const std::string& path, bool useCache)
+    {
+        if (model.load(path, useCache)) return true;
+        std::cout << "FAIL cannot load " << path << ": " << model.getError() << std::endl;
+        return false;
+    }
+
+    // the used vertices in file order, every index in range, edge and triangle counts as expected
+    bool expectModel(const TissueModel& model, const std::string& what, const std::vector<glm::vec3>& positions, int edgeCount, int triangleCount)
+    {
+        bool pass = model.getVertexCount() == (int)positions.size() && model.getEdgeCount() == edgeCount && model.getTriangleCount() == triangleCount;
+        for (int i = 0; pass && i < model.getVertexCount(); i++) pass = model.positions.get(i) == positions[i];
+        for (unsigned int index : model.triangles) pass &= index < positions.size();
+        for (int e = 0; e < model.getEdgeCount(); e++)
+        {
+            pass &= model.edgeFirst[e] < model.edgeSecond[e] && model.edgeSecond[e] < (int)positions.size();
+        }
+        if (!pass)
+        {
+            std::cout << "FAIL " << what << ": " << model.getVertexCount() << " vertices, " << model.getEdgeCount() << " edges, "
+                      << model.getTriangleCount() << " triangles, expected " << positions.size() << ", " << edgeCount << ", " << triangleCount << std::endl;
+        }
+        return pass;
+    }
+
+    // a unit quad with a stray point before and after it
+    const char* QUAD_OBJ = "# quad\n"
+                           "v 9 9 9\n"
+                           "v 0 0 0\n"
+                           "v 1 0 0\n"
+                           "v 1 1 0\n"
+                           "v 0 1 0\n"
+                           "v 8 8 8\n"
+                           "f 2 3 4 -2\n";
+    const std::vector<glm::vec3> QUAD = { glm::vec3(0, 0, 0), glm::vec3(1, 0, 0), glm::vec3(1, 1, 0), glm::vec3(0, 1, 0) };
+}
+
+// model-obj: a fanned quad keeps its 4 vertices, the stray ones are removed and the face renumbered
+int testModelObj()
+{
+    const std::string path = "regression_model.obj";
+    writeText(path, QUAD_OBJ);
+    TissueModel model;
+    bool pass = loadModel(model, path, false) && expectModel(model, "obj", QUAD, 5, 2);
+    pass = pass && model.triangles == std::vector<unsigned int>{ 0, 1, 2, 0, 2, 3 };
+    removeModel({ path });
+    return pass ? 0 : 1;
+}
+
+// model-ply: the same quad in ascii PLY, with an unused vertex between the used ones
+int testModelPly()
+{
+    const std::string path = "regression_model.ply";
+    writeText(path, "ply\n"
+                    "format ascii 1.0\n"
+                    "element vertex 5\n"
+                    "property float x\n"
+                    "property float y\n"
+                    "property float z\n"
+                    "element face 1\n"
+                    "property list uchar int vertex_indices\n"
+                    "end_header\n"
+                    "0 0 0\n"
+                    "1 0 0\n"
+                    "7 7 7\n"
+                    "1 1 0\n"
+                    "0 1 0\n"
+                    "4 0 1 3 4\n");
+    TissueModel model;
+    bool pass = loadModel(model, path, false) && expectModel(model, "ply", QUAD, 5, 2);
+    pass = pass && model.triangles == std::vector<unsigned int>{ 0, 1, 2, 0, 2, 3 };
+    removeModel({ path });
+    return pass ? 0 : 1;
+}
+
+// model-tetgen: one 10-node tet, 1-based; the six mid-edge nodes are removed, the corners keep their 6 edges
+// and the 4 faces wound outward
+int testModelTetGen()
+{
+    const std::string base = "regression_model";
+    writeText(base + ".node", "10 3 0 0\n"
+                              "1 0 0 0\n"
+                              "2 0.5 0 0\n"
+                              "3 1 0 0\n"
+                              "4 0.5 0.5 0\n"
+                              "5 0 1 0\n"
+                              "6 0 0.5 0\n"
+                              "7 0 0 0.5\n"
+                              "8 0.5 0 0.5\n"
+                              "9 0 0.5 0.5\n"
+                              "10 0 0 1\n");
+    writeText(base + ".ele", "1 10 0\n"
+                             "1 1 3 5 10 2 4 6 7 8 9\n");
+    TissueModel model;
+    const std::vector<glm::vec3> corners = { glm::vec3(0, 0, 0), glm::vec3(1, 0, 0), glm::vec3(0, 1, 0), glm::vec3(0, 0, 1) };
+    bool pass = loadModel(model, base + ".ele", false) && expectModel(model, "tetgen", corners, 6, 4);
+    for (int t = 0; pass && t < model.getTriangleCount(); t++)
+    {
+        glm::vec3 a = model.positions.get(model.triangles[t * 3]), b = model.positions.get(model.triangles[t * 3 + 1]);
+        glm::vec3 c = model.positions.get(model.triangles[t * 3 + 2]);
+        glm::vec3 centroid = (corners[0] + corners[1] + corners[2] + corners[3]) * 0.25f;
+        if (glm::dot(glm::cross(b - a, c - a), a - centroid) <= 0.0f)
+        {
+            std::cout << "FAIL tetgen: face " << t << " points inward" << std::endl;
+            pass = false;
+        }
+    }
+    removeModel({ base + ".node", base + ".ele" });
+    return pass ? 0 : 1;
+}
+
+// model-cache: the second load maps the cache the first one wrote and gives the same model
+int testModelCache()
+{
+    const std::string path = "regression_cached.obj";
+    removeModel({ path });
+    writeText(path, QUAD_OBJ);
+    TissueModel parsed, cached;
+    bool pass = loadModel(parsed, path, true) && loadModel(cached, path, true);
+    if (pass && (parsed.isFromCache() || !cached.isFromCache()))
+    {
+        std::cout << "FAIL the first load came from the cache or the second did not" << std::endl;
+        pass = false;
+    }
+    pass = pass && expectModel(cached, "cached", QUAD, 5, 2) && cached.triangles == parsed.triangles
+           && cached.edgeFirst == parsed.edgeFirst && cached.edgeSecond == parsed.edgeSecond;
+    removeModel({ path });
+    return pass ? 0 : 1;
+}
+
+// model-cache-stale: a cache is not used once its source changes or its file is damaged
+int testModelCacheStale()
+{
+    const std::string path = "regression_stale.obj";
+    removeModel({ path });
+    writeText(path, QUAD_OBJ);
+    TissueModel model;
+    bool pass = loadModel(model, path, true);
+
+    // one triangle instead of the quad, a different size whatever the clock resolution
+    writeText(path, "v 0 0 0\nv 1 0 0\nv 0 1 0\nf 1 2 3\n");
+    pass = pass && loadModel(model, path, true);
+    if (pass && (model.isFromCache() || model.getVertexCount() != 3))
+    {
+        std::cout << "FAIL the cache of the quad was used for the triangle" << std::endl;
+        pass = false;
+    }
+
+    // the reload wrote a fresh cache; cut it short
+    std::string cachePath = TissueModel::getCachePath(path);
+    std::ifstream in(cachePath, std::ios::binary);
+    std::string image((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    in.close();
+    writeText(cachePath, image.substr(0, image.size() / 2));
+    pass = pass && loadModel(model, path, true);
+    if (pass && (model.isFromCache() || model.getVertexCount() != 3))
+    {
+        std::cout << "FAIL a truncated cache was used" << std::endl;
+        pass = false;
+    }
+    removeModel({ path });
+    return pass ? 0 : 1;
+}
+
+static RegressionCase modelObj("model-obj", testModelObj);
+static RegressionCase modelPly("model-ply", testModelPly);
+static RegressionCase modelTetGen("model-tetgen", testModelTetGen);
+static RegressionCase modelCache("model-cache", testModelCache);
+static RegressionCase modelCacheStale("model-cache-stale", testModelCacheStale);
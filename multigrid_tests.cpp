@@ -0,0 +1,63 @@
+#include "regression_tests.h"
+
+#include <cmath>
+#include <iostream>
+#include <string>
+
+namespace
+{
+    const int MULTIGRID_EDGE_COUNT = 64;
+    const int CYCLES = 8;
+
+    // a sheet whose estimated positions are bent out of shape along its whole width, the error one sweep barely moves
+    void bend(Tissue& tissue)
+    {
+        for (int i = 0; i < tissue.getVertexCount(); i++)
+        {
+            glm::vec3 p = tissue.positions.get(i);
+            if (!tissue.isVertexFixed(i)) p += glm::vec3(0.0f, 0.3f * std::sin(3.14159f * p.x), 0.2f * std::sin(3.14159f * p.y));
+            tissue.estimatedPositions.set(i, p);
+        }
+        tissue.beginSubstep(DELTA_TIME / 20.0f);
+    }
+}
+
+// multigrid: every V-cycle lowers the residual of a sheet bent across its width, and 8 of them end below half the
+// residual of 4 flat sweeps per cycle (a V-cycle costs about 3.5)
+int testMultigrid()
+{
+    bool pass = true;
+    for (Integrator integrator : { Integrator::PBD, Integrator::XPBD })
+    {
+        std::string what = integrator == Integrator::XPBD ? "XPBD" : "PBD";
+        Tissue flat(MULTIGRID_EDGE_COUNT, 1, 0.001f, integrator);
+        Tissue multigrid(MULTIGRID_EDGE_COUNT, 1, 0.001f, integrator);
+        multigrid.setMultigridLevels(3);
+        bend(flat);
+        bend(multigrid);
+
+        float last = INFINITY;
+        ConstraintResidual cycled, swept;
+        for (int c = 0; c < CYCLES; c++)
+        {
+            cycled = multigrid.SolveAllStretchConstraints();
+            for (int s = 0; s < 4; s++) swept = flat.SolveAllStretchConstraints();
+            if (!(cycled.rms < last))
+            {
+                std::cout << "FAIL " << what << ": V-cycle " << c << " left the rms residual at " << cycled.rms << ", was " << last << std::endl;
+                pass = false;
+            }
+            last = cycled.rms;
+        }
+        std::cout << what << ": rms residual " << cycled.rms << " after " << CYCLES << " V-cycles, " << swept.rms << " after "
+                  << 4 * CYCLES << " sweeps" << std::endl;
+        if (!(cycled.rms * 2.0f < swept.rms) || !(cycled.max < swept.max))
+        {
+            std::cout << "FAIL " << what << ": the V-cycles converge no faster than flat sweeps" << std::endl;
+            pass = false;
+        }
+    }
+    return pass ? 0 : 1;
+}
+
+static RegressionCase multigrid("multigrid", testMultigrid);
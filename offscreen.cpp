@@ -0,0 +1,322 @@
+#include <glad/glad.h>
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+#include "mesh.h"
+#include "scene.h"
+#include "frame_capture.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
+
+// Offscreen batch renderer: no window system, works with Mesa llvmpipe on GPU-less nodes.
+// Steps the mesh, draws it into an FBO and streams every frame to a video file.
+// Usage: Offscreen [--edge N] [--frames N] [--threads N] [--width W] [--height H]
+//                  [--format y4m|raw] [--out file] [--no-capture] [--model file] [--order build|morton|rcm]
+//                  [--grid explicit|implicit] [--solver cpu|gpu|processes] [--check-cpu] [--sleep velocity residual] [--patches N]
+//                  [--vertex-format float|compact|half|snorm16]
+// --model imports an .obj, .ply or TetGen .node/.ele instead of the grid, pinned along its top.
+// --solver gpu steps the mesh with compute shaders (GL 4.3) and draws from the solver's buffer.
+// --solver processes steps it on 2 x 2 worker processes (DomainSolver) and uploads the gathered positions.
+// --check-cpu steps a CPU Tissue alongside and prints how far the mesh drifted from it once a second.
+// --sleep sets Tissue::sleepVelocity and sleepResidual, then only the ranges that changed are uploaded.
+// --patches lays out N shrunk copies of the grid or model in one Scene: one solver pass and one draw call for all.
+// --vertex-format picks the GPU vertex layout (VertexFormat); the run ends with the position bytes uploaded per frame
+// and the size of the vertex and index buffers.
+
+// settings
+const unsigned int EDGE_COUNT = 40;
+const unsigned int MAX_EDGE_WIDTH = 1;
+const unsigned int FRAMES = 600;
+const unsigned int SOLVER_THREADS = 1;
+const unsigned int SCR_WIDTH = 800;
+const unsigned int SCR_HEIGHT = 600;
+const unsigned int FPS = 60;
+const float MODEL_PIN_BAND = 0.02f;
+
+// EGL surfaceless display when the platform extension is there (Mesa), else the default display with a pbuffer.
+// compute asks for 4.3 first, for the GPU solver.
+// ---------------------------------------------------------------------------------------------------------
+bool createContext(EGLDisplay& display, EGLSurface& surface, EGLContext& context, bool compute)
+{
+    const char* clientExtensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+    bool surfaceless = clientExtensions && std::strstr(clientExtensions, "EGL_MESA_platform_surfaceless");
+
+    display = EGL_NO_DISPLAY;
+    if (surfaceless)
+    {
+        PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+        if (getPlatformDisplay) display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+    }
+    if (display == EGL_NO_DISPLAY)
+    {
+        surfaceless = false;
+        display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    }
+    if (display == EGL_NO_DISPLAY || !eglInitialize(display, nullptr, nullptr))
+    {
+        std::cout << "Failed to initialize EGL" << std::endl;
+        return false;
+    }
+    eglBindAPI(EGL_OPENGL_API);
+
+    const EGLint configAttributes[] = {
+        EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+        EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+        EGL_RED_SIZE, 8, EGL_GREEN_SIZE, 8, EGL_BLUE_SIZE, 8,
+        EGL_NONE
+    };
+    EGLConfig config = nullptr;
+    EGLint configCount = 0;
+    eglChooseConfig(display, configAttributes, &config, 1, &configCount);
+    if (configCount == 0 && !surfaceless)
+    {
+        std::cout << "No EGL config with pbuffer support" << std::endl;
+        return false;
+    }
+
+    const EGLint versions[2][2] = { { 4, 3 }, { 3, 3 } };
+    context = EGL_NO_CONTEXT;
+    for (int v = compute ? 0 : 1; v < 2 && context == EGL_NO_CONTEXT; v++)
+    {
+        const EGLint contextAttributes[] = {
+            EGL_CONTEXT_MAJOR_VERSION, versions[v][0],
+            EGL_CONTEXT_MINOR_VERSION, versions[v][1],
+            EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+            EGL_NONE
+        };
+        context = eglCreateContext(display, configCount ? config : nullptr, EGL_NO_CONTEXT, contextAttributes);
+    }
+    if (context == EGL_NO_CONTEXT)
+    {
+        std::cout << "Failed to create a GL 3.3 core context" << std::endl;
+        return false;
+    }
+
+    // everything is drawn into our own FBO, the pbuffer only exists to make the context current
+    surface = EGL_NO_SURFACE;
+    if (!surfaceless)
+    {
+        const EGLint pbufferAttributes[] = { EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE };
+        surface = eglCreatePbufferSurface(display, config, pbufferAttributes);
+    }
+    if (!eglMakeCurrent(display, surface, surface, context))
+    {
+        std::cout << "Failed to make the EGL context current" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char** argv)
+{
+    int edgeCount = EDGE_COUNT;
+    int frames = FRAMES;
+    int threads = SOLVER_THREADS;
+    int width = SCR_WIDTH;
+    int height = SCR_HEIGHT;
+    VideoFormat format = VideoFormat::Y4M;
+    std::string outPath, modelPath;
+    bool capture = true;
+    VertexOrder order = VertexOrder::Build;
+    GridConstraints constraints = GridConstraints::Explicit;
+    SolverBackend backend = SolverBackend::CPU;
+    bool checkCpu = false;
+    float sleepVelocity = 0.0f, sleepResidual = 0.0f;
+    int patches = 0;
+    VertexFormat vertexFormat = VertexFormat::Float;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (std::strcmp(argv[i], "--edge") == 0 && i + 1 < argc) edgeCount = std::atoi(argv[++i]);
+        else if (std::strcmp(argv[i], "--frames") == 0 && i + 1 < argc) frames = std::atoi(argv[++i]);
+        else if (std::strcmp(argv[i], "--threads") == 0 && i + 1 < argc) threads = std::atoi(argv[++i]);
+        else if (std::strcmp(argv[i], "--width") == 0 && i + 1 < argc) width = std::atoi(argv[++i]);
+        else if (std::strcmp(argv[i], "--height") == 0 && i + 1 < argc) height = std::atoi(argv[++i]);
+        else if (std::strcmp(argv[i], "--format") == 0 && i + 1 < argc && std::strcmp(argv[i + 1], "raw") == 0) { format = VideoFormat::Raw; i++; }
+        else if (std::strcmp(argv[i], "--format") == 0 && i + 1 < argc && std::strcmp(argv[i + 1], "y4m") == 0) { format = VideoFormat::Y4M; i++; }
+        else if (std::strcmp(argv[i], "--out") == 0 && i + 1 < argc) outPath = argv[++i];
+        else if (std::strcmp(argv[i], "--no-capture") == 0) capture = false;
+        else if (std::strcmp(argv[i], "--model") == 0 && i + 1 < argc) modelPath = argv[++i];
+        else if (std::strcmp(argv[i], "--order") == 0 && i + 1 < argc && std::strcmp(argv[i + 1], "morton") == 0) { order = VertexOrder::Morton; i++; }
+        else if (std::strcmp(argv[i], "--order") == 0 && i + 1 < argc && std::strcmp(argv[i + 1], "rcm") == 0) { order = VertexOrder::RCM; i++; }
+        else if (std::strcmp(argv[i], "--order") == 0 && i + 1 < argc && std::strcmp(argv[i + 1], "build") == 0) { order = VertexOrder::Build; i++; }
+        else if (std::strcmp(argv[i], "--grid") == 0 && i + 1 < argc && std::strcmp(argv[i + 1], "implicit") == 0) { constraints = GridConstraints::Implicit; i++; }
+        else if (std::strcmp(argv[i], "--grid") == 0 && i + 1 < argc && std::strcmp(argv[i + 1], "explicit") == 0) { constraints = GridConstraints::Explicit; i++; }
+        else if (std::strcmp(argv[i], "--solver") == 0 && i + 1 < argc && std::strcmp(argv[i + 1], "gpu") == 0) { backend = SolverBackend::GPU; i++; }
+        else if (std::strcmp(argv[i], "--solver") == 0 && i + 1 < argc && std::strcmp(argv[i + 1], "cpu") == 0) { backend = SolverBackend::CPU; i++; }
+        else if (std::strcmp(argv[i], "--solver") == 0 && i + 1 < argc && std::strcmp(argv[i + 1], "processes") == 0) { backend = SolverBackend::Processes; i++; }
+        else if (std::strcmp(argv[i], "--check-cpu") == 0) checkCpu = true;
+        else if (std::strcmp(argv[i], "--sleep") == 0 && i + 2 < argc)
+        {
+            sleepVelocity = (float)std::atof(argv[++i]);
+            sleepResidual = (float)std::atof(argv[++i]);
+        }
+        else if (std::strcmp(argv[i], "--patches") == 0 && i + 1 < argc) patches = std::atoi(argv[++i]);
+        else if (std::strcmp(argv[i], "--vertex-format") == 0 && i + 1 < argc && std::strcmp(argv[i + 1], "float") == 0) { vertexFormat = VertexFormat::Float; i++; }
+        else if (std::strcmp(argv[i], "--vertex-format") == 0 && i + 1 < argc && std::strcmp(argv[i + 1], "compact") == 0) { vertexFormat = VertexFormat::Compact; i++; }
+        else if (std::strcmp(argv[i], "--vertex-format") == 0 && i + 1 < argc && std::strcmp(argv[i + 1], "half") == 0) { vertexFormat = VertexFormat::CompactHalf; i++; }
+        else if (std::strcmp(argv[i], "--vertex-format") == 0 && i + 1 < argc && std::strcmp(argv[i + 1], "snorm16") == 0) { vertexFormat = VertexFormat::CompactSnorm16; i++; }
+        else
+        {
+            std::cout << "Usage: " << argv[0] << " [--edge N] [--frames N] [--threads N] [--width W] [--height H] [--format y4m|raw] [--out file] [--no-capture] [--model file] [--order build|morton|rcm] [--grid explicit|implicit] [--solver cpu|gpu|processes] [--check-cpu] [--sleep velocity residual] [--patches N] [--vertex-format float|compact|half|snorm16]" << std::endl;
+            return -1;
+        }
+    }
+    if (edgeCount < 2 || frames < 1 || threads < 1 || width < 1 || height < 1 || patches < 0)
+    {
+        std::cout << "edgeCount >= 2, frames, threads, width and height >= 1, patches >= 0" << std::endl;
+        return -1;
+    }
+    if (outPath.empty()) outPath = format == VideoFormat::Y4M ? "tissue.y4m" : "tissue.rgba";
+
+    EGLDisplay display;
+    EGLSurface surface;
+    EGLContext context;
+    if (!createContext(display, surface, context, backend == SolverBackend::GPU)) return -1;
+
+    if (!gladLoadGLLoader((GLADloadproc)eglGetProcAddress))
+    {
+        std::cout << "Failed to initialize GLAD" << std::endl;
+        return -1;
+    }
+    std::cout << "GL " << glGetString(GL_VERSION) << " on " << glGetString(GL_RENDERER) << std::endl;
+
+    // color target
+    unsigned int framebuffer, colorbuffer;
+    glGenFramebuffers(1, &framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glGenRenderbuffers(1, &colorbuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, colorbuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colorbuffer);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+    {
+        std::cout << "Framebuffer incomplete" << std::endl;
+        return -1;
+    }
+    glViewport(0, 0, width, height);
+    glReadBuffer(GL_COLOR_ATTACHMENT0);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+
+    TissueModel model;
+    if (!modelPath.empty())
+    {
+        if (!model.load(modelPath))
+        {
+            std::cout << "Cannot import " << modelPath << ": " << model.getError() << std::endl;
+            return -1;
+        }
+        model.fixTopVertices(MODEL_PIN_BAND);
+    }
+    // patches: one source, copies side by side in a square layout filling the viewport
+    std::unique_ptr<Tissue> patchSource;
+    std::vector<TissueInstance> instances;
+    if (patches > 0)
+    {
+        patchSource.reset(modelPath.empty() ? new Tissue(edgeCount, MAX_EDGE_WIDTH, 0.001f, Integrator::PBD, order, constraints)
+                                            : new Tissue(model, 0.001f, Integrator::PBD, order));
+        int columns = (int)std::ceil(std::sqrt((float)patches));
+        float cell = 2.0f / columns;
+        for (int p = 0; p < patches; p++)
+        {
+            glm::vec3 offset(-1.0f + (p % columns + 0.5f) * cell, 1.0f - (p / columns + 0.5f) * cell, 0.0f);
+            instances.push_back({ patchSource.get(), offset, 0.6f * cell / MAX_EDGE_WIDTH });
+        }
+    }
+    std::unique_ptr<Mesh> owned(patches > 0
+        ? new Scene(instances, "../shaders/VertexShader.vert", "../shaders/FragmentShader.frag", PositionUpload::Auto, vertexFormat)
+        : modelPath.empty()
+        ? new Mesh(edgeCount, MAX_EDGE_WIDTH, "../shaders/VertexShader.vert", "../shaders/FragmentShader.frag", 0.001f, Integrator::PBD, PositionUpload::Auto, order, constraints, vertexFormat)
+        : new Mesh(model, "../shaders/VertexShader.vert", "../shaders/FragmentShader.frag", 0.001f, Integrator::PBD, PositionUpload::Auto, order, vertexFormat));
+    Mesh& mesh = *owned;
+    if (patches > 0) std::cout << patches << " patches, " << mesh.getVertexCount() << " vertices" << std::endl;
+    mesh.setThreadCount(threads);
+    mesh.sleepVelocity = sleepVelocity;
+    mesh.sleepResidual = sleepResidual;
+    if (backend != SolverBackend::CPU && !mesh.setSolverBackend(backend, "../shaders/")) return -1;
+    std::cout << "Solving on the " << (mesh.getSolverBackend() == SolverBackend::GPU ? "GPU"
+                                       : mesh.getSolverBackend() == SolverBackend::Processes ? "worker processes" : "CPU") << std::endl;
+
+    // same build, always on the CPU
+    std::unique_ptr<Tissue> reference;
+    if (checkCpu)
+    {
+        reference.reset(patches > 0 ? new Tissue(instances)
+                        : modelPath.empty() ? new Tissue(edgeCount, MAX_EDGE_WIDTH, 0.001f, Integrator::PBD, order, constraints)
+                        : new Tissue(model, 0.001f, Integrator::PBD, order));
+        reference->setThreadCount(threads);
+        reference->sleepVelocity = sleepVelocity;
+        reference->sleepResidual = sleepResidual;
+    }
+
+    {
+        std::unique_ptr<VideoWriter> writer;
+        std::unique_ptr<FrameCapture> frameCapture;
+        if (capture)
+        {
+            writer.reset(new VideoWriter(outPath, width, height, FPS, format));
+            if (!writer->isOpen()) return -1;
+            frameCapture.reset(new FrameCapture(width, height, *writer));
+        }
+
+        // render loop, fixed timestep
+        // ---------------------------
+        auto start = std::chrono::steady_clock::now();
+        for (int frame = 0; frame < frames; frame++)
+        {
+            mesh.step(1.0f / FPS, glm::vec3(0.0f, -0.5f, 0.0f));
+            mesh.updatePositions();
+            if (reference)
+            {
+                reference->step(1.0f / FPS, glm::vec3(0.0f, -0.5f, 0.0f));
+                if ((frame + 1) % FPS == 0 || frame + 1 == frames)
+                {
+                    mesh.syncFromGpu();
+                    float drift = 0.0f;
+                    for (int i = 0; i < mesh.getVertexCount(); i++)
+                        drift = std::max(drift, glm::length(mesh.positions.get(i) - reference->positions.get(i)));
+                    std::cout << "frame " << frame + 1 << ": max |mesh - cpu| = " << drift << std::endl;
+                }
+            }
+
+            glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
+            glClear(GL_COLOR_BUFFER_BIT);
+            mesh.draw();
+            if (frameCapture) frameCapture->capture();
+        }
+        if (frameCapture) frameCapture->finish();
+        glFinish();
+        auto end = std::chrono::steady_clock::now();
+
+        double seconds = std::chrono::duration<double>(end - start).count();
+        std::cout << frames << " frames in " << seconds << " s: " << frames / seconds << " frames/sec";
+        if (writer)
+        {
+            // the writer may still be converting the last queued frames
+            uint64_t stalls = writer->getStalls();
+            frameCapture.reset();
+            writer.reset();
+            double total = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            std::cout << ", " << total << " s until " << outPath << " was complete, " << stalls << " writer stalls";
+        }
+        std::cout << std::endl;
+        std::cout << "vertex and index buffers " << mesh.getBufferBytes() << " bytes, positions uploaded "
+                  << mesh.getUploadedBytes() / frames << " bytes/frame" << std::endl;
+    }
+
+    mesh.deleteArraysAndBuffers();
+    glDeleteRenderbuffers(1, &colorbuffer);
+    glDeleteFramebuffers(1, &framebuffer);
+    eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    if (surface != EGL_NO_SURFACE) eglDestroySurface(display, surface);
+    eglDestroyContext(display, context);
+    eglTerminate(display);
+    return 0;
+}
@@ -0,0 +1,225 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <iomanip>
+#include <string>
+#include <vector>
+
+// stages the profiler knows about; the simulation ones are recorded by Tissue::step
+enum class Stage : uint8_t
+{
+    AddGravity,
+    ApplyDamping,
+    UpdateEstimatedPositions,
+    SelfCollision,
+    SolveConstraints,
+    UpdateVelocitiesAndPositions,
+    UpdatePositions,
+    Draw,
+    Count
+};
+
+const char* const STAGE_NAMES[] = {
+    "addGravity",
+    "applyDamping",
+    "updateEstimatedPositions",
+    "findCollisionPairs",
+    "SolveAllStretchConstraints",
+    "updateVelocitiesAndPositions",
+    "updatePositions",
+    "draw"
+};
+
+const int STAGE_COUNT = (int)Stage::Count;
+const int PROFILER_MAX_EVENTS = 128;  // stage events kept per frame, later ones are dropped
+const int PROFILER_MAX_SWEEPS = 128;  // residual samples kept per frame
+
+struct ProfileEvent
+{
+    Stage stage;
+    double start;       // seconds since the profiler was created
+    double duration;    // seconds
+};
+
+// residual of one SolveAllStretchConstraints sweep: max and RMS of |currentLength - restLength|
+struct ResidualSample
+{
+    double time;
+    float max;
+    float rms;
+};
+
+struct FrameRecord
+{
+    uint64_t index;
+    double start;
+    double duration;
+    double stageTotal[STAGE_COUNT];
+    int eventCount;
+    ProfileEvent events[PROFILER_MAX_EVENTS];
+    int sweepCount;
+    ResidualSample residuals[PROFILER_MAX_SWEEPS];
+};
+
+/*
+    Profiler
+        fixed-size ring of FrameRecords, allocated once
+        beginFrame / endFrame around a frame, ProfileScope around a stage
+        recordResidual after every constraint sweep
+        export as Chrome trace JSON (chrome://tracing, Perfetto) or CSV
+    Not thread-safe: record from one thread at a time.
+*/
+class Profiler
+{
+    public:
+    explicit Profiler(int frameCapacity = 600)
+        : frames(frameCapacity), origin(std::chrono::steady_clock::now())
+    {
+    }
+
+    double now() const
+    {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - origin).count();
+    }
+
+    void beginFrame()
+    {
+        current = &frames[frameCount % frames.size()];
+        current->index = frameCount;
+        current->start = now();
+        current->duration = 0.0;
+        for (int s = 0; s < STAGE_COUNT; s++) current->stageTotal[s] = 0.0;
+        current->eventCount = 0;
+        current->sweepCount = 0;
+    }
+
+    void endFrame()
+    {
+        if (!current) return;
+        current->duration = now() - current->start;
+        current = nullptr;
+        frameCount++;
+    }
+
+    void recordStage(Stage stage, double start, double end)
+    {
+        if (!current) return;
+        current->stageTotal[(int)stage] += end - start;
+        if (current->eventCount < PROFILER_MAX_EVENTS) current->events[current->eventCount++] = { stage, start, end - start };
+    }
+
+    void recordResidual(float max, float rms)
+    {
+        if (!current || current->sweepCount >= PROFILER_MAX_SWEEPS) return;
+        current->residuals[current->sweepCount++] = { now(), max, rms };
+    }
+
+    // completed frames currently held, oldest first through getFrame(0)
+    int getFrameCount() const { return (int)std::min<uint64_t>(frameCount, frames.size()); }
+    const FrameRecord& getFrame(int i) const
+    {
+        uint64_t first = frameCount - getFrameCount();
+        return frames[(first + i) % frames.size()];
+    }
+
+    bool writeChromeTrace(const std::string& path) const
+    {
+        std::ofstream out(path);
+        if (!out) return false;
+
+        // timestamps in microseconds since the profiler started: fixed to the ns, the default 6 significant digits would round
+        // them to 100 us after 10 s of running. Residuals keep 6 significant digits however small they get
+        out << std::fixed << std::setprecision(3);
+        out << "{\"traceEvents\":[\n";
+        out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,\"args\":{\"name\":\"simulation\"}}";
+        for (int f = 0; f < getFrameCount(); f++)
+        {
+            const FrameRecord& frame = getFrame(f);
+            out << ",\n{\"name\":\"frame " << frame.index << "\",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":" << frame.start * 1e6
+                << ",\"dur\":" << frame.duration * 1e6 << "}";
+            for (int e = 0; e < frame.eventCount; e++)
+            {
+                const ProfileEvent& event = frame.events[e];
+                out << ",\n{\"name\":\"" << STAGE_NAMES[(int)event.stage] << "\",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":"
+                    << event.start * 1e6 << ",\"dur\":" << event.duration * 1e6 << "}";
+            }
+            for (int r = 0; r < frame.sweepCount; r++)
+            {
+                const ResidualSample& residual = frame.residuals[r];
+                out << ",\n{\"name\":\"residual\",\"ph\":\"C\",\"pid\":1,\"ts\":" << residual.time * 1e6
+                    << std::scientific << std::setprecision(5) << ",\"args\":{\"max\":" << residual.max << ",\"rms\":" << residual.rms << "}}"
+                    << std::fixed << std::setprecision(3);
+            }
+        }
+        out << "\n]}\n";
+        return (bool)out;
+    }
+
+    // one row per frame: stage totals in ms, then max/rms residual of every sweep
+    bool writeCsv(const std::string& path) const
+    {
+        std::ofstream out(path);
+        if (!out) return false;
+
+        int sweeps = 0;
+        for (int f = 0; f < getFrameCount(); f++) sweeps = std::max(sweeps, getFrame(f).sweepCount);
+        out << std::fixed << std::setprecision(6); // ms to the ns, as in the trace
+
+        out << "frame,start_ms,frame_ms";
+        for (int s = 0; s < STAGE_COUNT; s++) out << "," << STAGE_NAMES[s] << "_ms";
+        out << ",sweeps";
+        for (int r = 0; r < sweeps; r++) out << ",residual_max_" << r << ",residual_rms_" << r;
+        out << "\n";
+
+        for (int f = 0; f < getFrameCount(); f++)
+        {
+            const FrameRecord& frame = getFrame(f);
+            out << frame.index << "," << frame.start * 1e3 << "," << frame.duration * 1e3;
+            for (int s = 0; s < STAGE_COUNT; s++) out << "," << frame.stageTotal[s] * 1e3;
+            out << "," << frame.sweepCount;
+            for (int r = 0; r < sweeps; r++)
+            {
+                if (r < frame.sweepCount)
+                {
+                    out << std::scientific << std::setprecision(5) << "," << frame.residuals[r].max << "," << frame.residuals[r].rms
+                        << std::fixed << std::setprecision(6);
+                }
+                else out << ",,";
+            }
+            out << "\n";
+        }
+        return (bool)out;
+    }
+
+    private:
+    std::vector<FrameRecord> frames;
+    std::chrono::steady_clock::time_point origin;
+    uint64_t frameCount = 0;
+    FrameRecord* current = nullptr;
+};
+
+// times the enclosing block as one stage event; no-op without a profiler
+class ProfileScope
+{
+    public:
+    ProfileScope(Profiler* profiler, Stage stage)
+        : profiler(profiler), stage(stage), start(profiler ? profiler->now() : 0.0)
+    {
+    }
+
+    ~ProfileScope()
+    {
+        if (profiler) profiler->recordStage(stage, start, profiler->now());
+    }
+
+    private:
+    Profiler* profiler;
+    Stage stage;
+    double start;
+};
+
+#endif
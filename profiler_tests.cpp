@@ -0,0 +1,85 @@
+#include "regression_tests.h"
+#include "profiler.h"
+
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <regex>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace
+{
+    std::string readFile(const std::string& path)
+    {
+        std::ifstream in(path);
+        std::stringstream contents;
+        contents << in.rdbuf();
+        return contents.str();
+    }
+}
+
+// profiler-export: stage events 1 us apart, three hours into a run, keep their own timestamps in the trace, and
+// residuals far below the timestamps' precision survive both exports
+int testProfilerExport()
+{
+    const double LATE = 3.0 * 3600.0; // seconds since the profiler started
+    const double starts[] = { LATE + 1e-6, LATE + 2e-6, LATE + 3e-6 };
+    Profiler profiler(4);
+    profiler.beginFrame();
+    for (double start : starts) profiler.recordStage(Stage::AddGravity, start, start + 0.5e-6);
+    profiler.recordResidual(1.25e-9f, 2.5e-10f);
+    profiler.endFrame();
+
+    const std::string tracePath = "regression_profile.json", csvPath = "regression_profile.csv";
+    if (!profiler.writeChromeTrace(tracePath) || !profiler.writeCsv(csvPath))
+    {
+        std::cout << "FAIL cannot write the exports" << std::endl;
+        return 1;
+    }
+    std::string trace = readFile(tracePath), csv = readFile(csvPath);
+    std::remove(tracePath.c_str());
+    std::remove(csvPath.c_str());
+
+    bool pass = true;
+    std::regex stageEvent("\"name\":\"addGravity\",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":([^,]+),\"dur\":([^}]+)\\}");
+    int e = 0;
+    for (std::sregex_iterator m(trace.begin(), trace.end(), stageEvent), end; m != end; ++m, e++)
+    {
+        double ts = std::stod((*m)[1]), dur = std::stod((*m)[2]);
+        if (e < 3 && (std::fabs(ts - starts[e] * 1e6) > 0.01 || std::fabs(dur - 0.5) > 0.01))
+        {
+            std::cout << std::fixed << "FAIL event " << e << " at ts " << (*m)[1] << " dur " << (*m)[2] << ", expected " << starts[e] * 1e6 << " dur 0.5" << std::endl;
+            pass = false;
+        }
+    }
+    if (e != 3)
+    {
+        std::cout << "FAIL " << e << " addGravity events in the trace, expected 3" << std::endl;
+        pass = false;
+    }
+
+    std::smatch residual;
+    if (!std::regex_search(trace, residual, std::regex("\"max\":([^,]+),\"rms\":([^}]+)\\}"))
+        || std::fabs(std::stod(residual[1]) / 1.25e-9 - 1.0) > 1e-5 || std::fabs(std::stod(residual[2]) / 2.5e-10 - 1.0) > 1e-5)
+    {
+        std::cout << "FAIL the trace residual is lost" << std::endl;
+        pass = false;
+    }
+
+    // one frame row: frame, start_ms, frame_ms, the stage totals, sweeps, then max and rms of the sweep
+    std::vector<std::string> fields;
+    std::stringstream row(csv.substr(csv.find('\n') + 1));
+    for (std::string field; std::getline(row, field, ',');) fields.push_back(field);
+    if (fields.size() != (size_t)(3 + STAGE_COUNT + 3) || std::fabs(std::stod(fields[3]) - 1.5e-3) > 1e-6
+        || std::fabs(std::stod(fields[4 + STAGE_COUNT]) / 1.25e-9 - 1.0) > 1e-5)
+    {
+        std::cout << "FAIL the csv row is wrong: " << csv.substr(csv.find('\n') + 1);
+        pass = false;
+    }
+    return pass ? 0 : 1;
+}
+
+static RegressionCase profilerExport("profiler-export", testProfilerExport);
@@ -0,0 +1,65 @@
+#include "regression_tests.h"
+
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace
+{
+    std::vector<std::pair<const char*, int (*)()>>& getCases()
+    {
+        static std::vector<std::pair<const char*, int (*)()>> cases; // filled during static initialization
+        return cases;
+    }
+}
+
+RegressionCase::RegressionCase(const char* name, int (*run)())
+{
+    getCases().push_back({ name, run });
+}
+
+int findDifference(const Tissue& a, const Tissue& b)
+{
+    if (a.getVertexCount() != b.getVertexCount()) return 0;
+    for (int i = 0; i < a.getVertexCount(); i++)
+    {
+        glm::vec3 pa = a.positions.get(i), pb = b.positions.get(i), va = a.velocities.get(i), vb = b.velocities.get(i);
+        if (std::memcmp(&pa, &pb, sizeof(pa)) != 0 || std::memcmp(&va, &vb, sizeof(va)) != 0) return i;
+    }
+    return -1;
+}
+
+bool expectSame(const Tissue& a, const Tissue& b, const std::string& what)
+{
+    int vertex = findDifference(a, b);
+    if (vertex < 0) return true;
+    glm::vec3 pa = a.positions.get(vertex), pb = b.positions.get(vertex);
+    std::cout << "FAIL " << what << ": vertex " << vertex << " at (" << pa.x << ", " << pa.y << ", " << pa.z << ") vs ("
+              << pb.x << ", " << pb.y << ", " << pb.z << ")" << std::endl;
+    return false;
+}
+
+void drag(Tissue& tissue, int step)
+{
+    int corner = tissue.getVertexIndex(0);
+    if (step < STEPS / 2)
+    {
+        tissue.positions.set(corner, tissue.positions.get(corner) + glm::vec3(0.0f, 0.0f, 0.005f));
+        tissue.setVertexFixed(corner, true);
+    }
+    else if (step == STEPS / 2) tissue.setVertexFixed(corner, false);
+}
+
+int main(int argc, char** argv)
+{
+    for (const std::pair<const char*, int (*)()>& c : getCases())
+    {
+        if (argc == 2 && std::strcmp(argv[1], c.first) == 0) return c.second();
+    }
+    std::cout << "Usage: " << argv[0] << " <case>, one of:";
+    for (const std::pair<const char*, int (*)()>& c : getCases()) std::cout << " " << c.first;
+    std::cout << std::endl;
+    return 1;
+}
@@ -0,0 +1,33 @@
+#ifndef REGRESSION_TESTS_H
+#define REGRESSION_TESTS_H
+
+#include "tissue.h"
+#include <glm/glm.hpp>
+
+#include <string>
+
+/*
+    RegressionTests (checks of the guarantees the solver documents, run by ctest, see CMakeLists.txt)
+        RegressionTests <case>: exit code 0 = pass, 1 = fail, SKIPPED = cannot run on this platform
+        every *_tests.cpp registers its cases with a static RegressionCase; ctest runs each case on its own
+        results are compared between two runs, never against stored numbers, so they hold at any SIMD width
+*/
+const int EDGE_COUNT = 40;
+const int STEPS = 60;
+const float DELTA_TIME = 1.0f / 60.0f;
+const glm::vec3 GRAVITY(0.0f, -0.5f, 0.0f);
+const int SKIPPED = 77;
+
+struct RegressionCase
+{
+    RegressionCase(const char* name, int (*run)());
+};
+
+// first vertex whose position or velocity differs by any bit, -1 when none
+int findDifference(const Tissue& a, const Tissue& b);
+// false, with the first difference printed, unless a and b are bit-identical
+bool expectSame(const Tissue& a, const Tissue& b, const std::string& what);
+// the same drag on every tissue: the free corner pulled out of the plane for STEPS / 2 steps, then let go
+void drag(Tissue& tissue, int step);
+
+#endif
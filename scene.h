@@ -0,0 +1,87 @@
+#ifndef SCENE_H
+#define SCENE_H
+
+#include <glad/glad.h>
+#include "mesh.h"
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <vector>
+
+/*
+    Scene (many tissue patches, one Tissue)
+        Tissue: every instance's vertices and constraints packed into shared arrays (see
+            Tissue(const std::vector<TissueInstance>&)), so step() is one solver pass for all of them
+        Vertices: one position VBO for every body, each body colored like its source
+        Indices: stored once per distinct source, bodies built from the same source share them (see VertexFormat)
+        draw: one glMultiDrawElementsBaseVertex, one range of the shared indices per body,
+            offset by the body's first vertex
+*/
+class Scene : public Mesh
+{
+    public:
+    // per body, in body order: the arguments of the multi-draw
+    std::vector<GLsizei> bodyIndexCounts;
+    std::vector<const void*> bodyIndexOffsets; // bytes into EBO
+    std::vector<GLint> bodyBaseVertices;
+    int topologyCount;  // index ranges in EBO, one per distinct source
+
+    // in the compact formats grids are drawn as strips when every source is a grid, and a 16-bit index
+    // only has to fit one source: the base vertex adds the body's offset
+    Scene(const std::vector<TissueInstance>& instances, const char* vertexPath, const char* fragmentPath,
+          PositionUpload upload=PositionUpload::Auto, VertexFormat format=VertexFormat::Float)
+        : Mesh(instances, vertexPath, fragmentPath, format, Deferred()), topologyCount(0)
+    {
+        bool strips = isCompact(format);
+        for(int b=0; b<getBodyCount(); b++) strips = strips && (getBodyBegin(b) == getBodyEnd(b) || instances[b].source->getEdgeCount() >= 2);
+
+        std::vector<unsigned int> indices;
+        std::vector<const Tissue*> topologies;
+        std::vector<size_t> topologyBegin, topologySize;
+        colors.resize(getVertexCount());
+        for(int b=0; b<getBodyCount(); b++)
+        {
+            // bodies the batch refused are empty, see Tissue(const std::vector<TissueInstance>&)
+            if (getBodyBegin(b) == getBodyEnd(b)) continue;
+            const Tissue* source = instances[b].source;
+
+            int topology = 0;
+            while (topology < (int)topologies.size() && topologies[topology] != source) topology++;
+            if (topology == (int)topologies.size())
+            {
+                std::vector<unsigned int> triangles = createIndices(*source, strips);
+                topologies.push_back(source);
+                topologyBegin.push_back(indices.size());
+                topologySize.push_back(triangles.size());
+                indices.insert(indices.end(), triangles.begin(), triangles.end());
+            }
+
+            std::vector<glm::vec3> sourceColors = createColors(*source);
+            std::copy(sourceColors.begin(), sourceColors.end(), colors.begin() + getBodyBegin(b));
+
+            bodyIndexCounts.push_back((GLsizei)topologySize[topology]);
+            bodyIndexOffsets.push_back((const void*)topologyBegin[topology]); // in indices until the index size is known
+            bodyBaseVertices.push_back(getBodyBegin(b));
+        }
+        topologyCount = (int)topologies.size();
+        createBuffers(upload, indices, strips ? GL_TRIANGLE_STRIP : GL_TRIANGLES);
+        size_t indexSize = indexType == GL_UNSIGNED_SHORT ? sizeof(uint16_t) : sizeof(uint32_t);
+        for (const void*& offset : bodyIndexOffsets) offset = (const void*)((size_t)offset * indexSize);
+    }
+
+    int getDrawCount() const { return (int)bodyIndexCounts.size(); }
+
+    void draw() override
+    {
+        shader.use();
+        glBindVertexArray(VAO);
+        bindPositions();
+        setPrimitiveRestart(true);
+        glMultiDrawElementsBaseVertex(indexMode, bodyIndexCounts.data(), indexType, bodyIndexOffsets.data(),
+                                      getDrawCount(), bodyBaseVertices.data());
+        setPrimitiveRestart(false);
+        fencePositions();
+    }
+};
+
+#endif
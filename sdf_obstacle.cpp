@@ -0,0 +1,359 @@
+#include "sdf_obstacle.h"
+#include "mapped_file.h"
+#include "simd.h"
+#include "thread_pool.h"
+#include "tissue_model.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <memory>
+
+namespace
+{
+    const uint32_t SDF_CACHE_ENDIAN_TAG = 0x01020304;
+    const int SDF_MAX_RESOLUTION = 200; // keeps every sample index exact in a float, see project
+    const float PI = 3.14159265358979f;
+
+    bool isLittleEndian()
+    {
+        uint32_t tag = SDF_CACHE_ENDIAN_TAG;
+        unsigned char first;
+        std::memcpy(&first, &tag, 1);
+        return first == 0x04;
+    }
+
+    // Ericson, Real-Time Collision Detection 5.1.5
+    glm::vec3 closestPointOnTriangle(glm::vec3 p, glm::vec3 a, glm::vec3 b, glm::vec3 c)
+    {
+        glm::vec3 ab = b - a, ac = c - a, ap = p - a;
+        float d1 = glm::dot(ab, ap), d2 = glm::dot(ac, ap);
+        if (d1 <= 0.0f && d2 <= 0.0f) return a;
+        glm::vec3 bp = p - b;
+        float d3 = glm::dot(ab, bp), d4 = glm::dot(ac, bp);
+        if (d3 >= 0.0f && d4 <= d3) return b;
+        float vc = d1 * d4 - d3 * d2;
+        if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f) return a + ab * (d1 / (d1 - d3));
+        glm::vec3 cp = p - c;
+        float d5 = glm::dot(ab, cp), d6 = glm::dot(ac, cp);
+        if (d6 >= 0.0f && d5 <= d6) return c;
+        float vb = d5 * d2 - d1 * d6;
+        if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f) return a + ac * (d2 / (d2 - d6));
+        float va = d3 * d6 - d5 * d4;
+        if (va <= 0.0f && d4 - d3 >= 0.0f && d5 - d6 >= 0.0f) return b + (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)));
+        float denominator = 1.0f / (va + vb + vc);
+        return a + ab * (vb * denominator) + ac * (vc * denominator);
+    }
+
+    // signed solid angle of triangle abc seen from the origin (Van Oosterom and Strackee)
+    float getSolidAngle(glm::vec3 a, glm::vec3 b, glm::vec3 c)
+    {
+        float la = glm::length(a), lb = glm::length(b), lc = glm::length(c);
+        float numerator = glm::dot(a, glm::cross(b, c));
+        float denominator = la * lb * lc + glm::dot(a, b) * lc + glm::dot(a, c) * lb + glm::dot(b, c) * la;
+        return 2.0f * std::atan2(numerator, denominator);
+    }
+}
+
+SdfObstacle::SdfObstacle()
+    : size(0), origin(0.0f), cellSize(0.0f), resolution(0), rotation(1.0f), translation(0.0f), poseVersion(0), fromCache(false)
+{
+}
+
+void SdfObstacle::allocate(glm::vec3 lower, glm::vec3 upper, int resolution)
+{
+    this->resolution = resolution;
+    resolution = std::max(2, std::min(resolution, SDF_MAX_RESOLUTION));
+    glm::vec3 extent = upper - lower;
+    float longest = std::max(1e-6f, std::max(extent.x, std::max(extent.y, extent.z)));
+    cellSize = longest / (resolution - 1);
+    origin = lower - glm::vec3(SDF_PADDING_CELLS * cellSize);
+    for (int a = 0; a < 3; a++) size[a] = (int)std::ceil(extent[a] / cellSize - 1e-4f) + 1 + 2 * SDF_PADDING_CELLS;
+    distances.assign((size_t)size.x * size.y * size.z, 0.0f);
+    error.clear();
+    fromCache = false;
+}
+
+template<typename F>
+void SdfObstacle::fill(F distance, ThreadPool* threadPool)
+{
+    auto fillSlice = [&](int z) {
+        size_t sample = (size_t)z * size.y * size.x;
+        for (int y = 0; y < size.y; y++)
+            for (int x = 0; x < size.x; x++) distances[sample++] = distance(origin + glm::vec3((float)x, (float)y, (float)z) * cellSize);
+    };
+    if (threadPool) threadPool->parallelFor(size.z, fillSlice);
+    else for (int z = 0; z < size.z; z++) fillSlice(z);
+}
+
+void SdfObstacle::bakeSphere(float radius, int resolution)
+{
+    allocate(glm::vec3(-radius), glm::vec3(radius), resolution);
+    fill([&](glm::vec3 p) { return glm::length(p) - radius; });
+}
+
+void SdfObstacle::bakeBox(glm::vec3 halfExtents, int resolution)
+{
+    allocate(-halfExtents, halfExtents, resolution);
+    fill([&](glm::vec3 p) {
+        glm::vec3 q = glm::abs(p) - halfExtents;
+        return glm::length(glm::max(q, glm::vec3(0.0f))) + std::min(std::max(q.x, std::max(q.y, q.z)), 0.0f);
+    });
+}
+
+void SdfObstacle::bakeCapsule(float halfLength, float radius, int resolution)
+{
+    allocate(glm::vec3(-radius, -halfLength - radius, -radius), glm::vec3(radius, halfLength + radius, radius), resolution);
+    fill([&](glm::vec3 p) { return glm::length(p - glm::vec3(0.0f, glm::clamp(p.y, -halfLength, halfLength), 0.0f)) - radius; });
+}
+
+// brute force over every triangle per sample: the bake is done once and cached. Samples are independent, so the
+// z-slices go to a pool and the grid is the same for any thread count
+void SdfObstacle::bakeTriangles(const Vec3Streams& vertices, const std::vector<unsigned int>& triangles, int resolution, int threadCount)
+{
+    glm::vec3 lower(0.0f), upper(0.0f);
+    if (vertices.size() > 0) lower = upper = vertices.get(0);
+    for (size_t i = 1; i < vertices.size(); i++)
+    {
+        lower = glm::min(lower, vertices.get((int)i));
+        upper = glm::max(upper, vertices.get((int)i));
+    }
+    allocate(lower, upper, resolution);
+
+    std::vector<glm::vec3> corners;
+    for (size_t t = 0; t + 2 < triangles.size(); t += 3)
+    {
+        glm::vec3 a = vertices.get(triangles[t]), b = vertices.get(triangles[t + 1]), c = vertices.get(triangles[t + 2]);
+        if (glm::length(glm::cross(b - a, c - a)) == 0.0f) continue; // no area, no closest point
+        corners.push_back(a);
+        corners.push_back(b);
+        corners.push_back(c);
+    }
+    std::unique_ptr<ThreadPool> threadPool;
+    if (threadCount > 1) threadPool.reset(new ThreadPool(threadCount));
+    fill([&](glm::vec3 p) {
+        float nearest = std::numeric_limits<float>::max(), solidAngle = 0.0f;
+        for (size_t k = 0; k < corners.size(); k += 3)
+        {
+            glm::vec3 d = p - closestPointOnTriangle(p, corners[k], corners[k + 1], corners[k + 2]);
+            nearest = std::min(nearest, glm::dot(d, d));
+            solidAngle += getSolidAngle(corners[k] - p, corners[k + 1] - p, corners[k + 2] - p);
+        }
+        // winding number over 1/2 is inside, either triangle orientation
+        bool inside = std::fabs(solidAngle) > 2.0f * PI;
+        return corners.empty() ? 0.0f : (inside ? -1.0f : 1.0f) * std::sqrt(nearest);
+    }, threadPool.get());
+}
+
+bool SdfObstacle::bakeModel(const std::string& path, int resolution, bool useCache, int threadCount)
+{
+    useCache = useCache && isLittleEndian();
+    std::string cachePath = getCachePath(path);
+    if (useCache && readCache(cachePath, path, resolution))
+    {
+        fromCache = true;
+        return true;
+    }
+
+    TissueModel model;
+    if (!model.load(path, useCache))
+    {
+        distances.clear();
+        error = model.getError();
+        return false;
+    }
+    if (model.triangles.empty())
+    {
+        distances.clear();
+        error = "model has no surface triangles";
+        return false;
+    }
+    bakeTriangles(model.positions, model.triangles, resolution, threadCount);
+    if (useCache && !writeCache(cachePath, path)) std::cout << "ERROR::SDF::CANNOT_WRITE_CACHE " << cachePath << std::endl;
+    return true;
+}
+
+// ------------------------------------------------------------------------
+// binary cache
+
+bool SdfObstacle::writeCache(const std::string& cachePath, const std::string& sourcePath) const
+{
+    if (distances.empty()) return false;
+    SdfCacheHeader header = {};
+    std::memcpy(header.magic, SDF_CACHE_MAGIC, sizeof(header.magic));
+    header.version = SDF_CACHE_VERSION;
+    header.endianTag = SDF_CACHE_ENDIAN_TAG;
+    if (!sourcePath.empty() && !TissueModel::getSourceStamp(sourcePath, header.sourceBytes, header.sourceModified)) return false;
+    for (int a = 0; a < 3; a++)
+    {
+        header.size[a] = size[a];
+        header.origin[a] = origin[a];
+    }
+    header.cellSize = cellSize;
+    header.resolution = resolution;
+
+    return replaceFile(cachePath, { { &header, sizeof(header) }, { distances.data(), getMemoryBytes() } });
+}
+
+bool SdfObstacle::readCache(const std::string& cachePath, const std::string& sourcePath, int resolution)
+{
+    MappedFile file;
+    if (!file.open(cachePath) || file.size() < sizeof(SdfCacheHeader)) return false;
+    SdfCacheHeader header;
+    std::memcpy(&header, file.data(), sizeof(header));
+    if (std::memcmp(header.magic, SDF_CACHE_MAGIC, sizeof(header.magic)) != 0 || header.version != SDF_CACHE_VERSION
+        || header.endianTag != SDF_CACHE_ENDIAN_TAG || header.resolution != resolution)
+    {
+        return false;
+    }
+    if (!sourcePath.empty())
+    {
+        uint64_t sourceBytes;
+        int64_t sourceModified;
+        if (!TissueModel::getSourceStamp(sourcePath, sourceBytes, sourceModified) || sourceBytes != header.sourceBytes
+            || sourceModified != header.sourceModified)
+        {
+            return false;
+        }
+    }
+    uint64_t count = 1;
+    for (int a = 0; a < 3; a++)
+    {
+        if (header.size[a] < 2 || header.size[a] > SDF_MAX_RESOLUTION + 2 * SDF_PADDING_CELLS + 1 || !std::isfinite(header.origin[a])) return false;
+        count *= (uint64_t)header.size[a];
+    }
+    if (!(header.cellSize > 0.0f) || !std::isfinite(header.cellSize) || sizeof(header) + count * sizeof(float) != file.size()) return false;
+
+    const float* samples = (const float*)(file.data() + sizeof(header));
+    distances.assign(samples, samples + count);
+    size = glm::ivec3(header.size[0], header.size[1], header.size[2]);
+    origin = glm::vec3(header.origin[0], header.origin[1], header.origin[2]);
+    cellSize = header.cellSize;
+    this->resolution = header.resolution;
+    error.clear();
+    return true;
+}
+
+// ------------------------------------------------------------------------
+// contact
+
+void SdfObstacle::setPose(const glm::mat3& rotation, glm::vec3 translation)
+{
+    this->rotation = rotation;
+    this->translation = translation;
+    poseVersion++;
+}
+
+bool SdfObstacle::sample(glm::vec3 local, float& distance, glm::vec3& gradient) const
+{
+    glm::vec3 g = (local - origin) / cellSize;
+    for (int a = 0; a < 3; a++) if (!(g[a] > 0.0f && g[a] < (float)(size[a] - 1))) return false;
+
+    glm::vec3 cell = glm::min(glm::floor(g), glm::vec3(size - glm::ivec3(2)));
+    glm::vec3 f = g - cell;
+    const float* c = &distances[(size_t)cell.x + (size_t)size.x * ((size_t)cell.y + (size_t)size.y * (size_t)cell.z)];
+    const size_t sy = size.x, sz = (size_t)size.x * size.y;
+    float c000 = c[0], c100 = c[1], c010 = c[sy], c110 = c[sy + 1];
+    float c001 = c[sz], c101 = c[sz + 1], c011 = c[sz + sy], c111 = c[sz + sy + 1];
+
+    float c00 = c000 + (c100 - c000) * f.x, c10 = c010 + (c110 - c010) * f.x;
+    float c01 = c001 + (c101 - c001) * f.x, c11 = c011 + (c111 - c011) * f.x;
+    float c0 = c00 + (c10 - c00) * f.y, c1 = c01 + (c11 - c01) * f.y;
+    distance = c0 + (c1 - c0) * f.z;
+
+    float ex0 = (c100 - c000) + ((c110 - c010) - (c100 - c000)) * f.y;
+    float ex1 = (c101 - c001) + ((c111 - c011) - (c101 - c001)) * f.y;
+    gradient = glm::vec3(ex0 + (ex1 - ex0) * f.z, (c10 - c00) + ((c11 - c01) - (c10 - c00)) * f.z, c1 - c0);
+    return true;
+}
+
+bool SdfObstacle::getDistance(glm::vec3 point, float& distance, glm::vec3& normal) const
+{
+    glm::vec3 gradient;
+    if (distances.empty() || !sample(glm::transpose(rotation) * (point - translation), distance, gradient)) return false;
+    float length = glm::length(gradient);
+    normal = length > 0.0f ? rotation * (gradient / length) : glm::vec3(0.0f);
+    return true;
+}
+
+// the trilinear sample and its gradient, WIDTH vertices at a time: the 8 corners are gathers into the grid
+void SdfObstacle::project(Vec3Streams& positions, const float* inverseMass, int begin, int end, float margin) const
+{
+    if (distances.empty()) return;
+    using namespace simd;
+    const int sy = size.x, sz = size.x * size.y;
+    vfloat r[3][3];
+    for (int column = 0; column < 3; column++)
+        for (int row = 0; row < 3; row++) r[column][row] = set1(rotation[column][row]);
+    vfloat tx = set1(translation.x), ty = set1(translation.y), tz = set1(translation.z);
+    vfloat ox = set1(origin.x), oy = set1(origin.y), oz = set1(origin.z);
+    vfloat inverseCellSize = set1(1.0f / cellSize);
+    vfloat lastX = set1((float)(size.x - 1)), lastY = set1((float)(size.y - 1)), lastZ = set1((float)(size.z - 1));
+    vfloat cellX = set1((float)(size.x - 2)), cellY = set1((float)(size.y - 2)), cellZ = set1((float)(size.z - 2));
+    vfloat strideY = set1((float)sy), strideZ = set1((float)sz);
+    vfloat zero = set1(0.0f), tiny = set1(1e-20f), m = set1(margin);
+    const float* d = distances.data();
+
+    int i = begin;
+    for (; i + WIDTH <= end; i += WIDTH)
+    {
+        vfloat px = load(&positions.x[i]), py = load(&positions.y[i]), pz = load(&positions.z[i]);
+        vfloat dx = sub(px, tx), dy = sub(py, ty), dz = sub(pz, tz);
+        // grid coordinates: transpose(rotation) * (p - translation), then into samples
+        vfloat gx = mul(sub(add(add(mul(r[0][0], dx), mul(r[0][1], dy)), mul(r[0][2], dz)), ox), inverseCellSize);
+        vfloat gy = mul(sub(add(add(mul(r[1][0], dx), mul(r[1][1], dy)), mul(r[1][2], dz)), oy), inverseCellSize);
+        vfloat gz = mul(sub(add(add(mul(r[2][0], dx), mul(r[2][1], dy)), mul(r[2][2], dz)), oz), inverseCellSize);
+        vmask inside = both(both(both(greater(gx, zero), greater(lastX, gx)), both(greater(gy, zero), greater(lastY, gy))),
+                            both(both(greater(gz, zero), greater(lastZ, gz)), greater(load(inverseMass + i), zero)));
+        // lanes outside the grid read a clamped cell and are dropped at the end
+        gx = max(zero, min(gx, lastX));
+        gy = max(zero, min(gy, lastY));
+        gz = max(zero, min(gz, lastZ));
+        vfloat cx = min(floor(gx), cellX), cy = min(floor(gy), cellY), cz = min(floor(gz), cellZ);
+        vfloat fx = sub(gx, cx), fy = sub(gy, cy), fz = sub(gz, cz);
+
+        alignas(32) int corner[8][WIDTH];
+        storeInt(corner[0], add(cx, add(mul(cy, strideY), mul(cz, strideZ))));
+        for (int l = 0; l < WIDTH; l++)
+        {
+            corner[1][l] = corner[0][l] + 1;
+            corner[2][l] = corner[0][l] + sy;
+            corner[3][l] = corner[0][l] + sy + 1;
+            corner[4][l] = corner[0][l] + sz;
+            corner[5][l] = corner[0][l] + sz + 1;
+            corner[6][l] = corner[0][l] + sz + sy;
+            corner[7][l] = corner[0][l] + sz + sy + 1;
+        }
+        vfloat c000 = gather(d, corner[0]), c100 = gather(d, corner[1]), c010 = gather(d, corner[2]), c110 = gather(d, corner[3]);
+        vfloat c001 = gather(d, corner[4]), c101 = gather(d, corner[5]), c011 = gather(d, corner[6]), c111 = gather(d, corner[7]);
+
+        vfloat ex00 = sub(c100, c000), ex10 = sub(c110, c010), ex01 = sub(c101, c001), ex11 = sub(c111, c011);
+        vfloat c00 = add(c000, mul(ex00, fx)), c10 = add(c010, mul(ex10, fx));
+        vfloat c01 = add(c001, mul(ex01, fx)), c11 = add(c011, mul(ex11, fx));
+        vfloat c0 = add(c00, mul(sub(c10, c00), fy)), c1 = add(c01, mul(sub(c11, c01), fy));
+        vfloat distance = add(c0, mul(sub(c1, c0), fz));
+
+        vfloat ex0 = add(ex00, mul(sub(ex10, ex00), fy)), ex1 = add(ex01, mul(sub(ex11, ex01), fy));
+        vfloat nx = add(ex0, mul(sub(ex1, ex0), fz));
+        vfloat ny = add(sub(c10, c00), mul(sub(sub(c11, c01), sub(c10, c00)), fz));
+        vfloat nz = sub(c1, c0);
+        vfloat inverseLength = div(set1(1.0f), sqrt(max(add(add(mul(nx, nx), mul(ny, ny)), mul(nz, nz)), tiny)));
+
+        // push out along rotation * normal
+        vfloat push = mul(select(inside, max(sub(m, distance), zero), zero), inverseLength);
+        store(&positions.x[i], add(px, mul(push, add(add(mul(r[0][0], nx), mul(r[1][0], ny)), mul(r[2][0], nz)))));
+        store(&positions.y[i], add(py, mul(push, add(add(mul(r[0][1], nx), mul(r[1][1], ny)), mul(r[2][1], nz)))));
+        store(&positions.z[i], add(pz, mul(push, add(add(mul(r[0][2], nx), mul(r[1][2], ny)), mul(r[2][2], nz)))));
+    }
+    for (; i < end; i++)
+    {
+        float distance;
+        glm::vec3 normal;
+        if (inverseMass[i] > 0.0f && getDistance(positions.get(i), distance, normal) && distance < margin)
+        {
+            positions.set(i, positions.get(i) + normal * (margin - distance));
+        }
+    }
+}
@@ -0,0 +1,105 @@
+#ifndef SDF_OBSTACLE_H
+#define SDF_OBSTACLE_H
+
+#include "tissue.h"
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/*
+    SDF cache file, version 1, little-endian, written next to a baked mesh as <source>.sdf
+        SdfCacheHeader          grid size and placement, the resolution asked for and the stamp of the source
+        distances               size[0] * size[1] * size[2] floats, x fastest
+    A cache whose stamp or resolution no longer matches is baked again.
+*/
+const char SDF_CACHE_MAGIC[8] = { 'T', 'I', 'S', 'S', 'S', 'D', 'F', '0' };
+const uint32_t SDF_CACHE_VERSION = 1;
+const int SDF_PADDING_CELLS = 4; // samples around the shape's bounds; Tissue::obstacleMargin has to stay below it
+
+struct SdfCacheHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t endianTag;
+    uint64_t sourceBytes;       // 0 for analytic shapes
+    int64_t sourceModified;     // file clock ticks
+    int32_t size[3];            // samples along x, y, z
+    float origin[3];            // sample (0, 0, 0), in the obstacle's frame
+    float cellSize;
+    int32_t resolution;         // samples along the longest side of the shape, as asked for
+};
+static_assert(sizeof(SdfCacheHeader) == 64, "SdfCacheHeader layout is part of the file format");
+
+/*
+    SdfObstacle (rigid obstacle for Tissue contact: an instrument, an organ, the table)
+        a signed distance grid in the obstacle's own frame, negative inside, baked once:
+            bakeSphere / bakeBox / bakeCapsule      analytic shapes around the frame's origin
+            bakeTriangles / bakeModel               closed triangle mesh: distance to the nearest triangle,
+                                                    inside where the winding number is over 1/2; O(samples *
+                                                    triangles) split over threadCount threads by z-slice, so
+                                                    bakeModel caches the grid on disk
+        sampled trilinearly; the gradient of the same 8 samples is the contact normal, so a contact is
+        one grid lookup. Outside the grid there is no contact.
+        the pose (rotation, translation) maps the obstacle's frame into the tissue's; moving it between
+        steps makes the obstacle kinematic, every pose change bumps getPoseVersion()
+        project pushes vertices [begin, end) with inverse mass > 0 out to margin, simd::WIDTH at a time
+*/
+class SdfObstacle
+{
+    public:
+    SdfObstacle();
+
+    // resolution = samples along the longest side of the shape, >= 2
+    void bakeSphere(float radius, int resolution);
+    void bakeBox(glm::vec3 halfExtents, int resolution);
+    void bakeCapsule(float halfLength, float radius, int resolution); // along y, an instrument shaft with a round tip
+    void bakeTriangles(const Vec3Streams& vertices, const std::vector<unsigned int>& triangles, int resolution, int threadCount = 1);
+    // .obj, .ply or TetGen surface (see TissueModel); false, with the reason in getError(), when the file
+    // cannot be read. useCache = false always bakes and leaves the cache alone
+    bool bakeModel(const std::string& path, int resolution, bool useCache = true, int threadCount = 1);
+    const std::string& getError() const { return error; }
+    bool isFromCache() const { return fromCache; }
+
+    static std::string getCachePath(const std::string& path) { return path + ".sdf"; }
+    // false when the cache is missing, stale or damaged; an empty sourcePath skips the stamp check
+    bool readCache(const std::string& cachePath, const std::string& sourcePath, int resolution);
+    bool writeCache(const std::string& cachePath, const std::string& sourcePath) const;
+
+    void setPose(const glm::mat3& rotation, glm::vec3 translation);
+    const glm::mat3& getRotation() const { return rotation; }
+    glm::vec3 getTranslation() const { return translation; }
+    uint64_t getPoseVersion() const { return poseVersion; }
+
+    bool isBaked() const { return !distances.empty(); }
+    glm::ivec3 getSize() const { return size; }
+    float getCellSize() const { return cellSize; }
+    size_t getMemoryBytes() const { return distances.size() * sizeof(float); }
+
+    // signed distance at a point of the tissue's frame, and the outward unit normal there;
+    // false (and no contact) outside the grid
+    bool getDistance(glm::vec3 point, float& distance, glm::vec3& normal) const;
+    void project(Vec3Streams& positions, const float* inverseMass, int begin, int end, float margin) const;
+
+    private:
+    std::vector<float> distances;
+    glm::ivec3 size;
+    glm::vec3 origin;
+    float cellSize;
+    int resolution;
+    glm::mat3 rotation;
+    glm::vec3 translation;
+    uint64_t poseVersion;
+    std::string error;
+    bool fromCache;
+
+    // a grid over [lower, upper] plus the padding
+    void allocate(glm::vec3 lower, glm::vec3 upper, int resolution);
+    // distance(point of the obstacle's frame) at every sample, one z-slice per task with a pool
+    template<typename F> void fill(F distance, ThreadPool* threadPool = nullptr);
+    // trilinear value and gradient at a point of the obstacle's frame
+    bool sample(glm::vec3 local, float& distance, glm::vec3& gradient) const;
+};
+
+#endif
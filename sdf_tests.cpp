@@ -0,0 +1,126 @@
+#include "regression_tests.h"
+#include "sdf_obstacle.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace
+{
+    // a unit cube around the origin, 12 triangles wound outward
+    const char* CUBE_OBJ = "v -0.5 -0.5 -0.5\nv 0.5 -0.5 -0.5\nv 0.5 0.5 -0.5\nv -0.5 0.5 -0.5\n"
+                           "v -0.5 -0.5 0.5\nv 0.5 -0.5 0.5\nv 0.5 0.5 0.5\nv -0.5 0.5 0.5\n"
+                           "f 1 4 3 2\nf 5 6 7 8\nf 1 2 6 5\nf 4 8 7 3\nf 1 5 8 4\nf 2 3 7 6\n";
+
+    // points of the tissue's frame spread over the obstacle and past its grid
+    std::vector<glm::vec3> getProbes(glm::vec3 center, float extent)
+    {
+        std::vector<glm::vec3> probes;
+        for (int i = 0; i < 7; i++)
+        {
+            for (int j = 0; j < 7; j++)
+            {
+                for (int k = 0; k < 7; k++) probes.push_back(center + glm::vec3(i - 3, j - 3, k - 3) * (extent / 3.0f) + glm::vec3(0.013f, -0.007f, 0.021f));
+            }
+        }
+        return probes;
+    }
+}
+
+// sdf-sample: a posed sphere gives its distance to within the grid's interpolation error and the outward normal
+// away from its center, and nothing outside its grid
+int testSdfSample()
+{
+    const float radius = 0.5f;
+    const glm::vec3 center(1.0f, 2.0f, 3.0f);
+    SdfObstacle sphere;
+    sphere.bakeSphere(radius, 32);
+    float angle = 0.7f;
+    sphere.setPose(glm::mat3(std::cos(angle), 0.0f, -std::sin(angle), 0.0f, 1.0f, 0.0f, std::sin(angle), 0.0f, std::cos(angle)), center);
+
+    bool pass = true;
+    int inside = 0, outside = 0, missed = 0;
+    for (glm::vec3 probe : getProbes(center, 1.2f))
+    {
+        float distance;
+        glm::vec3 normal;
+        float expected = glm::length(probe - center) - radius;
+        if (!sphere.getDistance(probe, distance, normal))
+        {
+            missed++;
+            continue;
+        }
+        (expected < 0.0f ? inside : outside)++;
+        if (glm::length(probe - center) < 2.0f * sphere.getCellSize()) continue; // the distance has a kink at the center
+        glm::vec3 outward = glm::normalize(probe - center);
+        if (std::fabs(distance - expected) > sphere.getCellSize() * 0.25f || glm::dot(normal, outward) < 0.99f
+            || std::fabs(glm::length(normal) - 1.0f) > 1e-4f)
+        {
+            std::cout << "FAIL at (" << probe.x << ", " << probe.y << ", " << probe.z << "): distance " << distance << ", expected " << expected
+                      << ", normal . outward " << glm::dot(normal, outward) << std::endl;
+            pass = false;
+        }
+    }
+    if (inside == 0 || outside == 0 || missed == 0)
+    {
+        std::cout << "FAIL the probes missed a region: " << inside << " inside, " << outside << " outside, " << missed << " off the grid" << std::endl;
+        pass = false;
+    }
+    return pass ? 0 : 1;
+}
+
+// sdf-cache: bakeModel writes the grid, the next bake maps it and answers bit-identically; another resolution bakes again
+int testSdfCache()
+{
+    const std::string path = "regression_cube.obj";
+    std::remove(SdfObstacle::getCachePath(path).c_str());
+    std::ofstream(path, std::ios::binary) << CUBE_OBJ;
+
+    SdfObstacle baked, cached, finer;
+    if (!baked.bakeModel(path, 16) || !cached.bakeModel(path, 16) || !finer.bakeModel(path, 20))
+    {
+        std::cout << "FAIL cannot bake " << path << ": " << baked.getError() << cached.getError() << finer.getError() << std::endl;
+        return 1;
+    }
+    bool pass = true;
+    if (baked.isFromCache() || !cached.isFromCache() || finer.isFromCache())
+    {
+        std::cout << "FAIL cache use: first " << baked.isFromCache() << ", second " << cached.isFromCache() << ", other resolution " << finer.isFromCache() << std::endl;
+        pass = false;
+    }
+    if (cached.getSize() != baked.getSize() || cached.getMemoryBytes() != baked.getMemoryBytes())
+    {
+        std::cout << "FAIL the cached grid has another size" << std::endl;
+        pass = false;
+    }
+
+    float centerDistance;
+    glm::vec3 normal;
+    if (!baked.getDistance(glm::vec3(0.0f), centerDistance, normal) || std::fabs(centerDistance + 0.5f) > baked.getCellSize())
+    {
+        std::cout << "FAIL the cube's center is at " << centerDistance << ", expected -0.5" << std::endl;
+        pass = false;
+    }
+    for (glm::vec3 probe : getProbes(glm::vec3(0.0f), 0.8f))
+    {
+        float a, b;
+        glm::vec3 na, nb;
+        bool hitA = baked.getDistance(probe, a, na), hitB = cached.getDistance(probe, b, nb);
+        if (hitA != hitB || (hitA && (std::memcmp(&a, &b, sizeof(a)) != 0 || std::memcmp(&na, &nb, sizeof(na)) != 0)))
+        {
+            std::cout << "FAIL at (" << probe.x << ", " << probe.y << ", " << probe.z << "): baked " << a << ", cached " << b << std::endl;
+            pass = false;
+            break;
+        }
+    }
+    std::remove(path.c_str());
+    std::remove(SdfObstacle::getCachePath(path).c_str());
+    return pass ? 0 : 1;
+}
+
+static RegressionCase sdfSample("sdf-sample", testSdfSample);
+static RegressionCase sdfCache("sdf-cache", testSdfCache);
@@ -0,0 +1,208 @@
+#include "self_collision.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <cmath>
+
+// vertices per query task; fixed so the pair order never depends on the thread count
+const int COLLISION_CHUNK = 4096;
+// widest digit of the cell sort: 2 passes up to 4M cells, with 2048 counts per task
+const int COLLISION_RADIX_BITS = 11;
+
+namespace
+{
+    int hashCell(int x, int y, int z, int mask)
+    {
+        return (int)(((uint32_t)x * 92837111u) ^ ((uint32_t)y * 689287499u) ^ ((uint32_t)z * 283923481u)) & mask;
+    }
+
+    // cell coordinate along one axis; far-away vertices share the outermost cells instead of overflowing
+    int cellCoordinate(float value, float inverseCellSize)
+    {
+        return (int)std::floor(std::max(-1e9f, std::min(1e9f, value * inverseCellSize)));
+    }
+
+    template<typename F>
+    void forEach(ThreadPool* threadPool, int count, F&& fn)
+    {
+        if (threadPool) threadPool->parallelFor(count, fn);
+        else for (int i = 0; i < count; i++) fn(i);
+    }
+}
+
+SelfCollision::SelfCollision(int vertexCount, const std::vector<unsigned int>& triangles, const std::vector<int>& edgeFirst, const std::vector<int>& edgeSecond)
+    : vertexCount(vertexCount)
+{
+    std::vector<std::pair<int, int>> edges;
+    auto addEdge = [&](unsigned int a, unsigned int b) {
+        if (a == b || a >= (unsigned int)vertexCount || b >= (unsigned int)vertexCount) return;
+        edges.push_back({ (int)a, (int)b });
+        edges.push_back({ (int)b, (int)a });
+    };
+    for (size_t t = 0; t + 2 < triangles.size(); t += 3)
+    {
+        addEdge(triangles[t], triangles[t + 1]);
+        addEdge(triangles[t + 1], triangles[t + 2]);
+        addEdge(triangles[t + 2], triangles[t]);
+    }
+    for (size_t e = 0; e < edgeFirst.size(); e++) addEdge(edgeFirst[e], edgeSecond[e]);
+    std::sort(edges.begin(), edges.end());
+    edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+
+    neighborOffsets.assign(vertexCount + 1, 0);
+    for (const std::pair<int, int>& edge : edges) neighborOffsets[edge.first + 1]++;
+    for (int v = 0; v < vertexCount; v++) neighborOffsets[v + 1] += neighborOffsets[v];
+    neighbors.resize(edges.size());
+    for (size_t e = 0; e < edges.size(); e++) neighbors[e] = edges[e].second; // sorted by first, then second
+
+    tableSize = 1;
+    while (tableSize < vertexCount) tableSize *= 2;
+    cells.resize(vertexCount);
+    cellScratch.resize(vertexCount);
+    cellStart.resize(tableSize + 1);
+    sorted.resize(vertexCount);
+    sortedScratch.resize(vertexCount);
+    chunkPairs.resize((vertexCount + COLLISION_CHUNK - 1) / COLLISION_CHUNK);
+}
+
+bool SelfCollision::areNeighbors(int a, int b) const
+{
+    return std::binary_search(neighbors.begin() + neighborOffsets[a], neighbors.begin() + neighborOffsets[a + 1], b);
+}
+
+void SelfCollision::findPairs(const Vec3Streams& positions, const std::vector<float>& inverseMass, const std::vector<uint8_t>& awake,
+                              float thickness, ThreadPool* threadPool)
+{
+    first.clear();
+    second.clear();
+    if (vertexCount == 0 || !(thickness > 0.0f)) return;
+
+    const int n = vertexCount, mask = tableSize - 1;
+    const float inverseCellSize = 0.5f / thickness;
+    const int tasks = std::max(1, std::min(threadPool ? threadPool->getThreadCount() : 1, n));
+    auto taskBegin = [&](int t) { return (int)((int64_t)n * t / tasks); };
+
+    forEach(threadPool, tasks, [&](int t) {
+        for (int i = taskBegin(t); i < taskBegin(t + 1); i++)
+        {
+            cells[i] = hashCell(cellCoordinate(positions.x[i], inverseCellSize), cellCoordinate(positions.y[i], inverseCellSize),
+                                cellCoordinate(positions.z[i], inverseCellSize), mask);
+            sorted[i] = i;
+        }
+    });
+
+    // stable LSD radix sort of the (cell, vertex) pairs, a digit of the cell per pass: every task counts the digits
+    // in its slice, the counts become write cursors in (digit, task) order, so the vertices stay in vertex order
+    // within each cell for any task count. The counts are tasks x 2^digitBits, not tasks x cells.
+    int cellBits = 0;
+    while ((1 << cellBits) < tableSize) cellBits++;
+    const int passes = std::max(1, (cellBits + COLLISION_RADIX_BITS - 1) / COLLISION_RADIX_BITS);
+    const int digitBits = (cellBits + passes - 1) / passes, digits = 1 << digitBits;
+    if (digitCounts.size() < (size_t)tasks * digits) digitCounts.resize((size_t)tasks * digits);
+    for (int pass = 0; pass < passes; pass++)
+    {
+        const int shift = pass * digitBits;
+        forEach(threadPool, tasks, [&](int t) {
+            int* counts = &digitCounts[(size_t)t * digits];
+            std::fill(counts, counts + digits, 0);
+            for (int k = taskBegin(t); k < taskBegin(t + 1); k++) counts[(cells[k] >> shift) & (digits - 1)]++;
+        });
+        int run = 0;
+        for (int d = 0; d < digits; d++)
+        {
+            for (int t = 0; t < tasks; t++)
+            {
+                int count = digitCounts[(size_t)t * digits + d];
+                digitCounts[(size_t)t * digits + d] = run;
+                run += count;
+            }
+        }
+        forEach(threadPool, tasks, [&](int t) {
+            int* cursors = &digitCounts[(size_t)t * digits];
+            for (int k = taskBegin(t); k < taskBegin(t + 1); k++)
+            {
+                int slot = cursors[(cells[k] >> shift) & (digits - 1)]++;
+                cellScratch[slot] = cells[k];
+                sortedScratch[slot] = sorted[k];
+            }
+        });
+        cells.swap(cellScratch);
+        sorted.swap(sortedScratch);
+    }
+
+    // cell c starts at the first sorted slot whose cell is >= c; every cell is written by the task owning that slot
+    forEach(threadPool, tasks, [&](int t) {
+        for (int k = taskBegin(t); k < taskBegin(t + 1); k++)
+        {
+            for (int c = k == 0 ? 0 : cells[k - 1] + 1; c <= cells[k]; c++) cellStart[c] = k;
+        }
+    });
+    for (int c = cells[n - 1] + 1; c <= tableSize; c++) cellStart[c] = n;
+
+    // every vertex against the higher-numbered vertices of 8 cells: cells are 2 * thickness wide, so whatever is
+    // within thickness of p lies in p's cell or, along each axis, the neighbour on the side of the half p is in
+    const float thicknessSquared = thickness * thickness;
+    auto movable = [&](int v) { return awake[v / SLEEP_TILE] && inverseMass[v] > 0.0f; };
+    forEach(threadPool, (int)chunkPairs.size(), [&](int chunk) {
+        std::vector<std::pair<int, int>>& pairs = chunkPairs[chunk];
+        pairs.clear();
+        int end = std::min(n, (chunk + 1) * COLLISION_CHUNK);
+        for (int i = chunk * COLLISION_CHUNK; i < end; i++)
+        {
+            glm::vec3 p = positions.get(i);
+            float fx = p.x * inverseCellSize, fy = p.y * inverseCellSize, fz = p.z * inverseCellSize;
+            int x = cellCoordinate(p.x, inverseCellSize), y = cellCoordinate(p.y, inverseCellSize), z = cellCoordinate(p.z, inverseCellSize);
+            int sx = fx - x < 0.5f ? -1 : 1, sy = fy - y < 0.5f ? -1 : 1, sz = fz - z < 0.5f ? -1 : 1;
+
+            // distinct buckets only, two of the 8 cells may hash to the same one
+            int buckets[8], bucketCount = 0;
+            for (int k = 0; k < 8; k++)
+            {
+                int bucket = hashCell(x + (k & 1 ? sx : 0), y + (k & 2 ? sy : 0), z + (k & 4 ? sz : 0), mask);
+                if (std::find(buckets, buckets + bucketCount, bucket) == buckets + bucketCount) buckets[bucketCount++] = bucket;
+            }
+
+            bool movableI = movable(i);
+            for (int k = 0; k < bucketCount; k++)
+            {
+                const int* bucketBegin = sorted.data() + cellStart[buckets[k]];
+                const int* bucketEnd = sorted.data() + cellStart[buckets[k] + 1];
+                for (const int* j = std::upper_bound(bucketBegin, bucketEnd, i); j != bucketEnd; j++)
+                {
+                    if (!movableI && !movable(*j)) continue;
+                    glm::vec3 d = p - positions.get(*j);
+                    if (glm::dot(d, d) >= thicknessSquared || areNeighbors(i, *j)) continue;
+                    pairs.push_back({ i, *j });
+                }
+            }
+        }
+    });
+    for (const std::vector<std::pair<int, int>>& pairs : chunkPairs)
+    {
+        for (const std::pair<int, int>& pair : pairs)
+        {
+            first.push_back(pair.first);
+            second.push_back(pair.second);
+        }
+    }
+}
+
+// C = |p1 - p2| - thickness >= 0, projected like a stretch constraint with stiffness 1 when violated
+void SelfCollision::solve(Vec3Streams& positions, const std::vector<float>& inverseMass, const std::vector<uint8_t>& awake, float thickness) const
+{
+    for (size_t k = 0; k < first.size(); k++)
+    {
+        int i = first[k], j = second[k];
+        float w1 = awake[i / SLEEP_TILE] ? inverseMass[i] : 0.0f;
+        float w2 = awake[j / SLEEP_TILE] ? inverseMass[j] : 0.0f;
+        glm::vec3 p1 = positions.get(i), p2 = positions.get(j);
+        glm::vec3 d = p1 - p2;
+        float lengthSquared = glm::dot(d, d);
+        if (w1 + w2 == 0.0f || lengthSquared >= thickness * thickness || lengthSquared == 0.0f) continue;
+
+        float length = std::sqrt(lengthSquared);
+        float scale = (length - thickness) / (length * (w1 + w2));
+        positions.set(i, p1 - w1 * scale * d);
+        positions.set(j, p2 + w2 * scale * d);
+    }
+}
@@ -0,0 +1,56 @@
+#ifndef SELF_COLLISION_H
+#define SELF_COLLISION_H
+
+#include "tissue.h"
+
+#include <cstdint>
+#include <vector>
+
+class ThreadPool;
+
+/*
+    SelfCollision (broad phase and collision constraints of one Tissue)
+        vertices are spheres of diameter thickness; two that share a draw triangle or a stretch
+        constraint are topological neighbours and never collide
+        findPairs   uniform spatial hash over the estimated positions, cell size = 2 * thickness: a parallel
+                    radix sort of the vertices by hashed cell, then each vertex looks at the 2x2x2 cells
+                    nearest to it. Pairs closer than thickness become collision constraints. Linear in
+                    the vertex count; pairs come out in vertex order, whatever the thread count.
+        solve       one Gauss-Seidel pass over the pairs, pushing each pair apart to thickness
+        a vertex with inverse mass 0, or in a sleeping tile, does not move
+*/
+class SelfCollision
+{
+    public:
+    // neighbours from the draw triangles and the (explicit) stretch constraint endpoints
+    SelfCollision(int vertexCount, const std::vector<unsigned int>& triangles, const std::vector<int>& edgeFirst, const std::vector<int>& edgeSecond);
+
+    // awake: one flag per SLEEP_TILE vertices
+    void findPairs(const Vec3Streams& positions, const std::vector<float>& inverseMass, const std::vector<uint8_t>& awake,
+                   float thickness, ThreadPool* threadPool);
+    void solve(Vec3Streams& positions, const std::vector<float>& inverseMass, const std::vector<uint8_t>& awake, float thickness) const;
+
+    int getPairCount() const { return (int)first.size(); }
+    int getNeighborCount() const { return (int)neighbors.size(); }
+
+    private:
+    int vertexCount;
+    std::vector<int> neighborOffsets;   // neighbours of v: neighbors[offsets[v] .. offsets[v+1]), ascending
+    std::vector<int> neighbors;
+
+    // hash of this substep
+    int tableSize;                      // power of two >= vertexCount
+    std::vector<int> cells;             // hashed cell of every sorted entry
+    std::vector<int> cellStart;         // vertices in cell c: sorted[cellStart[c] .. cellStart[c+1])
+    std::vector<int> sorted;            // vertex indices by cell, ascending within a cell
+    std::vector<int> cellScratch, sortedScratch; // radix sort: the other buffer of each pass
+    std::vector<int> digitCounts;       // radix sort: per task and digit, counts then write cursors
+    std::vector<std::vector<std::pair<int, int>>> chunkPairs; // per vertex chunk, concatenated in chunk order
+
+    // collision constraints of this substep
+    std::vector<int> first, second;
+
+    bool areNeighbors(int a, int b) const;
+};
+
+#endif
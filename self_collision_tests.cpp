@@ -0,0 +1,28 @@
+#include "regression_tests.h"
+
+#include <iostream>
+
+// threads-self-collision: pairs come out of a parallel radix sort in vertex order, so 1 and 4 threads give
+// bit-identical states
+int testThreadsSelfCollision()
+{
+    Tissue serial(EDGE_COUNT, 1);
+    Tissue parallel(EDGE_COUNT, 1);
+    serial.selfCollisionThickness = parallel.selfCollisionThickness = 2.5f / EDGE_COUNT; // wider than two grid spacings, so pairs exist from the start
+    parallel.setThreadCount(4);
+    for (int s = 0; s < STEPS; s++)
+    {
+        drag(serial, s);
+        drag(parallel, s);
+        serial.step(DELTA_TIME, GRAVITY);
+        parallel.step(DELTA_TIME, GRAVITY);
+    }
+    if (serial.getCollisionPairCount() == 0)
+    {
+        std::cout << "FAIL no self-collision pairs, the comparison is void" << std::endl;
+        return 1;
+    }
+    return expectSame(serial, parallel, "self-collision, 1 vs 4 threads") ? 0 : 1;
+}
+
+static RegressionCase threadsSelfCollision("threads-self-collision", testThreadsSelfCollision);
@@ -1,12 +1,15 @@
 #version 330 core
 layout (location = 0) in vec3 aPos;   // the position variable has attribute position 0
-layout (location = 1) in vec3 aColor; // the color variable has attribute position 1
-  
+layout (location = 1) in vec3 aColor; // the color variable has attribute position 1 (float3, or RGBA8 normalized)
+
+uniform float positionScale = 1.0; // VertexFormat::CompactSnorm16 stores positions / SNORM16_POSITION_RANGE
+
 out vec3 ourColor; // output a color to the fragment shader
 out vec3 ourPosition;
 void main()
 {
-    gl_Position = vec4(aPos, 1.0);
-    ourPosition = aPos.xyz;
+    vec3 position = aPos * positionScale;
+    gl_Position = vec4(position, 1.0);
+    ourPosition = position;
     ourColor = aColor; // set ourColor to the input color we got from the vertex data
-}     
\ No newline at end of file
+}
@@ -0,0 +1,202 @@
+#ifndef SIMD_H
+#define SIMD_H
+
+/*
+    simd
+        thin wrappers over one float vector register, picked at compile time:
+            AVX2  8 lanes (built with -mavx2 -mfma)
+            SSE2  4 lanes (x86-64 baseline)
+            scalar 1 lane (other targets or TISSUE_SIMD_SCALAR)
+        kernels are written once against these and handle the remainder with WIDTH == 1 code
+        deinterleave/interleave move 2 * WIDTH consecutive floats as their even and odd lanes
+*/
+
+#if defined(__AVX2__) && !defined(TISSUE_SIMD_SCALAR)
+#include <immintrin.h>
+
+namespace simd
+{
+    const int WIDTH = 8;
+    const char* const NAME = "AVX2";
+    typedef __m256 vfloat;
+    typedef __m256 vmask;
+
+    inline vfloat load(const float* p) { return _mm256_loadu_ps(p); }
+    inline void store(float* p, vfloat v) { _mm256_storeu_ps(p, v); }
+    inline vfloat set1(float f) { return _mm256_set1_ps(f); }
+    inline vfloat add(vfloat a, vfloat b) { return _mm256_add_ps(a, b); }
+    inline vfloat sub(vfloat a, vfloat b) { return _mm256_sub_ps(a, b); }
+    inline vfloat mul(vfloat a, vfloat b) { return _mm256_mul_ps(a, b); }
+    inline vfloat div(vfloat a, vfloat b) { return _mm256_div_ps(a, b); }
+    inline vfloat sqrt(vfloat a) { return _mm256_sqrt_ps(a); }
+    inline vfloat max(vfloat a, vfloat b) { return _mm256_max_ps(a, b); }
+    inline vfloat min(vfloat a, vfloat b) { return _mm256_min_ps(a, b); }
+    inline vfloat floor(vfloat a) { return _mm256_floor_ps(a); }
+    inline vfloat abs(vfloat a) { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a); }
+    inline vmask greater(vfloat a, vfloat b) { return _mm256_cmp_ps(a, b, _CMP_GT_OQ); }
+    inline vmask notEqual(vfloat a, vfloat b) { return _mm256_cmp_ps(a, b, _CMP_NEQ_OQ); }
+    inline vmask both(vmask a, vmask b) { return _mm256_and_ps(a, b); }
+    // mask ? a : b
+    inline vfloat select(vmask m, vfloat a, vfloat b) { return _mm256_blendv_ps(b, a, m); }
+
+    inline vfloat gather(const float* base, const int* index)
+    {
+        return _mm256_i32gather_ps(base, _mm256_loadu_si256((const __m256i*)index), 4);
+    }
+    // truncated to int, e.g. a gather index computed in floats
+    inline void storeInt(int* p, vfloat v) { _mm256_storeu_si256((__m256i*)p, _mm256_cvttps_epi32(v)); }
+    // no AVX2 scatter: spill and write lanes, callers guarantee distinct indices
+    inline void scatter(float* base, const int* index, vfloat v)
+    {
+        alignas(32) float lanes[8];
+        _mm256_store_ps(lanes, v);
+        for (int l = 0; l < 8; l++) base[index[l]] = lanes[l];
+    }
+    // p[0..15] split into its even lanes (p[0], p[2], ...) and odd lanes (p[1], p[3], ...)
+    inline void deinterleave(const float* p, vfloat& even, vfloat& odd)
+    {
+        __m256 a = _mm256_loadu_ps(p), b = _mm256_loadu_ps(p + 8);
+        // shuffle gives a0 a2 b0 b2 | a4 a6 b4 b6, the 64-bit permute puts the halves in order
+        even = _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(_mm256_shuffle_ps(a, b, 0x88)), 0xd8));
+        odd = _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(_mm256_shuffle_ps(a, b, 0xdd)), 0xd8));
+    }
+    // inverse of deinterleave: p[2k] = even[k], p[2k+1] = odd[k]
+    inline void interleave(float* p, vfloat even, vfloat odd)
+    {
+        __m256 low = _mm256_unpacklo_ps(even, odd), high = _mm256_unpackhi_ps(even, odd);
+        _mm256_storeu_ps(p, _mm256_permute2f128_ps(low, high, 0x20));
+        _mm256_storeu_ps(p + 8, _mm256_permute2f128_ps(low, high, 0x31));
+    }
+
+    inline float horizontalMax(vfloat v)
+    {
+        alignas(32) float lanes[8];
+        _mm256_store_ps(lanes, v);
+        float result = lanes[0];
+        for (int l = 1; l < 8; l++) result = lanes[l] > result ? lanes[l] : result;
+        return result;
+    }
+    inline double horizontalSum(vfloat v)
+    {
+        alignas(32) float lanes[8];
+        _mm256_store_ps(lanes, v);
+        double result = 0.0;
+        for (int l = 0; l < 8; l++) result += lanes[l];
+        return result;
+    }
+}
+
+#elif (defined(__SSE2__) || defined(_M_X64)) && !defined(TISSUE_SIMD_SCALAR)
+#include <emmintrin.h>
+
+namespace simd
+{
+    const int WIDTH = 4;
+    const char* const NAME = "SSE2";
+    typedef __m128 vfloat;
+    typedef __m128 vmask;
+
+    inline vfloat load(const float* p) { return _mm_loadu_ps(p); }
+    inline void store(float* p, vfloat v) { _mm_storeu_ps(p, v); }
+    inline vfloat set1(float f) { return _mm_set1_ps(f); }
+    inline vfloat add(vfloat a, vfloat b) { return _mm_add_ps(a, b); }
+    inline vfloat sub(vfloat a, vfloat b) { return _mm_sub_ps(a, b); }
+    inline vfloat mul(vfloat a, vfloat b) { return _mm_mul_ps(a, b); }
+    inline vfloat div(vfloat a, vfloat b) { return _mm_div_ps(a, b); }
+    inline vfloat sqrt(vfloat a) { return _mm_sqrt_ps(a); }
+    inline vfloat max(vfloat a, vfloat b) { return _mm_max_ps(a, b); }
+    inline vfloat min(vfloat a, vfloat b) { return _mm_min_ps(a, b); }
+    // SSE2 has no round instruction: truncate, then step down where that rounded up; |a| < 2^31
+    inline vfloat floor(vfloat a)
+    {
+        __m128 truncated = _mm_cvtepi32_ps(_mm_cvttps_epi32(a));
+        return _mm_sub_ps(truncated, _mm_and_ps(_mm_cmpgt_ps(truncated, a), _mm_set1_ps(1.0f)));
+    }
+    inline vfloat abs(vfloat a) { return _mm_andnot_ps(_mm_set1_ps(-0.0f), a); }
+    inline vmask greater(vfloat a, vfloat b) { return _mm_cmpgt_ps(a, b); }
+    inline vmask notEqual(vfloat a, vfloat b) { return _mm_cmpneq_ps(a, b); }
+    inline vmask both(vmask a, vmask b) { return _mm_and_ps(a, b); }
+    // mask ? a : b
+    inline vfloat select(vmask m, vfloat a, vfloat b) { return _mm_or_ps(_mm_and_ps(m, a), _mm_andnot_ps(m, b)); }
+
+    inline vfloat gather(const float* base, const int* index)
+    {
+        return _mm_set_ps(base[index[3]], base[index[2]], base[index[1]], base[index[0]]);
+    }
+    inline void storeInt(int* p, vfloat v) { _mm_storeu_si128((__m128i*)p, _mm_cvttps_epi32(v)); }
+    inline void scatter(float* base, const int* index, vfloat v)
+    {
+        alignas(16) float lanes[4];
+        _mm_store_ps(lanes, v);
+        for (int l = 0; l < 4; l++) base[index[l]] = lanes[l];
+    }
+    inline void deinterleave(const float* p, vfloat& even, vfloat& odd)
+    {
+        __m128 a = _mm_loadu_ps(p), b = _mm_loadu_ps(p + 4);
+        even = _mm_shuffle_ps(a, b, 0x88);
+        odd = _mm_shuffle_ps(a, b, 0xdd);
+    }
+    inline void interleave(float* p, vfloat even, vfloat odd)
+    {
+        _mm_storeu_ps(p, _mm_unpacklo_ps(even, odd));
+        _mm_storeu_ps(p + 4, _mm_unpackhi_ps(even, odd));
+    }
+
+    inline float horizontalMax(vfloat v)
+    {
+        alignas(16) float lanes[4];
+        _mm_store_ps(lanes, v);
+        float result = lanes[0];
+        for (int l = 1; l < 4; l++) result = lanes[l] > result ? lanes[l] : result;
+        return result;
+    }
+    inline double horizontalSum(vfloat v)
+    {
+        alignas(16) float lanes[4];
+        _mm_store_ps(lanes, v);
+        double result = 0.0;
+        for (int l = 0; l < 4; l++) result += lanes[l];
+        return result;
+    }
+}
+
+#else
+#include <cmath>
+
+namespace simd
+{
+    const int WIDTH = 1;
+    const char* const NAME = "scalar";
+    typedef float vfloat;
+    typedef bool vmask;
+
+    inline vfloat load(const float* p) { return *p; }
+    inline void store(float* p, vfloat v) { *p = v; }
+    inline vfloat set1(float f) { return f; }
+    inline vfloat add(vfloat a, vfloat b) { return a + b; }
+    inline vfloat sub(vfloat a, vfloat b) { return a - b; }
+    inline vfloat mul(vfloat a, vfloat b) { return a * b; }
+    inline vfloat div(vfloat a, vfloat b) { return a / b; }
+    inline vfloat sqrt(vfloat a) { return std::sqrt(a); }
+    inline vfloat max(vfloat a, vfloat b) { return a > b ? a : b; }
+    inline vfloat min(vfloat a, vfloat b) { return a < b ? a : b; }
+    inline vfloat floor(vfloat a) { return std::floor(a); }
+    inline vfloat abs(vfloat a) { return std::fabs(a); }
+    inline vmask greater(vfloat a, vfloat b) { return a > b; }
+    inline vmask notEqual(vfloat a, vfloat b) { return a != b; }
+    inline vmask both(vmask a, vmask b) { return a && b; }
+    inline vfloat select(vmask m, vfloat a, vfloat b) { return m ? a : b; }
+
+    inline vfloat gather(const float* base, const int* index) { return base[*index]; }
+    inline void storeInt(int* p, vfloat v) { *p = (int)v; }
+    inline void scatter(float* base, const int* index, vfloat v) { base[*index] = v; }
+    inline void deinterleave(const float* p, vfloat& even, vfloat& odd) { even = p[0]; odd = p[1]; }
+    inline void interleave(float* p, vfloat even, vfloat odd) { p[0] = even; p[1] = odd; }
+
+    inline float horizontalMax(vfloat v) { return v; }
+    inline double horizontalSum(vfloat v) { return v; }
+}
+
+#endif
+
+#endif
@@ -0,0 +1,261 @@
+#ifndef SIMULATION_THREAD_H
+#define SIMULATION_THREAD_H
+
+#include "tissue.h"
+#include "profiler.h"
+#include "spsc_queue.h"
+#include "triple_buffer.h"
+#include "vertex_picker.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+// input for the simulation thread; the render thread pushes, the sim thread applies them before its next step
+enum class SimCommandType : uint8_t
+{
+    Drag,           // move `vertex` by `offset` and pin it
+    Release,        // unpin `vertex`
+    Grab,           // pick along `ray`, then grab the free vertices within `grabRadius` of the hit (Tissue::grab)
+    MoveGrab,       // move the grab by `offset`
+    ReleaseGrab,
+    WriteProfile    // write the sim profiler to tracePath / csvPath (strings must outlive the command, e.g. literals)
+};
+
+struct SimCommand
+{
+    SimCommandType type;
+    int vertex;
+    glm::vec3 offset;
+    const char* tracePath;
+    const char* csvPath;
+    PickRay ray;
+    float grabRadius;
+};
+
+// one published state: positions after step `step` and before it, both interleaved xyz
+struct PositionSnapshot
+{
+    std::vector<float> current;
+    std::vector<float> previous;
+    double time;        // seconds on the simulation clock at which `current` is due
+    uint64_t step;
+    SolveStats stats;
+    uint64_t version;   // Tissue::getPositionVersion of `current`
+    uint64_t rangesSince;
+    std::vector<std::pair<int, int>> ranges; // vertices changed after version rangesSince, see Tissue::getChangedRanges
+};
+
+const size_t SIM_COMMAND_CAPACITY = 256;
+const int SIM_MAX_CATCH_UP_STEPS = 4; // steps run back to back when behind, then the clock is resynced
+
+/*
+    SimulationThread
+        owns stepping of a Tissue at a fixed timestep on its own thread, paced to the wall clock
+        every step publishes a PositionSnapshot through a TripleBuffer, readPositions never blocks
+        input arrives as SimCommands through a lock-free queue; Grab picks on the sim thread, against the state
+        it is about to step, so the render thread needs no positions of its own to pick from
+    While it runs, nothing else may touch the Tissue's simulation state.
+*/
+class SimulationThread
+{
+    public:
+    // starts the thread; profiler (not owned, may be nullptr) is only touched by the sim thread from here on
+    // ------------------------------------------------------------------------
+    SimulationThread(Tissue& tissue, float timestep, glm::vec3 gravity, Profiler* profiler = nullptr)
+        : tissue(tissue), timestep(timestep), gravity(gravity), profiler(profiler),
+          snapshots(makeSnapshot(tissue)), picker(tissue), origin(std::chrono::steady_clock::now())
+    {
+        lastPublished = snapshots.front().current;
+        tissue.setProfiler(profiler);
+        thread = std::thread([this]() { run(); });
+    }
+
+    ~SimulationThread()
+    {
+        running.store(false, std::memory_order_relaxed);
+        thread.join();
+    }
+
+    SimulationThread(const SimulationThread&) = delete;
+    SimulationThread& operator=(const SimulationThread&) = delete;
+
+    // render thread: false when the queue is full and the command was dropped
+    bool send(const SimCommand& command) { return commands.push(command); }
+
+    // render thread: writes interleaved xyz for the newest state into destination. With interpolate the
+    // result blends the last two steps, trailing the simulation by one timestep, so motion stays smooth
+    // when the render and step rates differ. Returns false when there is nothing new to upload.
+    bool readPositions(float* destination, bool interpolate)
+    {
+        bool fresh = snapshots.update();
+        const PositionSnapshot& snapshot = snapshots.front();
+        if (!interpolate)
+        {
+            if (fresh) std::memcpy(destination, snapshot.current.data(), snapshot.current.size() * sizeof(float));
+            return fresh;
+        }
+
+        float alpha = (float)std::min(1.0, std::max(0.0, (now() - snapshot.time) / timestep));
+        for (size_t i = 0; i < snapshot.current.size(); i++)
+        {
+            destination[i] = snapshot.previous[i] + (snapshot.current[i] - snapshot.previous[i]) * alpha;
+        }
+        return true;
+    }
+
+    // render thread: readPositions without interpolation into a destination that holds the positions of version
+    // (0 = unknown). Copies only the ranges of the newest state that changed since, lists them in ranges and sets
+    // version to what destination holds now; with sleeping tiles most of it stays untouched. Returns false when
+    // there is nothing new.
+    bool readChangedPositions(float* destination, uint64_t& version, std::vector<std::pair<int, int>>& ranges)
+    {
+        if (!snapshots.update()) return false;
+        const PositionSnapshot& snapshot = snapshots.front();
+        if (version == 0 || version < snapshot.rangesSince) ranges.assign(1, { 0, (int)snapshot.current.size() / 3 });
+        else ranges = snapshot.ranges;
+        for (const std::pair<int, int>& range : ranges)
+        {
+            std::memcpy(destination + (size_t)range.first * 3, snapshot.current.data() + (size_t)range.first * 3,
+                        (size_t)(range.second - range.first) * 3 * sizeof(float));
+        }
+        version = snapshot.version;
+        return true;
+    }
+
+    // render thread: the oldest position version any destination of readChangedPositions still holds; the
+    // snapshots published from then on carry the ranges changed since it
+    void setHeldVersion(uint64_t version) { heldVersion.store(version, std::memory_order_relaxed); }
+
+    // render thread: stats of the step behind the last readPositions
+    SolveStats getLastSolveStats() const { return snapshots.front().stats; }
+    uint64_t getLastStep() const { return snapshots.front().step; }
+
+    private:
+    Tissue& tissue;
+    float timestep;
+    glm::vec3 gravity;
+    Profiler* profiler;
+    SpscQueue<SimCommand, SIM_COMMAND_CAPACITY> commands;
+    TripleBuffer<PositionSnapshot> snapshots;
+    std::vector<float> lastPublished; // sim thread only
+    VertexPicker picker;              // refitted on every Grab, sim thread only
+    GrabRegion grabRegion;
+    std::chrono::steady_clock::time_point origin;
+    std::atomic<uint64_t> heldVersion{ 0 };
+    std::atomic<bool> running{ true };
+    std::thread thread;
+
+    static PositionSnapshot makeSnapshot(const Tissue& tissue)
+    {
+        PositionSnapshot snapshot;
+        snapshot.current.resize(tissue.getVertexCount() * 3);
+        tissue.copyPositions(snapshot.current.data());
+        snapshot.previous = snapshot.current;
+        snapshot.time = 0.0;
+        snapshot.step = 0;
+        snapshot.stats = tissue.getLastSolveStats();
+        snapshot.version = tissue.getPositionVersion();
+        snapshot.rangesSince = 0;
+        return snapshot;
+    }
+
+    double now() const
+    {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - origin).count();
+    }
+
+    void applyCommands()
+    {
+        SimCommand command;
+        int dragged = -1;
+        glm::vec3 dragOffset(0.0f);
+        glm::vec3 grabOffset(0.0f);
+        while (commands.pop(command))
+        {
+            switch (command.type)
+            {
+                case SimCommandType::Drag:
+                    tissue.positions.set(command.vertex, tissue.positions.get(command.vertex) + command.offset);
+                    tissue.setVertexFixed(command.vertex, true);
+                    if (command.vertex != dragged) dragOffset = glm::vec3(0.0f);
+                    dragged = command.vertex;
+                    dragOffset += command.offset;
+                    break;
+                case SimCommandType::Release:
+                    tissue.setVertexFixed(command.vertex, false);
+                    break;
+                case SimCommandType::Grab:
+                    picker.refit();
+                    picker.getGrabRegion(picker.pick(command.ray), command.grabRadius, grabRegion);
+                    tissue.grab(grabRegion.vertices, grabRegion.weights);
+                    grabOffset = glm::vec3(0.0f);
+                    break;
+                case SimCommandType::MoveGrab:
+                    tissue.moveGrab(command.offset);
+                    grabOffset += command.offset;
+                    break;
+                case SimCommandType::ReleaseGrab:
+                    tissue.releaseGrab();
+                    break;
+                case SimCommandType::WriteProfile:
+                    if (profiler)
+                    {
+                        profiler->writeChromeTrace(command.tracePath);
+                        profiler->writeCsv(command.csvPath);
+                    }
+                    break;
+            }
+        }
+        if (dragged >= 0) tissue.velocities.set(dragged, dragOffset / timestep);
+        // the pinned part of the grab keeps the speed it was moved at, for when it is let go
+        for (size_t k = 0; k < grabRegion.vertices.size() && grabOffset != glm::vec3(0.0f); k++)
+        {
+            if (grabRegion.weights[k] >= 1.0f) tissue.velocities.set(grabRegion.vertices[k], grabOffset / timestep);
+        }
+    }
+
+    void run()
+    {
+        uint64_t step = 0;
+        double nextStepTime = timestep; // wall time at which the state after the next step is due
+        while (running.load(std::memory_order_relaxed))
+        {
+            double wait = nextStepTime - now();
+            if (wait > 0.0)
+            {
+                std::this_thread::sleep_for(std::chrono::duration<double>(std::min(wait, (double)timestep)));
+                continue;
+            }
+
+            // too far behind: drop the missed time instead of spiralling
+            if (-wait > SIM_MAX_CATCH_UP_STEPS * timestep) nextStepTime = now();
+
+            if (profiler) profiler->beginFrame();
+            applyCommands();
+            tissue.step(timestep, gravity);
+            if (profiler) profiler->endFrame();
+            step++;
+
+            PositionSnapshot& snapshot = snapshots.back();
+            std::memcpy(snapshot.previous.data(), lastPublished.data(), lastPublished.size() * sizeof(float));
+            tissue.copyPositions(snapshot.current.data());
+            std::memcpy(lastPublished.data(), snapshot.current.data(), lastPublished.size() * sizeof(float));
+            snapshot.time = nextStepTime;
+            snapshot.step = step;
+            snapshot.stats = tissue.getLastSolveStats();
+            snapshot.version = tissue.getPositionVersion();
+            snapshot.rangesSince = heldVersion.load(std::memory_order_relaxed);
+            tissue.getChangedRanges(snapshot.rangesSince, snapshot.ranges);
+            snapshots.publish();
+
+            nextStepTime += timestep;
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,108 @@
+#include "regression_tests.h"
+#include "simulation_thread.h"
+
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+// sleep-off: sleeping switched on but never triggered is bit-identical to sleeping off, drags included
+int testSleepOff()
+{
+    Tissue off(EDGE_COUNT, 1);
+    Tissue never(EDGE_COUNT, 1);
+    never.sleepVelocity = 1e-9f; // on, but no tile is ever this slow with its constraints at rest
+    never.sleepResidual = 0.0f;
+    for (int s = 0; s < STEPS; s++)
+    {
+        drag(off, s);
+        drag(never, s);
+        off.step(DELTA_TIME, GRAVITY);
+        never.step(DELTA_TIME, GRAVITY);
+    }
+    if (never.getAwakeVertexCount() != never.getVertexCount())
+    {
+        std::cout << "FAIL a tile fell asleep, the comparison is void" << std::endl;
+        return 1;
+    }
+    return expectSame(off, never, "sleeping on but untriggered vs off") ? 0 : 1;
+}
+
+// sleep-snapshot: a ring of three render-side copies fed by readChangedPositions, as the viewer's ring regions are,
+// holds exactly the state of the step read into it, while most reads skip the sleeping tiles
+int testSleepSnapshot()
+{
+    Tissue tissue(EDGE_COUNT, 1);
+    Tissue reference(EDGE_COUNT, 1);
+    for (Tissue* t : { &tissue, &reference })
+    {
+        t->sleepVelocity = 1e-3f;
+        t->sleepResidual = 1e-3f;
+        // a drift below sleepVelocity moves every tile up to the step it falls asleep; one vertex kicked keeps its own awake
+        for (int i = 0; i < t->getVertexCount(); i++) t->velocities.set(i, glm::vec3(0.0f, 0.0f, 5e-4f));
+        t->velocities.set(EDGE_COUNT * EDGE_COUNT / 2, glm::vec3(0.0f, 0.0f, 0.05f));
+    }
+    int count = tissue.getVertexCount();
+
+    const int RING = 3;
+    std::vector<float> copies[RING];
+    uint64_t versions[RING];
+    uint64_t steps[RING] = {};
+    for (int r = 0; r < RING; r++)
+    {
+        copies[r].resize((size_t)count * 3);
+        tissue.copyPositions(copies[r].data());
+        versions[r] = tissue.getPositionVersion();
+    }
+    int slot = 0, reads = 0, partialReads = 0;
+    {
+        SimulationThread simulation(tissue, DELTA_TIME, glm::vec3(0.0f));
+        std::vector<std::pair<int, int>> ranges;
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+        while (partialReads < 30 && std::chrono::steady_clock::now() < deadline)
+        {
+            int next = (slot + 1) % RING;
+            uint64_t version = versions[next];
+            if (simulation.readChangedPositions(copies[next].data(), version, ranges))
+            {
+                int copied = 0;
+                for (const std::pair<int, int>& range : ranges) copied += range.second - range.first;
+                reads++;
+                partialReads += copied < count;
+                versions[next] = version;
+                steps[next] = simulation.getLastStep();
+                slot = next;
+            }
+            simulation.setHeldVersion(versions[(slot + 1) % RING]);
+            std::this_thread::sleep_for(std::chrono::milliseconds(4));
+        }
+    }
+    if (partialReads < 30)
+    {
+        std::cout << "FAIL " << reads << " reads, only " << partialReads << " skipped sleeping tiles" << std::endl;
+        return 1;
+    }
+
+    // no commands, so the thread's steps replay exactly
+    std::vector<float> expected((size_t)count * 3);
+    for (uint64_t s = 0; s <= steps[slot]; s++)
+    {
+        for (int r = 0; r < RING; r++)
+        {
+            if (steps[r] != s) continue;
+            reference.copyPositions(expected.data());
+            if (std::memcmp(copies[r].data(), expected.data(), expected.size() * sizeof(float)) != 0)
+            {
+                std::cout << "FAIL the copy read at step " << s << " differs from that step after " << reads << " reads" << std::endl;
+                return 1;
+            }
+        }
+        reference.step(DELTA_TIME, glm::vec3(0.0f));
+    }
+    std::cout << reads << " reads up to step " << steps[slot] << ", " << partialReads << " skipped sleeping tiles" << std::endl;
+    return 0;
+}
+
+static RegressionCase sleepOff("sleep-off", testSleepOff);
+static RegressionCase sleepSnapshot("sleep-snapshot", testSleepSnapshot);
@@ -0,0 +1,26 @@
+#include "regression_tests.h"
+
+#include <string>
+
+// threads: 1 and 4 solver threads give bit-identical states, PBD and XPBD
+int testThreads()
+{
+    bool pass = true;
+    for (Integrator integrator : { Integrator::PBD, Integrator::XPBD })
+    {
+        Tissue serial(EDGE_COUNT, 1, 0.001f, integrator);
+        Tissue parallel(EDGE_COUNT, 1, 0.001f, integrator);
+        parallel.setThreadCount(4);
+        for (int s = 0; s < STEPS; s++)
+        {
+            drag(serial, s);
+            drag(parallel, s);
+            serial.step(DELTA_TIME, GRAVITY);
+            parallel.step(DELTA_TIME, GRAVITY);
+        }
+        pass &= expectSame(serial, parallel, std::string(integrator == Integrator::XPBD ? "XPBD" : "PBD") + ", 1 vs 4 threads");
+    }
+    return pass ? 0 : 1;
+}
+
+static RegressionCase threads("threads", testThreads);
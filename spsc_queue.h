@@ -0,0 +1,48 @@
+#ifndef SPSC_QUEUE_H
+#define SPSC_QUEUE_H
+
+#include <atomic>
+#include <cstddef>
+
+/*
+    SpscQueue (one producer thread, one consumer thread, lock-free)
+        fixed ring of Capacity slots (a power of two), no allocation after construction
+        push returns false when full, pop returns false when empty; neither ever blocks
+*/
+template<typename T, size_t Capacity>
+class SpscQueue
+{
+    static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0, "SpscQueue capacity must be a power of two");
+
+    public:
+    SpscQueue() = default;
+    SpscQueue(const SpscQueue&) = delete;
+    SpscQueue& operator=(const SpscQueue&) = delete;
+
+    // producer side
+    bool push(const T& item)
+    {
+        size_t tail = this->tail.load(std::memory_order_relaxed);
+        if (tail - head.load(std::memory_order_acquire) == Capacity) return false;
+        slots[tail & (Capacity - 1)] = item;
+        this->tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // consumer side
+    bool pop(T& item)
+    {
+        size_t head = this->head.load(std::memory_order_relaxed);
+        if (head == tail.load(std::memory_order_acquire)) return false;
+        item = slots[head & (Capacity - 1)];
+        this->head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    private:
+    T slots[Capacity];
+    alignas(64) std::atomic<size_t> head{ 0 }; // next slot to pop, written by the consumer
+    alignas(64) std::atomic<size_t> tail{ 0 }; // next slot to push, written by the producer
+};
+
+#endif
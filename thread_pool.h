@@ -0,0 +1,135 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+/*
+    ThreadPool
+        fixed set of workers + the calling thread
+        parallelFor(count, fn) runs fn(index) for index in [0, count) and returns when all are done
+        index -> work mapping is up to the caller, so results do not depend on which thread ran what
+*/
+class ThreadPool
+{
+    public:
+    // threadCount includes the calling thread, so ThreadPool(4) starts 3 workers
+    // ------------------------------------------------------------------------
+    explicit ThreadPool(int threadCount)
+    {
+        for (int i = 1; i < threadCount; i++)
+        {
+            workers.emplace_back([this]() { workerLoop(); });
+        }
+    }
+
+    ~ThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (std::thread& worker : workers) worker.join();
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    int getThreadCount() const { return (int)workers.size() + 1; }
+
+    // fn is called as fn(int index); it is only referenced, never copied or heap-allocated
+    template<typename F>
+    void parallelFor(int count, F&& fn)
+    {
+        if (count <= 0) return;
+        if (workers.empty() || count == 1)
+        {
+            for (int i = 0; i < count; i++) fn(i);
+            return;
+        }
+
+        uint64_t job;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            job = ++generation;
+            jobCount = count;
+            jobContext = (void*)&fn;
+            jobInvoke = [](void* context, int index) { (*(typename std::remove_reference<F>::type*)context)(index); };
+            remaining.store(count, std::memory_order_relaxed);
+            nextIndex.store(job << 32, std::memory_order_relaxed);
+            published.store(job, std::memory_order_release);
+        }
+        wake.notify_all();
+
+        runChunks(job, jobInvoke, jobContext, count);
+        while (remaining.load(std::memory_order_acquire) != 0) std::this_thread::yield();
+    }
+
+    private:
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable wake;
+    bool stopping = false;
+
+    // job description, written under mutex
+    uint64_t generation = 0;
+    int jobCount = 0;
+    void* jobContext = nullptr;
+    void (*jobInvoke)(void*, int) = nullptr;
+
+    std::atomic<uint64_t> published{0};
+    // high 32 bits: job generation, low 32 bits: next index to claim
+    std::atomic<uint64_t> nextIndex{0};
+    std::atomic<int> remaining{0};
+
+    void workerLoop()
+    {
+        uint64_t seen = 0;
+        while (true)
+        {
+            // spin briefly first: solver sweeps post many short jobs back to back
+            for (int spin = 0; spin < 4096 && published.load(std::memory_order_acquire) == seen; spin++)
+            {
+                std::this_thread::yield();
+            }
+
+            uint64_t job;
+            int count;
+            void* context;
+            void (*invoke)(void*, int);
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [&]() { return stopping || generation != seen; });
+                if (stopping) return;
+                job = generation;
+                count = jobCount;
+                context = jobContext;
+                invoke = jobInvoke;
+            }
+            seen = job;
+            runChunks(job, invoke, context, count);
+        }
+    }
+
+    void runChunks(uint64_t job, void (*invoke)(void*, int), void* context, int count)
+    {
+        while (true)
+        {
+            // claiming is tagged with the job generation so a late worker can never take work from a newer job
+            uint64_t current = nextIndex.load(std::memory_order_relaxed);
+            if ((current >> 32) != job || (int)(current & 0xffffffffu) >= count) return;
+            if (!nextIndex.compare_exchange_weak(current, current + 1, std::memory_order_acq_rel)) continue;
+
+            invoke(context, (int)(current & 0xffffffffu));
+            remaining.fetch_sub(1, std::memory_order_acq_rel);
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,1399 @@
+#include "tissue.h"
+#include "checkpoint.h"
+#include "grid_hierarchy.h"
+#include "grid_solver.h"
+#include "profiler.h"
+#include "sdf_obstacle.h"
+#include "self_collision.h"
+#include "simd.h"
+#include "thread_pool.h"
+#include "tissue_model.h"
+#include "vertex_order.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <limits>
+
+// constraints handed to one pool task; smaller color batches are solved inline
+const int CONSTRAINTS_PER_TASK = 2048;
+// vertices per damping reduction chunk; fixed so the summation order never changes
+const int DAMPING_CHUNK = 4096;
+static_assert(DAMPING_CHUNK % SLEEP_TILE == 0, "a damping chunk holds whole sleep tiles");
+
+Tissue::Tissue(int edgeCount, int maxEdgeWidth, float mass, Integrator integrator, VertexOrder order, GridConstraints constraints)
+    : integrator(integrator), edgeCount(edgeCount), maxEdgeWidth(maxEdgeWidth), weight(1.0f/mass)
+{
+    setDefaultSettings();
+    createPositions(edgeCount,maxEdgeWidth);
+    bodyOffsets = { 0, getVertexCount() };
+
+    estimatedPositions = positions;
+    velocities.resize(positions.size()); // zero initialised
+
+    if(constraints == GridConstraints::Implicit)
+    {
+        createImplicitConstraints();
+        reorderVertices(order);
+        resetSleep();
+        return;
+    }
+    createStretchConstraints();
+    colorStretchConstraints();
+    stretchConstraintLambda.assign(getConstraintCount(), 0.0f);
+    allocateSolverScratch();
+    reorderVertices(order);
+    resetSleep();
+}
+
+Tissue::Tissue(const TissueModel& model, float mass, Integrator integrator, VertexOrder order)
+    : integrator(integrator), edgeCount(0), maxEdgeWidth(0), weight(1.0f/mass)
+{
+    setDefaultSettings();
+
+    positions = model.positions;
+    bodyOffsets = { 0, getVertexCount() };
+    inverseMass.assign(positions.size(), weight);
+    for(int i : model.fixedVertices) inverseMass[i] = 0.0f;
+    estimatedPositions = positions;
+    velocities.resize(positions.size()); // zero initialised
+    surfaceTriangles = model.triangles;
+
+    for(int e=0; e<model.getEdgeCount(); e++) addStretchConstraint(model.edgeFirst[e], model.edgeSecond[e]);
+    colorStretchConstraints();
+    stretchConstraintLambda.assign(getConstraintCount(), 0.0f);
+    allocateSolverScratch();
+    reorderVertices(order);
+    resetSleep();
+}
+
+template<typename T>
+void loadSection(const Checkpoint& checkpoint, CheckpointSectionId id, std::vector<T>& destination)
+{
+    uint64_t count;
+    const T* source = (const T*)checkpoint.getSection(id, count);
+    destination.assign(source, source + count);
+}
+
+// every array comes straight out of the (validated, mapped) checkpoint; nothing is recomputed
+Tissue::Tissue(const Checkpoint& checkpoint)
+{
+    const CheckpointHeader& header = checkpoint.getHeader();
+    integrator = (Integrator)header.integrator;
+    edgeCount = header.edgeCount;
+    maxEdgeWidth = header.maxEdgeWidth;
+    weight = header.weight;
+    iterations = header.iterations;
+    substeps = header.substeps;
+    compliance = header.compliance;
+    dampingFactor = header.dampingFactor;
+    residualTolerance = header.residualTolerance;
+    solverBudgetMs = header.solverBudgetMs;
+    sleepVelocity = header.sleepVelocity;
+    sleepResidual = header.sleepResidual;
+    selfCollisionThickness = header.selfCollisionThickness;
+    obstacleMargin = header.obstacleMargin;
+    positionVersion = 0;
+    substepTime = 0.0f;
+    lastResidual = {0.0f, 0.0f};
+    lastSolve = {0, {0.0f, 0.0f}, 0.0f, false};
+    profiler = nullptr;
+
+    loadSection(checkpoint, CheckpointSectionId::PositionsX, positions.x);
+    loadSection(checkpoint, CheckpointSectionId::PositionsY, positions.y);
+    loadSection(checkpoint, CheckpointSectionId::PositionsZ, positions.z);
+    loadSection(checkpoint, CheckpointSectionId::VelocitiesX, velocities.x);
+    loadSection(checkpoint, CheckpointSectionId::VelocitiesY, velocities.y);
+    loadSection(checkpoint, CheckpointSectionId::VelocitiesZ, velocities.z);
+    loadSection(checkpoint, CheckpointSectionId::InverseMass, inverseMass);
+    loadSection(checkpoint, CheckpointSectionId::ConstraintFirst, stretchConstraintFirst);
+    loadSection(checkpoint, CheckpointSectionId::ConstraintSecond, stretchConstraintSecond);
+    loadSection(checkpoint, CheckpointSectionId::ConstraintRestLength, stretchConstraintsRestLength);
+    loadSection(checkpoint, CheckpointSectionId::ConstraintLambda, stretchConstraintLambda);
+    loadSection(checkpoint, CheckpointSectionId::ColorOffsets, stretchConstraintColorOffsets);
+    loadSection(checkpoint, CheckpointSectionId::SurfaceTriangles, surfaceTriangles);
+    loadSection(checkpoint, CheckpointSectionId::VertexPermutation, vertexPermutation);
+    loadSection(checkpoint, CheckpointSectionId::BodyOffsets, bodyOffsets);
+    if (bodyOffsets.empty()) bodyOffsets = { 0, getVertexCount() }; // older files
+    estimatedPositions = positions;
+    if(header.gridConstraints == (uint32_t)GridConstraints::Implicit) createImplicitConstraints();
+    allocateSolverScratch();
+    setMultigridLevels(header.multigridLevels);
+    resetSleep();
+}
+
+Tissue::Tissue(const std::vector<TissueInstance>& instances)
+    : edgeCount(0), maxEdgeWidth(0)
+{
+    // the first body that can be packed sets the integrator, mass and settings the others must share
+    const Tissue* front = nullptr;
+    std::vector<bool> accepted(instances.size());
+    int vertexCount = 0, colorCount = 0;
+    bool permuted = false;
+    for(size_t b=0; b<instances.size(); b++)
+    {
+        const Tissue* source = instances[b].source;
+        if (!source) std::cout << "ERROR::TISSUE::BATCH_BODY_HAS_NO_SOURCE body " << b << std::endl;
+        else if (source->gridSolver) std::cout << "ERROR::TISSUE::BATCH_NEEDS_EXPLICIT_CONSTRAINTS body " << b << std::endl;
+        else if (front && (source->integrator != front->integrator || source->weight != front->weight)) std::cout << "ERROR::TISSUE::BATCH_NEEDS_ONE_INTEGRATOR_AND_MASS body " << b << std::endl;
+        else accepted[b] = true;
+        if (!accepted[b]) continue;
+        if (!front) front = source;
+        vertexCount += source->getVertexCount();
+        colorCount = std::max(colorCount, source->getColorCount());
+        permuted = permuted || !source->vertexPermutation.empty();
+    }
+    if (!front) std::cout << "ERROR::TISSUE::BATCH_IS_EMPTY " << instances.size() << " bodies, none usable" << std::endl;
+
+    integrator = front ? front->integrator : Integrator::PBD;
+    weight = front ? front->weight : 1.0f/0.001f;
+    setDefaultSettings();
+    if (front)
+    {
+        iterations = front->iterations;
+        substeps = front->substeps;
+        compliance = front->compliance;
+        dampingFactor = front->dampingFactor;
+        residualTolerance = front->residualTolerance;
+        solverBudgetMs = front->solverBudgetMs;
+        sleepVelocity = front->sleepVelocity;
+        sleepResidual = front->sleepResidual;
+        selfCollisionThickness = front->selfCollisionThickness;
+        obstacleMargin = front->obstacleMargin;
+    }
+
+    positions.resize(vertexCount);
+    velocities.resize(vertexCount);
+    inverseMass.resize(vertexCount);
+    if (permuted) vertexPermutation.resize(vertexCount);
+    bodyOffsets.assign(1, 0);
+    for(size_t b=0; b<instances.size(); b++)
+    {
+        int base = bodyOffsets.back();
+        bodyOffsets.push_back(base);
+        if (!accepted[b]) continue;
+
+        const TissueInstance& instance = instances[b];
+        const Tissue& source = *instance.source;
+        for(int i=0; i<source.getVertexCount(); i++)
+        {
+            positions.set(base + i, source.positions.get(i) * instance.scale + instance.offset);
+            velocities.set(base + i, source.velocities.get(i) * instance.scale);
+            inverseMass[base + i] = source.inverseMass[i];
+            if (permuted) vertexPermutation[base + i] = base + source.getVertexIndex(i);
+        }
+        for(unsigned int index : source.getDrawTriangles()) surfaceTriangles.push_back(base + index);
+        bodyOffsets.back() += source.getVertexCount();
+    }
+    if (instances.empty()) bodyOffsets.push_back(0); // one empty body, as an empty model would have
+    estimatedPositions = positions;
+
+    // bodies share no vertices, so color c of every body together is still a color
+    stretchConstraintColorOffsets.assign(1, 0);
+    for(int c=0; c<colorCount; c++)
+    {
+        for(size_t b=0; b<instances.size(); b++)
+        {
+            if (!accepted[b]) continue; // refused bodies may have no source at all
+            const Tissue& source = *instances[b].source;
+            if (c >= source.getColorCount()) continue;
+            for(int i=source.stretchConstraintColorOffsets[c]; i<source.stretchConstraintColorOffsets[c+1]; i++)
+            {
+                stretchConstraintFirst.push_back(bodyOffsets[b] + source.stretchConstraintFirst[i]);
+                stretchConstraintSecond.push_back(bodyOffsets[b] + source.stretchConstraintSecond[i]);
+                stretchConstraintsRestLength.push_back(source.stretchConstraintsRestLength[i] * instances[b].scale);
+            }
+        }
+        stretchConstraintColorOffsets.push_back((int)stretchConstraintFirst.size());
+    }
+    stretchConstraintLambda.assign(getConstraintCount(), 0.0f);
+    allocateSolverScratch();
+    resetSleep();
+}
+
+Tissue::~Tissue() = default;
+
+void Tissue::setDefaultSettings()
+{
+    // XPBD reaches the target stiffness with substeps instead of sweeps
+    iterations = integrator == Integrator::PBD ? 20 : 1;
+    substeps = integrator == Integrator::PBD ? 1 : 20;
+    compliance = 0.0f;
+    dampingFactor = 0.01f;
+    residualTolerance = 0.0f;
+    solverBudgetMs = 0.0f;
+    sleepVelocity = 0.0f;
+    sleepResidual = 0.0f;
+    selfCollisionThickness = 0.0f;
+    obstacleMargin = 0.0f;
+    positionVersion = 0;
+    substepTime = 0.0f;
+    lastResidual = {0.0f, 0.0f};
+    lastSolve = {0, {0.0f, 0.0f}, 0.0f, false};
+    profiler = nullptr;
+}
+
+void Tissue::allocateSolverScratch()
+{
+    int maxTasks = 0;
+    for(int c=0; c+1<(int)stretchConstraintColorOffsets.size(); c++)
+    {
+        int size = stretchConstraintColorOffsets[c+1] - stretchConstraintColorOffsets[c];
+        maxTasks = std::max(maxTasks, (size + CONSTRAINTS_PER_TASK - 1) / CONSTRAINTS_PER_TASK);
+    }
+    residualPartials.resize(maxTasks);
+}
+
+int Tissue::getConstraintCount() const
+{
+    return gridSolver ? gridSolver->getConstraintCount() : (int)stretchConstraintFirst.size();
+}
+
+int Tissue::getColorCount() const
+{
+    return gridSolver ? gridSolver->getColorCount() : (int)stretchConstraintColorOffsets.size() - 1;
+}
+
+size_t Tissue::getConstraintMemoryBytes() const
+{
+    if (gridSolver) return gridSolver->getMemoryBytes();
+    return (stretchConstraintFirst.size() + stretchConstraintSecond.size()) * sizeof(int)
+        + (stretchConstraintsRestLength.size() + stretchConstraintLambda.size()) * sizeof(float)
+        + stretchConstraintColorOffsets.size() * sizeof(int)
+        + residualPartials.size() * sizeof(ResidualPartial);
+}
+
+void Tissue::reorderVertices(VertexOrder order)
+{
+    if (gridSolver && order != VertexOrder::Build)
+    {
+        std::cout << "ERROR::TISSUE::IMPLICIT_GRID_CONSTRAINTS_NEED_BUILD_ORDER" << std::endl;
+        return;
+    }
+    if (order == VertexOrder::Morton) permuteVertices(computeMortonOrder(positions));
+    else if (order == VertexOrder::RCM) permuteVertices(computeRcmOrder(getVertexCount(), stretchConstraintFirst, stretchConstraintSecond));
+}
+
+template<typename T>
+void permuteStream(std::vector<T>& values, const std::vector<int>& newIndex)
+{
+    std::vector<T> permuted(values.size());
+    for(size_t i=0; i<values.size(); i++) permuted[newIndex[i]] = values[i];
+    values.swap(permuted);
+}
+
+// Constraints keep their color; inside a color they are sorted by lower endpoint, so a sweep
+// gathers vertices in ascending order and neighbouring lanes hit neighbouring cache lines.
+void Tissue::permuteVertices(const std::vector<int>& newIndex)
+{
+    if (gridSolver)
+    {
+        std::cout << "ERROR::TISSUE::IMPLICIT_GRID_CONSTRAINTS_NEED_BUILD_ORDER" << std::endl;
+        return;
+    }
+    if (hierarchy)
+    {
+        std::cout << "ERROR::TISSUE::MULTIGRID_NEEDS_GRID_IN_BUILD_ORDER" << std::endl;
+        return;
+    }
+    if (getBodyCount() > 1)
+    {
+        std::cout << "ERROR::TISSUE::BATCH_KEEPS_ITS_SOURCES_VERTEX_ORDER" << std::endl;
+        return;
+    }
+    selfCollision.reset(); // its neighbours hold the old indices
+    Vec3Streams* streams[] = { &positions, &estimatedPositions, &velocities };
+    for(Vec3Streams* stream : streams)
+    {
+        permuteStream(stream->x, newIndex);
+        permuteStream(stream->y, newIndex);
+        permuteStream(stream->z, newIndex);
+    }
+    permuteStream(inverseMass, newIndex);
+    for(unsigned int& index : surfaceTriangles) index = newIndex[index];
+    if (vertexPermutation.empty()) vertexPermutation = newIndex;
+    else for(int& index : vertexPermutation) index = newIndex[index];
+
+    std::vector<uint64_t> keys(getConstraintCount()); // lower endpoint << 32 | constraint
+    std::vector<int> first(getConstraintCount()), second(getConstraintCount());
+    std::vector<float> restLength(getConstraintCount()), lambda(getConstraintCount());
+    for(int c=0; c<getColorCount(); c++)
+    {
+        int begin = stretchConstraintColorOffsets[c], end = stretchConstraintColorOffsets[c+1];
+        for(int i=begin; i<end; i++)
+        {
+            uint64_t lower = std::min(newIndex[stretchConstraintFirst[i]], newIndex[stretchConstraintSecond[i]]);
+            keys[i] = lower << 32 | (uint32_t)i;
+        }
+        std::sort(keys.begin() + begin, keys.begin() + end);
+        for(int i=begin; i<end; i++)
+        {
+            int source = (int)(keys[i] & 0xffffffffu);
+            first[i] = newIndex[stretchConstraintFirst[source]];
+            second[i] = newIndex[stretchConstraintSecond[source]];
+            restLength[i] = stretchConstraintsRestLength[source];
+            lambda[i] = stretchConstraintLambda[source];
+        }
+    }
+    stretchConstraintFirst.swap(first);
+    stretchConstraintSecond.swap(second);
+    stretchConstraintsRestLength.swap(restLength);
+    stretchConstraintLambda.swap(lambda);
+    resetSleep();
+}
+
+void Tissue::setThreadCount(int threadCount)
+{
+    if (threadCount <= 1) threadPool.reset();
+    else if (!threadPool || threadPool->getThreadCount() != threadCount) threadPool.reset(new ThreadPool(threadCount));
+}
+
+int Tissue::getThreadCount() const
+{
+    return threadPool ? threadPool->getThreadCount() : 1;
+}
+
+void Tissue::setMultigridLevels(int levels)
+{
+    if (levels <= 0)
+    {
+        hierarchy.reset();
+        return;
+    }
+    if (edgeCount < 2 || !vertexPermutation.empty())
+    {
+        std::cout << "ERROR::TISSUE::MULTIGRID_NEEDS_GRID_IN_BUILD_ORDER" << std::endl;
+        return;
+    }
+    hierarchy.reset(new GridHierarchy(edgeCount, maxEdgeWidth, levels, weight, integrator, CONSTRAINTS_PER_TASK));
+}
+
+int Tissue::getMultigridLevels() const
+{
+    return hierarchy ? hierarchy->getLevelCount() : 0;
+}
+
+std::vector<unsigned int> Tissue::getDrawTriangles() const
+{
+    if (edgeCount < 2) return surfaceTriangles;
+
+    std::vector<unsigned int> indices((edgeCount-1)*(edgeCount-1)*6); // 6 indices per quad
+    for(int i=0; i<edgeCount-1; i++){
+        for(int j=0; j<edgeCount-1; j++)
+        {
+            indices[(i*(edgeCount-1)+j)*6+0] = getVertexIndex(i*edgeCount + j);         // top left
+            indices[(i*(edgeCount-1)+j)*6+1] = getVertexIndex(i*edgeCount + (j+1));     // top right
+            indices[(i*(edgeCount-1)+j)*6+2] = getVertexIndex((i+1)*edgeCount + (j+1)); // bottom right
+            indices[(i*(edgeCount-1)+j)*6+3] = getVertexIndex(i*edgeCount + j);         // top left
+            indices[(i*(edgeCount-1)+j)*6+4] = getVertexIndex((i+1)*edgeCount + (j+1)); // bottom right
+            indices[(i*(edgeCount-1)+j)*6+5] = getVertexIndex((i+1)*edgeCount + j);     // bottom left
+        }
+    }
+    return indices;
+}
+
+const char* Tissue::getSimdName()
+{
+    return simd::NAME;
+}
+
+void Tissue::copyPositions(float* destination) const
+{
+    copyPositions(destination, 0, positions.size());
+}
+
+void Tissue::copyPositions(float* destination, int begin, int end) const
+{
+    for(int i=begin; i<end; i++)
+    {
+        destination[i*3 + 0] = positions.x[i];
+        destination[i*3 + 1] = positions.y[i];
+        destination[i*3 + 2] = positions.z[i];
+    }
+}
+
+void Tissue::setVertexFixed(int i, bool fixed)
+{
+    inverseMass[i] = fixed ? 0.0f : weight;
+    wakeVertex(i);
+    sleep.inverseMass[i] = inverseMass[i];
+}
+
+// sleeping needs the explicit constraint arrays, the implicit grid and the coarse levels have no per-tile view
+bool Tissue::isSleepEnabled() const
+{
+    return sleepVelocity > 0.0f && !gridSolver && !hierarchy;
+}
+
+// every tile awake and changed, after construction or a vertex permutation
+void Tissue::resetSleep()
+{
+    int tiles = (getVertexCount() + SLEEP_TILE - 1) / SLEEP_TILE;
+    positionVersion++;
+    sleep.awake.assign(tiles, 1);
+    sleep.quietSteps.assign(tiles, 0);
+    sleep.version.assign(tiles, positionVersion);
+    sleep.moments.assign(tiles, DampingPartial());
+    sleep.inverseMass = inverseMass;
+    sleep.asleep = 0;
+    buildTileConstraints();
+    rebuildAwakeSet(); // so the stage functions work before the first step()
+}
+
+// constraints touching each tile, ascending; a constraint between two tiles is listed under both
+void Tissue::buildTileConstraints()
+{
+    int tiles = (int)sleep.awake.size();
+    int count = (int)stretchConstraintFirst.size();
+    sleep.constraintOffsets.assign(tiles + 1, 0);
+    for(int i=0; i<count; i++)
+    {
+        int t1 = stretchConstraintFirst[i] / SLEEP_TILE, t2 = stretchConstraintSecond[i] / SLEEP_TILE;
+        sleep.constraintOffsets[t1 + 1]++;
+        if(t2 != t1) sleep.constraintOffsets[t2 + 1]++;
+    }
+    for(int t=0; t<tiles; t++) sleep.constraintOffsets[t+1] += sleep.constraintOffsets[t];
+
+    std::vector<int> cursor(sleep.constraintOffsets.begin(), sleep.constraintOffsets.end() - 1);
+    sleep.constraints.resize(sleep.constraintOffsets[tiles]);
+    for(int i=0; i<count; i++)
+    {
+        int t1 = stretchConstraintFirst[i] / SLEEP_TILE, t2 = stretchConstraintSecond[i] / SLEEP_TILE;
+        sleep.constraints[cursor[t1]++] = i;
+        if(t2 != t1) sleep.constraints[cursor[t2]++] = i;
+    }
+}
+
+// Awake runs, and while tiles sleep the constraints of the awake tiles as a subsequence of the colored arrays, so
+// colors and the order inside them stay as they were. Gathers from the awake tiles only.
+void Tissue::rebuildAwakeSet()
+{
+    int count = getVertexCount();
+    sleep.awakeRuns.clear();
+    for(int t=0; t<(int)sleep.awake.size(); t++)
+    {
+        if(!sleep.awake[t]) continue;
+        int begin = t * SLEEP_TILE, end = std::min(begin + SLEEP_TILE, count);
+        if(!sleep.awakeRuns.empty() && sleep.awakeRuns.back().second == begin) sleep.awakeRuns.back().second = end;
+        else sleep.awakeRuns.emplace_back(begin, end);
+    }
+    sleep.changed = false;
+
+    sleep.first.clear();
+    sleep.second.clear();
+    sleep.restLength.clear();
+    sleep.colorOffsets.clear();
+    if(sleep.asleep == 0) return;
+
+    std::vector<int> selected;
+    for(const std::pair<int, int>& run : sleep.awakeRuns)
+    {
+        for(int t=run.first / SLEEP_TILE; t * SLEEP_TILE < run.second; t++)
+        {
+            selected.insert(selected.end(), sleep.constraints.begin() + sleep.constraintOffsets[t],
+                            sleep.constraints.begin() + sleep.constraintOffsets[t+1]);
+        }
+    }
+    std::sort(selected.begin(), selected.end());
+    selected.erase(std::unique(selected.begin(), selected.end()), selected.end());
+
+    for(int i : selected)
+    {
+        sleep.first.push_back(stretchConstraintFirst[i]);
+        sleep.second.push_back(stretchConstraintSecond[i]);
+        sleep.restLength.push_back(stretchConstraintsRestLength[i]);
+    }
+    sleep.lambda.assign(selected.size(), 0.0f);
+    for(int color : stretchConstraintColorOffsets)
+    {
+        sleep.colorOffsets.push_back((int)(std::lower_bound(selected.begin(), selected.end(), color) - selected.begin()));
+    }
+}
+
+void Tissue::wakeTile(int tile)
+{
+    sleep.quietSteps[tile] = 0;
+    if(sleep.awake[tile]) return;
+
+    int begin = tile * SLEEP_TILE, end = std::min(begin + SLEEP_TILE, getVertexCount());
+    std::copy(inverseMass.begin() + begin, inverseMass.begin() + end, sleep.inverseMass.begin() + begin);
+    sleep.awake[tile] = 1;
+    sleep.asleep--;
+    sleep.changed = true;
+}
+
+// velocities go to 0, so the damping moments only need the masses and positions, which stay put until the tile wakes
+void Tissue::sleepTile(int tile)
+{
+    int begin = tile * SLEEP_TILE, end = std::min(begin + SLEEP_TILE, getVertexCount());
+    for(int i=begin; i<end; i++) velocities.set(i, glm::vec3(0.0f));
+    sleep.moments[tile] = DampingPartial();
+    accumulateDampingMoments(sleep.moments[tile], begin, end);
+    std::fill(sleep.inverseMass.begin() + begin, sleep.inverseMass.begin() + end, 0.0f);
+    sleep.awake[tile] = 0;
+    sleep.asleep++;
+    sleep.changed = true;
+}
+
+void Tissue::wakeVertex(int i)
+{
+    int tile = i / SLEEP_TILE;
+    wakeTile(tile);
+    sleep.version[tile] = ++positionVersion;
+}
+
+void Tissue::wakeAll()
+{
+    positionVersion++;
+    for(int t=0; t<(int)sleep.awake.size(); t++)
+    {
+        wakeTile(t);
+        sleep.version[t] = positionVersion;
+    }
+}
+
+int Tissue::getAwakeVertexCount() const
+{
+    int count = getVertexCount(), awake = 0;
+    for(int t=0; t<(int)sleep.awake.size(); t++)
+    {
+        if(sleep.awake[t]) awake += std::min((t + 1) * SLEEP_TILE, count) - t * SLEEP_TILE;
+    }
+    return awake;
+}
+
+void Tissue::getChangedRanges(uint64_t sinceVersion, std::vector<std::pair<int, int>>& ranges) const
+{
+    int count = getVertexCount();
+    ranges.clear();
+    for(int t=0; t<(int)sleep.version.size(); t++)
+    {
+        if(sleep.version[t] <= sinceVersion) continue;
+        int begin = t * SLEEP_TILE, end = std::min(begin + SLEEP_TILE, count);
+        if(!ranges.empty() && ranges.back().second == begin) ranges.back().second = end;
+        else ranges.emplace_back(begin, end);
+    }
+}
+
+// End of step: the awake tiles were integrated and get the new positionVersion. One of them that has every vertex
+// slower than sleepVelocity and every constraint within sleepResidual for SLEEP_STEPS steps in a row falls asleep;
+// a constraint stretched past sleepResidual wakes the sleeping tile at its other end. Visits the awake tiles only.
+void Tissue::updateSleep()
+{
+    positionVersion++;
+    bool enabled = isSleepEnabled();
+    int count = getVertexCount();
+    float speedLimit = sleepVelocity * sleepVelocity;
+
+    for(const std::pair<int, int>& run : sleep.awakeRuns)
+    {
+        for(int begin=run.first; begin<run.second; begin+=SLEEP_TILE)
+        {
+            int tile = begin / SLEEP_TILE;
+            int end = std::min(begin + SLEEP_TILE, count);
+            sleep.version[tile] = positionVersion;
+            if(!enabled) continue;
+
+            bool quiet = true;
+            for(int i=begin; i<end && quiet; i++)
+            {
+                glm::vec3 v = velocities.get(i);
+                quiet = glm::dot(v, v) < speedLimit;
+            }
+            for(int k=sleep.constraintOffsets[tile]; k<sleep.constraintOffsets[tile+1]; k++)
+            {
+                int c = sleep.constraints[k];
+                int i1 = stretchConstraintFirst[c], i2 = stretchConstraintSecond[c];
+                float deltaLength = glm::length(positions.get(i1) - positions.get(i2)) - stretchConstraintsRestLength[c];
+                if(std::fabs(deltaLength) <= sleepResidual) continue;
+
+                quiet = false;
+                int other = i1 / SLEEP_TILE == tile ? i2 / SLEEP_TILE : i1 / SLEEP_TILE;
+                if(!sleep.awake[other]) wakeTile(other);
+            }
+
+            sleep.quietSteps[tile] = quiet ? sleep.quietSteps[tile] + 1 : 0;
+            if(sleep.quietSteps[tile] >= SLEEP_STEPS) sleepTile(tile);
+        }
+    }
+}
+
+void Tissue::step(float deltaTime, glm::vec3 gravity)
+{
+    if(!isSleepEnabled() && sleep.asleep > 0) wakeAll();
+    for(size_t o=0; o<obstacles.size(); o++)
+    {
+        // a moved obstacle may reach into sleeping tiles
+        if(obstacles[o]->getPoseVersion() == obstaclePoseVersions[o]) continue;
+        obstaclePoseVersions[o] = obstacles[o]->getPoseVersion();
+        if(sleep.asleep > 0) wakeAll();
+    }
+    if(sleep.changed) rebuildAwakeSet();
+
+    float h = deltaTime / substeps;
+    double budget = solverBudgetMs > 0.0f ? solverBudgetMs * 1e-3 : std::numeric_limits<double>::infinity();
+    double solverSeconds = 0.0;
+    lastSolve = {0, lastResidual, 0.0f, false};
+
+    for(int s=0; s<substeps; s++)
+    {
+        {
+            ProfileScope scope(profiler, Stage::AddGravity);
+            addGravity(h, gravity);
+        }
+        if(s == 0)
+        {
+            ProfileScope scope(profiler, Stage::ApplyDamping);
+            applyDamping(dampingFactor);
+        }
+        {
+            ProfileScope scope(profiler, Stage::UpdateEstimatedPositions);
+            updateEstimatedPositions(h);
+        }
+        if(selfCollisionThickness > 0.0f)
+        {
+            ProfileScope scope(profiler, Stage::SelfCollision);
+            findCollisionPairs();
+        }
+
+        beginSubstep(h);
+        solverSeconds += solveAdaptive((budget - solverSeconds) / (substeps - s));
+
+        ProfileScope scope(profiler, Stage::UpdateVelocitiesAndPositions);
+        updateVelocitiesAndPositions(h);
+    }
+    lastSolve.residual = lastResidual;
+    lastSolve.solverMs = (float)(solverSeconds * 1e3);
+    updateSleep();
+}
+
+void Tissue::beginSubstep(float deltaTime)
+{
+    if(integrator != Integrator::XPBD) return;
+    substepTime = deltaTime;
+    std::fill(stretchConstraintLambda.begin(), stretchConstraintLambda.end(), 0.0f);
+    std::fill(sleep.lambda.begin(), sleep.lambda.end(), 0.0f);
+    if (gridSolver) gridSolver->resetLambda();
+    if (hierarchy) hierarchy->resetLambda();
+}
+
+// Up to `iterations` sweeps of one (sub)step. Stops once the residual is below residualTolerance,
+// or before a sweep (estimated as the mean sweep so far) would overrun budget
+// seconds. The residual is measured going into each sweep, so the sweep that passes the test
+// still leaves its correction behind. Returns the seconds spent.
+double Tissue::solveAdaptive(double budget)
+{
+    double spent = 0.0;
+    for(int i=0; i<iterations; i++)
+    {
+        if(i > 0 && spent + spent / i > budget)
+        {
+            lastSolve.budgetLimited = true;
+            break;
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        ConstraintResidual residual = SolveAllStretchConstraints();
+        if(selfCollisionThickness > 0.0f) SolveCollisionConstraints();
+        if(!obstacles.empty()) SolveObstacleConstraints();
+        if(!grabVertices.empty()) SolveGrabConstraints();
+        spent += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        lastSolve.iterations++;
+
+        if(residual.max < residualTolerance) break;
+    }
+    return spent;
+}
+
+// The integration passes run over the awake runs only; with nothing asleep that is one run over every vertex.
+void Tissue::updateEstimatedPositions(float deltaTime)
+{
+    const float* w = inverseMass.data();
+    simd::vfloat dt = simd::set1(deltaTime);
+    simd::vfloat zero = simd::set1(0.0f);
+    for(const std::pair<int, int>& run : sleep.awakeRuns)
+    {
+        int i = run.first, end = run.second;
+        for(; i + simd::WIDTH <= end; i += simd::WIDTH)
+        {
+            simd::vmask free = simd::greater(simd::load(w + i), zero);
+            simd::vfloat px = simd::load(&positions.x[i]);
+            simd::vfloat py = simd::load(&positions.y[i]);
+            simd::vfloat pz = simd::load(&positions.z[i]);
+            simd::store(&estimatedPositions.x[i], simd::select(free, simd::add(px, simd::mul(simd::load(&velocities.x[i]), dt)), px));
+            simd::store(&estimatedPositions.y[i], simd::select(free, simd::add(py, simd::mul(simd::load(&velocities.y[i]), dt)), py));
+            simd::store(&estimatedPositions.z[i], simd::select(free, simd::add(pz, simd::mul(simd::load(&velocities.z[i]), dt)), pz));
+        }
+        for(; i<end; i++)
+        {
+            if(w[i] > 0.0f) estimatedPositions.set(i, positions.get(i) + velocities.get(i) * deltaTime);
+            else estimatedPositions.set(i, positions.get(i));
+        }
+    }
+}
+
+void Tissue::findCollisionPairs()
+{
+    if (!selfCollision) selfCollision.reset(new SelfCollision(getVertexCount(), getDrawTriangles(), stretchConstraintFirst, stretchConstraintSecond));
+    selfCollision->findPairs(estimatedPositions, inverseMass, sleep.awake, selfCollisionThickness, threadPool.get());
+}
+
+void Tissue::SolveCollisionConstraints()
+{
+    if (selfCollision) selfCollision->solve(estimatedPositions, inverseMass, sleep.awake, selfCollisionThickness);
+}
+
+int Tissue::getCollisionPairCount() const
+{
+    return selfCollision ? selfCollision->getPairCount() : 0;
+}
+
+void Tissue::addObstacle(const SdfObstacle* obstacle)
+{
+    if(!obstacle || std::find(obstacles.begin(), obstacles.end(), obstacle) != obstacles.end()) return;
+    obstacles.push_back(obstacle);
+    obstaclePoseVersions.push_back(obstacle->getPoseVersion());
+    wakeAll();
+}
+
+void Tissue::removeObstacle(const SdfObstacle* obstacle)
+{
+    for(size_t o=0; o<obstacles.size(); o++)
+    {
+        if(obstacles[o] != obstacle) continue;
+        obstacles.erase(obstacles.begin() + o);
+        obstaclePoseVersions.erase(obstaclePoseVersions.begin() + o);
+        wakeAll(); // vertices resting on it fall
+        return;
+    }
+}
+
+void Tissue::SolveObstacleConstraints()
+{
+    for(const SdfObstacle* obstacle : obstacles)
+    {
+        for(const std::pair<int, int>& run : sleep.awakeRuns)
+        {
+            obstacle->project(estimatedPositions, inverseMass.data(), run.first, run.second, obstacleMargin);
+        }
+    }
+}
+
+void Tissue::grab(const std::vector<int>& vertices, const std::vector<float>& weights)
+{
+    releaseGrab();
+    for(size_t k=0; k<vertices.size(); k++)
+    {
+        int i = vertices[k];
+        if(isVertexFixed(i)) continue; // a release would free it
+        grabVertices.push_back(i);
+        grabWeights.push_back(std::min(weights[k], 1.0f));
+    }
+    grabTargets.resize(grabVertices.size());
+    for(size_t k=0; k<grabVertices.size(); k++)
+    {
+        grabTargets.set((int)k, positions.get(grabVertices[k]));
+        if(grabWeights[k] >= 1.0f) setVertexFixed(grabVertices[k], true);
+        else wakeVertex(grabVertices[k]);
+    }
+}
+
+void Tissue::moveGrab(glm::vec3 offset)
+{
+    for(size_t k=0; k<grabVertices.size(); k++)
+    {
+        int i = grabVertices[k];
+        grabTargets.set((int)k, grabTargets.get((int)k) + offset);
+        if(grabWeights[k] >= 1.0f) positions.set(i, positions.get(i) + offset);
+        wakeVertex(i);
+    }
+}
+
+void Tissue::releaseGrab()
+{
+    for(size_t k=0; k<grabVertices.size(); k++)
+    {
+        if(grabWeights[k] >= 1.0f) setVertexFixed(grabVertices[k], false);
+    }
+    grabVertices.clear();
+    grabWeights.clear();
+    grabTargets.resize(0);
+}
+
+void Tissue::SolveGrabConstraints()
+{
+    for(size_t k=0; k<grabVertices.size(); k++)
+    {
+        int i = grabVertices[k];
+        if(grabWeights[k] >= 1.0f || !isVertexAwake(i)) continue;
+        glm::vec3 p = estimatedPositions.get(i);
+        estimatedPositions.set(i, p + grabWeights[k] * (grabTargets.get((int)k) - p));
+    }
+}
+
+void Tissue::updateVelocitiesAndPositions(float deltaTime)
+{
+    const float* w = inverseMass.data();
+    simd::vfloat dt = simd::set1(deltaTime);
+    simd::vfloat zero = simd::set1(0.0f);
+    for(const std::pair<int, int>& run : sleep.awakeRuns)
+    {
+        int i = run.first, end = run.second;
+        for(; i + simd::WIDTH <= end; i += simd::WIDTH)
+        {
+            simd::vmask free = simd::greater(simd::load(w + i), zero);
+            simd::vfloat ex = simd::load(&estimatedPositions.x[i]);
+            simd::vfloat ey = simd::load(&estimatedPositions.y[i]);
+            simd::vfloat ez = simd::load(&estimatedPositions.z[i]);
+            simd::vfloat px = simd::load(&positions.x[i]);
+            simd::vfloat py = simd::load(&positions.y[i]);
+            simd::vfloat pz = simd::load(&positions.z[i]);
+            simd::store(&velocities.x[i], simd::select(free, simd::div(simd::sub(ex, px), dt), zero));
+            simd::store(&velocities.y[i], simd::select(free, simd::div(simd::sub(ey, py), dt), zero));
+            simd::store(&velocities.z[i], simd::select(free, simd::div(simd::sub(ez, pz), dt), zero));
+            simd::store(&positions.x[i], simd::select(free, ex, px));
+            simd::store(&positions.y[i], simd::select(free, ey, py));
+            simd::store(&positions.z[i], simd::select(free, ez, pz));
+        }
+        for(; i<end; i++)
+        {
+            if(w[i] > 0.0f)
+            {
+                velocities.set(i, (estimatedPositions.get(i) - positions.get(i)) / deltaTime);
+                positions.set(i, estimatedPositions.get(i));
+            }
+            else velocities.set(i, glm::vec3(0.0f));
+        }
+    }
+}
+
+void Tissue::addGravity(float deltaTime, glm::vec3 gravity)
+{
+    const float* w = inverseMass.data();
+    simd::vfloat gx = simd::set1(gravity.x * deltaTime);
+    simd::vfloat gy = simd::set1(gravity.y * deltaTime);
+    simd::vfloat gz = simd::set1(gravity.z * deltaTime);
+    simd::vfloat zero = simd::set1(0.0f);
+    for(const std::pair<int, int>& run : sleep.awakeRuns)
+    {
+        int i = run.first, end = run.second;
+        for(; i + simd::WIDTH <= end; i += simd::WIDTH)
+        {
+            simd::vmask free = simd::greater(simd::load(w + i), zero);
+            simd::store(&velocities.x[i], simd::add(simd::load(&velocities.x[i]), simd::select(free, gx, zero)));
+            simd::store(&velocities.y[i], simd::add(simd::load(&velocities.y[i]), simd::select(free, gy, zero)));
+            simd::store(&velocities.z[i], simd::add(simd::load(&velocities.z[i]), simd::select(free, gz, zero)));
+        }
+        for(; i<end; i++)
+        {
+            if(w[i] > 0.0f) velocities.set(i, velocities.get(i) + gravity * deltaTime);
+        }
+    }
+}
+
+void addDampingPartial(DampingPartial& sum, const DampingPartial& partial)
+{
+    sum.mass += partial.mass;
+    for(int k=0; k<3; k++)
+    {
+        sum.position[k] += partial.position[k];
+        sum.velocity[k] += partial.velocity[k];
+        sum.momentum[k] += partial.momentum[k];
+    }
+    for(int k=0; k<6; k++) sum.second[k] += partial.second[k];
+}
+
+// Rigid-mode damping: removes a fraction of every vertex velocity that is not part of its
+// body's overall linear + angular motion. One reduction pass collects raw moments
+// (sum m, m x, m v, m x*v, m x x^T) per fixed-size chunk of a body in double, the center-of-mass
+// terms are folded in afterwards, then one pass applies the correction. Chunk size does not
+// depend on the thread count and partials are summed in chunk order, so the result is the
+// same serial or parallel. Sleeping tiles add the moments cached when they fell asleep and keep their
+// (zero) velocities. The bodies of a batch share the passes but not their motion.
+void Tissue::applyDamping(float dampingFactor)
+{
+    dampingChunks.clear();
+    for(int b=0; b<getBodyCount(); b++)
+    {
+        for(int begin=bodyOffsets[b]; begin<bodyOffsets[b+1]; begin+=DAMPING_CHUNK)
+        {
+            dampingChunks.push_back({ begin, std::min(begin + DAMPING_CHUNK, bodyOffsets[b+1]), b });
+        }
+    }
+    int chunks = (int)dampingChunks.size();
+    dampingPartials.resize(chunks);
+    dampingMotions.resize(getBodyCount());
+
+    // a tile cut by a body boundary is summed vertex by vertex: a sleeping one has zero velocities, so that is exact
+    auto accumulate = [&](int chunk) {
+        DampingPartial partial = {};
+        int begin = dampingChunks[chunk].begin, end = dampingChunks[chunk].end;
+        for(int tile=begin / SLEEP_TILE; tile * SLEEP_TILE < end; tile++)
+        {
+            int tileBegin = std::max(begin, tile * SLEEP_TILE), tileEnd = std::min(end, (tile + 1) * SLEEP_TILE);
+            bool whole = tileBegin == tile * SLEEP_TILE && tileEnd - tileBegin == std::min(SLEEP_TILE, getVertexCount() - tileBegin);
+            if(sleep.awake[tile] || !whole) accumulateDampingMoments(partial, tileBegin, tileEnd);
+            else addDampingPartial(partial, sleep.moments[tile]);
+        }
+        dampingPartials[chunk] = partial;
+    };
+    if (threadPool) threadPool->parallelFor(chunks, accumulate);
+    else for(int chunk=0; chunk<chunks; chunk++) accumulate(chunk);
+
+    for(int chunk=0; chunk<chunks; )
+    {
+        int body = dampingChunks[chunk].body;
+        DampingPartial sum = {};
+        for(; chunk<chunks && dampingChunks[chunk].body == body; chunk++) addDampingPartial(sum, dampingPartials[chunk]);
+
+        // fixed vertices count towards the total mass but not the moments, as before
+        double totalMass = 1.0/weight * (bodyOffsets[body+1] - bodyOffsets[body]);
+        glm::dvec3 sumPosition(sum.position[0], sum.position[1], sum.position[2]);
+        glm::dvec3 sumVelocity(sum.velocity[0], sum.velocity[1], sum.velocity[2]);
+        glm::dvec3 centerOfMassPosition = sumPosition / totalMass;
+        glm::dvec3 centerOfMassVelocity = sumVelocity / totalMass;
+
+        // L = sum m (x - c) x (v - cv)
+        glm::dvec3 angularMomentum = glm::dvec3(sum.momentum[0], sum.momentum[1], sum.momentum[2])
+            - glm::cross(sumPosition, centerOfMassVelocity)
+            - glm::cross(centerOfMassPosition, sumVelocity)
+            + sum.mass * glm::cross(centerOfMassPosition, centerOfMassVelocity);
+
+        // sum m r r^T with r = x - c, then I = sum m (|r|^2 Id - r r^T)
+        glm::dvec3 c = centerOfMassPosition;
+        double rr[6] = {
+            sum.second[0] - 2.0 * sumPosition.x * c.x + sum.mass * c.x * c.x,
+            sum.second[1] - 2.0 * sumPosition.y * c.y + sum.mass * c.y * c.y,
+            sum.second[2] - 2.0 * sumPosition.z * c.z + sum.mass * c.z * c.z,
+            sum.second[3] - sumPosition.x * c.y - c.x * sumPosition.y + sum.mass * c.x * c.y,
+            sum.second[4] - sumPosition.x * c.z - c.x * sumPosition.z + sum.mass * c.x * c.z,
+            sum.second[5] - sumPosition.y * c.z - c.y * sumPosition.z + sum.mass * c.y * c.z
+        };
+        double trace = rr[0] + rr[1] + rr[2];
+        glm::dmat3 inertiaTensor(
+            trace - rr[0], -rr[3],         -rr[4],
+            -rr[3],        trace - rr[1],  -rr[5],
+            -rr[4],        -rr[5],         trace - rr[2]
+        );
+
+        RigidMotion& motion = dampingMotions[body];
+        motion.angularVelocity = glm::vec3(glm::inverse(inertiaTensor) * angularMomentum);
+        motion.center = glm::vec3(centerOfMassPosition);
+        motion.velocity = glm::vec3(centerOfMassVelocity);
+    }
+
+    // v -= (cv + w x (x - c) - v) * k on free vertices
+    auto applyRange = [&](const RigidMotion& motion, int begin, int end) {
+        int i = begin;
+        glm::vec3 center = motion.center, centerVelocity = motion.velocity, angularVelocity = motion.angularVelocity;
+
+        simd::vfloat zero = simd::set1(0.0f), k = simd::set1(dampingFactor);
+        simd::vfloat cx = simd::set1(center.x), cy = simd::set1(center.y), cz = simd::set1(center.z);
+        simd::vfloat cvx = simd::set1(centerVelocity.x), cvy = simd::set1(centerVelocity.y), cvz = simd::set1(centerVelocity.z);
+        simd::vfloat wx = simd::set1(angularVelocity.x), wy = simd::set1(angularVelocity.y), wz = simd::set1(angularVelocity.z);
+        for(; i + simd::WIDTH <= end; i += simd::WIDTH)
+        {
+            simd::vmask free = simd::greater(simd::load(&inverseMass[i]), zero);
+            simd::vfloat rx = simd::sub(simd::load(&positions.x[i]), cx);
+            simd::vfloat ry = simd::sub(simd::load(&positions.y[i]), cy);
+            simd::vfloat rz = simd::sub(simd::load(&positions.z[i]), cz);
+            simd::vfloat vx = simd::load(&velocities.x[i]);
+            simd::vfloat vy = simd::load(&velocities.y[i]);
+            simd::vfloat vz = simd::load(&velocities.z[i]);
+
+            simd::vfloat dvx = simd::sub(simd::add(cvx, simd::sub(simd::mul(wy, rz), simd::mul(wz, ry))), vx);
+            simd::vfloat dvy = simd::sub(simd::add(cvy, simd::sub(simd::mul(wz, rx), simd::mul(wx, rz))), vy);
+            simd::vfloat dvz = simd::sub(simd::add(cvz, simd::sub(simd::mul(wx, ry), simd::mul(wy, rx))), vz);
+
+            simd::store(&velocities.x[i], simd::select(free, simd::sub(vx, simd::mul(dvx, k)), vx));
+            simd::store(&velocities.y[i], simd::select(free, simd::sub(vy, simd::mul(dvy, k)), vy));
+            simd::store(&velocities.z[i], simd::select(free, simd::sub(vz, simd::mul(dvz, k)), vz));
+        }
+        for(; i<end; i++)
+        {
+            if(inverseMass[i] == 0.0f) continue;
+            glm::vec3 deltaVelocity = centerVelocity + glm::cross(angularVelocity, positions.get(i) - center) - velocities.get(i);
+            velocities.set(i, velocities.get(i) - deltaVelocity * dampingFactor);
+        }
+    };
+    auto apply = [&](int chunk) {
+        int begin = dampingChunks[chunk].begin, end = dampingChunks[chunk].end;
+        const RigidMotion& motion = dampingMotions[dampingChunks[chunk].body];
+        for(int tile=begin / SLEEP_TILE; tile * SLEEP_TILE < end; tile++)
+        {
+            int tileBegin = std::max(begin, tile * SLEEP_TILE), tileEnd = std::min(end, (tile + 1) * SLEEP_TILE);
+            if(sleep.awake[tile]) applyRange(motion, tileBegin, tileEnd);
+        }
+    };
+    if (threadPool) threadPool->parallelFor(chunks, apply);
+    else for(int chunk=0; chunk<chunks; chunk++) apply(chunk);
+}
+
+// raw moments of the free vertices in [begin, end), added to partial in vertex order
+void Tissue::accumulateDampingMoments(DampingPartial& partial, int begin, int end) const
+{
+    for(int i=begin; i<end; i++)
+    {
+        if(inverseMass[i] == 0.0f) continue;
+
+        double m = 1.0 / inverseMass[i];
+        double x = positions.x[i], y = positions.y[i], z = positions.z[i];
+        double vx = velocities.x[i], vy = velocities.y[i], vz = velocities.z[i];
+
+        partial.mass += m;
+        partial.position[0] += m * x;  partial.position[1] += m * y;  partial.position[2] += m * z;
+        partial.velocity[0] += m * vx; partial.velocity[1] += m * vy; partial.velocity[2] += m * vz;
+        partial.momentum[0] += m * (y * vz - z * vy);
+        partial.momentum[1] += m * (z * vx - x * vz);
+        partial.momentum[2] += m * (x * vy - y * vx);
+        partial.second[0] += m * x * x; partial.second[1] += m * y * y; partial.second[2] += m * z * z;
+        partial.second[3] += m * x * y; partial.second[4] += m * x * z; partial.second[5] += m * y * z;
+    }
+}
+
+ConstraintResidual Tissue::SolveAllStretchConstraints()
+{
+    ProfileScope scope(profiler, Stage::SolveConstraints);
+    if (hierarchy)
+    {
+        // V-cycle: the fine sweep smooths out short-range error, the coarse levels carry the rest across
+        // the sheet, the second fine sweep smooths what interpolating their correction left behind
+        sweepStretchConstraints();
+        float alphaTilde = substepTime > 0.0f ? compliance / (substepTime * substepTime) : 0.0f;
+        hierarchy->correct(estimatedPositions, inverseMass, threadPool.get(), STRETCH_STIFFNESS, alphaTilde);
+    }
+    lastResidual = sweepStretchConstraints();
+    if (profiler) profiler->recordResidual(lastResidual.max, lastResidual.rms);
+    return lastResidual;
+}
+
+ConstraintResidual Tissue::sweepStretchConstraints()
+{
+    if (gridSolver)
+    {
+        float alphaTilde = substepTime > 0.0f ? compliance / (substepTime * substepTime) : 0.0f;
+        return gridSolver->solve(estimatedPositions, inverseMass, threadPool.get(), STRETCH_STIFFNESS, alphaTilde);
+    }
+
+    // while tiles sleep only the awake tiles' constraints run, with the sleeping vertices pinned
+    bool asleep = sleep.asleep > 0;
+    ConstraintArrays arrays = asleep
+        ? ConstraintArrays{sleep.first.data(), sleep.second.data(), sleep.restLength.data(), sleep.lambda.data(), sleep.inverseMass.data()}
+        : ConstraintArrays{stretchConstraintFirst.data(), stretchConstraintSecond.data(), stretchConstraintsRestLength.data(),
+                           stretchConstraintLambda.data(), inverseMass.data()};
+    const std::vector<int>& colorOffsets = asleep ? sleep.colorOffsets : stretchConstraintColorOffsets;
+    int constraintCount = asleep ? sleep.colorOffsets.back() : getConstraintCount();
+
+    float residualMax = 0.0f;
+    double residualSumSquares = 0.0;
+
+    // colors run one after another (Gauss-Seidel), constraints inside a color touch disjoint vertices.
+    // A color is cut into the same fixed-size tasks serial or parallel, and the residual partials are
+    // summed in task order, so thread count changes neither positions nor residuals.
+    for(int c=0; c<getColorCount(); c++)
+    {
+        int begin = colorOffsets[c];
+        int end = colorOffsets[c+1];
+        int tasks = (end - begin + CONSTRAINTS_PER_TASK - 1) / CONSTRAINTS_PER_TASK;
+
+        auto solve = [&](int task) {
+            int taskBegin = begin + task * CONSTRAINTS_PER_TASK;
+            int taskEnd = std::min(taskBegin + CONSTRAINTS_PER_TASK, end);
+            ResidualPartial& residual = residualPartials[task];
+            if (integrator == Integrator::XPBD) SolveStretchConstraintsXPBD(arrays, taskBegin, taskEnd, residual);
+            else SolveStretchConstraints(arrays, taskBegin, taskEnd, residual);
+        };
+        if (threadPool) threadPool->parallelFor(tasks, solve);
+        else for(int task=0; task<tasks; task++) solve(task);
+
+        for(int task=0; task<tasks; task++)
+        {
+            residualMax = std::max(residualMax, residualPartials[task].max);
+            residualSumSquares += residualPartials[task].sumSquares;
+        }
+    }
+
+    ConstraintResidual residual;
+    residual.max = residualMax;
+    residual.rms = constraintCount > 0 ? (float)std::sqrt(residualSumSquares / constraintCount) : 0.0f;
+    return residual;
+}
+
+void Tissue::createPositions(int edgeCount, int maxEdgeWidth)
+{
+    positions.resize(edgeCount * edgeCount);
+    inverseMass.resize(edgeCount * edgeCount);
+    for(int i=0; i < edgeCount; ++i){
+        for(int j=0; j < edgeCount; ++j){
+            positions.set(i*edgeCount + j, glm::vec3(
+                -(maxEdgeWidth/2.0f) + j*(maxEdgeWidth/(edgeCount-1.0f)),
+                -(maxEdgeWidth/2.0f) + i*(maxEdgeWidth/(edgeCount-1.0f)),
+                0.0f
+            ));
+
+            bool fixed = i == edgeCount - 1 && (j == 0 || j == edgeCount - 1);
+            inverseMass[i*edgeCount + j] = fixed ? 0.0f : weight;
+        }
+    }
+}
+
+void Tissue::createStretchConstraints()
+{
+    for(int i=0; i<edgeCount; i++){
+        for(int j=0; j<edgeCount; j++)
+        {
+            if(j < edgeCount - 1 && i < edgeCount - 1)
+            {
+                addStretchConstraint(i*edgeCount + j, i*edgeCount + (j+1));
+                addStretchConstraint(i*edgeCount + j, (i+1)*edgeCount + j);
+                addStretchConstraint(i*edgeCount + j, (i+1)*edgeCount + (j+1));
+                if(j > 0)
+                {
+                    addStretchConstraint(i*edgeCount + j, (i+1)*edgeCount + (j-1));
+                }
+            }
+            else if(j == edgeCount - 1 && i < edgeCount - 1)
+            {
+                addStretchConstraint(i*edgeCount + j, (i+1)*edgeCount + j);
+                addStretchConstraint(i*edgeCount + j, (i+1)*edgeCount + (j-1));
+            }
+            else if(j < edgeCount - 1 && i == edgeCount - 1)
+            {
+                addStretchConstraint(i*edgeCount + j, i*edgeCount + (j+1));
+            }
+        }
+    }
+}
+
+// Same constraints as createStretchConstraints, kept as the grid shape and three rest lengths
+// instead of arrays. The lengths come from the first cell as createPositions lays it out, not from
+// the current positions, so a restored tissue gets the same ones.
+void Tissue::createImplicitConstraints()
+{
+    float spacing = maxEdgeWidth/(edgeCount-1.0f);
+    glm::vec3 origin(-(maxEdgeWidth/2.0f), -(maxEdgeWidth/2.0f), 0.0f);
+    glm::vec3 right = origin + glm::vec3(spacing, 0.0f, 0.0f);
+    glm::vec3 up = origin + glm::vec3(0.0f, spacing, 0.0f);
+    glm::vec3 diagonal = origin + glm::vec3(spacing, spacing, 0.0f);
+
+    GridRestLengths restLengths;
+    restLengths.structural = glm::length(origin - right);
+    restLengths.shear = glm::length(origin - diagonal);
+    restLengths.antiShear = glm::length(right - up);
+    gridSolver = createGridSolver<FullStencil>(edgeCount, restLengths, integrator, CONSTRAINTS_PER_TASK);
+    stretchConstraintColorOffsets.assign(1, 0);
+}
+
+void Tissue::addStretchConstraint(int i1, int i2)
+{
+    stretchConstraintFirst.push_back(i1);
+    stretchConstraintSecond.push_back(i2);
+    stretchConstraintsRestLength.push_back(glm::length(positions.get(i1) - positions.get(i2)));
+}
+
+// Greedy edge coloring, then reorder the constraints color by color. The serial sweep
+// walks the same order, so serial and parallel solves give bit-identical results.
+// A vertex mask holds 64 colors; constraints that find all of them taken (vertices of
+// very high degree in imported models) wait for the next pass, which colors from 64 on.
+void Tissue::colorStretchConstraints()
+{
+    std::vector<uint64_t> usedColors(positions.size()); // bit c set: vertex already in color base + c
+    std::vector<int> constraintColor(getConstraintCount());
+    std::vector<int> pending(getConstraintCount());
+    for(int i=0; i<getConstraintCount(); i++) pending[i] = i;
+    int colorCount = 0;
+
+    for(int base=0; !pending.empty(); base += 64)
+    {
+        std::fill(usedColors.begin(), usedColors.end(), 0);
+        int deferred = 0;
+        for(int i : pending)
+        {
+            int i1 = stretchConstraintFirst[i];
+            int i2 = stretchConstraintSecond[i];
+
+            uint64_t used = usedColors[i1] | usedColors[i2];
+            if(used == ~uint64_t(0))
+            {
+                pending[deferred++] = i;
+                continue;
+            }
+            int color = 0;
+            while (used & (uint64_t(1) << color)) color++;
+
+            usedColors[i1] |= uint64_t(1) << color;
+            usedColors[i2] |= uint64_t(1) << color;
+            constraintColor[i] = base + color;
+            colorCount = std::max(colorCount, base + color + 1);
+        }
+        pending.resize(deferred);
+    }
+
+    stretchConstraintColorOffsets.assign(colorCount + 1, 0);
+    for(int i=0; i<getConstraintCount(); i++) stretchConstraintColorOffsets[constraintColor[i] + 1]++;
+    for(int c=0; c<colorCount; c++) stretchConstraintColorOffsets[c+1] += stretchConstraintColorOffsets[c];
+
+    std::vector<int> cursor(stretchConstraintColorOffsets.begin(), stretchConstraintColorOffsets.end() - 1);
+    std::vector<int> coloredFirst(getConstraintCount());
+    std::vector<int> coloredSecond(getConstraintCount());
+    std::vector<float> coloredRestLength(getConstraintCount());
+    for(int i=0; i<getConstraintCount(); i++)
+    {
+        int slot = cursor[constraintColor[i]]++;
+        coloredFirst[slot] = stretchConstraintFirst[i];
+        coloredSecond[slot] = stretchConstraintSecond[i];
+        coloredRestLength[slot] = stretchConstraintsRestLength[i];
+    }
+
+    stretchConstraintFirst.swap(coloredFirst);
+    stretchConstraintSecond.swap(coloredSecond);
+    stretchConstraintsRestLength.swap(coloredRestLength);
+}
+
+// Projects constraints [begin, end) of one color. Endpoints inside the range are all
+// distinct, so lanes can gather, correct and scatter independently.
+void Tissue::SolveStretchConstraints(const ConstraintArrays& arrays, int begin, int end, ResidualPartial& residual)
+{
+    float* x = estimatedPositions.x.data();
+    float* y = estimatedPositions.y.data();
+    float* z = estimatedPositions.z.data();
+    const float* w = arrays.inverseMass;
+    const int* first = arrays.first;
+    const int* second = arrays.second;
+    const float* restLength = arrays.restLength;
+    int i = begin;
+
+    simd::vfloat zero = simd::set1(0.0f);
+    simd::vfloat stiffness = simd::set1(STRETCH_STIFFNESS);
+    simd::vfloat residualMax = zero, residualSumSquares = zero;
+    for(; i + simd::WIDTH <= end; i += simd::WIDTH)
+    {
+        simd::vfloat x1 = simd::gather(x, first + i), x2 = simd::gather(x, second + i);
+        simd::vfloat y1 = simd::gather(y, first + i), y2 = simd::gather(y, second + i);
+        simd::vfloat z1 = simd::gather(z, first + i), z2 = simd::gather(z, second + i);
+        simd::vfloat w1 = simd::gather(w, first + i), w2 = simd::gather(w, second + i);
+
+        simd::vfloat dx = simd::sub(x1, x2), dy = simd::sub(y1, y2), dz = simd::sub(z1, z2);
+        simd::vfloat currentLength = simd::sqrt(simd::add(simd::add(simd::mul(dx, dx), simd::mul(dy, dy)), simd::mul(dz, dz)));
+        simd::vfloat wSum = simd::add(w1, w2);
+
+        // (currentLength - restLength) / (currentLength * wSum), 0 for degenerate or fully fixed constraints
+        simd::vmask valid = simd::both(simd::greater(currentLength, zero), simd::greater(wSum, zero));
+        simd::vfloat deltaLength = simd::select(valid, simd::sub(currentLength, simd::load(restLength + i)), zero);
+        simd::vfloat scale = simd::div(simd::mul(deltaLength, stiffness), simd::mul(currentLength, wSum));
+        scale = simd::select(valid, scale, zero);
+
+        residualMax = simd::max(residualMax, simd::abs(deltaLength));
+        residualSumSquares = simd::add(residualSumSquares, simd::mul(deltaLength, deltaLength));
+
+        simd::vfloat s1 = simd::mul(w1, scale), s2 = simd::mul(w2, scale);
+        simd::scatter(x, first + i, simd::sub(x1, simd::mul(s1, dx)));
+        simd::scatter(y, first + i, simd::sub(y1, simd::mul(s1, dy)));
+        simd::scatter(z, first + i, simd::sub(z1, simd::mul(s1, dz)));
+        simd::scatter(x, second + i, simd::add(x2, simd::mul(s2, dx)));
+        simd::scatter(y, second + i, simd::add(y2, simd::mul(s2, dy)));
+        simd::scatter(z, second + i, simd::add(z2, simd::mul(s2, dz)));
+    }
+    residual.max = simd::horizontalMax(residualMax);
+    residual.sumSquares = simd::horizontalSum(residualSumSquares);
+    for(; i<end; i++)
+    {
+        int i1 = first[i];
+        int i2 = second[i];
+
+        glm::vec3 p1 = estimatedPositions.get(i1);
+        glm::vec3 p2 = estimatedPositions.get(i2);
+
+        float currentLength = glm::length(p1 - p2);
+        if(currentLength == 0.0f) continue;
+
+        glm::vec3 deltaPNormalized = (p1 - p2)/currentLength;
+        float deltaLength = currentLength - restLength[i];
+
+        float wSum = w[i1] + w[i2];
+        if(wSum == 0.0f) continue;
+
+        residual.max = std::max(residual.max, std::fabs(deltaLength));
+        residual.sumSquares += deltaLength * deltaLength;
+
+        estimatedPositions.set(i1, p1 - (w[i1]/wSum) * deltaLength * deltaPNormalized * STRETCH_STIFFNESS);
+        estimatedPositions.set(i2, p2 + (w[i2]/wSum) * deltaLength * deltaPNormalized * STRETCH_STIFFNESS);
+    }
+}
+
+// XPBD projection of constraints [begin, end) of one color, C = |p1 - p2| - restLength:
+//   dLambda = (-C - alpha~ lambda) / (w1 + w2 + alpha~),  alpha~ = compliance / h^2
+//   p1 += w1 dLambda n,  p2 -= w2 dLambda n
+void Tissue::SolveStretchConstraintsXPBD(const ConstraintArrays& arrays, int begin, int end, ResidualPartial& residual)
+{
+    float* x = estimatedPositions.x.data();
+    float* y = estimatedPositions.y.data();
+    float* z = estimatedPositions.z.data();
+    float* lambda = arrays.lambda;
+    const float* w = arrays.inverseMass;
+    const int* first = arrays.first;
+    const int* second = arrays.second;
+    const float* restLength = arrays.restLength;
+    float alphaTilde = substepTime > 0.0f ? compliance / (substepTime * substepTime) : 0.0f;
+    int i = begin;
+
+    simd::vfloat zero = simd::set1(0.0f);
+    simd::vfloat alpha = simd::set1(alphaTilde);
+    simd::vfloat residualMax = zero, residualSumSquares = zero;
+    for(; i + simd::WIDTH <= end; i += simd::WIDTH)
+    {
+        simd::vfloat x1 = simd::gather(x, first + i), x2 = simd::gather(x, second + i);
+        simd::vfloat y1 = simd::gather(y, first + i), y2 = simd::gather(y, second + i);
+        simd::vfloat z1 = simd::gather(z, first + i), z2 = simd::gather(z, second + i);
+        simd::vfloat w1 = simd::gather(w, first + i), w2 = simd::gather(w, second + i);
+        simd::vfloat l = simd::load(lambda + i);
+
+        simd::vfloat dx = simd::sub(x1, x2), dy = simd::sub(y1, y2), dz = simd::sub(z1, z2);
+        simd::vfloat currentLength = simd::sqrt(simd::add(simd::add(simd::mul(dx, dx), simd::mul(dy, dy)), simd::mul(dz, dz)));
+        simd::vfloat wSum = simd::add(w1, w2);
+
+        simd::vmask valid = simd::both(simd::greater(currentLength, zero), simd::greater(wSum, zero));
+        simd::vfloat C = simd::select(valid, simd::sub(currentLength, simd::load(restLength + i)), zero);
+        residualMax = simd::max(residualMax, simd::abs(C));
+        residualSumSquares = simd::add(residualSumSquares, simd::mul(C, C));
+        simd::vfloat deltaLambda = simd::div(simd::sub(simd::sub(zero, C), simd::mul(alpha, l)), simd::add(wSum, alpha));
+        deltaLambda = simd::select(valid, deltaLambda, zero);
+        simd::store(lambda + i, simd::add(l, deltaLambda));
+
+        // scale by 1/|d| so d becomes the unit normal
+        simd::vfloat scale = simd::select(valid, simd::div(deltaLambda, currentLength), zero);
+        simd::vfloat s1 = simd::mul(w1, scale), s2 = simd::mul(w2, scale);
+        simd::scatter(x, first + i, simd::add(x1, simd::mul(s1, dx)));
+        simd::scatter(y, first + i, simd::add(y1, simd::mul(s1, dy)));
+        simd::scatter(z, first + i, simd::add(z1, simd::mul(s1, dz)));
+        simd::scatter(x, second + i, simd::sub(x2, simd::mul(s2, dx)));
+        simd::scatter(y, second + i, simd::sub(y2, simd::mul(s2, dy)));
+        simd::scatter(z, second + i, simd::sub(z2, simd::mul(s2, dz)));
+    }
+    residual.max = simd::horizontalMax(residualMax);
+    residual.sumSquares = simd::horizontalSum(residualSumSquares);
+    for(; i<end; i++)
+    {
+        int i1 = first[i];
+        int i2 = second[i];
+
+        glm::vec3 p1 = estimatedPositions.get(i1);
+        glm::vec3 p2 = estimatedPositions.get(i2);
+
+        float currentLength = glm::length(p1 - p2);
+        float wSum = w[i1] + w[i2];
+        if(currentLength == 0.0f || wSum == 0.0f) continue;
+
+        glm::vec3 n = (p1 - p2)/currentLength;
+        float C = currentLength - restLength[i];
+        residual.max = std::max(residual.max, std::fabs(C));
+        residual.sumSquares += C * C;
+        float deltaLambda = (-C - alphaTilde * lambda[i]) / (wSum + alphaTilde);
+        lambda[i] += deltaLambda;
+
+        estimatedPositions.set(i1, p1 + w[i1] * deltaLambda * n);
+        estimatedPositions.set(i2, p2 - w[i2] * deltaLambda * n);
+    }
+}
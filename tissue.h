@@ -0,0 +1,372 @@
+#ifndef TISSUE_H
+#define TISSUE_H
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+
+class Checkpoint;
+class GridHierarchy;
+class GridSolver;
+class Profiler;
+class SdfObstacle;
+class SelfCollision;
+class ThreadPool;
+class TissueModel;
+
+// PBD correction factor per sweep (the GPU solver uses it too)
+const float STRETCH_STIFFNESS = 0.25f;
+// sleeping works on tiles of consecutive vertex indices: bands of rows in build order, compact blocks after Morton / RCM
+const int SLEEP_TILE = 256;
+const int SLEEP_STEPS = 30; // quiet steps in a row before a tile sleeps
+
+// time integrator, chosen when the tissue is built
+enum class Integrator
+{
+    PBD,    // one step, `iterations` sweeps with a fixed 0.25 stiffness factor
+    XPBD    // `substeps` substeps with compliance and per-constraint Lagrange multipliers
+};
+
+// vertex numbering, applied once when the tissue is built (see vertex_order.h)
+enum class VertexOrder
+{
+    Build,  // as generated (row-major grid) or as listed in the imported file
+    Morton, // along a Z-order curve over the bounding box
+    RCM     // reverse Cuthill-McKee over the constraint graph
+};
+
+// how the grid's stretch constraints are kept (imported models are always Explicit)
+enum class GridConstraints
+{
+    Explicit,   // endpoint, rest length and multiplier arrays, colored at build time
+    Implicit    // generated row by row from the grid shape (see grid_solver.h); needs VertexOrder::Build
+};
+
+class Tissue;
+
+// one body of a batched Tissue: the source's state, scaled about the origin and then moved by offset
+struct TissueInstance
+{
+    const Tissue* source;
+    glm::vec3 offset;
+    float scale;
+};
+
+// per-chunk raw moments for applyDamping (double so the center-of-mass shift does not cancel)
+struct DampingPartial
+{
+    double mass;
+    double position[3];   // sum m x
+    double velocity[3];   // sum m v
+    double momentum[3];   // sum m x cross v
+    double second[6];     // sum m x x^T: xx yy zz xy xz yz
+};
+
+// vertices [begin, end) of one body, a damping reduction chunk never spans two
+struct DampingChunk
+{
+    int begin;
+    int end;
+    int body;
+};
+
+// the motion applyDamping keeps of one body
+struct RigidMotion
+{
+    glm::vec3 center;
+    glm::vec3 velocity;
+    glm::vec3 angularVelocity;
+};
+
+// residual of one constraint sweep: max and RMS of |currentLength - restLength|
+struct ConstraintResidual
+{
+    float max;
+    float rms;
+};
+
+// what the sweeps of the last step() did
+struct SolveStats
+{
+    int iterations;              // sweeps run, summed over substeps
+    ConstraintResidual residual; // residual of the last sweep
+    float solverMs;              // wall time spent in sweeps
+    bool budgetLimited;          // sweeps were cut to stay inside solverBudgetMs
+};
+
+// per-task residual accumulator, combined in task order
+struct ResidualPartial
+{
+    float max;
+    double sumSquares;
+};
+
+// sleeping bookkeeping (see Tissue::updateSleep), one entry per SLEEP_TILE vertices
+struct SleepTiles
+{
+    std::vector<uint8_t> awake;
+    std::vector<int> quietSteps;
+    std::vector<uint64_t> version;              // positionVersion when the tile's positions last changed
+    std::vector<DampingPartial> moments;        // damping moments of each sleeping tile (its velocities are 0)
+    std::vector<std::pair<int, int>> awakeRuns; // [begin, end) vertex ranges of consecutive awake tiles
+    std::vector<int> constraintOffsets;         // constraints touching tile t: constraints[offsets[t] .. offsets[t+1])
+    std::vector<int> constraints;
+    // while any tile sleeps: the constraints with an awake endpoint, color by color, with sleeping vertices at inverse mass 0
+    std::vector<int> first, second, colorOffsets;
+    std::vector<float> restLength, lambda, inverseMass;
+    int asleep;                                 // sleeping tiles
+    bool changed;                               // awake set changed, runs and arrays need a rebuild
+};
+
+// One float stream per component (structure of arrays) so kernels load x, y and z
+// of consecutive vertices straight into vector registers.
+struct Vec3Streams
+{
+    std::vector<float> x, y, z;
+
+    void resize(size_t count) { x.resize(count); y.resize(count); z.resize(count); }
+    size_t size() const { return x.size(); }
+    glm::vec3 get(int i) const { return glm::vec3(x[i], y[i], z[i]); }
+    void set(int i, const glm::vec3& v) { x[i] = v.x; y[i] = v.y; z[i] = v.z; }
+};
+
+/*
+    Tissue (GL-free simulation state, no context needed)
+        Vertices (SoA streams)
+            pos
+            est pos
+            velocity
+            inverse mass (0 = fixed)
+            UPDATE VERTICES VELOCITY
+            UPDATE VERTICES POSITIONS
+        Stretch constraints
+            endpoint index pairs + rest length
+            grouped by color: no two constraints of one color share a vertex,
+            so a color batch can be projected in parallel and 8 at a time in SIMD
+*/
+class Tissue
+{
+    friend class Checkpoint;
+
+    public:
+    Vec3Streams positions;
+    Vec3Streams estimatedPositions;
+    Vec3Streams velocities;
+    std::vector<float> inverseMass;
+
+    // step() settings
+    int iterations;         // max constraint sweeps per (sub)step: PBD 20, XPBD 1
+    int substeps;           // PBD 1, XPBD 20
+    float compliance;       // XPBD inverse stiffness, 0 = inextensible
+    float dampingFactor;    // rigid-mode damping applied once per step
+
+    // adaptive sweeps; all 0 (default) always runs `iterations` sweeps
+    float residualTolerance; // stop once the max residual is below this
+    float solverBudgetMs;    // sweep time per step(), split over the substeps; one sweep per substep always runs
+
+    // sleeping; sleepVelocity 0 (default) keeps every vertex awake. Explicit constraints only, no multigrid.
+    // Sleeping tiles skip integration, damping and projection; constraints into them treat their vertices as fixed.
+    float sleepVelocity;     // a tile sleeps after SLEEP_STEPS steps with every vertex slower than this
+    float sleepResidual;     // and every constraint touching it within this of its rest length; a constraint into a
+                             // sleeping tile stretched further wakes it
+
+    // self-collision; 0 (default) lets the sheet pass through itself. Vertices that share no draw triangle and no
+    // stretch constraint are kept at least this far apart (see self_collision.h). Sleeping vertices do not move.
+    // Implicit grids have no stored constraints, so keep it below the quad diagonal there.
+    float selfCollisionThickness;
+
+    // vertices are kept this far outside every obstacle (see addObstacle), < SDF_PADDING_CELLS of its grid
+    float obstacleMargin;
+
+    protected:
+    Integrator integrator;
+    int edgeCount;
+    int maxEdgeWidth;
+    float weight;
+    float substepTime;      // h of the running substep, XPBD scales compliance by 1/h^2
+    std::vector<int> stretchConstraintFirst;
+    std::vector<int> stretchConstraintSecond;
+    std::vector<float> stretchConstraintsRestLength;
+    std::vector<float> stretchConstraintLambda; // XPBD multipliers, reset every substep
+    std::vector<int> stretchConstraintColorOffsets; // color c = [offsets[c], offsets[c+1])
+    std::vector<unsigned int> surfaceTriangles; // imported models and batches, see getDrawTriangles for the grid's
+    std::vector<int> vertexPermutation; // build index -> current index, empty while vertices keep their build order
+    std::unique_ptr<GridSolver> gridSolver; // GridConstraints::Implicit, the stretchConstraint arrays then stay empty
+    std::unique_ptr<GridHierarchy> hierarchy; // coarse levels for multigrid V-cycles, see setMultigridLevels
+    std::unique_ptr<ThreadPool> threadPool;
+    std::unique_ptr<SelfCollision> selfCollision; // built on the first step with selfCollisionThickness > 0
+    std::vector<const SdfObstacle*> obstacles;
+    std::vector<uint64_t> obstaclePoseVersions; // as of the last step, a moved obstacle wakes every tile
+    std::vector<int> grabVertices;  // held by grab(), with their weights and targets
+    std::vector<float> grabWeights;
+    Vec3Streams grabTargets;
+    std::vector<int> bodyOffsets; // body b = vertices [offsets[b], offsets[b+1]); one body unless batched
+    std::vector<DampingChunk> dampingChunks; // scratch, kept between frames
+    std::vector<DampingPartial> dampingPartials;
+    std::vector<RigidMotion> dampingMotions;
+    std::vector<ResidualPartial> residualPartials; // one per task of the largest color
+    ConstraintResidual lastResidual;
+    SolveStats lastSolve;
+    Profiler* profiler;
+    SleepTiles sleep;
+    uint64_t positionVersion; // bumped whenever positions change, see getChangedRanges
+
+    public:
+    // constructor builds the grid vertices and stretch constraints
+    // ------------------------------------------------------------------------
+    Tissue(int edgeCount, int maxEdgeWidth, float mass=0.001f, Integrator integrator=Integrator::PBD, VertexOrder order=VertexOrder::Build,
+           GridConstraints constraints=GridConstraints::Explicit);
+    // builds vertices and one stretch constraint per edge of an imported model (see tissue_model.h)
+    explicit Tissue(const TissueModel& model, float mass=0.001f, Integrator integrator=Integrator::PBD, VertexOrder order=VertexOrder::Build);
+    // restores the state and settings saved in an open checkpoint (see checkpoint.h), no rebuild
+    explicit Tissue(const Checkpoint& checkpoint);
+    // packs the instances into one tissue, body b after body b-1, so a step covers all of them: color c holds color c of
+    // every body. Sources need explicit constraints and, after the first such source, its integrator and mass; settings
+    // come from that first accepted source. Other bodies (null sources too) stay empty, and with none accepted the
+    // tissue is empty with default settings. Multigrid levels are not carried over.
+    explicit Tissue(const std::vector<TissueInstance>& instances);
+    ~Tissue();
+
+    // 1 = serial sweep; more threads project each color batch in parallel with identical results
+    void setThreadCount(int threadCount);
+    int getThreadCount() const;
+
+    // 0 (default): every solver iteration is one Gauss-Seidel sweep. n > 0: every iteration is a V-cycle over the
+    // grid and up to n coarser levels (see grid_hierarchy.h), which carries corrections across the sheet in a few
+    // iterations. Grids in build order only.
+    void setMultigridLevels(int levels);
+    int getMultigridLevels() const;
+
+    // records stage times and per-sweep residuals into profiler (not owned), nullptr to stop
+    void setProfiler(Profiler* profiler) { this->profiler = profiler; }
+    ConstraintResidual getLastResidual() const { return lastResidual; }
+
+    // rigid obstacles (not owned) the vertices are kept obstacleMargin outside of; they may be moved between steps.
+    // Not stored in checkpoints, and a batch does not inherit its sources' obstacles
+    void addObstacle(const SdfObstacle* obstacle);
+    void removeObstacle(const SdfObstacle* obstacle);
+    int getObstacleCount() const { return (int)obstacles.size(); }
+    SolveStats getLastSolveStats() const { return lastSolve; }
+
+    Integrator getIntegrator() const { return integrator; }
+    int getEdgeCount() const { return edgeCount; } // grid resolution, 0 for imported models
+    int getMaxEdgeWidth() const { return maxEdgeWidth; } // grid side length in world units
+    int getVertexCount() const { return (int)positions.size(); }
+    int getConstraintCount() const;
+    int getColorCount() const;
+    GridConstraints getGridConstraints() const { return gridSolver ? GridConstraints::Implicit : GridConstraints::Explicit; }
+    // bytes held for the stretch constraints: endpoint/rest/multiplier arrays, or the implicit solver's multipliers
+    size_t getConstraintMemoryBytes() const;
+    static const char* getSimdName();
+    const std::vector<unsigned int>& getSurfaceTriangles() const { return surfaceTriangles; }
+    // what Mesh draws: the surface triangles, or two triangles per cell of a grid
+    std::vector<unsigned int> getDrawTriangles() const;
+    // bodies of a batch (damped each on its own), 1 otherwise
+    int getBodyCount() const { return (int)bodyOffsets.size() - 1; }
+    int getBodyBegin(int body) const { return bodyOffsets[body]; }
+    int getBodyEnd(int body) const { return bodyOffsets[body + 1]; }
+    // constraint endpoints in sweep order, color by color; empty for GridConstraints::Implicit
+    const std::vector<int>& getConstraintFirst() const { return stretchConstraintFirst; }
+    const std::vector<int>& getConstraintSecond() const { return stretchConstraintSecond; }
+    const std::vector<float>& getConstraintRestLength() const { return stretchConstraintsRestLength; }
+    const std::vector<int>& getColorOffsets() const { return stretchConstraintColorOffsets; } // color c = [c], [c+1]
+
+    // renumbers the vertices and sorts each color's constraints by endpoint to match; colors stay as they are.
+    // Meant for build time: anything holding vertex indices (picking, GL index buffers) must map them again.
+    // Implicit grid constraints depend on the build order, so they refuse any other.
+    void reorderVertices(VertexOrder order);
+    // newIndex[v] is where vertex v goes; single bodies only
+    void permuteVertices(const std::vector<int>& newIndex);
+    // current index of the vertex built as buildIndex (grid i*edgeCount + j, or the model's vertex)
+    int getVertexIndex(int buildIndex) const { return vertexPermutation.empty() ? buildIndex : vertexPermutation[buildIndex]; }
+    bool isBuildOrder() const { return vertexPermutation.empty(); }
+
+    bool isVertexFixed(int i) const { return inverseMass[i] == 0.0f; }
+    // also wakes the vertex's tile
+    void setVertexFixed(int i, bool fixed);
+
+    // kinematic grab, e.g. a VertexPicker::getGrabRegion. Weight 1 pins the vertex and moveGrab carries it along;
+    // after every stretch sweep a lighter one moves that share of the way to its target, where it was grabbed plus
+    // the moves since, so the hold fades out towards the rim. Fixed vertices are left out; a new grab drops the last
+    void grab(const std::vector<int>& vertices, const std::vector<float>& weights);
+    void moveGrab(glm::vec3 offset);
+    void releaseGrab();
+    const std::vector<int>& getGrabVertices() const { return grabVertices; }
+    const std::vector<float>& getGrabWeights() const { return grabWeights; }
+    float getFreeInverseMass() const { return weight; } // inverse mass of every vertex that is not fixed
+
+    // interleaved xyz copy of positions for upload (3 floats per vertex)
+    void copyPositions(float* destination) const;
+    // vertices [begin, end) only, to the same place in destination
+    void copyPositions(float* destination, int begin, int end) const;
+
+    // wakes the tile of vertex i and marks its positions changed; call after moving vertices by hand
+    void wakeVertex(int i);
+    void wakeAll();
+    bool isVertexAwake(int i) const { return sleep.awake[i / SLEEP_TILE] != 0; }
+    int getAwakeVertexCount() const;
+    // positionVersion grows with every change; ranges gets the [begin, end) vertex ranges changed after sinceVersion,
+    // so an upload holding sinceVersion only needs those
+    uint64_t getPositionVersion() const { return positionVersion; }
+    void getChangedRanges(uint64_t sinceVersion, std::vector<std::pair<int, int>>& ranges) const;
+
+    // one frame: gravity, damping, prediction, constraint sweeps, velocity update
+    void step(float deltaTime, glm::vec3 gravity);
+
+    void addGravity(float deltaTime, glm::vec3 gravity);
+    void applyDamping(float dampingFactor);
+    void updateEstimatedPositions(float deltaTime);
+    // XPBD: clears the multipliers and sets the substep length compliance is scaled by; before the first sweep of
+    // every substep. No-op for PBD
+    void beginSubstep(float deltaTime);
+    // broad phase over the estimated positions: the collision constraints of this substep, see selfCollisionThickness
+    void findCollisionPairs();
+    void SolveCollisionConstraints();
+    int getCollisionPairCount() const;
+    // projects the awake vertices out of every obstacle, after the stretch sweep of each iteration
+    void SolveObstacleConstraints();
+    // pulls the awake held vertices towards their grab targets, after the obstacles
+    void SolveGrabConstraints();
+    // one Gauss-Seidel sweep, or one V-cycle with multigrid levels; returns the residual of the last fine sweep
+    ConstraintResidual SolveAllStretchConstraints();
+    void updateVelocitiesAndPositions(float deltaTime);
+
+    // utility function for creating mesh vertices and constraints.
+    // ------------------------------------------------------------------------
+
+    private:
+    // the arrays a sweep runs over: every stretch constraint, or the awake ones while tiles sleep
+    struct ConstraintArrays
+    {
+        const int* first;
+        const int* second;
+        const float* restLength;
+        float* lambda;
+        const float* inverseMass;
+    };
+
+    void setDefaultSettings();
+    void createPositions(int edgeCount, int maxEdgeWidth);
+    void createStretchConstraints();
+    void createImplicitConstraints();
+    void addStretchConstraint(int i1, int i2);
+    void colorStretchConstraints();
+    void allocateSolverScratch();
+    ConstraintResidual sweepStretchConstraints();
+    void SolveStretchConstraints(const ConstraintArrays& arrays, int begin, int end, ResidualPartial& residual);
+    void SolveStretchConstraintsXPBD(const ConstraintArrays& arrays, int begin, int end, ResidualPartial& residual);
+    double solveAdaptive(double budget);
+    bool isSleepEnabled() const;
+    void resetSleep();
+    void buildTileConstraints();
+    void rebuildAwakeSet();
+    void updateSleep();
+    void accumulateDampingMoments(DampingPartial& partial, int begin, int end) const;
+    void wakeTile(int tile);
+    void sleepTile(int tile);
+};
+
+#endif
@@ -0,0 +1,688 @@
+#include "tissue_model.h"
+#include "mapped_file.h"
+
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <sstream>
+
+namespace
+{
+    const uint32_t MODEL_CACHE_ENDIAN_TAG = 0x01020304;
+
+    bool isLittleEndian()
+    {
+        uint32_t tag = MODEL_CACHE_ENDIAN_TAG;
+        unsigned char first;
+        std::memcpy(&first, &tag, 1);
+        return first == 0x04;
+    }
+
+    size_t alignUp(size_t offset)
+    {
+        return (offset + MODEL_CACHE_ALIGNMENT - 1) / MODEL_CACHE_ALIGNMENT * MODEL_CACHE_ALIGNMENT;
+    }
+
+    std::string getExtension(const std::string& path)
+    {
+        size_t dot = path.find_last_of('.');
+        if (dot == std::string::npos || path.find_first_of("/\\", dot) != std::string::npos) return "";
+        std::string extension = path.substr(dot + 1);
+        for (char& c : extension) c = (char)std::tolower((unsigned char)c);
+        return extension;
+    }
+
+    // a TetGen model is the .node / .ele pair, either name stands for both
+    bool isTetGen(const std::string& extension) { return extension == "node" || extension == "ele"; }
+
+    // byte offsets of the six cache arrays; returns the file size
+    size_t getCacheLayout(const ModelCacheHeader& header, size_t offsets[6])
+    {
+        const uint64_t counts[6] = { header.vertexCount, header.vertexCount, header.vertexCount,
+                                     header.triangleIndexCount, header.edgeCount, header.edgeCount };
+        size_t offset = alignUp(sizeof(ModelCacheHeader));
+        for (int a = 0; a < 6; a++)
+        {
+            offsets[a] = offset;
+            offset = alignUp(offset + counts[a] * 4);
+        }
+        return offset;
+    }
+
+    // whole file as a zero-terminated string, so the strto* parsers can never run off the end
+    bool readText(const std::string& path, std::string& text)
+    {
+        MappedFile file;
+        if (!file.open(path)) return false;
+        text.assign(file.data(), file.size());
+        return true;
+    }
+
+    // line-oriented text scanning: blanks never cross a newline, '#' starts a comment
+    const char* skipBlanks(const char* p)
+    {
+        while (*p == ' ' || *p == '\t' || *p == '\r') p++;
+        return p;
+    }
+
+    const char* nextLine(const char* p)
+    {
+        while (*p && *p != '\n') p++;
+        return *p ? p + 1 : p;
+    }
+
+    bool isLineEnd(const char* p) { return *p == '\n' || *p == '\0' || *p == '#'; }
+
+    bool readFloat(const char*& p, float& value)
+    {
+        p = skipBlanks(p);
+        if (isLineEnd(p)) return false;
+        char* end;
+        value = std::strtof(p, &end);
+        if (end == p) return false;
+        p = end;
+        return true;
+    }
+
+    bool readInt(const char*& p, long& value)
+    {
+        p = skipBlanks(p);
+        if (isLineEnd(p)) return false;
+        char* end;
+        value = std::strtol(p, &end, 10);
+        if (end == p) return false;
+        p = end;
+        return true;
+    }
+
+    // first line at or after p that is neither blank nor a comment, nullptr at the end of the text
+    const char* nextRecord(const char* p)
+    {
+        while (*p)
+        {
+            const char* start = skipBlanks(p);
+            if (!isLineEnd(start)) return start;
+            p = nextLine(start);
+        }
+        return nullptr;
+    }
+
+    // ------------------------------------------------------------------------
+    // PLY
+
+    enum class PlyType { Int8, UInt8, Int16, UInt16, Int32, UInt32, Float32, Float64, Invalid };
+
+    PlyType getPlyType(const std::string& name)
+    {
+        if (name == "char" || name == "int8") return PlyType::Int8;
+        if (name == "uchar" || name == "uint8") return PlyType::UInt8;
+        if (name == "short" || name == "int16") return PlyType::Int16;
+        if (name == "ushort" || name == "uint16") return PlyType::UInt16;
+        if (name == "int" || name == "int32") return PlyType::Int32;
+        if (name == "uint" || name == "uint32") return PlyType::UInt32;
+        if (name == "float" || name == "float32") return PlyType::Float32;
+        if (name == "double" || name == "float64") return PlyType::Float64;
+        return PlyType::Invalid;
+    }
+
+    size_t getPlySize(PlyType type)
+    {
+        switch (type)
+        {
+            case PlyType::Int8: case PlyType::UInt8: return 1;
+            case PlyType::Int16: case PlyType::UInt16: return 2;
+            case PlyType::Float64: return 8;
+            default: return 4;
+        }
+    }
+
+    struct PlyProperty
+    {
+        std::string name;
+        PlyType type;
+        PlyType countType;  // list length type, Invalid for scalar properties
+    };
+
+    struct PlyElement
+    {
+        std::string name;
+        uint64_t count;
+        std::vector<PlyProperty> properties;
+    };
+
+    // reads one value of any PLY type from the body, ascii or binary in either byte order
+    class PlyReader
+    {
+        public:
+        PlyReader(const char* begin, const char* end, bool ascii, bool swapBytes)
+            : p(begin), end(end), ascii(ascii), swapBytes(swapBytes) {}
+
+        bool read(PlyType type, double& value)
+        {
+            if (ascii)
+            {
+                while (p < end && std::isspace((unsigned char)*p)) p++;
+                char* stop;
+                value = std::strtod(p, &stop);
+                if (stop == p) return false;
+                p = stop;
+                return true;
+            }
+
+            size_t size = getPlySize(type);
+            if ((size_t)(end - p) < size) return false;
+            unsigned char bytes[8];
+            std::memcpy(bytes, p, size);
+            if (swapBytes) std::reverse(bytes, bytes + size);
+            p += size;
+            switch (type)
+            {
+                case PlyType::Int8: { int8_t v; std::memcpy(&v, bytes, 1); value = v; break; }
+                case PlyType::UInt8: value = bytes[0]; break;
+                case PlyType::Int16: { int16_t v; std::memcpy(&v, bytes, 2); value = v; break; }
+                case PlyType::UInt16: { uint16_t v; std::memcpy(&v, bytes, 2); value = v; break; }
+                case PlyType::Int32: { int32_t v; std::memcpy(&v, bytes, 4); value = v; break; }
+                case PlyType::UInt32: { uint32_t v; std::memcpy(&v, bytes, 4); value = v; break; }
+                case PlyType::Float32: { float v; std::memcpy(&v, bytes, 4); value = v; break; }
+                default: { double v; std::memcpy(&v, bytes, 8); value = v; break; }
+            }
+            return true;
+        }
+
+        private:
+        const char* p;
+        const char* end;
+        bool ascii;
+        bool swapBytes;
+    };
+
+    bool isVertexIndex(double value) { return value >= 0.0 && value <= (double)INT_MAX && value == (double)(int)value; }
+}
+
+bool TissueModel::getSourceStamp(const std::string& path, uint64_t& bytes, int64_t& modified)
+{
+    std::vector<std::string> sources = { path };
+    if (isTetGen(getExtension(path)))
+    {
+        std::string base = path.substr(0, path.find_last_of('.'));
+        sources = { base + ".node", base + ".ele" };
+    }
+    bytes = 0;
+    modified = INT64_MIN; // file clock epochs differ, times may be negative
+    for (const std::string& source : sources)
+    {
+        std::error_code failure;
+        uintmax_t size = std::filesystem::file_size(source, failure);
+        if (failure) return false;
+        auto time = std::filesystem::last_write_time(source, failure);
+        if (failure) return false;
+        bytes += size;
+        modified = std::max(modified, (int64_t)time.time_since_epoch().count());
+    }
+    return true;
+}
+
+// ------------------------------------------------------------------------
+// loading
+
+bool TissueModel::fail(const std::string& reason)
+{
+    error = reason;
+    clear();
+    return false;
+}
+
+void TissueModel::clear()
+{
+    positions.resize(0);
+    triangles.clear();
+    edgeFirst.clear();
+    edgeSecond.clear();
+}
+
+bool TissueModel::load(const std::string& path, bool useCache)
+{
+    clear();
+    error.clear();
+    fromCache = false;
+    useCache = useCache && isLittleEndian();
+
+    std::string cachePath = getCachePath(path);
+    if (useCache && readCache(cachePath, path))
+    {
+        fromCache = true;
+        return true;
+    }
+    clear();
+    if (!parse(path)) return false;
+
+    // a missing cache only costs the next start a parse
+    if (useCache && !writeCache(cachePath, path)) std::cout << "ERROR::MODEL::CANNOT_WRITE_CACHE " << cachePath << std::endl;
+    return true;
+}
+
+bool TissueModel::parse(const std::string& path)
+{
+    std::string extension = getExtension(path);
+    std::vector<int> tets;
+    if (extension == "obj")
+    {
+        if (!parseObj(path)) return false;
+    }
+    else if (extension == "ply")
+    {
+        if (!parsePly(path)) return false;
+    }
+    else if (isTetGen(extension))
+    {
+        if (!parseTetGen(path.substr(0, path.find_last_of('.')), tets)) return false;
+    }
+    else return fail(path + ": unknown model type, expected .obj, .ply, .node or .ele");
+
+    if (positions.size() == 0) return fail(path + " has no vertices");
+    if (!buildEdges(tets)) return false;
+    if (!tets.empty()) buildBoundary(tets);
+    if (edgeFirst.empty()) return fail(path + " has no faces or tetrahedra");
+    removeUnusedVertices();
+    return true;
+}
+
+// v x y z [w] and f a b c ... records; a face index may be negative (relative) and carry /vt/vn
+bool TissueModel::parseObj(const std::string& path)
+{
+    std::string text;
+    if (!readText(path, text)) return fail("cannot open " + path);
+
+    std::vector<long> polygon;
+    int lineNumber = 0;
+    for (const char* line = text.c_str(); *line; line = nextLine(line))
+    {
+        lineNumber++;
+        const char* p = skipBlanks(line);
+        bool vertex = p[0] == 'v' && (p[1] == ' ' || p[1] == '\t');
+        bool face = p[0] == 'f' && (p[1] == ' ' || p[1] == '\t');
+        if (!vertex && !face) continue;
+        p++;
+
+        if (vertex)
+        {
+            float x, y, z;
+            if (!readFloat(p, x) || !readFloat(p, y) || !readFloat(p, z)) return fail(path + ":" + std::to_string(lineNumber) + ": vertex needs x y z");
+            positions.x.push_back(x);
+            positions.y.push_back(y);
+            positions.z.push_back(z);
+            continue;
+        }
+
+        polygon.clear();
+        long index;
+        while (readInt(p, index))
+        {
+            long resolved = index > 0 ? index - 1 : (long)positions.size() + index;
+            if (index == 0 || resolved < 0 || resolved > INT_MAX) return fail(path + ":" + std::to_string(lineNumber) + ": bad vertex index");
+            polygon.push_back(resolved);
+            while (*p && *p != ' ' && *p != '\t' && *p != '\r' && *p != '\n') p++; // /vt/vn
+        }
+        if (polygon.size() < 3) return fail(path + ":" + std::to_string(lineNumber) + ": face needs 3 vertices");
+        for (size_t k = 1; k + 1 < polygon.size(); k++)
+        {
+            triangles.push_back((unsigned int)polygon[0]);
+            triangles.push_back((unsigned int)polygon[k]);
+            triangles.push_back((unsigned int)polygon[k + 1]);
+        }
+    }
+    return true;
+}
+
+bool TissueModel::parsePly(const std::string& path)
+{
+    MappedFile file;
+    if (!file.open(path)) return fail("cannot open " + path);
+    std::string head(file.data(), std::min(file.size(), (size_t)65536));
+    size_t headerEnd = head.find("end_header");
+    if (head.compare(0, 3, "ply") != 0 || headerEnd == std::string::npos) return fail(path + " is not a PLY file");
+    size_t bodyStart = head.find('\n', headerEnd);
+    if (bodyStart == std::string::npos) return fail(path + " is not a PLY file");
+    bodyStart++;
+
+    std::istringstream header(head.substr(0, headerEnd));
+    std::string line, format;
+    std::vector<PlyElement> elements;
+    while (std::getline(header, line))
+    {
+        std::istringstream words(line);
+        std::string keyword;
+        words >> keyword;
+        if (keyword == "format") words >> format;
+        else if (keyword == "element")
+        {
+            PlyElement element;
+            words >> element.name >> element.count;
+            elements.push_back(element);
+        }
+        else if (keyword == "property" && !elements.empty())
+        {
+            PlyProperty property;
+            std::string type;
+            words >> type;
+            if (type == "list")
+            {
+                std::string countType;
+                words >> countType >> type;
+                property.countType = getPlyType(countType);
+                if (property.countType == PlyType::Invalid) return fail(path + ": unknown PLY type " + countType);
+            }
+            else property.countType = PlyType::Invalid;
+            words >> property.name;
+            property.type = getPlyType(type);
+            if (property.type == PlyType::Invalid) return fail(path + ": unknown PLY type " + type);
+            elements.back().properties.push_back(property);
+        }
+    }
+
+    bool ascii = format == "ascii";
+    if (!ascii && format != "binary_little_endian" && format != "binary_big_endian") return fail(path + ": unknown PLY format " + format);
+    std::string body;
+    const char* begin = file.data() + bodyStart;
+    const char* end = file.data() + file.size();
+    if (ascii)
+    {
+        // zero-terminated copy for strtod
+        body.assign(begin, end);
+        begin = body.c_str();
+        end = begin + body.size();
+    }
+    PlyReader reader(begin, end, ascii, format == "binary_big_endian" ? isLittleEndian() : !isLittleEndian());
+
+    std::vector<long> polygon;
+    for (const PlyElement& element : elements)
+    {
+        bool vertices = element.name == "vertex";
+        bool faces = element.name == "face";
+        int axis[3] = { -1, -1, -1 };
+        for (size_t k = 0; k < element.properties.size(); k++)
+        {
+            const std::string& name = element.properties[k].name;
+            if (vertices && name.size() == 1 && name[0] >= 'x' && name[0] <= 'z') axis[name[0] - 'x'] = (int)k;
+        }
+        if (vertices && (axis[0] < 0 || axis[1] < 0 || axis[2] < 0)) return fail(path + ": PLY vertices need x, y and z");
+        if (vertices && element.count > INT_MAX) return fail(path + ": too many PLY vertices");
+        if (vertices) positions.resize(element.count);
+
+        for (uint64_t item = 0; item < element.count; item++)
+        {
+            for (size_t k = 0; k < element.properties.size(); k++)
+            {
+                const PlyProperty& property = element.properties[k];
+                double value;
+                if (property.countType == PlyType::Invalid)
+                {
+                    if (!reader.read(property.type, value)) return fail(path + ": PLY data is truncated");
+                    if (vertices && (int)k == axis[0]) positions.x[item] = (float)value;
+                    else if (vertices && (int)k == axis[1]) positions.y[item] = (float)value;
+                    else if (vertices && (int)k == axis[2]) positions.z[item] = (float)value;
+                    continue;
+                }
+
+                double length;
+                if (!reader.read(property.countType, length) || length < 0.0) return fail(path + ": PLY data is truncated");
+                bool indices = faces && (property.name == "vertex_indices" || property.name == "vertex_index");
+                polygon.clear();
+                for (long n = 0; n < (long)length; n++)
+                {
+                    if (!reader.read(property.type, value)) return fail(path + ": PLY data is truncated");
+                    if (!indices) continue;
+                    if (!isVertexIndex(value)) return fail(path + ": bad PLY vertex index");
+                    polygon.push_back((long)value);
+                }
+                for (size_t c = 1; c + 1 < polygon.size(); c++)
+                {
+                    triangles.push_back((unsigned int)polygon[0]);
+                    triangles.push_back((unsigned int)polygon[c]);
+                    triangles.push_back((unsigned int)polygon[c + 1]);
+                }
+            }
+        }
+    }
+    return true;
+}
+
+// <base>.node: "points 3 attributes markers", then "index x y z ...";
+// <base>.ele: "tets nodesPerTet attributes", then "index n1 n2 n3 n4 ..." (the mid-edge nodes of 10-node tets are
+// skipped, their points are removed with the other unused ones).
+// Indices start wherever the .node file starts, 0 or 1.
+bool TissueModel::parseTetGen(const std::string& basePath, std::vector<int>& tets)
+{
+    std::string nodes, elements;
+    if (!readText(basePath + ".node", nodes)) return fail("cannot open " + basePath + ".node");
+    if (!readText(basePath + ".ele", elements)) return fail("cannot open " + basePath + ".ele");
+
+    const char* p = nextRecord(nodes.c_str());
+    long pointCount, dimension;
+    if (!p || !readInt(p, pointCount) || !readInt(p, dimension) || pointCount <= 0 || pointCount > INT_MAX || dimension != 3)
+    {
+        return fail(basePath + ".node: expected a 3D point count");
+    }
+    positions.resize((size_t)pointCount);
+    long firstIndex = 0;
+    for (long i = 0; i < pointCount; i++)
+    {
+        p = nextRecord(nextLine(p));
+        long index;
+        float x, y, z;
+        if (!p || !readInt(p, index) || !readFloat(p, x) || !readFloat(p, y) || !readFloat(p, z)) return fail(basePath + ".node: point " + std::to_string(i) + " is malformed");
+        if (i == 0) firstIndex = index;
+        positions.set((int)i, glm::vec3(x, y, z));
+    }
+
+    p = nextRecord(elements.c_str());
+    long tetCount, nodesPerTet;
+    if (!p || !readInt(p, tetCount) || !readInt(p, nodesPerTet) || tetCount <= 0 || (nodesPerTet != 4 && nodesPerTet != 10))
+    {
+        return fail(basePath + ".ele: expected a count of 4- or 10-node tetrahedra");
+    }
+    tets.reserve((size_t)tetCount * 4);
+    for (long t = 0; t < tetCount; t++)
+    {
+        p = nextRecord(nextLine(p));
+        long index, node;
+        if (!p || !readInt(p, index)) return fail(basePath + ".ele: tetrahedron " + std::to_string(t) + " is malformed");
+        for (int k = 0; k < 4; k++)
+        {
+            if (!readInt(p, node) || node - firstIndex < 0 || node - firstIndex > INT_MAX) return fail(basePath + ".ele: tetrahedron " + std::to_string(t) + " is malformed");
+            tets.push_back((int)(node - firstIndex));
+        }
+    }
+    return true;
+}
+
+bool TissueModel::buildEdges(const std::vector<int>& tets)
+{
+    size_t vertexCount = positions.size();
+    if (triangles.size() % 3 != 0 || tets.size() % 4 != 0) return fail("model connectivity is incomplete");
+    for (unsigned int index : triangles) if (index >= vertexCount) return fail("model face refers to missing vertex " + std::to_string(index));
+    for (int index : tets) if (index < 0 || (size_t)index >= vertexCount) return fail("model tetrahedron refers to missing vertex " + std::to_string(index));
+
+    // (min << 32 | max) per edge, sorted and made unique; degenerate edges are dropped
+    std::vector<uint64_t> keys;
+    keys.reserve(triangles.size() + tets.size() / 4 * 6);
+    auto add = [&keys](uint32_t a, uint32_t b) {
+        if (a == b) return;
+        if (a > b) std::swap(a, b);
+        keys.push_back((uint64_t)a << 32 | b);
+    };
+    for (size_t t = 0; t < triangles.size(); t += 3)
+    {
+        add(triangles[t], triangles[t + 1]);
+        add(triangles[t + 1], triangles[t + 2]);
+        add(triangles[t + 2], triangles[t]);
+    }
+    for (size_t t = 0; t < tets.size(); t += 4)
+    {
+        for (int a = 0; a < 4; a++)
+        {
+            for (int b = a + 1; b < 4; b++) add(tets[t + a], tets[t + b]);
+        }
+    }
+    std::sort(keys.begin(), keys.end());
+    keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+
+    edgeFirst.resize(keys.size());
+    edgeSecond.resize(keys.size());
+    for (size_t e = 0; e < keys.size(); e++)
+    {
+        edgeFirst[e] = (int)(keys[e] >> 32);
+        edgeSecond[e] = (int)(keys[e] & 0xffffffffu);
+    }
+    return true;
+}
+
+// The surface of a tet mesh is every face only one tet has, wound to face out of that tet.
+void TissueModel::buildBoundary(const std::vector<int>& tets)
+{
+    struct Face
+    {
+        std::array<int, 3> key;     // sorted, equal for both sides of an interior face
+        std::array<int, 3> wound;   // outward for the tet it came from
+    };
+    std::vector<Face> faces;
+    faces.reserve(tets.size());
+    for (size_t t = 0; t < tets.size(); t += 4)
+    {
+        int a = tets[t], b = tets[t + 1], c = tets[t + 2], d = tets[t + 3];
+        glm::vec3 pa = positions.get(a);
+        bool positive = glm::dot(glm::cross(positions.get(b) - pa, positions.get(c) - pa), positions.get(d) - pa) >= 0.0f;
+        const std::array<int, 3> outward[4] = { { a, c, b }, { a, b, d }, { a, d, c }, { b, c, d } };
+        for (const std::array<int, 3>& face : outward)
+        {
+            Face entry;
+            entry.wound = positive ? face : std::array<int, 3>{ face[0], face[2], face[1] };
+            entry.key = face;
+            std::sort(entry.key.begin(), entry.key.end());
+            faces.push_back(entry);
+        }
+    }
+    std::sort(faces.begin(), faces.end(), [](const Face& l, const Face& r) { return l.key < r.key; });
+
+    triangles.clear();
+    for (size_t f = 0; f < faces.size();)
+    {
+        size_t next = f + 1;
+        while (next < faces.size() && faces[next].key == faces[f].key) next++;
+        if (next - f == 1)
+        {
+            for (int k = 0; k < 3; k++) triangles.push_back((unsigned int)faces[f].wound[k]);
+        }
+        f = next;
+    }
+}
+
+// Keeps the order of the remaining vertices, so sorted edges stay sorted and edgeFirst < edgeSecond still holds.
+void TissueModel::removeUnusedVertices()
+{
+    std::vector<int> remap(positions.size(), -1);
+    for (size_t e = 0; e < edgeFirst.size(); e++) remap[edgeFirst[e]] = remap[edgeSecond[e]] = 0;
+    int used = 0;
+    for (size_t i = 0; i < remap.size(); i++)
+    {
+        if (remap[i] < 0) continue;
+        remap[i] = used;
+        positions.set(used++, positions.get((int)i));
+    }
+    if (used == (int)positions.size()) return;
+    positions.resize(used);
+    for (unsigned int& index : triangles) index = (unsigned int)remap[index];
+    for (size_t e = 0; e < edgeFirst.size(); e++)
+    {
+        edgeFirst[e] = remap[edgeFirst[e]];
+        edgeSecond[e] = remap[edgeSecond[e]];
+    }
+}
+
+void TissueModel::fixTopVertices(float band)
+{
+    fixedVertices.clear();
+    if (positions.size() == 0) return;
+    auto range = std::minmax_element(positions.y.begin(), positions.y.end());
+    float top = *range.second - band * (*range.second - *range.first);
+    for (int i = 0; i < getVertexCount(); i++)
+    {
+        if (positions.y[i] >= top) fixedVertices.push_back(i);
+    }
+}
+
+// ------------------------------------------------------------------------
+// binary cache
+
+bool TissueModel::writeCache(const std::string& cachePath, const std::string& sourcePath) const
+{
+    ModelCacheHeader header = {};
+    std::memcpy(header.magic, MODEL_CACHE_MAGIC, sizeof(header.magic));
+    header.version = MODEL_CACHE_VERSION;
+    header.endianTag = MODEL_CACHE_ENDIAN_TAG;
+    if (!getSourceStamp(sourcePath, header.sourceBytes, header.sourceModified)) return false;
+    header.vertexCount = positions.size();
+    header.triangleIndexCount = triangles.size();
+    header.edgeCount = edgeFirst.size();
+    size_t offsets[6];
+    header.fileBytes = getCacheLayout(header, offsets);
+
+    const void* arrays[6] = { positions.x.data(), positions.y.data(), positions.z.data(), triangles.data(), edgeFirst.data(), edgeSecond.data() };
+    const size_t counts[6] = { positions.size(), positions.size(), positions.size(), triangles.size(), edgeFirst.size(), edgeSecond.size() };
+    std::vector<char> image(header.fileBytes, 0);
+    std::memcpy(image.data(), &header, sizeof(header));
+    for (int a = 0; a < 6; a++)
+    {
+        if (counts[a]) std::memcpy(image.data() + offsets[a], arrays[a], counts[a] * 4);
+    }
+
+    return replaceFile(cachePath, { { image.data(), image.size() } });
+}
+
+bool TissueModel::readCache(const std::string& cachePath, const std::string& sourcePath)
+{
+    MappedFile file;
+    if (!file.open(cachePath) || file.size() < sizeof(ModelCacheHeader)) return false;
+    ModelCacheHeader header;
+    std::memcpy(&header, file.data(), sizeof(header));
+    if (std::memcmp(header.magic, MODEL_CACHE_MAGIC, sizeof(header.magic)) != 0 || header.version != MODEL_CACHE_VERSION
+        || header.endianTag != MODEL_CACHE_ENDIAN_TAG || header.fileBytes != file.size())
+    {
+        return false;
+    }
+    uint64_t sourceBytes;
+    int64_t sourceModified;
+    if (!getSourceStamp(sourcePath, sourceBytes, sourceModified) || sourceBytes != header.sourceBytes || sourceModified != header.sourceModified) return false;
+    if (header.vertexCount == 0 || header.vertexCount > INT_MAX || header.triangleIndexCount % 3 != 0 || header.edgeCount > INT_MAX
+        || header.triangleIndexCount > file.size() || header.edgeCount > file.size())
+    {
+        return false;
+    }
+    size_t offsets[6];
+    if (getCacheLayout(header, offsets) != file.size()) return false;
+
+    const float* x = (const float*)(file.data() + offsets[0]);
+    const float* y = (const float*)(file.data() + offsets[1]);
+    const float* z = (const float*)(file.data() + offsets[2]);
+    const unsigned int* faces = (const unsigned int*)(file.data() + offsets[3]);
+    const int* first = (const int*)(file.data() + offsets[4]);
+    const int* second = (const int*)(file.data() + offsets[5]);
+    for (uint64_t t = 0; t < header.triangleIndexCount; t++) if (faces[t] >= header.vertexCount) return false;
+    for (uint64_t e = 0; e < header.edgeCount; e++)
+    {
+        if (first[e] < 0 || second[e] < 0 || (uint64_t)first[e] >= header.vertexCount || (uint64_t)second[e] >= header.vertexCount) return false;
+    }
+
+    positions.x.assign(x, x + header.vertexCount);
+    positions.y.assign(y, y + header.vertexCount);
+    positions.z.assign(z, z + header.vertexCount);
+    triangles.assign(faces, faces + header.triangleIndexCount);
+    edgeFirst.assign(first, first + header.edgeCount);
+    edgeSecond.assign(second, second + header.edgeCount);
+    return true;
+}
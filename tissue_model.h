@@ -0,0 +1,91 @@
+#ifndef TISSUE_MODEL_H
+#define TISSUE_MODEL_H
+
+#include "tissue.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/*
+    Model cache file, version 2, little-endian, written next to the source as <source>.tcache
+        ModelCacheHeader        counts and the size / modification time of the source it came from
+        arrays                  x, y, z, triangles, edgeFirst, edgeSecond, each on a MODEL_CACHE_ALIGNMENT boundary
+    A cache whose stamp no longer matches the source is rebuilt.
+*/
+const char MODEL_CACHE_MAGIC[8] = { 'T', 'I', 'S', 'S', 'M', 'E', 'S', 'H' };
+const uint32_t MODEL_CACHE_VERSION = 2;     // 2: unused vertices removed
+const size_t MODEL_CACHE_ALIGNMENT = 64;
+
+struct ModelCacheHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t endianTag;
+    uint64_t sourceBytes;
+    int64_t sourceModified;     // file clock ticks
+    uint64_t vertexCount;
+    uint64_t triangleIndexCount;
+    uint64_t edgeCount;
+    uint64_t fileBytes;
+};
+static_assert(sizeof(ModelCacheHeader) == 64, "ModelCacheHeader layout is part of the file format");
+
+/*
+    TissueModel (vertices and connectivity of an imported tissue, input to Tissue(const TissueModel&))
+        load() reads
+            .obj            v / f records, polygons fanned into triangles
+            .ply            ascii or binary, vertex x y z and a face index list
+            .node / .ele    TetGen tetrahedra (either file names the pair); the surface is the faces
+                            no two tets share
+        Edges of every triangle and tet are deduplicated into one distance constraint each
+        Vertices no edge uses (mid-edge nodes of 10-node tets, stray OBJ / PLY points) are removed and the indices
+        compacted, since nothing would hold them they would only fall
+        The first load writes the binary cache, later loads map it instead of parsing
+*/
+class TissueModel
+{
+    public:
+    Vec3Streams positions;
+    std::vector<unsigned int> triangles;    // surface to draw, 3 indices each
+    std::vector<int> edgeFirst;             // unique edges, edgeFirst[e] < edgeSecond[e], sorted
+    std::vector<int> edgeSecond;
+    std::vector<int> fixedVertices;         // pinned by Tissue, not part of the file or the cache
+
+    // false, with the reason in getError(), when the file is missing, malformed or of an unknown type
+    // useCache = false always parses and leaves the cache alone
+    bool load(const std::string& path, bool useCache = true);
+    const std::string& getError() const { return error; }
+    bool isFromCache() const { return fromCache; }
+
+    int getVertexCount() const { return (int)positions.size(); }
+    int getTriangleCount() const { return (int)triangles.size() / 3; }
+    int getEdgeCount() const { return (int)edgeFirst.size(); }
+
+    // pins every vertex within band * height of the highest one, the imported counterpart of the grid's top corners
+    void fixTopVertices(float band);
+
+    static std::string getCachePath(const std::string& path) { return path + ".tcache"; }
+    // size and modification time of the source files (both of a TetGen pair), what a cache is checked against
+    static bool getSourceStamp(const std::string& path, uint64_t& bytes, int64_t& modified);
+    // false when the cache is missing, stale or damaged
+    bool readCache(const std::string& cachePath, const std::string& sourcePath);
+    bool writeCache(const std::string& cachePath, const std::string& sourcePath) const;
+
+    private:
+    std::string error;
+    bool fromCache = false;
+
+    bool fail(const std::string& reason);
+    void clear();
+    bool parse(const std::string& path);
+    bool parseObj(const std::string& path);
+    bool parsePly(const std::string& path);
+    bool parseTetGen(const std::string& basePath, std::vector<int>& tets);
+    // edges of triangles and tets (4 indices each), validated against the vertex count
+    bool buildEdges(const std::vector<int>& tets);
+    void buildBoundary(const std::vector<int>& tets);
+    void removeUnusedVertices();
+};
+
+#endif
@@ -0,0 +1,53 @@
+#ifndef TRIPLE_BUFFER_H
+#define TRIPLE_BUFFER_H
+
+#include <atomic>
+#include <cstdint>
+
+/*
+    TripleBuffer (one writer thread, one reader thread, lock-free)
+        writer fills back() and publish()es it, never waits
+        reader calls update() to take the newest published slot, then reads front(), never waits
+        the third slot sits in the middle, so neither side ever touches the slot the other one holds
+        unread slots are overwritten: the reader always sees the latest state, not every state
+*/
+template<typename T>
+class TripleBuffer
+{
+    public:
+    // every slot starts as a copy of initial, so the reader has something to show before the first publish
+    explicit TripleBuffer(const T& initial)
+        : slots{ initial, initial, initial }
+    {
+    }
+
+    TripleBuffer(const TripleBuffer&) = delete;
+    TripleBuffer& operator=(const TripleBuffer&) = delete;
+
+    // writer side
+    T& back() { return slots[backIndex]; }
+    void publish()
+    {
+        backIndex = middle.exchange(backIndex | FRESH, std::memory_order_acq_rel) & INDEX;
+    }
+
+    // reader side; returns false and keeps the current front when nothing new was published
+    bool update()
+    {
+        if (!(middle.load(std::memory_order_relaxed) & FRESH)) return false;
+        frontIndex = middle.exchange(frontIndex, std::memory_order_acq_rel) & INDEX;
+        return true;
+    }
+    const T& front() const { return slots[frontIndex]; }
+
+    private:
+    static const uint8_t INDEX = 0x3;
+    static const uint8_t FRESH = 0x4; // set while the middle slot holds a state the reader has not taken
+
+    T slots[3];
+    alignas(64) std::atomic<uint8_t> middle{ 1 };
+    alignas(64) uint8_t backIndex = 0;   // writer only
+    alignas(64) uint8_t frontIndex = 2;  // reader only
+};
+
+#endif
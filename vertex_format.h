@@ -0,0 +1,131 @@
+#ifndef VERTEX_FORMAT_H
+#define VERTEX_FORMAT_H
+
+#include "tissue.h"
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+// what Mesh stores per vertex and per index on the GPU
+enum class VertexFormat
+{
+    Float,          // float3 positions and colors, 32-bit triangle lists
+    Compact,        // float3 positions, RGBA8 colors, 16-bit indices where they fit, grids as strips with restarts
+    CompactHalf,    // Compact with half-float positions (8 bytes with padding)
+    CompactSnorm16  // Compact with snorm16 positions over [-SNORM16_POSITION_RANGE, SNORM16_POSITION_RANGE], clamped
+};
+
+const float SNORM16_POSITION_RANGE = 2.0f;  // the viewport is [-1, 1], so about 6e-5 per step
+const unsigned int PRIMITIVE_RESTART = 0xFFFFFFFF; // in 32-bit index lists; 0xFFFF once packed to 16 bits
+
+inline bool isCompact(VertexFormat format) { return format != VertexFormat::Float; }
+
+// bytes per streamed position
+inline int getPositionStride(VertexFormat format)
+{
+    return format == VertexFormat::CompactHalf || format == VertexFormat::CompactSnorm16 ? 4 * sizeof(uint16_t) : 3 * sizeof(float);
+}
+
+// round to nearest even, overflow to infinity, NaN stays NaN
+inline uint16_t packHalf(float value)
+{
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    uint32_t sign = (bits >> 16) & 0x8000;
+    bits &= 0x7FFFFFFF;
+
+    uint32_t half;
+    if (bits >= 0x47800000) half = bits > 0x7F800000 ? 0x7E00 : 0x7C00;   // >= 65536, inf, NaN
+    else if (bits < 0x38800000)                                             // below 2^-14: subnormal, the FPU rounds
+    {
+        const uint32_t magicBits = 126u << 23; // 0.5: adding it leaves the half mantissa in the low bits
+        float magic, sum = 0.0f;
+        std::memcpy(&magic, &magicBits, sizeof(magic));
+        std::memcpy(&sum, &bits, sizeof(sum));
+        sum += magic;
+        std::memcpy(&half, &sum, sizeof(half));
+        half -= magicBits;
+    }
+    else
+    {
+        uint32_t odd = (bits >> 13) & 1;
+        bits -= 112u << 23; // rebias the exponent, 127 -> 15
+        half = (bits + 0xFFF + odd) >> 13;
+    }
+    return (uint16_t)(sign | half);
+}
+
+inline int16_t packSnorm16(float value, float range)
+{
+    return (int16_t)std::lround(std::max(-1.0f, std::min(1.0f, value / range)) * 32767.0f);
+}
+
+// position i goes to destination + i * getPositionStride(format)
+inline void packPosition(VertexFormat format, const glm::vec3& position, char* destination)
+{
+    if (format == VertexFormat::CompactHalf)
+    {
+        uint16_t packed[4] = { packHalf(position.x), packHalf(position.y), packHalf(position.z), 0 };
+        std::memcpy(destination, packed, sizeof(packed));
+    }
+    else if (format == VertexFormat::CompactSnorm16)
+    {
+        int16_t packed[4] = { packSnorm16(position.x, SNORM16_POSITION_RANGE), packSnorm16(position.y, SNORM16_POSITION_RANGE),
+                              packSnorm16(position.z, SNORM16_POSITION_RANGE), 0 };
+        std::memcpy(destination, packed, sizeof(packed));
+    }
+    else std::memcpy(destination, &position.x, 3 * sizeof(float));
+}
+
+// vertices [begin, end) of the SoA positions, to the same place in destination
+inline void packPositions(VertexFormat format, const Vec3Streams& positions, char* destination, int begin, int end)
+{
+    int stride = getPositionStride(format);
+    for (int i = begin; i < end; i++) packPosition(format, glm::vec3(positions.x[i], positions.y[i], positions.z[i]), destination + (size_t)i * stride);
+}
+
+// count interleaved xyz floats, e.g. a SimulationThread snapshot
+inline void packPositions(VertexFormat format, const float* positions, char* destination, int count)
+{
+    int stride = getPositionStride(format);
+    for (int i = 0; i < count; i++) packPosition(format, glm::vec3(positions[i*3], positions[i*3 + 1], positions[i*3 + 2]), destination + (size_t)i * stride);
+}
+
+// RGBA8, alpha 255
+inline std::vector<uint32_t> packColors(const std::vector<glm::vec3>& colors)
+{
+    std::vector<uint32_t> packed(colors.size());
+    for (size_t i = 0; i < colors.size(); i++)
+    {
+        glm::vec3 c = glm::clamp(colors[i], 0.0f, 1.0f) * 255.0f + 0.5f;
+        uint8_t rgba[4] = { (uint8_t)c.x, (uint8_t)c.y, (uint8_t)c.z, 255 };
+        std::memcpy(&packed[i], rgba, sizeof(rgba));
+    }
+    return packed;
+}
+
+// 16 bits when allowed and every index but the restarts is below 0xFFFF, else 32; returns the bytes per index
+inline int packIndices(const std::vector<unsigned int>& indices, bool allowShort, std::vector<char>& packed)
+{
+    bool narrow = allowShort;
+    for (unsigned int index : indices) narrow = narrow && (index < 0xFFFF || index == PRIMITIVE_RESTART);
+    int size = narrow ? sizeof(uint16_t) : sizeof(uint32_t);
+    packed.resize(indices.size() * size);
+    if (!narrow)
+    {
+        if (!indices.empty()) std::memcpy(packed.data(), indices.data(), packed.size());
+        return size;
+    }
+    for (size_t i = 0; i < indices.size(); i++)
+    {
+        uint16_t index = indices[i] == PRIMITIVE_RESTART ? 0xFFFF : (uint16_t)indices[i];
+        std::memcpy(&packed[i * size], &index, size);
+    }
+    return size;
+}
+
+#endif
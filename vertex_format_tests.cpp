@@ -0,0 +1,96 @@
+#include "regression_tests.h"
+#include "vertex_format.h"
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <vector>
+
+namespace
+{
+    template<typename T> bool expectPacked(T packed, T expected, float value, const char* what)
+    {
+        if (packed == expected) return true;
+        std::cout << "FAIL " << what << "(" << value << ") = " << std::hex << packed << ", expected " << expected << std::dec << std::endl;
+        return false;
+    }
+}
+
+// vertex-packing: packHalf rounds to nearest even through the subnormals and at the overflow edge, packSnorm16
+// clamps to the range, packIndices narrows only when no index collides with the 16-bit restart
+int testVertexPacking()
+{
+    struct HalfCase { float value; uint16_t half; };
+    const HalfCase halves[] = {
+        { 0.0f, 0x0000 }, { -0.0f, 0x8000 }, { 1.0f, 0x3C00 }, { -2.0f, 0xC000 },
+        { 1.0f + std::ldexp(1.0f, -11), 0x3C00 },   // halfway, down to the even mantissa
+        { 1.0f + std::ldexp(3.0f, -11), 0x3C02 },   // halfway, up to the even mantissa
+        { 65504.0f, 0x7BFF }, { 65519.0f, 0x7BFF }, // largest half, and just below the halfway point to 65536
+        { 65520.0f, 0x7C00 }, { 1e6f, 0x7C00 },     // rounds past the largest half to infinity
+        { INFINITY, 0x7C00 }, { -INFINITY, 0xFC00 }, { std::numeric_limits<float>::quiet_NaN(), 0x7E00 },
+        { std::ldexp(1.0f, -14), 0x0400 },          // smallest normal
+        { std::ldexp(2047.0f, -25), 0x0400 },       // halfway from the largest subnormal, up to the even normal
+        { std::ldexp(1023.0f, -24), 0x03FF },       // largest subnormal
+        { std::ldexp(1.0f, -24), 0x0001 },          // smallest subnormal
+        { std::ldexp(3.0f, -26), 0x0001 }, { std::ldexp(1.0f, -25), 0x0000 }, { -std::ldexp(1.0f, -26), 0x8000 },
+    };
+    bool pass = true;
+    for (const HalfCase& c : halves) pass &= expectPacked(packHalf(c.value), c.half, c.value, "packHalf");
+
+    struct SnormCase { float value; int16_t snorm; };
+    const float range = SNORM16_POSITION_RANGE;
+    const SnormCase snorms[] = {
+        { 0.0f, 0 }, { range, 32767 }, { -range, -32767 }, { 10.0f * range, 32767 }, { -10.0f * range, -32767 },
+        { 0.5f * range, 16384 }, { -0.5f * range, -16384 }, { range / 32767.0f * 0.49f, 0 }, { range / 32767.0f * 0.51f, 1 },
+    };
+    for (const SnormCase& c : snorms) pass &= expectPacked(packSnorm16(c.value, range), c.snorm, c.value, "packSnorm16");
+
+    // a position in both compact formats: 8 bytes, the fourth component zero
+    char packed[8];
+    std::memset(packed, 0x55, sizeof(packed));
+    packPosition(VertexFormat::CompactHalf, glm::vec3(1.0f, -2.0f, 0.0f), packed);
+    uint16_t halfPosition[4];
+    std::memcpy(halfPosition, packed, sizeof(packed));
+    pass &= expectPacked(halfPosition[1], (uint16_t)0xC000, -2.0f, "CompactHalf y") && expectPacked(halfPosition[3], (uint16_t)0, 0.0f, "CompactHalf w");
+    std::memset(packed, 0x55, sizeof(packed));
+    packPosition(VertexFormat::CompactSnorm16, glm::vec3(range, -range, 0.0f), packed);
+    int16_t snormPosition[4];
+    std::memcpy(snormPosition, packed, sizeof(packed));
+    pass &= expectPacked(snormPosition[1], (int16_t)-32767, -range, "CompactSnorm16 y") && expectPacked(snormPosition[3], (int16_t)0, 0.0f, "CompactSnorm16 w");
+
+    struct IndexCase { std::vector<unsigned int> indices; bool allowShort; int size; };
+    const IndexCase indexCases[] = {
+        { { 0, 1, 0xFFFE }, true, 2 },                      // largest index that fits
+        { { 0, 1, 0xFFFF }, true, 4 },                      // would read as the restart
+        { { 0, 1, 0x10000 }, true, 4 },
+        { { 0, PRIMITIVE_RESTART, 0xFFFE }, true, 2 },      // restarts narrow to 0xFFFF
+        { { 0, 1, 2 }, false, 4 },
+        { {}, true, 2 },
+    };
+    for (const IndexCase& c : indexCases)
+    {
+        std::vector<char> bytes;
+        int size = packIndices(c.indices, c.allowShort, bytes);
+        bool same = size == c.size && bytes.size() == c.indices.size() * c.size;
+        for (size_t i = 0; same && i < c.indices.size(); i++)
+        {
+            uint16_t narrow;
+            uint32_t index;
+            std::memcpy(size == 2 ? (void*)&narrow : (void*)&index, &bytes[i * size], size);
+            if (size == 2) index = narrow;
+            uint32_t expected = size == 2 && c.indices[i] == PRIMITIVE_RESTART ? 0xFFFF : c.indices[i];
+            same = index == expected;
+        }
+        if (!same)
+        {
+            std::cout << "FAIL packIndices of " << c.indices.size() << " indices ending in " << (c.indices.empty() ? 0 : c.indices.back())
+                      << ": " << size << " bytes each, expected " << c.size << std::endl;
+            pass = false;
+        }
+    }
+    return pass ? 0 : 1;
+}
+
+static RegressionCase vertexPacking("vertex-packing", testVertexPacking);
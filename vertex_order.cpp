@@ -0,0 +1,166 @@
+#include "vertex_order.h"
+#include "tissue.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <numeric>
+
+namespace
+{
+    const int MORTON_BITS = 21; // per axis, 63 bits in all
+
+    // spreads the low 21 bits of v so two zero bits follow each one
+    uint64_t spreadBits(uint64_t v)
+    {
+        v &= 0x1fffff;
+        v = (v | v << 32) & 0x1f00000000ffffull;
+        v = (v | v << 16) & 0x1f0000ff0000ffull;
+        v = (v | v << 8) & 0x100f00f00f00f00full;
+        v = (v | v << 4) & 0x10c30c30c30c30c3ull;
+        v = (v | v << 2) & 0x1249249249249249ull;
+        return v;
+    }
+
+    // neighbors of every vertex, compressed rows
+    struct Adjacency
+    {
+        std::vector<int> offsets;
+        std::vector<int> neighbors;
+
+        int degree(int v) const { return offsets[v + 1] - offsets[v]; }
+    };
+
+    Adjacency buildAdjacency(int vertexCount, const std::vector<int>& first, const std::vector<int>& second)
+    {
+        Adjacency graph;
+        graph.offsets.assign(vertexCount + 1, 0);
+        for (size_t e = 0; e < first.size(); e++)
+        {
+            graph.offsets[first[e] + 1]++;
+            graph.offsets[second[e] + 1]++;
+        }
+        for (int v = 0; v < vertexCount; v++) graph.offsets[v + 1] += graph.offsets[v];
+        graph.neighbors.resize(graph.offsets[vertexCount]);
+        std::vector<int> cursor(graph.offsets.begin(), graph.offsets.end() - 1);
+        for (size_t e = 0; e < first.size(); e++)
+        {
+            graph.neighbors[cursor[first[e]]++] = second[e];
+            graph.neighbors[cursor[second[e]]++] = first[e];
+        }
+        return graph;
+    }
+
+    // breadth-first from start, neighbors by ascending degree (Cuthill-McKee order); appends the visit
+    // order to order, counts the levels and returns the index in order where the last level begins.
+    // mark[v] == stamp means v was already reached, by this search or an earlier one using the same stamp
+    size_t breadthFirst(const Adjacency& graph, int start, std::vector<int>& mark, int stamp, std::vector<int>& order, int& levels)
+    {
+        size_t begin = order.size();
+        size_t levelStart = begin;
+        mark[start] = stamp;
+        order.push_back(start);
+        levels = 0;
+        std::vector<int> level;
+        for (size_t head = begin; head < order.size();)
+        {
+            levelStart = head;
+            levels++;
+            size_t levelEnd = order.size();
+            for (; head < levelEnd; head++)
+            {
+                int v = order[head];
+                level.clear();
+                for (int k = graph.offsets[v]; k < graph.offsets[v + 1]; k++)
+                {
+                    int u = graph.neighbors[k];
+                    if (mark[u] == stamp) continue;
+                    mark[u] = stamp;
+                    level.push_back(u);
+                }
+                std::sort(level.begin(), level.end(), [&graph](int a, int b) {
+                    return graph.degree(a) != graph.degree(b) ? graph.degree(a) < graph.degree(b) : a < b;
+                });
+                order.insert(order.end(), level.begin(), level.end());
+            }
+        }
+        return levelStart;
+    }
+}
+
+std::vector<int> computeMortonOrder(const Vec3Streams& positions)
+{
+    int count = (int)positions.size();
+    std::vector<int> newIndex(count);
+    if (count == 0) return newIndex;
+
+    glm::vec3 low = positions.get(0), high = low;
+    for (int i = 1; i < count; i++)
+    {
+        low = glm::min(low, positions.get(i));
+        high = glm::max(high, positions.get(i));
+    }
+    glm::vec3 extent = high - low;
+    glm::vec3 scale;
+    for (int a = 0; a < 3; a++) scale[a] = extent[a] > 0.0f ? (float)((1 << MORTON_BITS) - 1) / extent[a] : 0.0f;
+
+    // (code, vertex) pairs sorted; the vertex breaks ties so the order is deterministic
+    std::vector<std::pair<uint64_t, int>> keys(count);
+    for (int i = 0; i < count; i++)
+    {
+        glm::vec3 q = (positions.get(i) - low) * scale;
+        uint64_t code = spreadBits((uint64_t)q.x) | spreadBits((uint64_t)q.y) << 1 | spreadBits((uint64_t)q.z) << 2;
+        keys[i] = { code, i };
+    }
+    std::sort(keys.begin(), keys.end());
+    for (int k = 0; k < count; k++) newIndex[keys[k].second] = k;
+    return newIndex;
+}
+
+std::vector<int> computeRcmOrder(int vertexCount, const std::vector<int>& first, const std::vector<int>& second)
+{
+    Adjacency graph = buildAdjacency(vertexCount, first, second);
+
+    // component roots are tried lowest degree first
+    std::vector<int> byDegree(vertexCount);
+    std::iota(byDegree.begin(), byDegree.end(), 0);
+    std::stable_sort(byDegree.begin(), byDegree.end(), [&graph](int a, int b) { return graph.degree(a) < graph.degree(b); });
+
+    std::vector<int> visited(vertexCount, 0);  // 1 once placed in the final order
+    std::vector<int> mark(vertexCount, 0);     // search stamps for the peripheral-vertex probes
+    int stamp = 1;
+    std::vector<int> order, probe;
+    order.reserve(vertexCount);
+    for (int root : byDegree)
+    {
+        if (visited[root]) continue;
+
+        // pseudo-peripheral start (George-Liu): hop to the lowest-degree vertex of the last level
+        // for as long as that makes the search deeper
+        int start = root;
+        int depth = 0;
+        for (int round = 0; round < 8; round++)
+        {
+            probe.clear();
+            int levels;
+            size_t lastLevel = breadthFirst(graph, start, mark, ++stamp, probe, levels);
+            if (round > 0 && levels <= depth) break;
+            depth = levels;
+            int candidate = probe[lastLevel];
+            for (size_t k = lastLevel; k < probe.size(); k++)
+            {
+                if (graph.degree(probe[k]) < graph.degree(candidate)) candidate = probe[k];
+            }
+            if (candidate == start) break;
+            start = candidate;
+        }
+
+        size_t begin = order.size();
+        int levels;
+        breadthFirst(graph, start, visited, 1, order, levels);
+        std::reverse(order.begin() + begin, order.end());
+    }
+
+    std::vector<int> newIndex(vertexCount);
+    for (int k = 0; k < vertexCount; k++) newIndex[order[k]] = k;
+    return newIndex;
+}
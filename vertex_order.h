@@ -0,0 +1,18 @@
+#ifndef VERTEX_ORDER_H
+#define VERTEX_ORDER_H
+
+#include <vector>
+
+struct Vec3Streams;
+
+/*
+    Vertex renumbering for cache locality; each function returns newIndex, newIndex[v] = position of vertex v
+        Morton  sorts vertices along a Z-order curve over their bounding box, so vertices close in
+                space end up close in memory whatever order the file listed them in
+        RCM     reverse Cuthill-McKee over the constraint graph: breadth-first from a peripheral vertex,
+                low-degree neighbors first, then reversed; keeps the index distance along every edge small
+*/
+std::vector<int> computeMortonOrder(const Vec3Streams& positions);
+std::vector<int> computeRcmOrder(int vertexCount, const std::vector<int>& first, const std::vector<int>& second);
+
+#endif
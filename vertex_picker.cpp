@@ -0,0 +1,230 @@
+#include "vertex_picker.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+const int PICK_STACK_SIZE = 64; // > tree depth + 1, the tree is at most 31 levels deep
+
+namespace
+{
+    const float INF = std::numeric_limits<float>::infinity();
+}
+
+VertexPicker::VertexPicker(const Tissue& tissue)
+    : tissue(tissue), version(tissue.getPositionVersion()), lastRefitLeaves(0)
+{
+    leafCount = (tissue.getVertexCount() + PICK_LEAF_SIZE - 1) / PICK_LEAF_SIZE;
+    firstLeaf = 1;
+    while (firstLeaf < leafCount) firstLeaf *= 2;
+    nodes.assign(2 * firstLeaf, Box{ glm::vec3(INF), glm::vec3(-INF) });
+
+    refitLeaves(0, leafCount);
+    lastRefitLeaves = leafCount;
+    for (int k = firstLeaf - 1; k >= 1; k--)
+    {
+        nodes[k].lower = glm::min(nodes[2 * k].lower, nodes[2 * k + 1].lower);
+        nodes[k].upper = glm::max(nodes[2 * k].upper, nodes[2 * k + 1].upper);
+    }
+}
+
+void VertexPicker::refitLeaves(int begin, int end)
+{
+    const float* x = tissue.positions.x.data();
+    const float* y = tissue.positions.y.data();
+    const float* z = tissue.positions.z.data();
+    int count = tissue.getVertexCount();
+    for (int l = begin; l < end; l++)
+    {
+        int first = l * PICK_LEAF_SIZE, last = std::min(first + PICK_LEAF_SIZE, count);
+        Box box = { glm::vec3(x[first], y[first], z[first]), glm::vec3(x[first], y[first], z[first]) };
+        if (last - first == PICK_LEAF_SIZE)
+        {
+            // full leaf: a fixed trip count the compiler unrolls into vector min / max
+            float lower[3] = { x[first], y[first], z[first] }, upper[3] = { x[first], y[first], z[first] };
+            for (int k = 1; k < PICK_LEAF_SIZE; k++)
+            {
+                lower[0] = std::min(lower[0], x[first + k]); upper[0] = std::max(upper[0], x[first + k]);
+                lower[1] = std::min(lower[1], y[first + k]); upper[1] = std::max(upper[1], y[first + k]);
+                lower[2] = std::min(lower[2], z[first + k]); upper[2] = std::max(upper[2], z[first + k]);
+            }
+            box = { glm::vec3(lower[0], lower[1], lower[2]), glm::vec3(upper[0], upper[1], upper[2]) };
+        }
+        else
+        {
+            for (int i = first + 1; i < last; i++)
+            {
+                box.lower = glm::min(box.lower, glm::vec3(x[i], y[i], z[i]));
+                box.upper = glm::max(box.upper, glm::vec3(x[i], y[i], z[i]));
+            }
+        }
+        nodes[firstLeaf + l] = box;
+    }
+}
+
+// Only the changed leaves, then their ancestors level by level; the ancestors of a run of leaves are a run too.
+void VertexPicker::refit()
+{
+    lastRefitLeaves = 0;
+    if (tissue.getPositionVersion() == version) return;
+    tissue.getChangedRanges(version, ranges);
+    version = tissue.getPositionVersion();
+
+    for (const std::pair<int, int>& range : ranges)
+    {
+        int begin = range.first / PICK_LEAF_SIZE, end = (range.second - 1) / PICK_LEAF_SIZE + 1;
+        refitLeaves(begin, end);
+        lastRefitLeaves += end - begin;
+        for (int lo = (firstLeaf + begin) / 2, hi = (firstLeaf + end - 1) / 2; lo >= 1; lo /= 2, hi /= 2)
+        {
+            for (int k = lo; k <= hi; k++)
+            {
+                nodes[k].lower = glm::min(nodes[2 * k].lower, nodes[2 * k + 1].lower);
+                nodes[k].upper = glm::max(nodes[2 * k].upper, nodes[2 * k + 1].upper);
+            }
+        }
+    }
+}
+
+// slab test against the box grown by radius; the entry is clamped to the origin
+float VertexPicker::enterNode(int node, glm::vec3 origin, glm::vec3 inverseDirection, float radius) const
+{
+    const Box& box = nodes[node];
+    if (box.lower.x > box.upper.x) return -1.0f; // padding or empty
+    float enter = 0.0f, leave = INF;
+    for (int a = 0; a < 3; a++)
+    {
+        float lower = box.lower[a] - radius, upper = box.upper[a] + radius;
+        if (std::isinf(inverseDirection[a]))
+        {
+            // parallel to the slab
+            if (origin[a] < lower || origin[a] > upper) return -1.0f;
+            continue;
+        }
+        float t0 = (lower - origin[a]) * inverseDirection[a], t1 = (upper - origin[a]) * inverseDirection[a];
+        enter = std::max(enter, std::min(t0, t1));
+        leave = std::min(leave, std::max(t0, t1));
+    }
+    return enter <= leave ? enter : -1.0f;
+}
+
+// Two walks down the tree, near child first: the first hit along the ray, then the hit closest to the ray up to
+// 2 * radius behind it. Both prune subtrees the ray enters past their limit.
+int VertexPicker::pick(const PickRay& ray) const
+{
+    float length = glm::length(ray.direction);
+    if (length == 0.0f || leafCount == 0) return -1;
+    glm::vec3 direction = ray.direction / length;
+    glm::vec3 inverseDirection = glm::vec3(1.0f) / direction;
+    const Vec3Streams& p = tissue.positions;
+    int count = tissue.getVertexCount();
+    float radius2 = ray.radius * ray.radius;
+
+    float front = INF;
+    int best = -1;
+    float bestDistance2 = INF;
+    for (int pass = 0; pass < 2; pass++)
+    {
+        float limit = pass == 0 ? front : front + 2.0f * ray.radius;
+        std::pair<int, float> stack[PICK_STACK_SIZE];
+        int size = 0;
+        float enter = enterNode(1, ray.origin, inverseDirection, ray.radius);
+        if (enter >= 0.0f) stack[size++] = { 1, enter };
+        while (size > 0)
+        {
+            std::pair<int, float> top = stack[--size];
+            if (top.second > limit) continue;
+            if (top.first >= firstLeaf)
+            {
+                int first = (top.first - firstLeaf) * PICK_LEAF_SIZE, last = std::min(first + PICK_LEAF_SIZE, count);
+                for (int i = first; i < last; i++)
+                {
+                    glm::vec3 offset = p.get(i) - ray.origin;
+                    float t = glm::dot(offset, direction);
+                    float distance2 = glm::dot(offset, offset) - t * t;
+                    if (t < 0.0f || distance2 > radius2 || t > limit) continue;
+                    if (pass == 0) front = limit = t;
+                    else if (distance2 < bestDistance2)
+                    {
+                        best = i;
+                        bestDistance2 = distance2;
+                    }
+                }
+                continue;
+            }
+            int near = 2 * top.first, far = near + 1;
+            float enterNear = enterNode(near, ray.origin, inverseDirection, ray.radius);
+            float enterFar = enterNode(far, ray.origin, inverseDirection, ray.radius);
+            if (enterFar >= 0.0f && (enterNear < 0.0f || enterFar < enterNear))
+            {
+                std::swap(near, far);
+                std::swap(enterNear, enterFar);
+            }
+            if (enterFar >= 0.0f && enterFar <= limit) stack[size++] = { far, enterFar };
+            if (enterNear >= 0.0f && enterNear <= limit) stack[size++] = { near, enterNear };
+        }
+        if (front == INF) return -1;
+    }
+    return best;
+}
+
+void VertexPicker::findWithin(glm::vec3 point, float radius, std::vector<int>& vertices) const
+{
+    vertices.clear();
+    if (leafCount == 0) return;
+    const Vec3Streams& p = tissue.positions;
+    int count = tissue.getVertexCount();
+    float radius2 = radius * radius;
+
+    int stack[PICK_STACK_SIZE];
+    int size = 0;
+    stack[size++] = 1;
+    while (size > 0)
+    {
+        int node = stack[--size];
+        const Box& box = nodes[node];
+        // squared distance from the point to the box, infinite for an empty box
+        glm::vec3 outside = glm::max(glm::max(box.lower - point, point - box.upper), glm::vec3(0.0f));
+        if (box.lower.x > box.upper.x || glm::dot(outside, outside) > radius2) continue;
+        if (node >= firstLeaf)
+        {
+            int first = (node - firstLeaf) * PICK_LEAF_SIZE, last = std::min(first + PICK_LEAF_SIZE, count);
+            for (int i = first; i < last; i++)
+            {
+                glm::vec3 offset = p.get(i) - point;
+                if (glm::dot(offset, offset) <= radius2) vertices.push_back(i);
+            }
+            continue;
+        }
+        // right first, so leaves come off the stack left to right and the vertices in index order
+        stack[size++] = 2 * node + 1;
+        stack[size++] = 2 * node;
+    }
+}
+
+void VertexPicker::getGrabRegion(int center, float falloffRadius, GrabRegion& region) const
+{
+    region.center = center;
+    region.vertices.clear();
+    region.weights.clear();
+    if (center < 0) return;
+    if (falloffRadius <= 0.0f)
+    {
+        if (tissue.isVertexFixed(center)) return;
+        region.vertices.push_back(center);
+        region.weights.push_back(1.0f);
+        return;
+    }
+
+    glm::vec3 origin = tissue.positions.get(center);
+    std::vector<int> within;
+    findWithin(origin, falloffRadius, within);
+    for (int i : within)
+    {
+        if (tissue.isVertexFixed(i)) continue; // already pinned, a release must not free it
+        float s = glm::length(tissue.positions.get(i) - origin) / falloffRadius;
+        float falloff = 1.0f - s * s;
+        region.vertices.push_back(i);
+        region.weights.push_back(i == center ? 1.0f : falloff * falloff);
+    }
+}
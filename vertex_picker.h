@@ -0,0 +1,80 @@
+#ifndef VERTEX_PICKER_H
+#define VERTEX_PICKER_H
+
+#include "tissue.h"
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+const int PICK_LEAF_SIZE = 16;  // consecutive vertices per leaf box
+
+// vertices within radius of the line origin + t * direction, t >= 0, are hit; direction need not be unit length
+struct PickRay
+{
+    glm::vec3 origin;
+    glm::vec3 direction;
+    float radius;
+};
+
+// what a grab holds (see Tissue::grab): the free vertices within the falloff radius of the picked one
+struct GrabRegion
+{
+    int center = -1;            // -1: nothing was hit
+    std::vector<int> vertices;  // in index order
+    std::vector<float> weights; // 1 at the center, falling smoothly to 0 at the falloff radius
+};
+
+/*
+    VertexPicker (ray and point queries over a Tissue's current positions)
+        a bounding volume hierarchy over the vertex order: leaf l boxes vertices [l * PICK_LEAF_SIZE, (l + 1) *
+        PICK_LEAF_SIZE), and node k of the implicit binary tree boxes its children 2k and 2k + 1. The vertex
+        orders Tissue builds (grid rows, Morton, RCM) keep neighbouring indices close in space, and a deforming
+        sheet keeps its neighbours, so the tree is never rebuilt, only refitted.
+        refit() reboxes the leaves in Tissue::getChangedRanges since the last refit and the nodes above them, so
+        sleeping tiles cost nothing. Queries read the positions, so refit after the tissue moved and before asking.
+        Holds the tissue; not thread-safe against a step running on it.
+*/
+class VertexPicker
+{
+    public:
+    // boxes every vertex
+    explicit VertexPicker(const Tissue& tissue);
+
+    void refit();
+    // leaves reboxed by the last refit
+    int getLastRefitLeaves() const { return lastRefitLeaves; }
+    int getLeafCount() const { return leafCount; }
+
+    // the vertex closest to the ray among those hit on its front layer (no further along the ray than 2 * radius
+    // past the first hit), so a click picks what is under it rather than whatever is nearest the camera; -1 when
+    // nothing is within radius
+    int pick(const PickRay& ray) const;
+    // every vertex within radius of point, in index order
+    void findWithin(glm::vec3 point, float radius, std::vector<int>& vertices) const;
+    // the free vertices within falloffRadius of center, weighted (1 - (d / falloffRadius)^2)^2, the center itself 1;
+    // falloffRadius 0 holds the center alone. Empty for center -1
+    void getGrabRegion(int center, float falloffRadius, GrabRegion& region) const;
+
+    private:
+    struct Box
+    {
+        glm::vec3 lower;
+        glm::vec3 upper;
+    };
+
+    const Tissue& tissue;
+    int leafCount;
+    int firstLeaf;              // node of leaf 0, a power of two; node 1 is the root, padding leaves stay empty
+    std::vector<Box> nodes;
+    uint64_t version;           // Tissue::getPositionVersion as of the last refit
+    int lastRefitLeaves;
+    std::vector<std::pair<int, int>> ranges; // scratch
+
+    void refitLeaves(int begin, int end);
+    // entry of the ray into the node's box grown by radius, -1 when it misses
+    float enterNode(int node, glm::vec3 origin, glm::vec3 inverseDirection, float radius) const;
+};
+
+#endif
@@ -0,0 +1,123 @@
+#include "regression_tests.h"
+#include "vertex_picker.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace
+{
+    // deterministic uniform floats in [0, 1)
+    struct Random
+    {
+        uint32_t state = 12345;
+        float next()
+        {
+            state = state * 1664525u + 1013904223u;
+            return (state >> 8) * (1.0f / 16777216.0f);
+        }
+    };
+
+    // pick by scanning every vertex, with the same arithmetic: the closest to the ray among the hits no further than
+    // 2 * radius past the first; false when nothing is hit, else its squared distance (rounding may make it negative)
+    bool scanPick(const Tissue& tissue, const PickRay& ray, float& best)
+    {
+        glm::vec3 direction = ray.direction / glm::length(ray.direction);
+        float radius2 = ray.radius * ray.radius;
+        float front = INFINITY;
+        best = INFINITY;
+        for (int pass = 0; pass < 2; pass++)
+        {
+            for (int i = 0; i < tissue.getVertexCount(); i++)
+            {
+                glm::vec3 offset = tissue.positions.get(i) - ray.origin;
+                float t = glm::dot(offset, direction);
+                float distance2 = glm::dot(offset, offset) - t * t;
+                if (t < 0.0f || distance2 > radius2) continue;
+                if (pass == 0) front = std::min(front, t);
+                else if (t <= front + 2.0f * ray.radius) best = std::min(best, distance2);
+            }
+        }
+        return front != INFINITY;
+    }
+
+    // checks pick and findWithin against a scan over every vertex, for rays and points around the sheet
+    bool expectScan(const Tissue& tissue, const VertexPicker& picker, const char* what)
+    {
+        glm::vec3 lower(INFINITY), upper(-INFINITY);
+        for (int i = 0; i < tissue.getVertexCount(); i++)
+        {
+            lower = glm::min(lower, tissue.positions.get(i));
+            upper = glm::max(upper, tissue.positions.get(i));
+        }
+        glm::vec3 extent = upper - lower + glm::vec3(0.1f);
+        float edge = 1.0f / (EDGE_COUNT - 1);
+        Random random;
+        int hits = 0;
+        std::vector<int> found, scanned;
+        for (int q = 0; q < 500; q++)
+        {
+            glm::vec3 target = lower - glm::vec3(0.05f) + extent * glm::vec3(random.next(), random.next(), random.next());
+            glm::vec3 direction(random.next() - 0.5f, random.next() - 0.5f, 1.0f);
+            PickRay ray = { target - 3.0f * direction, direction, edge * (0.2f + 2.0f * random.next()) };
+            int picked = picker.pick(ray);
+            float expected;
+            bool same = (picked >= 0) == scanPick(tissue, ray, expected);
+            if (same && picked >= 0)
+            {
+                glm::vec3 offset = tissue.positions.get(picked) - ray.origin;
+                float t = glm::dot(offset, direction / glm::length(direction));
+                same = glm::dot(offset, offset) - t * t == expected;
+                hits++;
+            }
+            if (!same)
+            {
+                std::cout << "FAIL " << what << ": ray " << q << " picked " << picked << ", the scan "
+                          << (expected < INFINITY ? "one at squared distance " + std::to_string(expected) : std::string("none")) << std::endl;
+                return false;
+            }
+
+            float radius = edge * 3.0f * random.next();
+            picker.findWithin(target, radius, found);
+            scanned.clear();
+            for (int i = 0; i < tissue.getVertexCount(); i++)
+            {
+                glm::vec3 offset = tissue.positions.get(i) - target;
+                if (glm::dot(offset, offset) <= radius * radius) scanned.push_back(i);
+            }
+            if (found != scanned)
+            {
+                std::cout << "FAIL " << what << ": findWithin " << q << " found " << found.size() << " vertices, the scan " << scanned.size() << std::endl;
+                return false;
+            }
+        }
+        if (hits < 50)
+        {
+            std::cout << "FAIL " << what << ": only " << hits << " rays hit the sheet" << std::endl;
+            return false;
+        }
+        return true;
+    }
+}
+
+// picker: pick and findWithin answer as a scan over every vertex would, on the sheet as built and after refits
+// while it is dragged and swings
+int testPicker()
+{
+    Tissue tissue(EDGE_COUNT, 1);
+    VertexPicker picker(tissue);
+    bool pass = expectScan(tissue, picker, "as built");
+    for (int s = 0; s < STEPS && pass; s++)
+    {
+        drag(tissue, s);
+        tissue.step(DELTA_TIME, GRAVITY);
+        if (s % 20 != 19) continue;
+        picker.refit();
+        pass = expectScan(tissue, picker, s < STEPS / 2 ? "dragged" : "let go");
+    }
+    return pass ? 0 : 1;
+}
+
+static RegressionCase picker("picker", testPicker);
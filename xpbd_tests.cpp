@@ -0,0 +1,47 @@
+#include "regression_tests.h"
+
+#include <algorithm>
+#include <iostream>
+#include <vector>
+
+namespace
+{
+    // largest relative stretch of any constraint after 2 * STEPS steps of a hanging sheet
+    float getSag(Integrator integrator, int iterations, int substeps, float compliance)
+    {
+        Tissue tissue(EDGE_COUNT, 1, 0.001f, integrator);
+        tissue.iterations = iterations;
+        tissue.substeps = substeps;
+        tissue.compliance = compliance;
+        for (int s = 0; s < 2 * STEPS; s++) tissue.step(DELTA_TIME, GRAVITY);
+
+        const std::vector<int>& first = tissue.getConstraintFirst();
+        const std::vector<int>& second = tissue.getConstraintSecond();
+        const std::vector<float>& restLength = tissue.getConstraintRestLength();
+        float stretch = 0.0f;
+        for (size_t c = 0; c < first.size(); c++)
+        {
+            float length = glm::length(tissue.positions.get(first[c]) - tissue.positions.get(second[c]));
+            stretch = std::max(stretch, (length - restLength[c]) / restLength[c]);
+        }
+        return stretch;
+    }
+}
+
+// xpbd-stiffness: for the same 20 sweeps per step, 20 XPBD substeps hold the sheet far stiffer than 20 PBD
+// iterations or fewer, longer substeps; compliance softens it in order
+int testXpbdStiffness()
+{
+    float pbd = getSag(Integrator::PBD, 20, 1, 0.0f);
+    float xpbd = getSag(Integrator::XPBD, 1, 20, 0.0f);
+    float iterated = getSag(Integrator::XPBD, 4, 5, 0.0f);
+    float soft = getSag(Integrator::XPBD, 1, 20, 1e-4f);
+    float softer = getSag(Integrator::XPBD, 1, 20, 1e-3f);
+    std::cout << "stretch: PBD 20 iterations " << pbd << ", XPBD 20 substeps " << xpbd << ", 5 x 4 " << iterated
+              << ", compliance 1e-4 " << soft << ", 1e-3 " << softer << std::endl;
+    bool pass = xpbd * 4.0f < pbd && xpbd < iterated && xpbd < soft && soft < softer;
+    if (!pass) std::cout << "FAIL the stiffness is out of order" << std::endl;
+    return pass ? 0 : 1;
+}
+
+static RegressionCase xpbdStiffness("xpbd-stiffness", testXpbdStiffness);